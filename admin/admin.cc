@@ -47,8 +47,11 @@
 #include "admin/coord_rpc_backup.h"
 #include "admin/coord_rpc_generic.h"
 #include "admin/hyperspace_builder_internal.h"
+#include "admin/pending_hot_keys.h"
 #include "admin/pending_perf_counters.h"
 #include "admin/pending_raw_backup.h"
+#include "admin/pending_slow_ops.h"
+#include "admin/pending_truncate_space.h"
 #include "admin/pending_string.h"
 #include "admin/yieldable.h"
 
@@ -309,6 +312,52 @@ admin :: rm_space(const char* name,
     }
 }
 
+int64_t
+admin :: truncate_space(const char* name,
+                        hyperdex_admin_returncode* status)
+{
+    if (!maintain_coord_connection(status))
+    {
+        return -1;
+    }
+
+    if (!m_config.get_schema(name))
+    {
+        ERROR(NOTFOUND) << "space \"" << name << "\" does not exist";
+        return -1;
+    }
+
+    // every server empties the regions of the space that it holds
+    std::vector<std::pair<server_id, po6::net::location> > addrs;
+    m_config.get_all_addresses(&addrs);
+    uint64_t id = m_next_admin_id;
+    ++m_next_admin_id;
+    e::intrusive_ptr<pending_truncate_space> op = new pending_truncate_space(id, status);
+    e::slice name_s(name, strlen(name) + 1);
+
+    for (size_t i = 0; i < addrs.size(); ++i)
+    {
+        size_t sz = HYPERDEX_ADMIN_HEADER_SIZE_REQ
+                  + pack_size(name_s);
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        msg->pack_at(HYPERDEX_ADMIN_HEADER_SIZE_REQ) << name_s;
+        uint64_t nonce = m_next_server_nonce;
+        ++m_next_server_nonce;
+
+        if (!send(TRUNCATE_SPACE, addrs[i].first, nonce, msg, op.get(), status))
+        {
+            op->handle_unsent(addrs[i].first);
+        }
+    }
+
+    if (op->can_yield())
+    {
+        m_yieldable.push_back(op.get());
+    }
+
+    return op->admin_visible_id();
+}
+
 int64_t
 admin :: mv_space(const char* source, const char* target,
                   hyperdex_admin_returncode* status)
@@ -695,6 +744,93 @@ admin :: disable_perf_counters()
     m_pcs = NULL;
 }
 
+int64_t
+admin :: hot_keys(const char* space, uint64_t limit,
+                  hyperdex_admin_returncode* status,
+                  const char** hot_keys)
+{
+    if (!maintain_coord_connection(status))
+    {
+        return -1;
+    }
+
+    if (!m_config.get_schema(space))
+    {
+        ERROR(NOTFOUND) << "space \"" << space << "\" does not exist";
+        return -1;
+    }
+
+    // every server reports the keys it sampled in the regions it holds
+    std::vector<std::pair<server_id, po6::net::location> > addrs;
+    m_config.get_all_addresses(&addrs);
+    uint64_t id = m_next_admin_id;
+    ++m_next_admin_id;
+    e::intrusive_ptr<pending_hot_keys> op = new pending_hot_keys(id, status, limit, hot_keys);
+    e::slice space_s(space, strlen(space) + 1);
+
+    for (size_t i = 0; i < addrs.size(); ++i)
+    {
+        size_t sz = HYPERDEX_ADMIN_HEADER_SIZE_REQ
+                  + pack_size(space_s)
+                  + sizeof(uint64_t);
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        msg->pack_at(HYPERDEX_ADMIN_HEADER_SIZE_REQ) << space_s << limit;
+        uint64_t nonce = m_next_server_nonce;
+        ++m_next_server_nonce;
+
+        if (!send(HOT_KEYS, addrs[i].first, nonce, msg, op.get(), status))
+        {
+            op->handle_unsent(addrs[i].first);
+        }
+    }
+
+    if (op->can_yield())
+    {
+        m_yieldable.push_back(op.get());
+    }
+
+    return op->admin_visible_id();
+}
+
+int64_t
+admin :: slow_ops(uint64_t limit,
+                  hyperdex_admin_returncode* status,
+                  const char** slow_ops)
+{
+    if (!maintain_coord_connection(status))
+    {
+        return -1;
+    }
+
+    std::vector<std::pair<server_id, po6::net::location> > addrs;
+    m_config.get_all_addresses(&addrs);
+    uint64_t id = m_next_admin_id;
+    ++m_next_admin_id;
+    e::intrusive_ptr<pending_slow_ops> op = new pending_slow_ops(id, status, limit, slow_ops);
+
+    for (size_t i = 0; i < addrs.size(); ++i)
+    {
+        size_t sz = HYPERDEX_ADMIN_HEADER_SIZE_REQ
+                  + sizeof(uint64_t);
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        msg->pack_at(HYPERDEX_ADMIN_HEADER_SIZE_REQ) << limit;
+        uint64_t nonce = m_next_server_nonce;
+        ++m_next_server_nonce;
+
+        if (!send(SLOW_OPS, addrs[i].first, nonce, msg, op.get(), status))
+        {
+            op->handle_unsent(addrs[i].first);
+        }
+    }
+
+    if (op->can_yield())
+    {
+        m_yieldable.push_back(op.get());
+    }
+
+    return op->admin_visible_id();
+}
+
 int64_t
 admin :: loop(int timeout, hyperdex_admin_returncode* status)
 {
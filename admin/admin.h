@@ -76,6 +76,8 @@ class admin
                          enum hyperdex_admin_returncode* status);
         int64_t mv_space(const char* source, const char* target,
                          enum hyperdex_admin_returncode* status);
+        int64_t truncate_space(const char* name,
+                               enum hyperdex_admin_returncode* status);
         int64_t add_index(const char* space, const char* attr,
                           enum hyperdex_admin_returncode* status);
         int64_t list_indices(const char* space, enum hyperdex_admin_returncode* status,
@@ -105,6 +107,14 @@ class admin
         int64_t enable_perf_counters(hyperdex_admin_returncode* status,
                                      hyperdex_admin_perf_counter* pc);
         void disable_perf_counters();
+        // the most frequently read and written keys of a space
+        int64_t hot_keys(const char* space, uint64_t limit,
+                         enum hyperdex_admin_returncode* status,
+                         const char** hot_keys);
+        // the slowest operations the servers have logged
+        int64_t slow_ops(uint64_t limit,
+                         enum hyperdex_admin_returncode* status,
+                         const char** slow_ops);
         // looping/polling
         int64_t loop(int timeout, hyperdex_admin_returncode* status);
         // error handling
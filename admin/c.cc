@@ -193,6 +193,17 @@ hyperdex_admin_mv_space(struct hyperdex_admin* _adm,
     );
 }
 
+HYPERDEX_API int64_t
+hyperdex_admin_truncate_space(struct hyperdex_admin* _adm,
+                              const char* space,
+                              enum hyperdex_admin_returncode* status)
+{
+    C_WRAP_EXCEPT(
+    hyperdex::admin* adm = reinterpret_cast<hyperdex::admin*>(_adm);
+    return adm->truncate_space(space, status);
+    );
+}
+
 HYPERDEX_API int64_t
 hyperdex_admin_list_spaces(struct hyperdex_admin* _adm,
                            enum hyperdex_admin_returncode* status,
@@ -337,6 +348,31 @@ hyperdex_admin_disable_perf_counters(struct hyperdex_admin* _adm)
     return adm->disable_perf_counters();
 }
 
+HYPERDEX_API int64_t
+hyperdex_admin_hot_keys(struct hyperdex_admin* _adm,
+                        const char* space,
+                        uint64_t limit,
+                        enum hyperdex_admin_returncode* status,
+                        const char** hot_keys)
+{
+    C_WRAP_EXCEPT(
+    hyperdex::admin* adm = reinterpret_cast<hyperdex::admin*>(_adm);
+    return adm->hot_keys(space, limit, status, hot_keys);
+    );
+}
+
+HYPERDEX_API int64_t
+hyperdex_admin_slow_ops(struct hyperdex_admin* _adm,
+                        uint64_t limit,
+                        enum hyperdex_admin_returncode* status,
+                        const char** slow_ops)
+{
+    C_WRAP_EXCEPT(
+    hyperdex::admin* adm = reinterpret_cast<hyperdex::admin*>(_adm);
+    return adm->slow_ops(limit, status, slow_ops);
+    );
+}
+
 HYPERDEX_API int64_t
 hyperdex_admin_loop(struct hyperdex_admin* _adm, int timeout,
                     enum hyperdex_admin_returncode* status)
@@ -0,0 +1,226 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+// e
+#include <e/strescape.h>
+
+// HyperDex
+#include "common/network_returncode.h"
+#include "admin/pending_hot_keys.h"
+
+using hyperdex::pending_hot_keys;
+
+namespace
+{
+
+typedef std::pair<std::pair<uint64_t, uint64_t>, std::pair<uint64_t, std::string> > ranked_t;
+
+bool
+hotter(const ranked_t& lhs, const ranked_t& rhs)
+{
+    return lhs.first.first > rhs.first.first;
+}
+
+} // namespace
+
+pending_hot_keys :: pending_hot_keys(uint64_t id,
+                                     hyperdex_admin_returncode* status,
+                                     uint64_t limit,
+                                     const char** store)
+    : pending(id, status)
+    , m_limit(limit)
+    , m_store(store)
+    , m_outstanding(0)
+    , m_failed(false)
+    , m_done(false)
+    , m_keys()
+    , m_string()
+{
+    this->set_status(HYPERDEX_ADMIN_SUCCESS);
+    this->set_error(e::error());
+}
+
+pending_hot_keys :: ~pending_hot_keys() throw ()
+{
+}
+
+bool
+pending_hot_keys :: can_yield()
+{
+    return m_outstanding == 0 && !m_done;
+}
+
+bool
+pending_hot_keys :: yield(hyperdex_admin_returncode* status)
+{
+    *status = HYPERDEX_ADMIN_SUCCESS;
+    m_done = true;
+    std::ostringstream ostr;
+
+    for (uint8_t kind = 0; kind < 2; ++kind)
+    {
+        std::vector<ranked_t> ranked;
+
+        for (std::map<key_t, count_t>::iterator it = m_keys.begin();
+                it != m_keys.end(); ++it)
+        {
+            if (it->first.first.first == kind)
+            {
+                ranked.push_back(ranked_t(it->second,
+                                          std::make_pair(it->first.first.second,
+                                                         it->first.second)));
+            }
+        }
+
+        std::stable_sort(ranked.begin(), ranked.end(), hotter);
+        ranked.resize(std::min(ranked.size(), static_cast<size_t>(m_limit)));
+
+        for (size_t i = 0; i < ranked.size(); ++i)
+        {
+            ostr << (kind == 0 ? "read" : "write")
+                 << " count=" << ranked[i].first.first
+                 << " error=" << ranked[i].first.second
+                 << " region=" << ranked[i].second.first
+                 << " key=\"" << e::strescape(ranked[i].second.second) << "\"\n";
+        }
+    }
+
+    m_string = ostr.str();
+    *m_store = m_string.c_str();
+    return true;
+}
+
+void
+pending_hot_keys :: handle_unsent(const server_id& si)
+{
+    m_failed = true;
+    YIELDING_ERROR(SERVERERROR) << "could not send HOT_KEYS to " << si;
+}
+
+void
+pending_hot_keys :: handle_sent_to(const server_id&)
+{
+    ++m_outstanding;
+}
+
+void
+pending_hot_keys :: handle_failure(const server_id& si)
+{
+    --m_outstanding;
+    m_failed = true;
+    YIELDING_ERROR(SERVERERROR) << "communication with " << si << " failed";
+}
+
+bool
+pending_hot_keys :: handle_message(admin*,
+                                   const server_id& si,
+                                   network_msgtype mt,
+                                   std::auto_ptr<e::buffer> msg,
+                                   e::unpacker up,
+                                   hyperdex_admin_returncode* status)
+{
+    *status = HYPERDEX_ADMIN_SUCCESS;
+    --m_outstanding;
+
+    if (m_failed)
+    {
+        return true;
+    }
+
+    if (mt != HOT_KEYS)
+    {
+        m_failed = true;
+        YIELDING_ERROR(SERVERERROR) << "server " << si << " responded to HOT_KEYS with " << mt;
+        return true;
+    }
+
+    uint16_t rt;
+    uint64_t entries;
+    up = up >> rt >> entries;
+    std::vector<std::pair<key_t, count_t> > keys;
+
+    for (uint64_t i = 0; !up.error() && i < entries; ++i)
+    {
+        region_id ri;
+        uint8_t kind;
+        uint64_t count;
+        uint64_t error;
+        e::slice key;
+        up = up >> ri >> kind >> count >> error >> key;
+        keys.push_back(std::make_pair(key_t(std::make_pair(kind, ri.get()), key.str()),
+                                      count_t(count, error)));
+    }
+
+    if (up.error())
+    {
+        m_failed = true;
+        YIELDING_ERROR(SERVERERROR) << "communication error: server "
+                                    << si << " sent corrupt message="
+                                    << msg->as_slice().hex()
+                                    << " in response to a HOT_KEYS";
+        return true;
+    }
+
+    network_returncode rc = static_cast<network_returncode>(rt);
+
+    if (rc == NET_NOTFOUND)
+    {
+        m_failed = true;
+        YIELDING_ERROR(NOTFOUND) << "server " << si << " does not know the space";
+        return true;
+    }
+    else if (rc != NET_SUCCESS)
+    {
+        m_failed = true;
+        YIELDING_ERROR(SERVERERROR) << "server " << si << " could not report hot keys";
+        return true;
+    }
+
+    // every replica of a region applies every write to it, but each serves
+    // only a share of its reads
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        count_t* c = &m_keys[keys[i].first];
+
+        if (keys[i].first.first.first == 0)
+        {
+            c->first += keys[i].second.first;
+            c->second += keys[i].second.second;
+        }
+        else if (c->first < keys[i].second.first)
+        {
+            *c = keys[i].second;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_admin_pending_hot_keys_h_
+#define hyperdex_admin_pending_hot_keys_h_
+
+// STL
+#include <map>
+#include <string>
+
+// HyperDex
+#include "admin/pending.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// HOT_KEYS goes to every server; once all have answered this merges their
+// samples and yields the hottest keys of the space as text
+class pending_hot_keys : public pending
+{
+    public:
+        pending_hot_keys(uint64_t admin_visible_id,
+                         hyperdex_admin_returncode* status,
+                         uint64_t limit,
+                         const char** store);
+        virtual ~pending_hot_keys() throw ();
+
+    // return to admin
+    public:
+        virtual bool can_yield();
+        virtual bool yield(hyperdex_admin_returncode* status);
+
+    // events
+    public:
+        void handle_unsent(const server_id& si);
+        virtual void handle_sent_to(const server_id& si);
+        virtual void handle_failure(const server_id& si);
+        virtual bool handle_message(admin* adm,
+                                    const server_id& si,
+                                    network_msgtype mt,
+                                    std::auto_ptr<e::buffer> msg,
+                                    e::unpacker up,
+                                    hyperdex_admin_returncode* status);
+
+    private:
+        // 0 for reads or 1 for writes, the region, and the key
+        typedef std::pair<std::pair<uint8_t, uint64_t>, std::string> key_t;
+        typedef std::pair<uint64_t, uint64_t> count_t;
+        pending_hot_keys(const pending_hot_keys& other);
+        pending_hot_keys& operator = (const pending_hot_keys& rhs);
+
+    private:
+        const uint64_t m_limit;
+        const char** m_store;
+        uint64_t m_outstanding;
+        bool m_failed;
+        bool m_done;
+        std::map<key_t, count_t> m_keys;
+        std::string m_string;
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_admin_pending_hot_keys_h_
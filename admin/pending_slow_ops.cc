@@ -0,0 +1,203 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdio.h>
+
+// STL
+#include <algorithm>
+#include <sstream>
+
+// HyperDex
+#include "common/network_returncode.h"
+#include "admin/pending_slow_ops.h"
+
+using hyperdex::pending_slow_ops;
+
+namespace
+{
+
+bool
+slower(const pending_slow_ops::op& lhs, const pending_slow_ops::op& rhs)
+{
+    return lhs.latency > rhs.latency;
+}
+
+} // namespace
+
+pending_slow_ops :: pending_slow_ops(uint64_t id,
+                                     hyperdex_admin_returncode* status,
+                                     uint64_t limit,
+                                     const char** store)
+    : pending(id, status)
+    , m_limit(limit)
+    , m_store(store)
+    , m_outstanding(0)
+    , m_failed(false)
+    , m_done(false)
+    , m_ops()
+    , m_suppressed(0)
+    , m_string()
+{
+    this->set_status(HYPERDEX_ADMIN_SUCCESS);
+    this->set_error(e::error());
+}
+
+pending_slow_ops :: ~pending_slow_ops() throw ()
+{
+}
+
+bool
+pending_slow_ops :: can_yield()
+{
+    return m_outstanding == 0 && !m_done;
+}
+
+bool
+pending_slow_ops :: yield(hyperdex_admin_returncode* status)
+{
+    *status = HYPERDEX_ADMIN_SUCCESS;
+    m_done = true;
+    std::stable_sort(m_ops.begin(), m_ops.end(), slower);
+    m_ops.resize(std::min(m_ops.size(), static_cast<size_t>(m_limit)));
+    std::ostringstream ostr;
+
+    for (size_t i = 0; i < m_ops.size(); ++i)
+    {
+        char when[32];
+        snprintf(when, sizeof(when), "%lu.%06lu",
+                 static_cast<unsigned long>(m_ops[i].when / 1000000000ULL),
+                 static_cast<unsigned long>((m_ops[i].when % 1000000000ULL) / 1000ULL));
+        ostr << "server=" << m_ops[i].server.get()
+             << " time=" << when
+             << " op=" << m_ops[i].type
+             << " space=" << m_ops[i].space
+             << " latency=" << m_ops[i].latency / 1000ULL << "us"
+             << " rows=" << m_ops[i].rows
+             << " bytes=" << m_ops[i].bytes
+             << " plan=\"" << m_ops[i].plan << "\""
+             << " checks=\"" << m_ops[i].checks << "\"\n";
+    }
+
+    if (m_suppressed > 0)
+    {
+        ostr << "suppressed=" << m_suppressed << "\n";
+    }
+
+    m_string = ostr.str();
+    *m_store = m_string.c_str();
+    return true;
+}
+
+void
+pending_slow_ops :: handle_unsent(const server_id& si)
+{
+    m_failed = true;
+    YIELDING_ERROR(SERVERERROR) << "could not send SLOW_OPS to " << si;
+}
+
+void
+pending_slow_ops :: handle_sent_to(const server_id&)
+{
+    ++m_outstanding;
+}
+
+void
+pending_slow_ops :: handle_failure(const server_id& si)
+{
+    --m_outstanding;
+    m_failed = true;
+    YIELDING_ERROR(SERVERERROR) << "communication with " << si << " failed";
+}
+
+bool
+pending_slow_ops :: handle_message(admin*,
+                                   const server_id& si,
+                                   network_msgtype mt,
+                                   std::auto_ptr<e::buffer> msg,
+                                   e::unpacker up,
+                                   hyperdex_admin_returncode* status)
+{
+    *status = HYPERDEX_ADMIN_SUCCESS;
+    --m_outstanding;
+
+    if (m_failed)
+    {
+        return true;
+    }
+
+    if (mt != SLOW_OPS)
+    {
+        m_failed = true;
+        YIELDING_ERROR(SERVERERROR) << "server " << si << " responded to SLOW_OPS with " << mt;
+        return true;
+    }
+
+    uint16_t rt;
+    uint64_t suppressed;
+    uint64_t entries;
+    up = up >> rt >> suppressed >> entries;
+    std::vector<op> ops;
+
+    for (uint64_t i = 0; !up.error() && i < entries; ++i)
+    {
+        op o;
+        e::slice type;
+        e::slice space;
+        e::slice checks;
+        e::slice plan;
+        up = up >> o.when >> o.latency >> o.rows >> o.bytes
+                >> type >> space >> checks >> plan;
+        o.server = si;
+        o.type = type.str();
+        o.space = space.str();
+        o.checks = checks.str();
+        o.plan = plan.str();
+        ops.push_back(o);
+    }
+
+    if (up.error())
+    {
+        m_failed = true;
+        YIELDING_ERROR(SERVERERROR) << "communication error: server "
+                                    << si << " sent corrupt message="
+                                    << msg->as_slice().hex()
+                                    << " in response to a SLOW_OPS";
+        return true;
+    }
+
+    if (static_cast<network_returncode>(rt) != NET_SUCCESS)
+    {
+        m_failed = true;
+        YIELDING_ERROR(SERVERERROR) << "server " << si << " could not report slow operations";
+        return true;
+    }
+
+    m_ops.insert(m_ops.end(), ops.begin(), ops.end());
+    m_suppressed += suppressed;
+    return true;
+}
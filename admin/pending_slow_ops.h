@@ -0,0 +1,101 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_admin_pending_slow_ops_h_
+#define hyperdex_admin_pending_slow_ops_h_
+
+// STL
+#include <string>
+#include <vector>
+
+// HyperDex
+#include "admin/pending.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// SLOW_OPS goes to every server; once all have answered this yields the
+// slowest of the operations they logged as text, slowest first
+class pending_slow_ops : public pending
+{
+    public:
+        pending_slow_ops(uint64_t admin_visible_id,
+                         hyperdex_admin_returncode* status,
+                         uint64_t limit,
+                         const char** store);
+        virtual ~pending_slow_ops() throw ();
+
+    // return to admin
+    public:
+        virtual bool can_yield();
+        virtual bool yield(hyperdex_admin_returncode* status);
+
+    // events
+    public:
+        void handle_unsent(const server_id& si);
+        virtual void handle_sent_to(const server_id& si);
+        virtual void handle_failure(const server_id& si);
+        virtual bool handle_message(admin* adm,
+                                    const server_id& si,
+                                    network_msgtype mt,
+                                    std::auto_ptr<e::buffer> msg,
+                                    e::unpacker up,
+                                    hyperdex_admin_returncode* status);
+
+    public:
+        struct op
+        {
+            op() : server(), when(0), latency(0), rows(0), bytes(0)
+                 , type(), space(), checks(), plan() {}
+            server_id server;
+            uint64_t when;
+            uint64_t latency;
+            uint64_t rows;
+            uint64_t bytes;
+            std::string type;
+            std::string space;
+            std::string checks;
+            std::string plan;
+        };
+
+    private:
+        pending_slow_ops(const pending_slow_ops& other);
+        pending_slow_ops& operator = (const pending_slow_ops& rhs);
+
+    private:
+        const uint64_t m_limit;
+        const char** m_store;
+        uint64_t m_outstanding;
+        bool m_failed;
+        bool m_done;
+        std::vector<op> m_ops;
+        uint64_t m_suppressed;
+        std::string m_string;
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_admin_pending_slow_ops_h_
@@ -0,0 +1,137 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// HyperDex
+#include "common/network_returncode.h"
+#include "admin/pending_truncate_space.h"
+
+using hyperdex::pending_truncate_space;
+
+pending_truncate_space :: pending_truncate_space(uint64_t id,
+                                                 hyperdex_admin_returncode* status)
+    : pending(id, status)
+    , m_outstanding(0)
+    , m_failed(false)
+    , m_done(false)
+{
+    this->set_status(HYPERDEX_ADMIN_SUCCESS);
+    this->set_error(e::error());
+}
+
+pending_truncate_space :: ~pending_truncate_space() throw ()
+{
+}
+
+bool
+pending_truncate_space :: can_yield()
+{
+    return m_outstanding == 0 && !m_done;
+}
+
+bool
+pending_truncate_space :: yield(hyperdex_admin_returncode* status)
+{
+    *status = HYPERDEX_ADMIN_SUCCESS;
+    m_done = true;
+    return true;
+}
+
+void
+pending_truncate_space :: handle_unsent(const server_id& si)
+{
+    m_failed = true;
+    YIELDING_ERROR(SERVERERROR) << "could not send TRUNCATE_SPACE to " << si;
+}
+
+void
+pending_truncate_space :: handle_sent_to(const server_id&)
+{
+    ++m_outstanding;
+}
+
+void
+pending_truncate_space :: handle_failure(const server_id& si)
+{
+    --m_outstanding;
+    m_failed = true;
+    YIELDING_ERROR(SERVERERROR) << "communication with " << si << " failed";
+}
+
+bool
+pending_truncate_space :: handle_message(admin*,
+                                         const server_id& si,
+                                         network_msgtype mt,
+                                         std::auto_ptr<e::buffer> msg,
+                                         e::unpacker up,
+                                         hyperdex_admin_returncode* status)
+{
+    *status = HYPERDEX_ADMIN_SUCCESS;
+    --m_outstanding;
+
+    if (m_failed)
+    {
+        return true;
+    }
+
+    if (mt != TRUNCATE_SPACE)
+    {
+        m_failed = true;
+        YIELDING_ERROR(SERVERERROR) << "server " << si << " responded to TRUNCATE_SPACE with " << mt;
+        return true;
+    }
+
+    uint16_t rt;
+    up = up >> rt;
+
+    if (up.error())
+    {
+        m_failed = true;
+        YIELDING_ERROR(SERVERERROR) << "communication error: server "
+                                    << si << " sent corrupt message="
+                                    << msg->as_slice().hex()
+                                    << " in response to a TRUNCATE_SPACE";
+        return true;
+    }
+
+    network_returncode rc = static_cast<network_returncode>(rt);
+
+    if (rc == NET_NOTFOUND)
+    {
+        m_failed = true;
+        YIELDING_ERROR(NOTFOUND) << "server " << si << " does not know the space";
+        return true;
+    }
+    else if (rc != NET_SUCCESS)
+    {
+        m_failed = true;
+        YIELDING_ERROR(SERVERERROR) << "truncate on server " << si
+                                    << " failed; see the server's log for details";
+        return true;
+    }
+
+    return true;
+}
@@ -96,6 +96,10 @@ class AttributeName(object):
     args = (('const char*', 'attribute'),)
 class IndexID(object):
     args = (('uint64_t', 'idxid'),)
+class HotKeyList(object):
+    args = (('const char*', 'hot_keys'),)
+class SlowOpList(object):
+    args = (('const char*', 'slow_ops'),)
 
 class Method(object):
 
@@ -257,6 +261,7 @@ Admin = [
     Method('add_space', AsyncCall, (SpaceDescription,), (AdminStatus,)),
     Method('rm_space', AsyncCall, (SpaceName,), (AdminStatus,)),
     Method('mv_space', AsyncCall, (SpaceNameSource, SpaceNameTarget), (AdminStatus,)),
+    Method('truncate_space', AsyncCall, (SpaceName,), (AdminStatus,)),
     Method('list_spaces', AsyncCall, (), (AdminStatus, SpaceList)),
     Method('list_indices', AsyncCall, (SpaceName,), (AdminStatus, IndexList)),
     Method('list_subspaces', AsyncCall, (SpaceName,), (AdminStatus, SubspaceList)),
@@ -270,6 +275,8 @@ Admin = [
     Method('backup', AsyncCall, (BackupName,), (AdminStatus, BackupList)),
     Method('enable_perf_counters', AsyncCall, (), (AdminStatus, PerformanceCounters)),
     Method('disable_perf_counters', NoFailCall, (), ()),
+    Method('hot_keys', AsyncCall, (SpaceName, Limit), (AdminStatus, HotKeyList)),
+    Method('slow_ops', AsyncCall, (Limit,), (AdminStatus, SlowOpList)),
 ]
 
 DoNotDocument = ['search_describe']
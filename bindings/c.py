@@ -443,6 +443,14 @@ hyperdex_client_poll_fd(struct hyperdex_client* client);
 int
 hyperdex_client_block(struct hyperdex_client* client, int timeout);
 
+/* resend a GET to a second replica when the first is slower than usual */
+void
+hyperdex_client_set_hedged_reads(struct hyperdex_client* client, int enabled);
+
+/* tag one in every "one_in" atomic operations for tracing; zero disables */
+void
+hyperdex_client_set_trace_sampling(struct hyperdex_client* client, uint64_t one_in);
+
 enum hyperdatatype
 hyperdex_client_attribute_type(struct hyperdex_client* client,
                                const char* space, const char* name,
@@ -774,6 +782,20 @@ hyperdex_client_set_type_conversion(hyperdex_client* _cl, bool enabled)
     cl->set_type_conversion(enabled);
 }
 
+HYPERDEX_API void
+hyperdex_client_set_hedged_reads(hyperdex_client* _cl, int enabled)
+{
+    hyperdex::client* cl = reinterpret_cast<hyperdex::client*>(_cl);
+    cl->set_hedged_reads(enabled != 0);
+}
+
+HYPERDEX_API void
+hyperdex_client_set_trace_sampling(hyperdex_client* _cl, uint64_t one_in)
+{
+    hyperdex::client* cl = reinterpret_cast<hyperdex::client*>(_cl);
+    cl->set_trace_sampling(one_in);
+}
+
 #ifdef __cplusplus
 } // extern "C"
 #endif // __cplusplus
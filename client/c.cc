@@ -2338,6 +2338,20 @@ hyperdex_client_set_type_conversion(hyperdex_client* _cl, bool enabled)
     cl->set_type_conversion(enabled);
 }
 
+HYPERDEX_API void
+hyperdex_client_set_hedged_reads(hyperdex_client* _cl, int enabled)
+{
+    hyperdex::client* cl = reinterpret_cast<hyperdex::client*>(_cl);
+    cl->set_hedged_reads(enabled != 0);
+}
+
+HYPERDEX_API void
+hyperdex_client_set_trace_sampling(hyperdex_client* _cl, uint64_t one_in)
+{
+    hyperdex::client* cl = reinterpret_cast<hyperdex::client*>(_cl);
+    cl->set_trace_sampling(one_in);
+}
+
 #ifdef __cplusplus
 } // extern "C"
 #endif // __cplusplus
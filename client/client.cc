@@ -33,6 +33,9 @@
 // STL
 #include <algorithm>
 
+// po6
+#include <po6/time.h>
+
 // e
 #include <e/intrusive_ptr.h>
 #include <e/strescape.h>
@@ -44,6 +47,7 @@
 #include "visibility.h"
 #include "common/attribute_check.h"
 #include "common/auth_wallet.h"
+#include "common/configuration_delta.h"
 #include "common/datatype_info.h"
 #include "common/documents.h"
 #include "common/funcall.h"
@@ -103,6 +107,11 @@ client :: client(const char* coordinator, uint16_t port)
     , m_macaroons(NULL)
     , m_macaroons_sz(0)
     , m_convert_types(true)
+    , m_latency()
+    , m_hedge_reads(false)
+    , m_hedges()
+    , m_trace_one_in(0)
+    , m_trace_salt(0)
 {
     if (!m_coord)
     {
@@ -135,6 +144,11 @@ client :: client(const char* conn_str)
     , m_macaroons(NULL)
     , m_macaroons_sz(0)
     , m_convert_types(true)
+    , m_latency()
+    , m_hedge_reads(false)
+    , m_hedges()
+    , m_trace_one_in(0)
+    , m_trace_salt(0)
 {
     if (!m_coord)
     {
@@ -423,10 +437,12 @@ client :: perform_funcall(const hyperdex_client_keyop_info* opinfo,
         return -1;
     }
 
+    int64_t client_id = m_next_client_id++;
     e::intrusive_ptr<pending> op;
-    op = new pending_atomic(m_next_client_id++, status);
+    op = new pending_atomic(client_id, status);
     std::auto_ptr<e::buffer> msg;
     auth_wallet aw(m_macaroons, m_macaroons_sz);
+    const uint64_t trace_id = sample_trace(client_id);
     size_t header_sz = HYPERDEX_CLIENT_HEADER_SIZE_REQ
                      + pack_size(key);
     size_t footer_sz = 0;
@@ -436,12 +452,17 @@ client :: perform_funcall(const hyperdex_client_keyop_info* opinfo,
         footer_sz += pack_size(aw);
     }
 
+    if (trace_id)
+    {
+        footer_sz += sizeof(uint64_t);
+    }
+
     int64_t ret = perform_funcall(space, sc, opinfo,
                                   chks, chks_sz,
                                   attrs, attrs_sz,
                                   mapattrs, mapattrs_sz,
                                   header_sz, footer_sz,
-                                  status, &msg);
+                                  trace_id, status, &msg);
 
     if (ret < 0)
     {
@@ -449,10 +470,16 @@ client :: perform_funcall(const hyperdex_client_keyop_info* opinfo,
     }
 
     msg->pack_at(HYPERDEX_CLIENT_HEADER_SIZE_REQ) << key;
+    e::packer pa = msg->pack_at(msg->capacity() - footer_sz);
 
     if (m_macaroons_sz)
     {
-        msg->pack_at(msg->capacity() - footer_sz) << aw;
+        pa = pa << aw;
+    }
+
+    if (trace_id)
+    {
+        pa = pa << trace_id;
     }
 
     return send_keyop(space, key, REQ_ATOMIC, msg, op, status);
@@ -476,7 +503,7 @@ client :: perform_group_funcall(const hyperdex_client_keyop_info* opinfo,
                           chks, chks_sz,
                           attrs, attrs_sz,
                           mapattrs, mapattrs_sz,
-                          0, 0, status, &inner_msg);
+                          0, 0, 0, status, &inner_msg);
 
     if (ret < 0)
     {
@@ -499,6 +526,7 @@ client :: loop(int timeout, hyperdex_client_returncode* status)
 {
     *status = HYPERDEX_CLIENT_SUCCESS;
     m_last_error = e::error();
+    const uint64_t started = po6::monotonic_time();
 
     while (m_yielding ||
            !m_failed.empty() ||
@@ -553,9 +581,34 @@ client :: loop(int timeout, hyperdex_client_returncode* status)
             return -1;
         }
 
+        int recv_timeout = timeout;
+        bool hedge_wait = false;
+
+        if (!m_hedges.empty())
+        {
+            int until = send_hedges();
+
+            if (!m_failed.empty())
+            {
+                continue;
+            }
+
+            if (timeout >= 0)
+            {
+                uint64_t elapsed = (po6::monotonic_time() - started) / 1000000ULL;
+                recv_timeout = elapsed < uint64_t(timeout) ? timeout - static_cast<int>(elapsed) : 0;
+            }
+
+            if (until >= 0 && (recv_timeout < 0 || until < recv_timeout))
+            {
+                recv_timeout = until;
+                hedge_wait = true;
+            }
+        }
+
         uint64_t sid_num;
         std::auto_ptr<e::buffer> msg;
-        m_busybee.set_timeout(timeout);
+        m_busybee.set_timeout(recv_timeout);
         busybee_returncode rc = m_busybee.recv(&sid_num, &msg);
         server_id id(sid_num);
 
@@ -567,6 +620,11 @@ client :: loop(int timeout, hyperdex_client_returncode* status)
                 ERROR(INTERRUPTED) << "signal received";
                 return -1;
             case BUSYBEE_TIMEOUT:
+                if (hedge_wait)
+                {
+                    continue;
+                }
+
                 ERROR(TIMEOUT) << "operation timed out";
                 return -1;
             case BUSYBEE_DISRUPTED:
@@ -609,10 +667,21 @@ client :: loop(int timeout, hyperdex_client_returncode* status)
         const pending_server_pair psp(it->second);
         e::intrusive_ptr<pending> op = psp.op;
         m_pending_ops.erase(it);
+        m_hedges.erase(nonce);
 
         if (msg_type == CONFIGMISMATCH)
         {
-            m_failed.push_back(psp);
+            if (psp.started)
+            {
+                m_latency.abandoned(psp.si, 0);
+            }
+
+            // the other copy of a hedged read may still succeed
+            if (!detach_sibling(psp))
+            {
+                m_failed.push_back(psp);
+            }
+
             continue;
         }
 
@@ -620,6 +689,24 @@ client :: loop(int timeout, hyperdex_client_returncode* status)
             id == psp.si &&
             m_config.get_server_id(vfrom) == id)
         {
+            const uint64_t now = psp.started ? po6::monotonic_time() : 0;
+
+            if (psp.started)
+            {
+                m_latency.received(psp.si, now - psp.started);
+            }
+
+            // first answer wins; forget the slower copy of a hedged read
+            pending_map_t::iterator sib = psp.sibling
+                                        ? m_pending_ops.find(psp.sibling)
+                                        : m_pending_ops.end();
+
+            if (sib != m_pending_ops.end())
+            {
+                m_latency.abandoned(sib->second.si, now - sib->second.started);
+                m_pending_ops.erase(sib);
+            }
+
             if (!op->handle_message(this, id, vfrom, msg_type, msg, up, status, &m_last_error))
             {
                 return -1;
@@ -1047,6 +1134,7 @@ client :: perform_funcall(const char* space, const schema* sc,
                           const hyperdex_client_map_attribute* mapattrs, size_t mapattrs_sz,
                           size_t header_sz,
                           size_t footer_sz,
+                          uint64_t trace_id,
                           hyperdex_client_returncode* status,
                           std::auto_ptr<e::buffer>* msg)
 {
@@ -1089,11 +1177,29 @@ client :: perform_funcall(const char* space, const schema* sc,
     uint8_t flags = (opinfo->fail_if_not_found ? 1 : 0)
                   | (opinfo->fail_if_found ? 2 : 0)
                   | (opinfo->erase ? 0 : 128)
-                  | (m_macaroons_sz ? 64 : 0);
+                  | (m_macaroons_sz ? 64 : 0)
+                  | (trace_id ? 32 : 0);
     (*msg)->pack_at(header_sz) << flags << checks << funcs;
     return 0;
 }
 
+uint64_t
+client :: sample_trace(int64_t client_id)
+{
+    if (m_trace_one_in == 0 || client_id % m_trace_one_in != 0)
+    {
+        return 0;
+    }
+
+    // mix the id with this client's salt so that ids from different clients
+    // do not collide
+    uint64_t x = m_trace_salt + static_cast<uint64_t>(client_id) * 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x = x ^ (x >> 31);
+    return x ? x : 1;
+}
+
 int64_t
 client :: perform_aggregation(const std::vector<virtual_server_id>& servers,
                               e::intrusive_ptr<pending_aggregation> _op,
@@ -1132,7 +1238,7 @@ client :: maintain_coord_connection(hyperdex_client_returncode* status)
     if (m_config_id < 0)
     {
         m_config_status = REPLICANT_SUCCESS;
-        m_config_id = replicant_client_cond_follow(m_coord, "hyperdex", "config",
+        m_config_id = replicant_client_cond_follow(m_coord, "hyperdex", "config_delta",
                                                    &m_config_status, &m_config_state,
                                                    &m_config_data, &m_config_data_sz);
         if (replicant_client_wait(m_coord, m_config_id, -1, &rc) < 0)
@@ -1158,13 +1264,16 @@ client :: maintain_coord_connection(hyperdex_client_returncode* status)
 
     if (m_config.version() < m_config_state)
     {
-        configuration new_config;
+        configuration_delta delta;
         e::unpacker up(m_config_data, m_config_data_sz);
-        up = up >> new_config;
+        up = up >> delta;
 
-        if (!up.error())
+        // a delta only applies to the version right before it; after a
+        // missed broadcast, or on the first one, start from a full copy
+        if ((up.error() || !m_config.apply_delta(delta)) &&
+            !fetch_configuration(status))
         {
-            m_config = new_config;
+            return false;
         }
 
         pending_map_t::iterator it = m_pending_ops.begin();
@@ -1189,6 +1298,42 @@ client :: maintain_coord_connection(hyperdex_client_returncode* status)
     return true;
 }
 
+bool
+client :: fetch_configuration(hyperdex_client_returncode* status)
+{
+    replicant_returncode rc = REPLICANT_GARBAGE;
+    replicant_returncode lrc = REPLICANT_GARBAGE;
+    char* data = NULL;
+    size_t data_sz = 0;
+    int64_t id = replicant_client_call(m_coord, "hyperdex", "config_get", NULL, 0,
+                                       REPLICANT_CALL_ROBUST, &rc, &data, &data_sz);
+
+    bool ok = id >= 0 &&
+              replicant_client_wait(m_coord, id, -1, &lrc) >= 0 &&
+              rc == REPLICANT_SUCCESS;
+    configuration new_config;
+    e::unpacker up(data, ok ? data_sz : 0);
+    up = up >> new_config;
+
+    if (data)
+    {
+        free(data);
+    }
+
+    if (!ok)
+    {
+        ERROR(COORDFAIL) << "coordinator failure: " << replicant_client_error_message(m_coord);
+        return false;
+    }
+
+    if (!up.error())
+    {
+        m_config = new_config;
+    }
+
+    return true;
+}
+
 bool
 client :: send(network_msgtype mt,
                const virtual_server_id& to,
@@ -1237,7 +1382,21 @@ client :: send_keyop(const char* space,
                      e::intrusive_ptr<pending> op,
                      hyperdex_client_returncode* status)
 {
-    virtual_server_id vsi = m_config.point_leader(space, key);
+    virtual_server_id vsi;
+    virtual_server_id alternate;
+    const bool read = mt == REQ_GET || mt == REQ_GET_PARTIAL;
+
+    // spread reads over every replica of the key, preferring the ones that
+    // have been answering quickly; the servers make sure the result is no
+    // older than what the tail would return
+    if (read)
+    {
+        choose_read_replicas(space, key, &vsi, &alternate);
+    }
+    else
+    {
+        vsi = m_config.point_leader(space, key);
+    }
 
     if (vsi == virtual_server_id())
     {
@@ -1249,9 +1408,32 @@ client :: send_keyop(const char* space,
     }
 
     int64_t nonce = m_next_server_nonce++;
+    e::compat::shared_ptr<e::buffer> hedge;
+
+    if (read && m_hedge_reads &&
+        alternate != virtual_server_id() &&
+        m_latency.hedge_delay() > 0)
+    {
+        hedge.reset(msg->copy());
+    }
 
     if (send(mt, vsi, nonce, msg, op, status))
     {
+        if (read)
+        {
+            track_read(nonce);
+        }
+
+        if (hedge.get())
+        {
+            hedged_read hr;
+            hr.deadline = m_pending_ops[nonce].started + m_latency.hedge_delay();
+            hr.mt = mt;
+            hr.alternate = alternate;
+            hr.msg = hedge;
+            m_hedges[nonce] = hr;
+        }
+
         return op->client_visible_id();
     }
     else
@@ -1270,10 +1452,21 @@ client :: handle_disruption(const server_id& si)
     {
         if (it->second.si == si)
         {
-            m_failed.push_back(it->second);
+            const pending_server_pair psp(it->second);
+            m_hedges.erase(it->first);
             pending_map_t::iterator tmp = it;
             ++it;
             m_pending_ops.erase(tmp);
+
+            if (psp.started)
+            {
+                m_latency.abandoned(si, po6::monotonic_time() - psp.started);
+            }
+
+            if (!detach_sibling(psp))
+            {
+                m_failed.push_back(psp);
+            }
         }
         else
         {
@@ -1284,6 +1477,130 @@ client :: handle_disruption(const server_id& si)
     m_busybee.drop(si.get());
 }
 
+void
+client :: choose_read_replicas(const char* space, const e::slice& key,
+                               virtual_server_id* best,
+                               virtual_server_id* alternate)
+{
+    std::vector<virtual_server_id> replicas;
+    m_config.read_replicas(space, key, &replicas);
+    *best = virtual_server_id();
+    *alternate = virtual_server_id();
+    uint64_t best_score = 0;
+    uint64_t alternate_score = 0;
+
+    // start somewhere different each time so that ties spread the load
+    for (size_t i = 0; i < replicas.size(); ++i)
+    {
+        const virtual_server_id vsi = replicas[(m_next_server_nonce + i) % replicas.size()];
+        const uint64_t score = m_latency.score(m_config.get_server_id(vsi));
+
+        if (*best == virtual_server_id() || score < best_score)
+        {
+            *alternate = *best;
+            alternate_score = best_score;
+            *best = vsi;
+            best_score = score;
+        }
+        else if (*alternate == virtual_server_id() || score < alternate_score)
+        {
+            *alternate = vsi;
+            alternate_score = score;
+        }
+    }
+}
+
+void
+client :: track_read(uint64_t nonce)
+{
+    pending_map_t::iterator it = m_pending_ops.find(nonce);
+    assert(it != m_pending_ops.end());
+    it->second.started = po6::monotonic_time();
+    m_latency.sent(it->second.si);
+}
+
+bool
+client :: detach_sibling(const pending_server_pair& psp)
+{
+    if (psp.sibling == 0)
+    {
+        return false;
+    }
+
+    pending_map_t::iterator it = m_pending_ops.find(psp.sibling);
+
+    if (it == m_pending_ops.end())
+    {
+        return false;
+    }
+
+    it->second.sibling = 0;
+    return true;
+}
+
+int
+client :: send_hedges()
+{
+    const uint64_t now = po6::monotonic_time();
+    uint64_t next = 0;
+    hedge_map_t::iterator it = m_hedges.begin();
+
+    while (it != m_hedges.end())
+    {
+        if (it->second.deadline > now)
+        {
+            if (next == 0 || it->second.deadline < next)
+            {
+                next = it->second.deadline;
+            }
+
+            ++it;
+            continue;
+        }
+
+        const uint64_t original = it->first;
+        const hedged_read hr(it->second);
+        m_hedges.erase(it++);
+        pending_map_t::iterator orig = m_pending_ops.find(original);
+
+        if (orig == m_pending_ops.end())
+        {
+            continue;
+        }
+
+        e::intrusive_ptr<pending> op = orig->second.op;
+        const uint64_t nonce = m_next_server_nonce++;
+        std::auto_ptr<e::buffer> msg(hr.msg->copy());
+        // a failed hedge is not the caller's error; the original is still
+        // outstanding and will be reported on its own
+        const e::error saved(m_last_error);
+        hyperdex_client_returncode status;
+
+        if (send(hr.mt, hr.alternate, nonce, msg, op, &status))
+        {
+            track_read(nonce);
+            // sending may have disrupted the original's server
+            orig = m_pending_ops.find(original);
+
+            if (orig != m_pending_ops.end())
+            {
+                orig->second.sibling = nonce;
+                m_pending_ops[nonce].sibling = original;
+            }
+        }
+
+        m_last_error = saved;
+    }
+
+    if (next == 0)
+    {
+        return -1;
+    }
+
+    // round up so that we never wake before the deadline
+    return (next - now + 999999ULL) / 1000000ULL;
+}
+
 microtransaction* client::uxact_init(const char* space, hyperdex_client_returncode *status)
 {
     if (!maintain_coord_connection(status))
@@ -1517,6 +1834,28 @@ client :: set_type_conversion(bool enabled)
     m_convert_types = enabled;
 }
 
+void
+client :: set_hedged_reads(bool enabled)
+{
+    m_hedge_reads = enabled;
+
+    if (!enabled)
+    {
+        m_hedges.clear();
+    }
+}
+
+void
+client :: set_trace_sampling(uint64_t one_in)
+{
+    m_trace_one_in = one_in;
+
+    if (m_trace_salt == 0)
+    {
+        m_trace_salt = po6::wallclock_time() ^ reinterpret_cast<uintptr_t>(this);
+    }
+}
+
 int64_t
 microtransaction::generate_message(size_t header_sz, size_t footer_sz,
                                    const std::vector<attribute_check>& checks,
@@ -34,6 +34,9 @@
 #include <map>
 #include <list>
 
+// e
+#include <e/compat.h>
+
 // BusyBee
 #include <busybee_st.h>
 
@@ -48,6 +51,7 @@
 #include "client/keyop_info.h"
 #include "client/pending.h"
 #include "client/pending_aggregation.h"
+#include "client/server_latency.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 
@@ -176,23 +180,44 @@ class client
                                      hyperdex_client_returncode* status);
         // enable or disable type conversion on the client-side
         void set_type_conversion(bool enabled);
+        // resend slow GETs to a second replica and keep the first answer
+        void set_hedged_reads(bool enabled);
+        // tag one in every "one_in" atomic operations with a trace id; zero
+        // turns tracing off
+        void set_trace_sampling(uint64_t one_in);
 
     private:
         struct pending_server_pair
         {
             pending_server_pair()
-                : si(), vsi(), op() {}
+                : si(), vsi(), op(), started(0), sibling(0) {}
             pending_server_pair(const server_id& s,
                                 const virtual_server_id& v,
                                 const e::intrusive_ptr<pending>& o)
-                : si(s), vsi(v), op(o) {}
+                : si(s), vsi(v), op(o), started(0), sibling(0) {}
             ~pending_server_pair() throw () {}
             server_id si;
             virtual_server_id vsi;
             e::intrusive_ptr<pending> op;
+            // when a read was sent, for latency tracking; zero otherwise
+            uint64_t started;
+            // nonce of the other copy of a hedged read; zero otherwise
+            uint64_t sibling;
         };
         typedef std::map<uint64_t, pending_server_pair> pending_map_t;
         typedef std::list<pending_server_pair> pending_queue_t;
+        // a read that will be resent to alternate if it is still
+        // outstanding at deadline
+        struct hedged_read
+        {
+            hedged_read()
+                : deadline(0), mt(), alternate(), msg() {}
+            uint64_t deadline;
+            network_msgtype mt;
+            virtual_server_id alternate;
+            e::compat::shared_ptr<e::buffer> msg;
+        };
+        typedef std::map<uint64_t, hedged_read> hedge_map_t;
         friend class pending_get;
         friend class pending_get_partial;
         friend class pending_search;
@@ -230,14 +255,19 @@ class client
                                 const hyperdex_client_map_attribute* mapattrs, size_t mapattrs_sz,
                                 size_t header_sz,
                                 size_t footer_sz,
+                                uint64_t trace_id,
                                 hyperdex_client_returncode* status,
                                 std::auto_ptr<e::buffer>* msg);
+        // a fresh trace id if this operation is sampled, zero otherwise
+        uint64_t sample_trace(int64_t client_id);
         int64_t perform_aggregation(const std::vector<virtual_server_id>& servers,
                                     e::intrusive_ptr<pending_aggregation> op,
                                     network_msgtype mt,
                                     std::auto_ptr<e::buffer> msg,
                                     hyperdex_client_returncode* status);
         bool maintain_coord_connection(hyperdex_client_returncode* status);
+        // fetch the whole configuration when a delta cannot be applied
+        bool fetch_configuration(hyperdex_client_returncode* status);
         bool send(network_msgtype mt,
                   const virtual_server_id& to,
                   uint64_t nonce,
@@ -251,6 +281,17 @@ class client
                            e::intrusive_ptr<pending> op,
                            hyperdex_client_returncode* status);
         void handle_disruption(const server_id& si);
+        // order the key's replicas by expected latency
+        void choose_read_replicas(const char* space, const e::slice& key,
+                                  virtual_server_id* best,
+                                  virtual_server_id* alternate);
+        void track_read(uint64_t nonce);
+        // unlink a read from its hedged sibling; returns true if the sibling
+        // is still outstanding and will answer in its place
+        bool detach_sibling(const pending_server_pair& psp);
+        // send every hedge whose deadline has passed, and return how many
+        // milliseconds until the next one is due (-1 if none are waiting)
+        int send_hedges();
 
     private:
         replicant_client* m_coord;
@@ -278,6 +319,13 @@ class client
         const char** m_macaroons;
         size_t m_macaroons_sz;
         bool m_convert_types;
+        // read latency
+        server_latency m_latency;
+        bool m_hedge_reads;
+        hedge_map_t m_hedges;
+        // request tracing
+        uint64_t m_trace_one_in;
+        uint64_t m_trace_salt;
 
     private:
         client(const client&);
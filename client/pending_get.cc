@@ -68,7 +68,8 @@ void
 pending_get :: handle_sent_to(const server_id&,
                               const virtual_server_id&)
 {
-    assert(m_state == INITIALIZED);
+    // hedged reads are sent to more than one replica
+    assert(m_state == INITIALIZED || m_state == SENT);
     m_state = SENT;
 }
 
@@ -25,11 +25,107 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// C
+#include <stdlib.h>
+
+// STL
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
 // HyperDex
 #include "client/pending_search_describe.h"
 
 using hyperdex::pending_search_describe;
 
+namespace
+{
+
+// one iterator's statistics, as "name=value" pairs in the order the daemon
+// wrote them; units such as "ns" are kept aside so the sums print alike
+struct analysis
+{
+    analysis() : iterator(), fields(), units() {}
+    std::string iterator;
+    std::vector<std::pair<std::string, uint64_t> > fields;
+    std::vector<std::string> units;
+};
+
+// pull the per-iterator lines out of one region's description and add them
+// into "merged", matching iterators by their position in the plan
+void
+merge_analysis(const std::string& text, std::vector<analysis>* merged)
+{
+    const std::string marker("\n analyze\n");
+    size_t pos = text.find(marker);
+
+    if (pos == std::string::npos)
+    {
+        return;
+    }
+
+    const bool first = merged->empty();
+    std::istringstream lines(text.substr(pos + marker.size()));
+    std::string line;
+
+    for (size_t idx = 0; std::getline(lines, line); ++idx)
+    {
+        size_t start = line.find(" rows=");
+
+        if (start == std::string::npos)
+        {
+            continue;
+        }
+
+        analysis a;
+        a.iterator = line.substr(0, start);
+        std::istringstream tokens(line.substr(start));
+        std::string token;
+
+        while (tokens >> token)
+        {
+            size_t eq = token.find('=');
+
+            if (eq == std::string::npos)
+            {
+                continue;
+            }
+
+            char* end = NULL;
+            uint64_t value = strtoull(token.c_str() + eq + 1, &end, 10);
+            a.fields.push_back(std::make_pair(token.substr(0, eq), value));
+            a.units.push_back(std::string(end));
+        }
+
+        if (first)
+        {
+            merged->push_back(a);
+            continue;
+        }
+
+        if (idx >= merged->size())
+        {
+            break;
+        }
+
+        analysis* m = &(*merged)[idx];
+
+        if (m->iterator != a.iterator || m->fields.size() != a.fields.size())
+        {
+            // regions picked different plans; keep the first one's shape
+            continue;
+        }
+
+        for (size_t i = 0; i < a.fields.size(); ++i)
+        {
+            m->fields[i].second += a.fields[i].second;
+        }
+    }
+}
+
+} // namespace
+
 pending_search_describe :: pending_search_describe(uint64_t id,
                                                    hyperdex_client_returncode* status,
                                                    const char** description)
@@ -56,9 +152,31 @@ pending_search_describe :: yield(hyperdex_client_returncode* status, e::error* e
 {
     std::ostringstream ostr;
 
+    std::vector<analysis> merged;
+
     for (size_t i = 0; i < m_msgs.size(); ++i)
     {
         ostr << m_msgs[i].first << " " << m_msgs[i].second << "\n";
+        merge_analysis(m_msgs[i].second, &merged);
+    }
+
+    if (!merged.empty())
+    {
+        ostr << "all regions\n";
+
+        for (size_t i = 0; i < merged.size(); ++i)
+        {
+            ostr << merged[i].iterator;
+
+            for (size_t j = 0; j < merged[i].fields.size(); ++j)
+            {
+                ostr << " " << merged[i].fields[j].first
+                     << "=" << merged[i].fields[j].second
+                     << merged[i].units[j];
+            }
+
+            ostr << "\n";
+        }
     }
 
     m_text = ostr.str();
@@ -0,0 +1,143 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// STL
+#include <algorithm>
+
+// HyperDex
+#include "client/server_latency.h"
+
+using hyperdex::server_latency;
+
+// size of the window the p95 is taken over
+const size_t server_latency::SAMPLES = 256;
+// don't hedge on the strength of a handful of reads
+const size_t server_latency::MIN_SAMPLES = 32;
+const size_t server_latency::RECOMPUTE_EVERY = 16;
+
+server_latency :: server_latency()
+    : m_servers()
+    , m_samples()
+    , m_next_sample(0)
+    , m_since_recompute(0)
+    , m_hedge_delay(0)
+{
+}
+
+server_latency :: ~server_latency() throw ()
+{
+}
+
+uint64_t
+server_latency :: score(const server_id& si) const
+{
+    stats_map_t::const_iterator it = m_servers.find(si);
+
+    if (it == m_servers.end())
+    {
+        return 0;
+    }
+
+    // expected time to drain everything queued ahead of us, plus our read
+    return (it->second.ewma + 1) * (it->second.outstanding + 1);
+}
+
+void
+server_latency :: sent(const server_id& si)
+{
+    ++m_servers[si].outstanding;
+}
+
+void
+server_latency :: received(const server_id& si, uint64_t latency)
+{
+    stats* st = &m_servers[si];
+    finished(st);
+
+    if (st->ewma == 0)
+    {
+        st->ewma = latency;
+    }
+    else
+    {
+        // alpha = 1/8
+        st->ewma = st->ewma - st->ewma / 8 + latency / 8;
+    }
+
+    sample(latency);
+}
+
+void
+server_latency :: abandoned(const server_id& si, uint64_t elapsed)
+{
+    stats* st = &m_servers[si];
+    finished(st);
+
+    // only ever push the estimate up; the true latency is at least elapsed
+    if (elapsed > st->ewma)
+    {
+        st->ewma = st->ewma - st->ewma / 8 + elapsed / 8;
+    }
+}
+
+void
+server_latency :: finished(stats* st)
+{
+    if (st->outstanding > 0)
+    {
+        --st->outstanding;
+    }
+}
+
+void
+server_latency :: sample(uint64_t latency)
+{
+    if (m_samples.size() < SAMPLES)
+    {
+        m_samples.push_back(latency);
+    }
+    else
+    {
+        m_samples[m_next_sample] = latency;
+        m_next_sample = (m_next_sample + 1) % SAMPLES;
+    }
+
+    ++m_since_recompute;
+
+    if (m_samples.size() < MIN_SAMPLES ||
+        m_since_recompute < RECOMPUTE_EVERY)
+    {
+        return;
+    }
+
+    std::vector<uint64_t> sorted(m_samples);
+    std::vector<uint64_t>::iterator p95 = sorted.begin() + sorted.size() * 95 / 100;
+    std::nth_element(sorted.begin(), p95, sorted.end());
+    m_hedge_delay = *p95;
+    m_since_recompute = 0;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_client_server_latency_h_
+#define hyperdex_client_server_latency_h_
+
+// STL
+#include <map>
+#include <vector>
+
+// HyperDex
+#include "namespace.h"
+#include "common/ids.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// Tracks how quickly each server has been answering reads so the client can
+// route around slow replicas and decide when a read is worth hedging.  All
+// times are in nanoseconds.
+class server_latency
+{
+    public:
+        server_latency();
+        ~server_latency() throw ();
+
+    public:
+        // lower is better; servers that have never answered score lowest so
+        // that every replica gets sampled at least once
+        uint64_t score(const server_id& si) const;
+        // how long a read may be outstanding before it is worth resending it
+        // to another replica; zero until enough reads have completed
+        uint64_t hedge_delay() const { return m_hedge_delay; }
+        void sent(const server_id& si);
+        void received(const server_id& si, uint64_t latency);
+        // the read will never be answered (or the answer will be ignored);
+        // elapsed is a lower bound on what its latency would have been
+        void abandoned(const server_id& si, uint64_t elapsed);
+
+    private:
+        struct stats
+        {
+            stats() : ewma(0), outstanding(0) {}
+            uint64_t ewma;
+            uint64_t outstanding;
+        };
+        typedef std::map<server_id, stats> stats_map_t;
+        static const size_t SAMPLES;
+        static const size_t MIN_SAMPLES;
+        static const size_t RECOMPUTE_EVERY;
+
+    private:
+        void finished(stats* st);
+        void sample(uint64_t latency);
+
+    private:
+        stats_map_t m_servers;
+        std::vector<uint64_t> m_samples;
+        size_t m_next_sample;
+        size_t m_since_recompute;
+        uint64_t m_hedge_delay;
+
+    private:
+        server_latency(const server_latency&);
+        server_latency& operator = (const server_latency&);
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_client_server_latency_h_
@@ -27,12 +27,17 @@
 
 #define __STDC_LIMIT_MACROS
 
+// C
+#include <string.h>
+
 // STL
 #include <algorithm>
+#include <iterator>
 #include <sstream>
 
 // HyperDex
 #include "common/configuration.h"
+#include "common/configuration_delta.h"
 #include "common/configuration_flags.h"
 #include "common/hash.h"
 #include "common/index.h"
@@ -40,11 +45,13 @@
 #include "common/serialization.h"
 
 using hyperdex::configuration;
+using hyperdex::configuration_delta;
 using hyperdex::index;
 using hyperdex::region_id;
 using hyperdex::schema;
 using hyperdex::server;
 using hyperdex::server_id;
+using hyperdex::space;
 using hyperdex::subspace;
 using hyperdex::subspace_id;
 using hyperdex::virtual_server_id;
@@ -67,6 +74,12 @@ configuration :: configuration()
     , m_point_leaders_by_virtual()
     , m_spaces()
     , m_transfers()
+    , m_subspace_routes()
+    , m_key_routes()
+    , m_virtual_base(0)
+    , m_virtuals()
+    , m_region_base(0)
+    , m_regions()
 {
     refill_cache();
 }
@@ -89,6 +102,12 @@ configuration :: configuration(const configuration& other)
     , m_point_leaders_by_virtual(other.m_point_leaders_by_virtual)
     , m_spaces(other.m_spaces)
     , m_transfers(other.m_transfers)
+    , m_subspace_routes()
+    , m_key_routes()
+    , m_virtual_base(0)
+    , m_virtuals()
+    , m_region_base(0)
+    , m_regions()
 {
     refill_cache();
 }
@@ -172,6 +191,12 @@ configuration :: get_state(const server_id& id) const
 region_id
 configuration :: get_region_id(const virtual_server_id& id) const
 {
+    if (!m_virtuals.empty())
+    {
+        const virtual_entry* ve = dense_virtual(id.get());
+        return region_id(ve ? ve->ri : 0);
+    }
+
     std::vector<pair_uint64_t>::const_iterator it;
     it = std::lower_bound(m_region_ids_by_virtual.begin(),
                           m_region_ids_by_virtual.end(),
@@ -188,6 +213,12 @@ configuration :: get_region_id(const virtual_server_id& id) const
 server_id
 configuration :: get_server_id(const virtual_server_id& id) const
 {
+    if (!m_virtuals.empty())
+    {
+        const virtual_entry* ve = dense_virtual(id.get());
+        return server_id(ve ? ve->si : 0);
+    }
+
     std::vector<pair_uint64_t>::const_iterator it;
     it = std::lower_bound(m_server_ids_by_virtual.begin(),
                           m_server_ids_by_virtual.end(),
@@ -218,6 +249,12 @@ configuration :: get_schema(const char* sname) const
 const schema*
 configuration :: get_schema(const region_id& ri) const
 {
+    if (!m_regions.empty())
+    {
+        const region_entry* re = dense_region(ri.get());
+        return re ? re->sc : NULL;
+    }
+
     std::vector<uint64_schema_t>::const_iterator it;
     it = std::lower_bound(m_schemas_by_region.begin(),
                           m_schemas_by_region.end(),
@@ -234,6 +271,12 @@ configuration :: get_schema(const region_id& ri) const
 const subspace*
 configuration :: get_subspace(const region_id& ri) const
 {
+    if (!m_regions.empty())
+    {
+        const region_entry* re = dense_region(ri.get());
+        return re ? re->ss : NULL;
+    }
+
     std::vector<uint64_subspace_t>::const_iterator it;
     it = std::lower_bound(m_subspaces_by_region.begin(),
                           m_subspaces_by_region.end(),
@@ -247,6 +290,13 @@ configuration :: get_subspace(const region_id& ri) const
     return NULL;
 }
 
+const space*
+configuration :: get_space(const region_id& ri) const
+{
+    const subspace_route* sr = route_for(subspace_of(ri));
+    return sr ? sr->sp : NULL;
+}
+
 virtual_server_id
 configuration :: get_virtual(const region_id& ri, const server_id& si) const
 {
@@ -286,6 +336,12 @@ configuration :: get_virtual(const region_id& ri, const server_id& si) const
 subspace_id
 configuration :: subspace_of(const region_id& ri) const
 {
+    if (!m_regions.empty())
+    {
+        const region_entry* re = dense_region(ri.get());
+        return subspace_id(re ? re->ssid : 0);
+    }
+
     std::vector<pair_uint64_t>::const_iterator it;
     it = std::lower_bound(m_subspace_ids_by_region.begin(),
                           m_subspace_ids_by_region.end(),
@@ -334,6 +390,12 @@ configuration :: subspace_next(const subspace_id& ss) const
 virtual_server_id
 configuration :: head_of_region(const region_id& ri) const
 {
+    if (!m_regions.empty())
+    {
+        const region_entry* re = dense_region(ri.get());
+        return virtual_server_id(re ? re->head : 0);
+    }
+
     std::vector<pair_uint64_t>::const_iterator it;
     it = std::lower_bound(m_heads_by_region.begin(),
                           m_heads_by_region.end(),
@@ -350,6 +412,12 @@ configuration :: head_of_region(const region_id& ri) const
 virtual_server_id
 configuration :: tail_of_region(const region_id& ri) const
 {
+    if (!m_regions.empty())
+    {
+        const region_entry* re = dense_region(ri.get());
+        return virtual_server_id(re ? re->tail : 0);
+    }
+
     std::vector<pair_uint64_t>::const_iterator it;
     it = std::lower_bound(m_tails_by_region.begin(),
                           m_tails_by_region.end(),
@@ -366,6 +434,12 @@ configuration :: tail_of_region(const region_id& ri) const
 virtual_server_id
 configuration :: next_in_region(const virtual_server_id& vsi) const
 {
+    if (!m_virtuals.empty())
+    {
+        const virtual_entry* ve = dense_virtual(vsi.get());
+        return virtual_server_id(ve ? ve->next : 0);
+    }
+
     std::vector<pair_uint64_t>::const_iterator it;
     it = std::lower_bound(m_next_by_virtual.begin(),
                           m_next_by_virtual.end(),
@@ -436,66 +510,114 @@ configuration :: point_leader(const char* sname, const e::slice& key) const
 
         uint64_t h;
         hash(m_spaces[s].sc, key, &h);
+        const region* r = route(m_subspace_routes[m_key_routes[s]], h);
 
-        for (size_t pl = 0; pl < m_spaces[s].subspaces[0].regions.size(); ++pl)
+        if (!r)
         {
-            if (m_spaces[s].subspaces[0].regions[pl].lower_coord[0] <= h &&
-                h <= m_spaces[s].subspaces[0].regions[pl].upper_coord[0])
-            {
-                if (m_spaces[s].subspaces[0].regions[pl].replicas.empty())
-                {
-                    return virtual_server_id();
-                }
+            abort();
+        }
 
-                return m_spaces[s].subspaces[0].regions[pl].replicas[0].vsi;
-            }
+        if (r->replicas.empty())
+        {
+            return virtual_server_id();
         }
 
-        abort();
+        return r->replicas[0].vsi;
     }
 
     return virtual_server_id();
 }
 
-virtual_server_id
-configuration :: point_leader(const region_id& rid, const e::slice& key) const
+void
+configuration :: read_replicas(const char* sname, const e::slice& key,
+                                std::vector<virtual_server_id>* vsis) const
 {
+    vsis->clear();
+
     for (size_t s = 0; s < m_spaces.size(); ++s)
     {
-        for (size_t ss = 0; ss < m_spaces[s].subspaces.size(); ++ss)
+        if (strcmp(sname, m_spaces[s].name) != 0)
         {
-            for (size_t r = 0; r < m_spaces[s].subspaces[ss].regions.size(); ++r)
-            {
-                if (m_spaces[s].subspaces[ss].regions[r].id != rid)
-                {
-                    continue;
-                }
+            continue;
+        }
 
-                uint64_t h;
-                hash(m_spaces[s].sc, key, &h);
+        uint64_t h;
+        hash(m_spaces[s].sc, key, &h);
+        const region* r = route(m_subspace_routes[m_key_routes[s]], h);
 
-                for (size_t pl = 0; pl < m_spaces[s].subspaces[0].regions.size(); ++pl)
-                {
-                    if (m_spaces[s].subspaces[0].regions[pl].lower_coord[0] <= h &&
-                        h <= m_spaces[s].subspaces[0].regions[pl].upper_coord[0])
-                    {
-                        if (m_spaces[s].subspaces[0].regions[pl].replicas.empty())
-                        {
-                            return virtual_server_id();
-                        }
+        if (!r)
+        {
+            abort();
+        }
 
-                        return m_spaces[s].subspaces[0].regions[pl].replicas[0].vsi;
-                    }
-                }
+        for (size_t i = 0; i < r->replicas.size(); ++i)
+        {
+            vsis->push_back(r->replicas[i].vsi);
+        }
 
-                abort();
-            }
+        return;
+    }
+}
+
+virtual_server_id
+configuration :: point_leader(const region_id& rid, const e::slice& key) const
+{
+    const schema* sc = get_schema(rid);
+
+    for (size_t s = 0; sc && s < m_spaces.size(); ++s)
+    {
+        if (&m_spaces[s].sc != sc)
+        {
+            continue;
+        }
+
+        uint64_t h;
+        hash(m_spaces[s].sc, key, &h);
+        const region* r = route(m_subspace_routes[m_key_routes[s]], h);
+
+        if (!r)
+        {
+            abort();
+        }
+
+        if (r->replicas.empty())
+        {
+            return virtual_server_id();
         }
+
+        return r->replicas[0].vsi;
     }
 
     return virtual_server_id();
 }
 
+region_id
+configuration :: key_region(const region_id& rid, const e::slice& key) const
+{
+    const schema* sc = get_schema(rid);
+
+    for (size_t s = 0; sc && s < m_spaces.size(); ++s)
+    {
+        if (&m_spaces[s].sc != sc)
+        {
+            continue;
+        }
+
+        uint64_t h;
+        hash(m_spaces[s].sc, key, &h);
+        const region* r = route(m_subspace_routes[m_key_routes[s]], h);
+
+        if (!r)
+        {
+            abort();
+        }
+
+        return r->id;
+    }
+
+    return region_id();
+}
+
 bool
 configuration :: subspace_adjacent(const virtual_server_id& lhs, const virtual_server_id& rhs) const
 {
@@ -532,6 +654,36 @@ configuration :: mapped_regions(const server_id& si, std::vector<region_id>* ser
     std::sort(servers->begin(), servers->end());
 }
 
+void
+configuration :: space_regions(const server_id& si, std::vector<region_id>* regions) const
+{
+    for (size_t s = 0; s < m_spaces.size(); ++s)
+    {
+        bool found = false;
+        size_t start = regions->size();
+
+        for (size_t ss = 0; ss < m_spaces[s].subspaces.size(); ++ss)
+        {
+            for (size_t r = 0; r < m_spaces[s].subspaces[ss].regions.size(); ++r)
+            {
+                regions->push_back(m_spaces[s].subspaces[ss].regions[r].id);
+
+                for (size_t R = 0; R < m_spaces[s].subspaces[ss].regions[r].replicas.size(); ++R)
+                {
+                    found = found || m_spaces[s].subspaces[ss].regions[r].replicas[R].si == si;
+                }
+            }
+        }
+
+        if (!found)
+        {
+            regions->resize(start);
+        }
+    }
+
+    std::sort(regions->begin(), regions->end());
+}
+
 const hyperdex::index*
 configuration :: get_index(const index_id& ii) const
 {
@@ -700,34 +852,40 @@ configuration :: lookup_region(const subspace_id& ssid,
                                const std::vector<uint64_t>& hashes,
                                region_id* rid) const
 {
-    for (size_t s = 0; s < m_spaces.size(); ++s)
+    const subspace_route* sr = route_for(ssid);
+
+    if (!sr)
     {
-        for (size_t ss = 0; ss < m_spaces[s].subspaces.size(); ++ss)
-        {
-            if (m_spaces[s].subspaces[ss].id != ssid)
-            {
-                continue;
-            }
+        *rid = region_id();
+        return;
+    }
 
-            assert(m_spaces[s].sc.attrs_sz == hashes.size());
+    assert(sr->sp->sc.attrs_sz == hashes.size());
 
-            for (size_t r = 0; r < m_spaces[s].subspaces[ss].regions.size(); ++r)
-            {
-                bool matches = true;
+    if (!sr->lower.empty())
+    {
+        assert(sr->ss->attrs[0] < hashes.size());
+        *rid = route(*sr, hashes[sr->ss->attrs[0]])->id;
+        return;
+    }
 
-                for (size_t a = 0; matches && a < m_spaces[s].subspaces[ss].attrs.size(); ++a)
-                {
-                    assert(a < m_spaces[s].sc.attrs_sz);
-                    matches &= m_spaces[s].subspaces[ss].regions[r].lower_coord[a] <= hashes[m_spaces[s].subspaces[ss].attrs[a]] &&
-                               hashes[m_spaces[s].subspaces[ss].attrs[a]] <= m_spaces[s].subspaces[ss].regions[r].upper_coord[a];
-                }
+    const subspace& ss(*sr->ss);
 
-                if (matches)
-                {
-                    *rid = m_spaces[s].subspaces[ss].regions[r].id;
-                    return;
-                }
-            }
+    for (size_t r = 0; r < ss.regions.size(); ++r)
+    {
+        bool matches = true;
+
+        for (size_t a = 0; matches && a < ss.attrs.size(); ++a)
+        {
+            assert(a < sr->sp->sc.attrs_sz);
+            matches &= ss.regions[r].lower_coord[a] <= hashes[ss.attrs[a]] &&
+                       hashes[ss.attrs[a]] <= ss.regions[r].upper_coord[a];
+        }
+
+        if (matches)
+        {
+            *rid = ss.regions[r].id;
+            return;
         }
     }
 
@@ -1082,6 +1240,215 @@ configuration :: operator = (const configuration& rhs)
     return *this;
 }
 
+namespace
+{
+
+typedef std::pair<uint64_t, uint64_t> pair_uint64_t;
+
+// the lookup table entries that one region or transfer contributes
+struct cache_entries
+{
+    cache_entries()
+        : region_ids_by_virtual(), server_ids_by_virtual()
+        , heads_by_region(), tails_by_region()
+        , next_by_virtual(), point_leaders_by_virtual() {}
+    std::vector<pair_uint64_t> region_ids_by_virtual;
+    std::vector<pair_uint64_t> server_ids_by_virtual;
+    std::vector<pair_uint64_t> heads_by_region;
+    std::vector<pair_uint64_t> tails_by_region;
+    std::vector<pair_uint64_t> next_by_virtual;
+    std::vector<uint64_t> point_leaders_by_virtual;
+};
+
+void
+region_entries(const hyperdex::region& r, bool first_subspace, cache_entries* ce)
+{
+    if (r.replicas.empty())
+    {
+        return;
+    }
+
+    if (first_subspace)
+    {
+        ce->point_leaders_by_virtual.push_back(r.replicas[0].vsi.get());
+    }
+
+    ce->heads_by_region.push_back(std::make_pair(r.id.get(), r.replicas[0].vsi.get()));
+    ce->tails_by_region.push_back(std::make_pair(r.id.get(), r.replicas.back().vsi.get()));
+
+    for (size_t z = 0; z < r.replicas.size(); ++z)
+    {
+        ce->region_ids_by_virtual.push_back(std::make_pair(r.replicas[z].vsi.get(), r.id.get()));
+        ce->server_ids_by_virtual.push_back(std::make_pair(r.replicas[z].vsi.get(), r.replicas[z].si.get()));
+
+        if (z + 1 < r.replicas.size())
+        {
+            ce->next_by_virtual.push_back(std::make_pair(r.replicas[z].vsi.get(),
+                                                         r.replicas[z + 1].vsi.get()));
+        }
+    }
+}
+
+void
+transfer_entries(const hyperdex::transfer& xfer, cache_entries* ce)
+{
+    ce->region_ids_by_virtual.push_back(std::make_pair(xfer.vsrc.get(), xfer.rid.get()));
+    ce->server_ids_by_virtual.push_back(std::make_pair(xfer.vdst.get(), xfer.dst.get()));
+}
+
+// remove the entries in del from the sorted vector v (one occurrence each)
+// and merge in the entries in add, keeping v sorted
+template <typename T>
+void
+patch_sorted(std::vector<T>* v, std::vector<T>* del, std::vector<T>* add)
+{
+    if (del->empty() && add->empty())
+    {
+        return;
+    }
+
+    std::sort(del->begin(), del->end());
+    std::sort(add->begin(), add->end());
+    std::vector<T> kept;
+    kept.reserve(v->size());
+    std::set_difference(v->begin(), v->end(),
+                        del->begin(), del->end(),
+                        std::back_inserter(kept));
+    std::vector<T> merged;
+    merged.reserve(kept.size() + add->size());
+    std::merge(kept.begin(), kept.end(),
+               add->begin(), add->end(),
+               std::back_inserter(merged));
+    v->swap(merged);
+}
+
+bool
+space_name_lt(const hyperdex::space& lhs, const hyperdex::space& rhs)
+{
+    return strcmp(lhs.name, rhs.name) < 0;
+}
+
+} // namespace
+
+bool
+configuration :: apply_delta(const configuration_delta& delta)
+{
+    if (delta.base_version == 0 ||
+        delta.base_version != m_version ||
+        delta.cluster != m_cluster)
+    {
+        return false;
+    }
+
+    // find every region that changed before touching anything
+    std::vector<region*> regions;
+
+    for (size_t i = 0; i < delta.regions.size(); ++i)
+    {
+        std::vector<uint64_subspace_t>::iterator it;
+        it = std::lower_bound(m_subspaces_by_region.begin(),
+                              m_subspaces_by_region.end(),
+                              uint64_subspace_t(delta.regions[i].id.get(), NULL));
+
+        if (it == m_subspaces_by_region.end() || it->first != delta.regions[i].id.get())
+        {
+            return false;
+        }
+
+        region* r = NULL;
+
+        for (size_t j = 0; j < it->second->regions.size(); ++j)
+        {
+            if (it->second->regions[j].id == delta.regions[i].id)
+            {
+                r = &it->second->regions[j];
+                break;
+            }
+        }
+
+        if (!r)
+        {
+            return false;
+        }
+
+        regions.push_back(r);
+    }
+
+    m_version = delta.version;
+    m_flags = delta.flags;
+    m_servers = delta.servers;
+    std::sort(m_servers.begin(), m_servers.end());
+
+    // spaces that were added, dropped or restructured are rare; rebuild
+    if (!delta.removed_spaces.empty() || !delta.spaces.empty())
+    {
+        for (size_t i = 0; i < regions.size(); ++i)
+        {
+            regions[i]->replicas = delta.regions[i].replicas;
+        }
+
+        for (size_t i = 0; i < m_spaces.size(); )
+        {
+            bool drop = std::find(delta.removed_spaces.begin(),
+                                  delta.removed_spaces.end(),
+                                  m_spaces[i].id) != delta.removed_spaces.end();
+
+            for (size_t j = 0; !drop && j < delta.spaces.size(); ++j)
+            {
+                drop = m_spaces[i].id == delta.spaces[j].id;
+            }
+
+            if (drop)
+            {
+                m_spaces.erase(m_spaces.begin() + i);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        m_spaces.insert(m_spaces.end(), delta.spaces.begin(), delta.spaces.end());
+        std::sort(m_spaces.begin(), m_spaces.end(), space_name_lt);
+        m_transfers = delta.transfers;
+        refill_cache();
+        return true;
+    }
+
+    cache_entries del;
+    cache_entries add;
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        subspace_id ss = subspace_of(regions[i]->id);
+        bool first = subspace_prev(ss) == subspace_id();
+        region_entries(*regions[i], first, &del);
+        regions[i]->replicas = delta.regions[i].replicas;
+        region_entries(*regions[i], first, &add);
+    }
+
+    for (size_t i = 0; i < m_transfers.size(); ++i)
+    {
+        transfer_entries(m_transfers[i], &del);
+    }
+
+    m_transfers = delta.transfers;
+
+    for (size_t i = 0; i < m_transfers.size(); ++i)
+    {
+        transfer_entries(m_transfers[i], &add);
+    }
+
+    patch_sorted(&m_region_ids_by_virtual, &del.region_ids_by_virtual, &add.region_ids_by_virtual);
+    patch_sorted(&m_server_ids_by_virtual, &del.server_ids_by_virtual, &add.server_ids_by_virtual);
+    patch_sorted(&m_heads_by_region, &del.heads_by_region, &add.heads_by_region);
+    patch_sorted(&m_tails_by_region, &del.tails_by_region, &add.tails_by_region);
+    patch_sorted(&m_next_by_virtual, &del.next_by_virtual, &add.next_by_virtual);
+    patch_sorted(&m_point_leaders_by_virtual, &del.point_leaders_by_virtual, &add.point_leaders_by_virtual);
+    fill_dense();
+    return true;
+}
+
 void
 configuration :: refill_cache()
 {
@@ -1175,6 +1542,250 @@ configuration :: refill_cache()
     std::sort(m_tails_by_region.begin(), m_tails_by_region.end());
     std::sort(m_next_by_virtual.begin(), m_next_by_virtual.end());
     std::sort(m_point_leaders_by_virtual.begin(), m_point_leaders_by_virtual.end());
+    fill_routes();
+    fill_dense();
+}
+
+void
+configuration :: fill_routes()
+{
+    m_subspace_routes.clear();
+    m_key_routes.clear();
+    std::vector<std::pair<uint64_t, std::pair<size_t, size_t> > > order;
+
+    for (size_t w = 0; w < m_spaces.size(); ++w)
+    {
+        for (size_t x = 0; x < m_spaces[w].subspaces.size(); ++x)
+        {
+            order.push_back(std::make_pair(m_spaces[w].subspaces[x].id.get(),
+                                           std::make_pair(w, x)));
+        }
+    }
+
+    std::sort(order.begin(), order.end());
+    m_subspace_routes.resize(order.size());
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const space& s(m_spaces[order[i].second.first]);
+        const subspace& ss(s.subspaces[order[i].second.second]);
+        subspace_route* sr = &m_subspace_routes[i];
+        sr->id = ss.id.get();
+        sr->sp = &s;
+        sr->ss = &ss;
+
+        if (ss.attrs.size() != 1 || ss.regions.empty())
+        {
+            continue;
+        }
+
+        std::vector<std::pair<uint64_t, const region*> > bounds;
+
+        for (size_t y = 0; y < ss.regions.size(); ++y)
+        {
+            if (ss.regions[y].lower_coord.size() != 1 ||
+                ss.regions[y].upper_coord.size() != 1)
+            {
+                bounds.clear();
+                break;
+            }
+
+            bounds.push_back(std::make_pair(ss.regions[y].lower_coord[0], &ss.regions[y]));
+        }
+
+        std::sort(bounds.begin(), bounds.end());
+        // only an exact tiling of the hash space can be searched by lower
+        // bound alone
+        bool tiles = !bounds.empty() &&
+                     bounds.front().first == 0 &&
+                     bounds.back().second->upper_coord[0] == UINT64_MAX;
+
+        for (size_t b = 0; tiles && b + 1 < bounds.size(); ++b)
+        {
+            tiles = bounds[b].second->upper_coord[0] + 1 == bounds[b + 1].first;
+        }
+
+        if (!tiles)
+        {
+            continue;
+        }
+
+        sr->lower.reserve(bounds.size());
+        sr->regions.reserve(bounds.size());
+
+        for (size_t b = 0; b < bounds.size(); ++b)
+        {
+            sr->lower.push_back(bounds[b].first);
+            sr->regions.push_back(bounds[b].second);
+        }
+    }
+
+    for (size_t w = 0; w < m_spaces.size(); ++w)
+    {
+        assert(!m_spaces[w].subspaces.empty());
+        const subspace_route* sr = route_for(m_spaces[w].subspaces[0].id);
+        assert(sr);
+        m_key_routes.push_back(sr - &m_subspace_routes[0]);
+    }
+}
+
+// dense tables pay off while at least one in four slots is in use
+static bool
+dense_enough(uint64_t lo, uint64_t hi, size_t n)
+{
+    return hi - lo < 4 * n + 64;
+}
+
+void
+configuration :: fill_dense()
+{
+    m_virtual_base = 0;
+    m_virtuals.clear();
+    m_region_base = 0;
+    m_regions.clear();
+
+    if (!m_region_ids_by_virtual.empty() && !m_server_ids_by_virtual.empty())
+    {
+        uint64_t lo = std::min(m_region_ids_by_virtual.front().first,
+                               m_server_ids_by_virtual.front().first);
+        uint64_t hi = std::max(m_region_ids_by_virtual.back().first,
+                               m_server_ids_by_virtual.back().first);
+
+        if (dense_enough(lo, hi, m_server_ids_by_virtual.size()))
+        {
+            m_virtual_base = lo;
+            m_virtuals.resize(hi - lo + 1);
+
+            // the sorted caches may hold a transfer's entry after the
+            // replica's; for every field the first one wins, as with the
+            // lower_bound lookups used when the tables are sparse
+            for (size_t i = 0; i < m_region_ids_by_virtual.size(); ++i)
+            {
+                virtual_entry* ve = &m_virtuals[m_region_ids_by_virtual[i].first - lo];
+                ve->ri = ve->ri ? ve->ri : m_region_ids_by_virtual[i].second;
+            }
+
+            for (size_t i = 0; i < m_server_ids_by_virtual.size(); ++i)
+            {
+                virtual_entry* ve = &m_virtuals[m_server_ids_by_virtual[i].first - lo];
+                ve->si = ve->si ? ve->si : m_server_ids_by_virtual[i].second;
+            }
+
+            for (size_t i = 0; i < m_next_by_virtual.size(); ++i)
+            {
+                virtual_entry* ve = &m_virtuals[m_next_by_virtual[i].first - lo];
+                ve->next = ve->next ? ve->next : m_next_by_virtual[i].second;
+            }
+        }
+    }
+
+    if (!m_subspace_ids_by_region.empty())
+    {
+        uint64_t lo = m_subspace_ids_by_region.front().first;
+        uint64_t hi = m_subspace_ids_by_region.back().first;
+
+        if (dense_enough(lo, hi, m_subspace_ids_by_region.size()))
+        {
+            m_region_base = lo;
+            m_regions.resize(hi - lo + 1);
+
+            for (size_t i = 0; i < m_subspace_ids_by_region.size(); ++i)
+            {
+                region_entry* re = &m_regions[m_subspace_ids_by_region[i].first - lo];
+                re->ssid = m_subspace_ids_by_region[i].second;
+                re->sc = m_schemas_by_region[i].second;
+                re->ss = m_subspaces_by_region[i].second;
+            }
+
+            // as above, the first entry for a region wins
+            for (size_t i = 0; i < m_heads_by_region.size(); ++i)
+            {
+                region_entry* re = &m_regions[m_heads_by_region[i].first - lo];
+                re->head = re->head ? re->head : m_heads_by_region[i].second;
+            }
+
+            for (size_t i = 0; i < m_tails_by_region.size(); ++i)
+            {
+                region_entry* re = &m_regions[m_tails_by_region[i].first - lo];
+                re->tail = re->tail ? re->tail : m_tails_by_region[i].second;
+            }
+        }
+    }
+}
+
+const configuration::subspace_route*
+configuration :: route_for(const subspace_id& ss) const
+{
+    size_t lo = 0;
+    size_t hi = m_subspace_routes.size();
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (m_subspace_routes[mid].id < ss.get())
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo < m_subspace_routes.size() && m_subspace_routes[lo].id == ss.get())
+    {
+        return &m_subspace_routes[lo];
+    }
+
+    return NULL;
+}
+
+const hyperdex::region*
+configuration :: route(const subspace_route& sr, uint64_t h) const
+{
+    if (sr.lower.empty())
+    {
+        for (size_t r = 0; r < sr.ss->regions.size(); ++r)
+        {
+            if (sr.ss->regions[r].lower_coord[0] <= h &&
+                h <= sr.ss->regions[r].upper_coord[0])
+            {
+                return &sr.ss->regions[r];
+            }
+        }
+
+        return NULL;
+    }
+
+    // find the last lower bound <= h without branching on the comparison;
+    // lower[0] is zero, so there always is one
+    const uint64_t* base = &sr.lower[0];
+    size_t n = sr.lower.size();
+
+    while (n > 1)
+    {
+        size_t half = n / 2;
+        base = base[half] <= h ? base + half : base;
+        n -= half;
+    }
+
+    return sr.regions[base - &sr.lower[0]];
+}
+
+const configuration::virtual_entry*
+configuration :: dense_virtual(uint64_t id) const
+{
+    // ids below the base wrap around to large offsets
+    uint64_t off = id - m_virtual_base;
+    return off < m_virtuals.size() ? &m_virtuals[off] : NULL;
+}
+
+const configuration::region_entry*
+configuration :: dense_region(uint64_t id) const
+{
+    uint64_t off = id - m_region_base;
+    return off < m_regions.size() ? &m_regions[off] : NULL;
 }
 
 e::unpacker
@@ -49,6 +49,7 @@
 #include "common/transfer.h"
 
 BEGIN_HYPERDEX_NAMESPACE
+class configuration_delta;
 
 class configuration
 {
@@ -77,6 +78,7 @@ class configuration
         const schema* get_schema(const char* space) const;
         const schema* get_schema(const region_id& ri) const;
         const subspace* get_subspace(const region_id& ri) const;
+        const space* get_space(const region_id& ri) const;
         virtual_server_id get_virtual(const region_id& ri, const server_id& si) const;
         subspace_id subspace_of(const region_id& ri) const;
         subspace_id subspace_prev(const subspace_id& ss) const;
@@ -88,13 +90,20 @@ class configuration
         void key_regions(const server_id& s, std::vector<region_id>* servers) const;
         bool is_point_leader(const virtual_server_id& e) const;
         virtual_server_id point_leader(const char* space, const e::slice& key) const;
+        // every replica in the key's region, in chain order
+        void read_replicas(const char* space, const e::slice& key,
+                           std::vector<virtual_server_id>* replicas) const;
         // point leader for this key in the same space as ri
         virtual_server_id point_leader(const region_id& ri, const e::slice& key) const;
+        // the key subspace region for this key in the same space as ri
+        region_id key_region(const region_id& ri, const e::slice& key) const;
         // lhs and rhs are in adjacent subspaces such that lhs sends CHAIN_PUT
         // to rhs and rhs sends CHAIN_ACK to lhs
         bool subspace_adjacent(const virtual_server_id& lhs, const virtual_server_id& rhs) const;
         // mapped regions -- regions mapped for server "us"
         void mapped_regions(const server_id& s, std::vector<region_id>* servers) const;
+        // every region of every space in which server "us" has a region
+        void space_regions(const server_id& s, std::vector<region_id>* regions) const;
 
     // index metadata
     public:
@@ -139,9 +148,18 @@ class configuration
 
     public:
         configuration& operator = (const configuration& rhs);
+        // move to the configuration described by delta, updating the lookup
+        // tables in place when only replicas and transfers changed; returns
+        // false, leaving this configuration untouched, if the delta does not
+        // start from this configuration's version
+        bool apply_delta(const configuration_delta& delta);
 
     private:
         void refill_cache();
+        // build the routing tables; call after the sorted caches are filled
+        void fill_routes();
+        // rebuild the dense tables from the sorted caches
+        void fill_dense();
         friend size_t pack_size(const configuration&);
         friend e::packer operator << (e::packer, const configuration& s);
         friend e::unpacker operator >> (e::unpacker, configuration& s);
@@ -151,6 +169,42 @@ class configuration
         typedef std::pair<uint64_t, schema*> uint64_schema_t;
         typedef std::pair<uint64_t, subspace*> uint64_subspace_t;
         typedef std::pair<uint64_t, po6::net::location> uint64_location_t;
+        // where a hash lands within one subspace; when the subspace has a
+        // single dimension whose regions tile the hash space, lower holds
+        // their sorted lower bounds and regions[i] covers [lower[i],
+        // lower[i + 1]); otherwise both are empty and lookups scan
+        struct subspace_route
+        {
+            subspace_route() : id(), sp(), ss(), lower(), regions() {}
+            uint64_t id;
+            const space* sp;
+            const subspace* ss;
+            std::vector<uint64_t> lower;
+            std::vector<const region*> regions;
+        };
+        // per virtual server and per region metadata, indexed by id - base
+        struct virtual_entry
+        {
+            virtual_entry() : ri(), si(), next() {}
+            uint64_t ri;
+            uint64_t si;
+            uint64_t next;
+        };
+        struct region_entry
+        {
+            region_entry() : sc(), ss(), ssid(), head(), tail() {}
+            const schema* sc;
+            const subspace* ss;
+            uint64_t ssid;
+            uint64_t head;
+            uint64_t tail;
+        };
+
+    private:
+        const subspace_route* route_for(const subspace_id& ss) const;
+        const region* route(const subspace_route& sr, uint64_t h) const;
+        const virtual_entry* dense_virtual(uint64_t id) const;
+        const region_entry* dense_region(uint64_t id) const;
 
     private:
         uint64_t m_cluster;
@@ -170,6 +224,16 @@ class configuration
         std::vector<uint64_t> m_point_leaders_by_virtual;
         std::vector<space> m_spaces;
         std::vector<transfer> m_transfers;
+        // routing tables: every subspace sorted by id, and the index of each
+        // space's key subspace within them (parallel to m_spaces)
+        std::vector<subspace_route> m_subspace_routes;
+        std::vector<size_t> m_key_routes;
+        // dense tables; empty when the ids in use are too sparse, in which
+        // case lookups fall back to the sorted caches
+        uint64_t m_virtual_base;
+        std::vector<virtual_entry> m_virtuals;
+        uint64_t m_region_base;
+        std::vector<region_entry> m_regions;
 };
 
 e::packer
@@ -0,0 +1,300 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <string.h>
+
+// STL
+#include <map>
+
+// HyperDex
+#include "common/configuration_delta.h"
+#include "common/serialization.h"
+
+using hyperdex::configuration_delta;
+using hyperdex::space;
+using hyperdex::region;
+
+configuration_delta :: configuration_delta()
+    : cluster(0)
+    , base_version(0)
+    , version(0)
+    , flags(0)
+    , servers()
+    , removed_spaces()
+    , spaces()
+    , regions()
+    , transfers()
+{
+}
+
+configuration_delta :: ~configuration_delta() throw ()
+{
+}
+
+static bool
+same_structure(const space& lhs, const space& rhs)
+{
+    if (strcmp(lhs.name, rhs.name) != 0 ||
+        lhs.fault_tolerance != rhs.fault_tolerance ||
+        lhs.predecessor_width != rhs.predecessor_width ||
+        lhs.indices.size() != rhs.indices.size() ||
+        lhs.subspaces.size() != rhs.subspaces.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < lhs.indices.size(); ++i)
+    {
+        if (lhs.indices[i].id != rhs.indices[i].id ||
+            lhs.indices[i].attr != rhs.indices[i].attr ||
+            lhs.indices[i].type != rhs.indices[i].type)
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < lhs.subspaces.size(); ++i)
+    {
+        const hyperdex::subspace& l(lhs.subspaces[i]);
+        const hyperdex::subspace& r(rhs.subspaces[i]);
+
+        if (l.id != r.id ||
+            l.attrs != r.attrs ||
+            l.regions.size() != r.regions.size())
+        {
+            return false;
+        }
+
+        for (size_t j = 0; j < l.regions.size(); ++j)
+        {
+            if (l.regions[j].id != r.regions[j].id ||
+                l.regions[j].lower_coord != r.regions[j].lower_coord ||
+                l.regions[j].upper_coord != r.regions[j].upper_coord)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool
+same_replicas(const region& lhs, const region& rhs)
+{
+    if (lhs.replicas.size() != rhs.replicas.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < lhs.replicas.size(); ++i)
+    {
+        if (lhs.replicas[i].si != rhs.replicas[i].si ||
+            lhs.replicas[i].vsi != rhs.replicas[i].vsi)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+configuration_delta :: diff_spaces(const std::vector<const space*>& before,
+                                   const std::vector<const space*>& after)
+{
+    std::map<uint64_t, const space*> old_spaces;
+
+    for (size_t i = 0; i < before.size(); ++i)
+    {
+        old_spaces[before[i]->id.get()] = before[i];
+    }
+
+    for (size_t i = 0; i < after.size(); ++i)
+    {
+        std::map<uint64_t, const space*>::iterator it;
+        it = old_spaces.find(after[i]->id.get());
+
+        if (it == old_spaces.end() ||
+            !same_structure(*it->second, *after[i]))
+        {
+            spaces.push_back(*after[i]);
+        }
+        else
+        {
+            for (size_t j = 0; j < after[i]->subspaces.size(); ++j)
+            {
+                const subspace& o(it->second->subspaces[j]);
+                const subspace& n(after[i]->subspaces[j]);
+
+                for (size_t k = 0; k < n.regions.size(); ++k)
+                {
+                    if (!same_replicas(o.regions[k], n.regions[k]))
+                    {
+                        regions.push_back(n.regions[k]);
+                    }
+                }
+            }
+        }
+
+        if (it != old_spaces.end())
+        {
+            old_spaces.erase(it);
+        }
+    }
+
+    for (std::map<uint64_t, const space*>::iterator it = old_spaces.begin();
+            it != old_spaces.end(); ++it)
+    {
+        removed_spaces.push_back(space_id(it->first));
+    }
+}
+
+e::packer
+hyperdex :: operator << (e::packer pa, const configuration_delta& d)
+{
+    pa = pa << d.cluster << d.base_version << d.version << d.flags
+            << uint64_t(d.servers.size())
+            << uint64_t(d.removed_spaces.size())
+            << uint64_t(d.spaces.size())
+            << uint64_t(d.regions.size())
+            << uint64_t(d.transfers.size());
+
+    for (size_t i = 0; i < d.servers.size(); ++i)
+    {
+        pa = pa << d.servers[i];
+    }
+
+    for (size_t i = 0; i < d.removed_spaces.size(); ++i)
+    {
+        pa = pa << d.removed_spaces[i];
+    }
+
+    for (size_t i = 0; i < d.spaces.size(); ++i)
+    {
+        pa = pa << d.spaces[i];
+    }
+
+    for (size_t i = 0; i < d.regions.size(); ++i)
+    {
+        pa = pa << d.regions[i];
+    }
+
+    for (size_t i = 0; i < d.transfers.size(); ++i)
+    {
+        pa = pa << d.transfers[i];
+    }
+
+    return pa;
+}
+
+e::unpacker
+hyperdex :: operator >> (e::unpacker up, configuration_delta& d)
+{
+    uint64_t num_servers = 0;
+    uint64_t num_removed = 0;
+    uint64_t num_spaces = 0;
+    uint64_t num_regions = 0;
+    uint64_t num_transfers = 0;
+    up = up >> d.cluster >> d.base_version >> d.version >> d.flags
+            >> num_servers >> num_removed >> num_spaces
+            >> num_regions >> num_transfers;
+    d.servers.clear();
+    d.removed_spaces.clear();
+    d.spaces.clear();
+    d.regions.clear();
+    d.transfers.clear();
+
+    for (size_t i = 0; !up.error() && i < num_servers; ++i)
+    {
+        server s;
+        up = up >> s;
+        d.servers.push_back(s);
+    }
+
+    for (size_t i = 0; !up.error() && i < num_removed; ++i)
+    {
+        space_id id;
+        up = up >> id;
+        d.removed_spaces.push_back(id);
+    }
+
+    for (size_t i = 0; !up.error() && i < num_spaces; ++i)
+    {
+        space s;
+        up = up >> s;
+        d.spaces.push_back(s);
+    }
+
+    for (size_t i = 0; !up.error() && i < num_regions; ++i)
+    {
+        region r;
+        up = up >> r;
+        d.regions.push_back(r);
+    }
+
+    for (size_t i = 0; !up.error() && i < num_transfers; ++i)
+    {
+        transfer xfer;
+        up = up >> xfer;
+        d.transfers.push_back(xfer);
+    }
+
+    return up;
+}
+
+size_t
+hyperdex :: pack_size(const configuration_delta& d)
+{
+    size_t sz = 9 * sizeof(uint64_t);
+
+    for (size_t i = 0; i < d.servers.size(); ++i)
+    {
+        sz += pack_size(d.servers[i]);
+    }
+
+    sz += sizeof(uint64_t) * d.removed_spaces.size();
+
+    for (size_t i = 0; i < d.spaces.size(); ++i)
+    {
+        sz += pack_size(d.spaces[i]);
+    }
+
+    for (size_t i = 0; i < d.regions.size(); ++i)
+    {
+        sz += pack_size(d.regions[i]);
+    }
+
+    for (size_t i = 0; i < d.transfers.size(); ++i)
+    {
+        sz += pack_size(d.transfers[i]);
+    }
+
+    return sz;
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_common_configuration_delta_h_
+#define hyperdex_common_configuration_delta_h_
+
+// STL
+#include <vector>
+
+// e
+#include <e/serialization.h>
+
+// HyperDex
+#include "namespace.h"
+#include "common/hyperspace.h"
+#include "common/ids.h"
+#include "common/server.h"
+#include "common/transfer.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// The changes that move a configuration from base_version to version.
+// Servers and transfers are few and are always sent in full.  A space that
+// was added, or whose subspaces, regions or indices changed, is sent in
+// full; otherwise only the regions whose replicas changed are sent.  A
+// base_version of zero means there is nothing to apply the delta to, and
+// the receiver must fetch the whole configuration.
+class configuration_delta
+{
+    public:
+        configuration_delta();
+        ~configuration_delta() throw ();
+
+    public:
+        // fill in removed_spaces, spaces and regions to turn "before" into
+        // "after"; both must be ordered by space name
+        void diff_spaces(const std::vector<const space*>& before,
+                         const std::vector<const space*>& after);
+
+    public:
+        uint64_t cluster;
+        uint64_t base_version;
+        uint64_t version;
+        uint64_t flags;
+        std::vector<server> servers;
+        std::vector<space_id> removed_spaces;
+        std::vector<space> spaces;
+        std::vector<region> regions;
+        std::vector<transfer> transfers;
+
+    private:
+        configuration_delta(const configuration_delta&);
+        configuration_delta& operator = (const configuration_delta&);
+};
+
+e::packer
+operator << (e::packer, const configuration_delta& d);
+e::unpacker
+operator >> (e::unpacker, configuration_delta& d);
+size_t
+pack_size(const configuration_delta& d);
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_common_configuration_delta_h_
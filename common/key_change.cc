@@ -44,6 +44,7 @@ key_change :: key_change()
     , checks()
     , funcs()
     , auth()
+    , trace_id(0)
 {
 }
 
@@ -55,6 +56,7 @@ key_change :: key_change(const key_change& other)
     , checks(other.checks)
     , funcs(other.funcs)
     , auth()
+    , trace_id(other.trace_id)
 {
     if (other.auth.get())
     {
@@ -113,6 +115,7 @@ key_change :: operator = (const key_change& rhs)
         fail_if_found     = rhs.fail_if_found;
         checks            = rhs.checks;
         funcs             = rhs.funcs;
+        trace_id          = rhs.trace_id;
 
         if (rhs.auth.get())
         {
@@ -125,6 +128,7 @@ key_change :: operator = (const key_change& rhs)
 
 #define FLAG_WRITE 128
 #define FLAG_AUTH 64
+#define FLAG_TRACE 32
 #define FLAG_FINF 1
 #define FLAG_FIF 2
 
@@ -134,7 +138,8 @@ hyperdex :: operator << (e::packer pa, const key_change& td)
     uint8_t flags = (td.erase ? 0 : FLAG_WRITE)
                   | (td.fail_if_not_found ? FLAG_FINF : 0)
                   | (td.fail_if_found ? FLAG_FIF : 0)
-                  | (td.auth.get() ? FLAG_AUTH : 0);
+                  | (td.auth.get() ? FLAG_AUTH : 0)
+                  | (td.trace_id ? FLAG_TRACE : 0);
     pa = pa << td.key << flags << td.checks << td.funcs;
 
     if (td.auth.get())
@@ -142,6 +147,11 @@ hyperdex :: operator << (e::packer pa, const key_change& td)
         pa = pa << *td.auth;
     }
 
+    if (td.trace_id)
+    {
+        pa = pa << td.trace_id;
+    }
+
     return pa;
 }
 
@@ -160,6 +170,11 @@ hyperdex :: operator >> (e::unpacker up, key_change& td)
         up = up >> *td.auth;
     }
 
+    if ((flags & FLAG_TRACE))
+    {
+        up = up >> td.trace_id;
+    }
+
     return up;
 }
 
@@ -170,5 +185,6 @@ hyperdex :: pack_size(const key_change& td)
          + sizeof(uint8_t)
          + pack_size(td.checks)
          + pack_size(td.funcs)
-         + (td.auth.get() ? pack_size(*td.auth) : 0);
+         + (td.auth.get() ? pack_size(*td.auth) : 0)
+         + (td.trace_id ? sizeof(uint64_t) : 0);
 }
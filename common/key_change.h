@@ -76,6 +76,9 @@ class key_change
 
         // Authorization info is stored here
         std::auto_ptr<auth_wallet> auth;
+
+        // Nonzero if the client sampled this change for tracing
+        uint64_t trace_id;
 };
 
 e::packer
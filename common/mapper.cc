@@ -25,13 +25,23 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// e
+#include <e/atomic.h>
+
 // HyperDex
 #include "common/mapper.h"
 
 using hyperdex::mapper;
 
 mapper :: mapper(const hyperdex::configuration* config)
-    : m_config(config)
+    : m_fixed(config)
+    , m_config(&m_fixed)
+{
+}
+
+mapper :: mapper(const hyperdex::configuration* const* config)
+    : m_fixed(NULL)
+    , m_config(config)
 {
 }
 
@@ -42,6 +52,7 @@ mapper :: ~mapper() throw ()
 bool
 mapper :: lookup(uint64_t id, po6::net::location* addr)
 {
-    *addr = m_config->get_address(server_id(id));
+    const configuration* config = e::atomic::load_ptr_acquire(m_config);
+    *addr = config->get_address(server_id(id));
     return *addr != po6::net::location();
 }
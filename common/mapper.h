@@ -41,6 +41,8 @@ class mapper : public ::busybee_mapper
 {
     public:
         mapper(const configuration* config);
+        // follow a configuration that is republished by swapping *config
+        mapper(const configuration* const* config);
         ~mapper() throw ();
 
     public:
@@ -51,7 +53,8 @@ class mapper : public ::busybee_mapper
         mapper& operator = (const mapper&);
 
     private:
-        const configuration* m_config;
+        const configuration* m_fixed;
+        const configuration* const* m_config;
 };
 
 END_HYPERDEX_NAMESPACE
@@ -56,14 +56,21 @@ hyperdex :: operator << (std::ostream& lhs, const network_msgtype& rhs)
         STRINGIFY(CHAIN_OP);
         STRINGIFY(CHAIN_SUBSPACE);
         STRINGIFY(CHAIN_ACK);
+        STRINGIFY(CHAIN_NACK);
+        STRINGIFY(CHAIN_TRUNCATE);
         STRINGIFY(XFER_OP);
         STRINGIFY(XFER_ACK);
         STRINGIFY(XFER_HS);
         STRINGIFY(XFER_HSA);
         STRINGIFY(XFER_HA);
         STRINGIFY(XFER_HW);
+        STRINGIFY(XFER_BULK);
         STRINGIFY(BACKUP);
         STRINGIFY(PERF_COUNTERS);
+        STRINGIFY(TRUNCATE_SPACE);
+        STRINGIFY(HOT_KEYS);
+        STRINGIFY(SLOW_OPS);
+        STRINGIFY(PACKET_BATCH);
         STRINGIFY(CONFIGMISMATCH);
         STRINGIFY(PACKET_NOP);
         default:
@@ -71,6 +71,8 @@ enum network_msgtype
     CHAIN_SUBSPACE  = 65,
     CHAIN_ACK       = 66,
     /* 67 retired */
+    CHAIN_NACK      = 68,
+    CHAIN_TRUNCATE  = 69,
 
     XFER_OP  = 80,
     XFER_ACK = 81,
@@ -78,10 +80,15 @@ enum network_msgtype
     XFER_HSA = 83, // handshake syn-ack
     XFER_HA  = 84, // handshake ack
     XFER_HW  = 85, // wiped
+    XFER_BULK = 86, // many objects under one sequence number
 
     BACKUP = 126,
     PERF_COUNTERS = 127,
+    TRUNCATE_SPACE = 128,
+    HOT_KEYS = 129,
+    SLOW_OPS = 130,
 
+    PACKET_BATCH    = 253,
     CONFIGMISMATCH  = 254,
     PACKET_NOP      = 255
 };
@@ -0,0 +1,94 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// HyperDex
+#include "common/region_load.h"
+
+using hyperdex::region_load;
+
+region_load :: region_load()
+    : id()
+    , bytes(0)
+    , ops(0)
+{
+}
+
+region_load :: region_load(const hyperdex::region_id& _id,
+                           uint64_t _bytes,
+                           uint64_t _ops)
+    : id(_id)
+    , bytes(_bytes)
+    , ops(_ops)
+{
+}
+
+region_load :: region_load(const region_load& other)
+    : id(other.id)
+    , bytes(other.bytes)
+    , ops(other.ops)
+{
+}
+
+region_load :: ~region_load() throw ()
+{
+}
+
+region_load&
+region_load :: operator = (const region_load& rhs)
+{
+    id = rhs.id;
+    bytes = rhs.bytes;
+    ops = rhs.ops;
+    return *this;
+}
+
+std::ostream&
+hyperdex :: operator << (std::ostream& lhs, const region_load& rhs)
+{
+    return lhs << "region_load(region=" << rhs.id
+               << ", bytes=" << rhs.bytes
+               << ", ops=" << rhs.ops << ")";
+}
+
+e::packer
+hyperdex :: operator << (e::packer pa, const region_load& rl)
+{
+    return pa << rl.id << rl.bytes << rl.ops;
+}
+
+e::unpacker
+hyperdex :: operator >> (e::unpacker up, region_load& rl)
+{
+    return up >> rl.id >> rl.bytes >> rl.ops;
+}
+
+size_t
+hyperdex :: pack_size(const region_load&)
+{
+    return 3 * sizeof(uint64_t);
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_common_region_load_h_
+#define hyperdex_common_region_load_h_
+
+// e
+#include <e/buffer.h>
+
+// HyperDex
+#include "namespace.h"
+#include "common/ids.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// What the head of a region reports to the coordinator about it:  the
+// approximate bytes on disk, and the writes it saw since its last report.
+class region_load
+{
+    public:
+        region_load();
+        region_load(const region_id& id, uint64_t bytes, uint64_t ops);
+        region_load(const region_load&);
+        ~region_load() throw ();
+
+    public:
+        region_load& operator = (const region_load&);
+        bool operator < (const region_load& rhs) const { return id < rhs.id; }
+
+    public:
+        region_id id;
+        uint64_t bytes;
+        uint64_t ops;
+};
+
+std::ostream&
+operator << (std::ostream& lhs, const region_load& rhs);
+
+e::packer
+operator << (e::packer, const region_load& rl);
+e::unpacker
+operator >> (e::unpacker, region_load& rl);
+size_t
+pack_size(const region_load& rl);
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_common_region_load_h_
@@ -31,6 +31,8 @@
 
 using hyperdex::server;
 
+const uint64_t server::DEFAULT_WEIGHT;
+
 const char*
 server :: to_string(state_t state)
 {
@@ -55,6 +57,7 @@ server :: server()
     : state(KILLED)
     , id()
     , bind_to()
+    , weight(DEFAULT_WEIGHT)
 {
 }
 
@@ -62,6 +65,7 @@ server :: server(const server_id& sid)
     : state(ASSIGNED)
     , id(sid)
     , bind_to()
+    , weight(DEFAULT_WEIGHT)
 {
 }
 
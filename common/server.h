@@ -49,6 +49,8 @@ class server
             KILLED = 5
         };
         static const char* to_string(state_t state);
+        // the weight of a server that did not say what it can hold
+        static const uint64_t DEFAULT_WEIGHT = 100;
 
     public:
         server();
@@ -58,6 +60,10 @@ class server
         state_t state;
         server_id id;
         po6::net::location bind_to;
+        // relative capacity; the coordinator places regions in proportion.
+        // Only the coordinator keeps it (see its snapshot), so it is not
+        // packed with the server and older parsers still read servers.
+        uint64_t weight;
 };
 
 bool
@@ -0,0 +1,333 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+
+// STL
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// e
+#include <e/buffer.h>
+
+// HyperDex
+#include "test/th.h"
+#include "common/configuration.h"
+#include "common/serialization.h"
+
+using hyperdex::attribute;
+using hyperdex::configuration;
+using hyperdex::region;
+using hyperdex::region_id;
+using hyperdex::replica;
+using hyperdex::schema;
+using hyperdex::server;
+using hyperdex::server_id;
+using hyperdex::space;
+using hyperdex::space_id;
+using hyperdex::subspace;
+using hyperdex::subspace_id;
+using hyperdex::virtual_server_id;
+
+static const attribute ATTRS[] = {attribute("k", HYPERDATATYPE_STRING),
+                                  attribute("a", HYPERDATATYPE_STRING),
+                                  attribute("b", HYPERDATATYPE_STRING)};
+
+static space
+make_space(const char* name, uint64_t id)
+{
+    schema sc;
+    sc.attrs_sz = 3;
+    sc.attrs = ATTRS;
+    space s(name, sc);
+    s.id = space_id(id);
+    s.fault_tolerance = 1;
+    return s;
+}
+
+// a subspace over "attrs" whose regions span [cuts[i], cuts[i + 1]) in
+// every dimension, listed in a scrambled order; each region is replicated
+// on servers 1 and 2, and ids are spaced by "stride"
+static void
+add_subspace(space* s,
+             uint64_t id,
+             const std::vector<uint16_t>& attrs,
+             const std::vector<uint64_t>& cuts,
+             uint64_t stride)
+{
+    s->subspaces.push_back(subspace());
+    subspace& ss(s->subspaces.back());
+    ss.id = subspace_id(id);
+    ss.attrs = attrs;
+    size_t per_dim = cuts.size();
+    size_t count = 1;
+
+    for (size_t a = 0; a < attrs.size(); ++a)
+    {
+        count *= per_dim;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        // visit the cells out of order so that routing cannot rely on the
+        // order of the regions in the subspace
+        size_t cell = (i * 5 + 3) % count;
+        region r;
+        r.id = region_id((id * 50 + i + 1) * stride);
+
+        for (size_t a = 0; a < attrs.size(); ++a)
+        {
+            size_t c = cell % per_dim;
+            cell /= per_dim;
+            r.lower_coord.push_back(cuts[c]);
+            r.upper_coord.push_back(c + 1 < per_dim ? cuts[c + 1] - 1 : UINT64_MAX);
+        }
+
+        r.replicas.push_back(replica(server_id(1), virtual_server_id(r.id.get() * 2 + 1)));
+        r.replicas.push_back(replica(server_id(2), virtual_server_id(r.id.get() * 2 + 2)));
+        ss.regions.push_back(r);
+    }
+}
+
+static void
+make_config(const space& s, configuration* c)
+{
+    std::vector<server> servers;
+    servers.push_back(server(server_id(1)));
+    servers.push_back(server(server_id(2)));
+    size_t sz = 6 * sizeof(uint64_t) + pack_size(s);
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        sz += pack_size(servers[i]);
+    }
+
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::packer pa = msg->pack_at(0);
+    pa = pa << uint64_t(1) << uint64_t(1) << uint64_t(0)
+            << uint64_t(servers.size()) << uint64_t(1) << uint64_t(0);
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        pa = pa << servers[i];
+    }
+
+    pa = pa << s;
+    e::unpacker up = msg->unpack_from(0);
+    up = up >> *c;
+    ASSERT_FALSE(up.error());
+}
+
+// the lookup every configuration used before routing tables: the first
+// region, in subspace order, whose box holds the point
+static region_id
+linear_lookup(const subspace& ss, const std::vector<uint64_t>& hashes)
+{
+    for (size_t r = 0; r < ss.regions.size(); ++r)
+    {
+        bool matches = true;
+
+        for (size_t a = 0; matches && a < ss.attrs.size(); ++a)
+        {
+            matches = ss.regions[r].lower_coord[a] <= hashes[ss.attrs[a]] &&
+                      hashes[ss.attrs[a]] <= ss.regions[r].upper_coord[a];
+        }
+
+        if (matches)
+        {
+            return ss.regions[r].id;
+        }
+    }
+
+    return region_id();
+}
+
+static std::vector<uint64_t>
+make_cuts()
+{
+    std::vector<uint64_t> cuts;
+    cuts.push_back(0);
+    cuts.push_back(1);
+    cuts.push_back(2);
+    cuts.push_back(1000);
+    cuts.push_back(1ULL << 40);
+    cuts.push_back(UINT64_MAX / 3);
+    cuts.push_back(UINT64_MAX - 1);
+    return cuts;
+}
+
+// every cut, its neighbours and a spread of pseudo-random points
+static std::vector<uint64_t>
+make_probes(const std::vector<uint64_t>& cuts)
+{
+    std::vector<uint64_t> probes;
+    probes.push_back(UINT64_MAX);
+
+    for (size_t i = 0; i < cuts.size(); ++i)
+    {
+        probes.push_back(cuts[i] - 1);
+        probes.push_back(cuts[i]);
+        probes.push_back(cuts[i] + 1);
+    }
+
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        probes.push_back(x);
+        // and small values, where most cuts are
+        probes.push_back(x >> (x % 64));
+    }
+
+    return probes;
+}
+
+// lookup_region must agree with linear_lookup for every probe in every
+// dimension of every subspace of "s"
+static void
+assert_routes(const space& s)
+{
+    configuration c;
+    make_config(s, &c);
+    std::vector<uint64_t> probes(make_probes(make_cuts()));
+
+    for (size_t x = 0; x < s.subspaces.size(); ++x)
+    {
+        const subspace& ss(s.subspaces[x]);
+
+        for (size_t i = 0; i < probes.size(); ++i)
+        {
+            std::vector<uint64_t> hashes(s.sc.attrs_sz, 0);
+
+            for (size_t a = 0; a < hashes.size(); ++a)
+            {
+                hashes[a] = probes[(i + a * 7) % probes.size()];
+            }
+
+            region_id expected = linear_lookup(ss, hashes);
+            region_id actual;
+            c.lookup_region(ss.id, hashes, &actual);
+            ASSERT_EQ(actual, expected);
+        }
+    }
+}
+
+TEST(Configuration, RouteTiled)
+{
+    space s = make_space("tiled", 1);
+    add_subspace(&s, 1, std::vector<uint16_t>(1, 0), make_cuts(), 1);
+    add_subspace(&s, 2, std::vector<uint16_t>(1, 2), make_cuts(), 1);
+    assert_routes(s);
+}
+
+TEST(Configuration, RouteSingleRegion)
+{
+    space s = make_space("single", 1);
+    add_subspace(&s, 1, std::vector<uint16_t>(1, 0), std::vector<uint64_t>(1, 0), 1);
+    assert_routes(s);
+}
+
+TEST(Configuration, RouteGaps)
+{
+    // without its first and last regions the subspace no longer tiles the
+    // hash space, so some points land nowhere
+    std::vector<uint64_t> cuts(make_cuts());
+    space s = make_space("gaps", 1);
+    add_subspace(&s, 1, std::vector<uint16_t>(1, 0), cuts, 1);
+    add_subspace(&s, 2, std::vector<uint16_t>(1, 1), cuts, 1);
+    std::vector<region>& key(s.subspaces[0].regions);
+    key.erase(key.begin());
+    std::vector<region>& other(s.subspaces[1].regions);
+    other.erase(other.begin() + 3);
+    assert_routes(s);
+}
+
+TEST(Configuration, RouteMultipleAttributes)
+{
+    std::vector<uint64_t> cuts;
+    cuts.push_back(0);
+    cuts.push_back(1ULL << 63);
+    std::vector<uint16_t> attrs;
+    attrs.push_back(1);
+    attrs.push_back(2);
+    space s = make_space("multi", 1);
+    add_subspace(&s, 1, std::vector<uint16_t>(1, 0), make_cuts(), 1);
+    add_subspace(&s, 2, attrs, cuts, 1);
+    assert_routes(s);
+}
+
+// the dense tables must answer as the sorted caches do; widely spaced ids
+// force the latter
+TEST(Configuration, DenseAndSparse)
+{
+    for (uint64_t stride = 1; stride <= 1000000; stride *= 1000)
+    {
+        space s = make_space("space", 1);
+        add_subspace(&s, 1, std::vector<uint16_t>(1, 0), make_cuts(), stride);
+        add_subspace(&s, 2, std::vector<uint16_t>(1, 1), make_cuts(), stride);
+        configuration c;
+        make_config(s, &c);
+
+        for (size_t x = 0; x < s.subspaces.size(); ++x)
+        {
+            const subspace& ss(s.subspaces[x]);
+
+            for (size_t y = 0; y < ss.regions.size(); ++y)
+            {
+                const region& r(ss.regions[y]);
+                ASSERT_EQ(c.subspace_of(r.id), ss.id);
+                ASSERT_EQ(c.head_of_region(r.id), r.replicas.front().vsi);
+                ASSERT_EQ(c.tail_of_region(r.id), r.replicas.back().vsi);
+                ASSERT_TRUE(c.get_schema(r.id) != NULL);
+
+                for (size_t z = 0; z < r.replicas.size(); ++z)
+                {
+                    const virtual_server_id& vsi(r.replicas[z].vsi);
+                    virtual_server_id next;
+
+                    if (z + 1 < r.replicas.size())
+                    {
+                        next = r.replicas[z + 1].vsi;
+                    }
+
+                    ASSERT_EQ(c.get_region_id(vsi), r.id);
+                    ASSERT_EQ(c.get_server_id(vsi), r.replicas[z].si);
+                    ASSERT_EQ(c.next_in_region(vsi), next);
+                    ASSERT_EQ(c.is_point_leader(vsi), x == 0 && z == 0);
+                }
+            }
+        }
+
+        ASSERT_EQ(c.get_region_id(virtual_server_id(3)), region_id());
+        ASSERT_EQ(c.next_in_region(virtual_server_id(3)), virtual_server_id());
+    }
+}
@@ -0,0 +1,385 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+
+// STL
+#include <memory>
+#include <vector>
+
+// e
+#include <e/buffer.h>
+
+// HyperDex
+#include "test/th.h"
+#include "common/configuration.h"
+#include "common/configuration_delta.h"
+#include "common/serialization.h"
+
+using hyperdex::attribute;
+using hyperdex::configuration;
+using hyperdex::configuration_delta;
+using hyperdex::region;
+using hyperdex::region_id;
+using hyperdex::replica;
+using hyperdex::schema;
+using hyperdex::server;
+using hyperdex::server_id;
+using hyperdex::space;
+using hyperdex::space_id;
+using hyperdex::subspace;
+using hyperdex::subspace_id;
+using hyperdex::transfer;
+using hyperdex::transfer_id;
+using hyperdex::virtual_server_id;
+
+static const uint64_t CLUSTER = 0xdeadbeefULL;
+static const attribute ATTRS[] = {attribute("k", HYPERDATATYPE_STRING),
+                                  attribute("v", HYPERDATATYPE_STRING)};
+
+// a space with a key subspace and a subspace on "v", each split into two
+// regions replicated on servers 1 and 2; ids are derived from "id"
+static space
+make_space(const char* name, uint64_t id)
+{
+    schema sc;
+    sc.attrs_sz = 2;
+    sc.attrs = ATTRS;
+    space s(name, sc);
+    s.id = space_id(id);
+    s.fault_tolerance = 1;
+    s.subspaces.resize(2);
+
+    for (size_t i = 0; i < s.subspaces.size(); ++i)
+    {
+        subspace& ss(s.subspaces[i]);
+        ss.id = subspace_id(id * 10 + i);
+        ss.attrs.push_back(i);
+        ss.regions.resize(2);
+
+        for (size_t j = 0; j < ss.regions.size(); ++j)
+        {
+            region& r(ss.regions[j]);
+            r.id = region_id(id * 100 + i * 10 + j);
+            r.lower_coord.push_back(j == 0 ? 0 : UINT64_MAX / 2 + 1);
+            r.upper_coord.push_back(j == 0 ? UINT64_MAX / 2 : UINT64_MAX);
+            r.replicas.push_back(replica(server_id(1), virtual_server_id(r.id.get() * 10 + 1)));
+            r.replicas.push_back(replica(server_id(2), virtual_server_id(r.id.get() * 10 + 2)));
+        }
+    }
+
+    return s;
+}
+
+static std::vector<server>
+make_servers()
+{
+    std::vector<server> servers;
+
+    for (uint64_t i = 1; i <= 3; ++i)
+    {
+        servers.push_back(server(server_id(i)));
+        servers.back().state = server::AVAILABLE;
+    }
+
+    return servers;
+}
+
+// the configuration the coordinator would publish for "spaces", which must
+// be ordered by name
+static void
+make_config(uint64_t version,
+            const std::vector<const space*>& spaces,
+            const std::vector<transfer>& transfers,
+            configuration* c)
+{
+    std::vector<server> servers(make_servers());
+    size_t sz = 6 * sizeof(uint64_t);
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        sz += pack_size(servers[i]);
+    }
+
+    for (size_t i = 0; i < spaces.size(); ++i)
+    {
+        sz += pack_size(*spaces[i]);
+    }
+
+    for (size_t i = 0; i < transfers.size(); ++i)
+    {
+        sz += pack_size(transfers[i]);
+    }
+
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::packer pa = msg->pack_at(0);
+    pa = pa << CLUSTER << version << uint64_t(0)
+            << uint64_t(servers.size())
+            << uint64_t(spaces.size())
+            << uint64_t(transfers.size());
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        pa = pa << servers[i];
+    }
+
+    for (size_t i = 0; i < spaces.size(); ++i)
+    {
+        pa = pa << *spaces[i];
+    }
+
+    for (size_t i = 0; i < transfers.size(); ++i)
+    {
+        pa = pa << transfers[i];
+    }
+
+    e::unpacker up = msg->unpack_from(0);
+    up = up >> *c;
+    ASSERT_FALSE(up.error());
+}
+
+// the delta the coordinator would publish to move from "before" to "after"
+static void
+make_delta(uint64_t base_version,
+           uint64_t version,
+           const std::vector<const space*>& before,
+           const std::vector<const space*>& after,
+           const std::vector<transfer>& transfers,
+           configuration_delta* d)
+{
+    d->cluster = CLUSTER;
+    d->base_version = base_version;
+    d->version = version;
+    d->flags = 0;
+    d->servers = make_servers();
+    d->transfers = transfers;
+    d->diff_spaces(before, after);
+
+    // what travels is the packed form
+    std::auto_ptr<e::buffer> msg(e::buffer::create(pack_size(*d)));
+    msg->pack_at(0) << *d;
+    e::unpacker up = msg->unpack_from(0);
+    up = up >> *d;
+    ASSERT_FALSE(up.error());
+}
+
+// "lhs" must answer exactly as "rhs" does, both in what it contains and in
+// the lookup tables built from it; "gone" lists spaces neither may know
+static void
+assert_same(const configuration& lhs,
+            const configuration& rhs,
+            const std::vector<const space*>& spaces,
+            const std::vector<const space*>& gone)
+{
+    ASSERT_EQ(lhs.version(), rhs.version());
+    ASSERT_EQ(lhs.dump(), rhs.dump());
+    ASSERT_EQ(lhs.list_spaces(), rhs.list_spaces());
+
+    for (uint64_t s = 1; s <= 3; ++s)
+    {
+        std::vector<region_id> l;
+        std::vector<region_id> r;
+        lhs.point_leaders(server_id(s), &l);
+        rhs.point_leaders(server_id(s), &r);
+        ASSERT_TRUE(l == r);
+        lhs.key_regions(server_id(s), &l);
+        rhs.key_regions(server_id(s), &r);
+        ASSERT_TRUE(l == r);
+        lhs.mapped_regions(server_id(s), &l);
+        rhs.mapped_regions(server_id(s), &r);
+        ASSERT_TRUE(l == r);
+    }
+
+    for (size_t i = 0; i < spaces.size(); ++i)
+    {
+        const space& sp(*spaces[i]);
+        ASSERT_TRUE(lhs.get_schema(sp.name) != NULL);
+
+        for (size_t j = 0; j < sp.subspaces.size(); ++j)
+        {
+            const subspace& ss(sp.subspaces[j]);
+
+            for (size_t k = 0; k < ss.regions.size(); ++k)
+            {
+                const region& reg(ss.regions[k]);
+                ASSERT_TRUE(lhs.get_schema(reg.id) != NULL);
+                ASSERT_EQ(lhs.subspace_of(reg.id), rhs.subspace_of(reg.id));
+                ASSERT_EQ(lhs.head_of_region(reg.id), rhs.head_of_region(reg.id));
+                ASSERT_EQ(lhs.tail_of_region(reg.id), rhs.tail_of_region(reg.id));
+
+                for (size_t z = 0; z < reg.replicas.size(); ++z)
+                {
+                    virtual_server_id vsi = reg.replicas[z].vsi;
+                    ASSERT_EQ(lhs.get_region_id(vsi), reg.id);
+                    ASSERT_EQ(lhs.get_server_id(vsi), reg.replicas[z].si);
+                    ASSERT_EQ(lhs.next_in_region(vsi), rhs.next_in_region(vsi));
+                    ASSERT_EQ(lhs.is_point_leader(vsi), rhs.is_point_leader(vsi));
+                }
+
+                std::vector<uint64_t> hashes(sp.sc.attrs_sz, reg.lower_coord[0]);
+                region_id l;
+                region_id r;
+                lhs.lookup_region(ss.id, hashes, &l);
+                rhs.lookup_region(ss.id, hashes, &r);
+                ASSERT_EQ(l, r);
+                ASSERT_EQ(l, reg.id);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < gone.size(); ++i)
+    {
+        const space& sp(*gone[i]);
+        ASSERT_TRUE(lhs.get_schema(sp.name) == NULL);
+
+        for (size_t j = 0; j < sp.subspaces.size(); ++j)
+        {
+            for (size_t k = 0; k < sp.subspaces[j].regions.size(); ++k)
+            {
+                ASSERT_TRUE(lhs.get_schema(sp.subspaces[j].regions[k].id) == NULL);
+            }
+        }
+    }
+}
+
+TEST(ConfigurationDelta, ReplicasOnly)
+{
+    space alpha = make_space("alpha", 1);
+    space beta = make_space("beta", 2);
+    std::vector<const space*> before;
+    before.push_back(&alpha);
+    before.push_back(&beta);
+    configuration a;
+    make_config(5, before, std::vector<transfer>(), &a);
+
+    // server 3 replaces server 1 in one region, and joins another through
+    // a transfer
+    space alpha2(alpha);
+    alpha2.subspaces[0].regions[1].replicas[0] = replica(server_id(3), virtual_server_id(9001));
+    std::vector<const space*> after;
+    after.push_back(&alpha2);
+    after.push_back(&beta);
+    std::vector<transfer> transfers;
+    transfers.push_back(transfer(transfer_id(1), region_id(210),
+                                 server_id(2), virtual_server_id(2102),
+                                 server_id(3), virtual_server_id(9002)));
+    configuration b;
+    make_config(6, after, transfers, &b);
+
+    configuration_delta d;
+    make_delta(5, 6, before, after, transfers, &d);
+    ASSERT_TRUE(d.spaces.empty());
+    ASSERT_TRUE(d.removed_spaces.empty());
+    ASSERT_EQ(d.regions.size(), 1U);
+    ASSERT_TRUE(a.apply_delta(d));
+    assert_same(a, b, after, std::vector<const space*>());
+    ASSERT_TRUE(a.is_server_involved_in_transfer(server_id(3), region_id(210)));
+}
+
+TEST(ConfigurationDelta, AddAndRemoveSpaces)
+{
+    space alpha = make_space("alpha", 1);
+    space beta = make_space("beta", 2);
+    space gamma = make_space("gamma", 3);
+    std::vector<const space*> before;
+    before.push_back(&alpha);
+    before.push_back(&beta);
+    configuration a;
+    make_config(5, before, std::vector<transfer>(), &a);
+
+    // beta goes away, gamma arrives and alpha changes replicas
+    space alpha2(alpha);
+    alpha2.subspaces[1].regions[0].replicas.pop_back();
+    std::vector<const space*> after;
+    after.push_back(&alpha2);
+    after.push_back(&gamma);
+    configuration b;
+    make_config(7, after, std::vector<transfer>(), &b);
+
+    configuration_delta d;
+    make_delta(5, 7, before, after, std::vector<transfer>(), &d);
+    ASSERT_EQ(d.removed_spaces.size(), 1U);
+    ASSERT_EQ(d.removed_spaces[0], beta.id);
+    ASSERT_EQ(d.spaces.size(), 1U);
+    ASSERT_EQ(d.spaces[0].id, gamma.id);
+    ASSERT_EQ(d.regions.size(), 1U);
+    ASSERT_TRUE(a.apply_delta(d));
+    std::vector<const space*> gone;
+    gone.push_back(&beta);
+    assert_same(a, b, after, gone);
+}
+
+TEST(ConfigurationDelta, Restructured)
+{
+    space alpha = make_space("alpha", 1);
+    space beta = make_space("beta", 2);
+    std::vector<const space*> before;
+    before.push_back(&alpha);
+    before.push_back(&beta);
+    configuration a;
+    make_config(5, before, std::vector<transfer>(), &a);
+
+    // beta's key subspace is carved into different regions; every space
+    // is now ordered after it by name
+    space beta2(beta);
+    beta2.subspaces[0].regions[0].upper_coord[0] = UINT64_MAX / 4;
+    beta2.subspaces[0].regions[1].lower_coord[0] = UINT64_MAX / 4 + 1;
+    space aardvark = make_space("aardvark", 4);
+    std::vector<const space*> after;
+    after.push_back(&aardvark);
+    after.push_back(&alpha);
+    after.push_back(&beta2);
+    configuration b;
+    make_config(6, after, std::vector<transfer>(), &b);
+
+    configuration_delta d;
+    make_delta(5, 6, before, after, std::vector<transfer>(), &d);
+    ASSERT_EQ(d.spaces.size(), 2U);
+    ASSERT_TRUE(d.regions.empty());
+    ASSERT_TRUE(a.apply_delta(d));
+    assert_same(a, b, after, std::vector<const space*>());
+}
+
+TEST(ConfigurationDelta, WrongBase)
+{
+    space alpha = make_space("alpha", 1);
+    std::vector<const space*> spaces;
+    spaces.push_back(&alpha);
+    configuration a;
+    make_config(5, spaces, std::vector<transfer>(), &a);
+    configuration_delta stale;
+    make_delta(4, 6, spaces, spaces, std::vector<transfer>(), &stale);
+    ASSERT_FALSE(a.apply_delta(stale));
+    ASSERT_EQ(a.version(), 5U);
+    configuration_delta full;
+    make_delta(0, 6, spaces, spaces, std::vector<transfer>(), &full);
+    ASSERT_FALSE(a.apply_delta(full));
+    ASSERT_EQ(a.version(), 5U);
+}
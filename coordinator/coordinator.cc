@@ -25,6 +25,7 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#define __STDC_LIMIT_MACROS
 #define __STDC_FORMAT_MACROS
 
 // C
@@ -39,6 +40,7 @@
 #include <e/endian.h>
 
 // HyperDex
+#include "common/configuration_delta.h"
 #include "common/configuration_flags.h"
 #include "common/serialization.h"
 #include "coordinator/coordinator.h"
@@ -46,6 +48,15 @@
 #include "coordinator/util.h"
 
 #define ALARM_INTERVAL 30
+// weights are fixed point, with one subspace's reported bytes (or ops)
+// summing to WEIGHT_UNIT
+#define WEIGHT_UNIT (1ULL << 20)
+// Snapshots end with the spaces.  Fields added since follow an empty space
+// name and a version, so that older snapshots, which have neither, still
+// restore.  Each version appends to the fields of the one before it.
+#define SNAPSHOT_LOADS 1
+#define SNAPSHOT_WEIGHTS 2
+#define SNAPSHOT_VERSION SNAPSHOT_WEIGHTS
 
 using hyperdex::coordinator;
 using hyperdex::region;
@@ -146,6 +157,7 @@ coordinator :: coordinator()
     , m_deferred_init()
     , m_offline()
     , m_transfers()
+    , m_loads()
     , m_config_ack_through(0)
     , m_config_ack_barrier()
     , m_config_stable_through(0)
@@ -155,6 +167,9 @@ coordinator :: coordinator()
     , m_checkpoint_gc_through(0)
     , m_checkpoint_stable_barrier()
     , m_latest_config()
+    , m_latest_delta()
+    , m_published_spaces()
+    , m_published_version(0)
     , m_response()
 {
     assert(m_config_ack_through == m_config_ack_barrier.min_version());
@@ -291,7 +306,8 @@ coordinator :: server_register(rsm_context* ctx,
 void
 coordinator :: server_online(rsm_context* ctx,
                              const server_id& sid,
-                             const po6::net::location* bind_to)
+                             const po6::net::location* bind_to,
+                             uint64_t weight)
 {
     server* srv = get_server(sid);
 
@@ -338,6 +354,17 @@ coordinator :: server_online(rsm_context* ctx,
         changed = true;
     }
 
+    bool reweighed = false;
+
+    if (weight > 0 && srv->weight != weight)
+    {
+        rsm_log(ctx, "changing server(%" PRIu64 ")'s weight from %" PRIu64 " to %" PRIu64 "\n",
+                     sid.get(), srv->weight, weight);
+        srv->weight = weight;
+        reweighed = true;
+        changed = true;
+    }
+
     if (srv->state != server::AVAILABLE)
     {
         rsm_log(ctx, "changing server(%" PRIu64 ") from %s to %s\n",
@@ -353,6 +380,10 @@ coordinator :: server_online(rsm_context* ctx,
         rebalance_replica_sets(ctx);
         changed = true;
     }
+    else if (reweighed)
+    {
+        rebalance_replica_sets(ctx);
+    }
 
     if (changed)
     {
@@ -572,6 +603,13 @@ coordinator :: space_add(rsm_context* ctx, const space& _s)
         return generate_response(ctx, COORD_MALFORMED);
     }
 
+    // an empty name ends the spaces in a snapshot
+    if (!*_s.name)
+    {
+        rsm_log(ctx, "could not add a space because its name is empty\n");
+        return generate_response(ctx, COORD_MALFORMED);
+    }
+
     if (m_spaces.find(std::string(_s.name)) != m_spaces.end())
     {
         rsm_log(ctx, "could not add space \"%s\" because there is already a space with that name\n", _s.name);
@@ -658,6 +696,18 @@ coordinator :: space_rm(rsm_context* ctx, const char* name)
             }
         }
 
+        for (size_t i = 0; i < m_loads.size(); )
+        {
+            if (std::binary_search(rids.begin(), rids.end(), m_loads[i].id))
+            {
+                shift_and_pop(i, &m_loads);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
         remove(sid, &m_deferred_init);
         generate_next_configuration(ctx);
         return generate_response(ctx, COORD_SUCCESS);
@@ -896,6 +946,39 @@ coordinator :: transfer_complete(rsm_context* ctx,
     return generate_response(ctx, COORD_SUCCESS);
 }
 
+void
+coordinator :: report_load(rsm_context* ctx,
+                           const server_id& sid,
+                           const std::vector<region_load>& loads)
+{
+    for (size_t i = 0; i < loads.size(); ++i)
+    {
+        region* reg = get_region(loads[i].id);
+
+        // only the head reports, so that a region's rate does not jump
+        // between the counters of different replicas
+        if (!reg || reg->replicas.empty() || reg->replicas[0].si != sid)
+        {
+            continue;
+        }
+
+        std::vector<region_load>::iterator it;
+        it = std::lower_bound(m_loads.begin(), m_loads.end(), loads[i]);
+
+        if (it == m_loads.end() || it->id != loads[i].id)
+        {
+            m_loads.insert(it, loads[i]);
+            continue;
+        }
+
+        // smooth the rate so one busy interval doesn't move a region
+        it->bytes = loads[i].bytes;
+        it->ops = (it->ops * 3 + loads[i].ops) / 4;
+    }
+
+    return generate_response(ctx, COORD_SUCCESS);
+}
+
 void
 coordinator :: config_get(rsm_context* ctx)
 {
@@ -968,6 +1051,7 @@ void
 coordinator :: periodic(rsm_context* ctx)
 {
     checkpoint(ctx);
+    rebalance_load(ctx);
 }
 
 void
@@ -1019,6 +1103,14 @@ coordinator :: debug_dump(rsm_context* ctx)
                 m_transfers[i].dst.get(), m_transfers[i].vdst.get());
     }
 
+    rsm_log(ctx, "region loads:\n");
+
+    for (size_t i = 0; i < m_loads.size(); ++i)
+    {
+        rsm_log(ctx, " - rid=%" PRIu64 " bytes=%" PRIu64 " ops=%" PRIu64 "\n",
+                m_loads[i].id.get(), m_loads[i].bytes, m_loads[i].ops);
+    }
+
     rsm_log(ctx, "offline servers:\n");
 
     for (size_t i = 0; i < m_offline.size(); ++i)
@@ -1055,14 +1147,50 @@ coordinator :: recreate(rsm_context* ctx,
             >> c->m_checkpoint >> c->m_checkpoint_stable_through
             >> c->m_checkpoint_gc_through >> c->m_checkpoint_stable_barrier;
 
+    uint64_t snapshot_version = 0;
+
     while (!up.error() && up.remain())
     {
         e::slice name;
+        up = up >> name;
+
+        if (name.empty())
+        {
+            up = up >> snapshot_version;
+            break;
+        }
+
         space_ptr ptr(new space());
-        up = up >> name >> *ptr;
+        up = up >> *ptr;
         c->m_spaces[std::string(reinterpret_cast<const char*>(name.data()), name.size())] = ptr;
     }
 
+    if (snapshot_version >= SNAPSHOT_LOADS)
+    {
+        up = up >> c->m_loads;
+    }
+
+    // servers are packed without their weights; older snapshots restore
+    // with the default weight
+    if (snapshot_version >= SNAPSHOT_WEIGHTS)
+    {
+        uint64_t num_weights = 0;
+        up = up >> num_weights;
+
+        for (size_t i = 0; !up.error() && i < num_weights; ++i)
+        {
+            server_id sid;
+            uint64_t weight = 0;
+            up = up >> sid >> weight;
+            server* srv = c->get_server(sid);
+
+            if (srv)
+            {
+                srv->weight = weight;
+            }
+        }
+    }
+
     if (up.error())
     {
         rsm_log(ctx, "unpacking failed\n");
@@ -1153,6 +1281,11 @@ coordinator :: snapshot(rsm_context* /*ctx*/,
         sz += pack_size(name) + pack_size(*it->second);
     }
 
+    sz += pack_size(e::slice())
+        + sizeof(uint64_t)
+        + pack_size(m_loads)
+        + sizeof(uint64_t)
+        + m_servers.size() * 2 * sizeof(uint64_t);
     std::auto_ptr<e::buffer> buf(e::buffer::create(sz));
     e::packer pa = buf->pack_at(0);
     pa = pa << m_cluster << m_counter << m_version << m_flags << m_servers
@@ -1170,6 +1303,14 @@ coordinator :: snapshot(rsm_context* /*ctx*/,
         pa = pa << name << (*it->second);
     }
 
+    pa = pa << e::slice() << uint64_t(SNAPSHOT_VERSION) << m_loads
+            << uint64_t(m_servers.size());
+
+    for (size_t i = 0; i < m_servers.size(); ++i)
+    {
+        pa = pa << m_servers[i].id << m_servers[i].weight;
+    }
+
     char* ptr = static_cast<char*>(malloc(buf->size()));
     *data = ptr;
     *data_sz = buf->size();
@@ -1387,24 +1528,31 @@ coordinator :: get_region(const region_id& rid)
     return NULL;
 }
 
-void
+bool
 coordinator :: setup_intents(rsm_context* ctx,
                              const std::vector<replica_set>& replica_sets,
                              space* s, bool skip_transfers)
 {
     if (replica_sets.size() == 0)
     {
-        return;
+        return false;
     }
 
+    bool changed = false;
+
+    std::vector<uint64_t> set_weights;
+    compute_replica_set_weights(replica_sets, m_servers, &set_weights);
+
     for (size_t ss_idx = 0; ss_idx < s->subspaces.size(); ++ss_idx)
     {
         subspace& ss(s->subspaces[ss_idx]);
+        std::vector<size_t> assignment;
+        assign_regions(ss, replica_sets, set_weights, &assignment);
 
         for (size_t reg_idx = 0; reg_idx < ss.regions.size(); ++reg_idx)
         {
             region* reg = &ss.regions[reg_idx];
-            size_t idx = (reg_idx * replica_sets.size()) / ss.regions.size();
+            size_t idx = assignment[reg_idx];
             assert(idx < replica_sets.size());
             bool need_change = replica_sets[idx].size() != reg->replicas.size();
 
@@ -1429,6 +1577,8 @@ coordinator :: setup_intents(rsm_context* ctx,
                 continue;
             }
 
+            changed = true;
+
             if (skip_transfers)
             {
                 assert(reg->replicas.empty());
@@ -1460,6 +1610,8 @@ coordinator :: setup_intents(rsm_context* ctx,
             }
         }
     }
+
+    return changed;
 }
 
 void
@@ -1759,6 +1911,287 @@ coordinator :: remove_offline(const server_id& sid)
     }
 }
 
+namespace
+{
+
+// x as a fraction of total, in WEIGHT_UNITs
+uint64_t
+scale_to_unit(uint64_t x, uint64_t total)
+{
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    if (x < (UINT64_MAX / WEIGHT_UNIT))
+    {
+        return (x * WEIGHT_UNIT) / total;
+    }
+
+    return x / (total / WEIGHT_UNIT);
+}
+
+} // namespace
+
+void
+coordinator :: assign_regions(const subspace& ss,
+                              const std::vector<replica_set>& replica_sets,
+                              const std::vector<uint64_t>& set_weights,
+                              std::vector<size_t>* assignment)
+{
+    const size_t n = ss.regions.size();
+    const size_t sets = replica_sets.size();
+    assert(set_weights.size() == sets);
+    assignment->assign(n, sets);
+    std::vector<uint64_t> weights;
+
+    if (!region_weights(ss, &weights))
+    {
+        weights.assign(n, 1);
+    }
+
+    uint64_t total = 0;
+    uint64_t total_set_weight = 0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        total += weights[i];
+    }
+
+    for (size_t i = 0; i < sets; ++i)
+    {
+        total_set_weight += set_weights[i];
+    }
+
+    // what each set should hold, in the units of the region weights
+    std::vector<int64_t> deficit(sets);
+
+    for (size_t i = 0; i < sets; ++i)
+    {
+        deficit[i] = total_set_weight > 0
+                   ? (total * set_weights[i]) / total_set_weight
+                   : total / sets;
+    }
+
+    // regions already on a set stay there while the set has room, so that
+    // a change in weights moves only the regions it has to
+    std::map<std::vector<server_id>, size_t> set_of;
+
+    for (size_t i = sets; i > 0; --i)
+    {
+        std::vector<server_id> members;
+
+        for (size_t j = 0; j < replica_sets[i - 1].size(); ++j)
+        {
+            members.push_back(replica_sets[i - 1][j]);
+        }
+
+        if (!members.empty())
+        {
+            set_of[members] = i - 1;
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const region& reg(ss.regions[i]);
+        std::vector<server_id> members;
+
+        for (size_t j = 0; j < reg.replicas.size(); ++j)
+        {
+            members.push_back(reg.replicas[j].si);
+        }
+
+        std::map<std::vector<server_id>, size_t>::iterator it = set_of.find(members);
+        const int64_t w = weights[i];
+
+        if (it != set_of.end() && deficit[it->second] * 2 >= w)
+        {
+            (*assignment)[i] = it->second;
+            deficit[it->second] -= w;
+        }
+    }
+
+    // everything else goes wherever is furthest below its share
+    for (size_t i = 0; i < n; ++i)
+    {
+        if ((*assignment)[i] < sets)
+        {
+            continue;
+        }
+
+        size_t best = 0;
+
+        for (size_t j = 1; j < sets; ++j)
+        {
+            if (deficit[j] > deficit[best])
+            {
+                best = j;
+            }
+        }
+
+        (*assignment)[i] = best;
+        deficit[best] -= weights[i];
+    }
+}
+
+bool
+coordinator :: region_weights(const subspace& ss,
+                              std::vector<uint64_t>* weights)
+{
+    const size_t n = ss.regions.size();
+    std::vector<const region_load*> loads;
+    loads.reserve(n);
+    uint64_t bytes = 0;
+    uint64_t ops = 0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        region_load key(ss.regions[i].id, 0, 0);
+        std::vector<region_load>::iterator it;
+        it = std::lower_bound(m_loads.begin(), m_loads.end(), key);
+
+        if (it == m_loads.end() || it->id != key.id)
+        {
+            return false;
+        }
+
+        loads.push_back(&*it);
+        bytes += it->bytes;
+        ops += it->ops;
+    }
+
+    if (n == 0 || (bytes == 0 && ops == 0))
+    {
+        return false;
+    }
+
+    // size and rate count equally; the floor keeps empty, idle regions from
+    // all piling onto one set
+    const uint64_t floor = WEIGHT_UNIT / (4 * n) + 1;
+    weights->resize(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        (*weights)[i] = floor
+                      + scale_to_unit(loads[i]->bytes, bytes)
+                      + scale_to_unit(loads[i]->ops, ops);
+    }
+
+    return true;
+}
+
+bool
+coordinator :: load_imbalanced(const subspace& ss)
+{
+    std::vector<uint64_t> weights;
+
+    if (m_permutation.size() < 2 || !region_weights(ss, &weights))
+    {
+        return false;
+    }
+
+    std::map<server_id, uint64_t> per_server;
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < ss.regions.size(); ++i)
+    {
+        const region& reg(ss.regions[i]);
+
+        for (size_t j = 0; j < reg.replicas.size(); ++j)
+        {
+            per_server[reg.replicas[j].si] += weights[i];
+            total += weights[i];
+        }
+    }
+
+    uint64_t total_capacity = 0;
+
+    for (size_t i = 0; i < m_permutation.size(); ++i)
+    {
+        server* srv = get_server(m_permutation[i]);
+        total_capacity += srv ? srv->weight : 0;
+    }
+
+    for (std::map<server_id, uint64_t>::iterator it = per_server.begin();
+            it != per_server.end(); ++it)
+    {
+        server* srv = get_server(it->first);
+        uint64_t capacity = srv ? srv->weight : 0;
+        uint64_t share = total_capacity > 0
+                       ? (total * capacity) / total_capacity
+                       : total / m_permutation.size();
+
+        // a server carrying a quarter more than its share
+        if (it->second * 4 > share * 5)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Load is evened out by moving whole regions between replica sets.  Region
+// boundaries are fixed when the space is created and are never split or
+// merged here, so a space needs several partitions per server for whole
+// regions to spread its load.
+void
+coordinator :: rebalance_load(rsm_context* ctx)
+{
+    // let the previous round of moves finish before judging the placement
+    if (m_permutation.empty() || !m_intents.empty() || !m_transfers.empty())
+    {
+        return;
+    }
+
+    bool changed = false;
+
+    for (space_map_t::iterator it = m_spaces.begin();
+            it != m_spaces.end(); ++it)
+    {
+        space* s(it->second.get());
+        bool imbalanced = false;
+
+        if (std::find(m_deferred_init.begin(),
+                      m_deferred_init.end(),
+                      s->id) != m_deferred_init.end())
+        {
+            continue;
+        }
+
+        for (size_t i = 0; !imbalanced && i < s->subspaces.size(); ++i)
+        {
+            imbalanced = load_imbalanced(s->subspaces[i]);
+        }
+
+        if (!imbalanced)
+        {
+            continue;
+        }
+
+        std::vector<server_id> replica_storage;
+        std::vector<replica_set> replica_sets;
+        compute_replica_sets(s->fault_tolerance + 1, s->predecessor_width,
+                             m_permutation, m_servers,
+                             &replica_storage, &replica_sets);
+
+        // the sets may not allow a better placement than the current one;
+        // ask setup_intents rather than counting intents, because
+        // converge_intent may finish an intent, and drop it, at once
+        if (setup_intents(ctx, replica_sets, s, false))
+        {
+            rsm_log(ctx, "moving regions of space \"%s\" to even out their load\n", s->name);
+            changed = true;
+        }
+    }
+
+    if (changed)
+    {
+        generate_next_configuration(ctx);
+    }
+}
+
 transfer*
 coordinator :: new_transfer(region* reg,
                             const server_id& sid)
@@ -1869,6 +2302,7 @@ coordinator :: generate_next_configuration(rsm_context* ctx)
     check_stable_condition(ctx);
     generate_cached_configuration(ctx);
     rsm_cond_broadcast_data(ctx, "config", m_latest_config->cdata(), m_latest_config->size());
+    rsm_cond_broadcast_data(ctx, "config_delta", m_latest_delta->cdata(), m_latest_delta->size());
     broadcast_checkpoint_information(ctx);
 }
 
@@ -1921,6 +2355,47 @@ coordinator :: generate_cached_configuration(rsm_context*)
     }
 
     m_latest_config = new_config;
+
+    // followers of "config_delta" that saw the previous broadcast apply
+    // just the changes; everyone else fetches the whole configuration
+    configuration_delta delta;
+    delta.cluster = m_cluster;
+    delta.base_version = m_published_version;
+    delta.version = m_version;
+    delta.flags = m_flags;
+    delta.servers = m_servers;
+    delta.transfers = transfers_subset;
+    std::vector<const space*> after;
+
+    for (std::map<std::string, e::compat::shared_ptr<space> >::iterator it = m_spaces.begin();
+            it != m_spaces.end(); ++it)
+    {
+        after.push_back(it->second.get());
+    }
+
+    if (m_published_version > 0)
+    {
+        std::vector<const space*> before;
+
+        for (size_t i = 0; i < m_published_spaces.size(); ++i)
+        {
+            before.push_back(&m_published_spaces[i]);
+        }
+
+        delta.diff_spaces(before, after);
+    }
+
+    m_latest_delta.reset(e::buffer::create(pack_size(delta)));
+    m_latest_delta->pack_at(0) << delta;
+    m_published_spaces.clear();
+    m_published_spaces.reserve(after.size());
+
+    for (size_t i = 0; i < after.size(); ++i)
+    {
+        m_published_spaces.push_back(*after[i]);
+    }
+
+    m_published_version = m_version;
 }
 
 struct coordinator::transfer_sorter
@@ -1950,10 +2425,17 @@ coordinator :: transfer_sorter :: operator () (const transfer& lhs, const transf
     {
         return false;
     }
-    else
+    else if (rlhs->replicas.size() != rrhs->replicas.size())
     {
         return rlhs->replicas.size() < rrhs->replicas.size();
     }
+
+    // fill the servers that are meant to hold the most first
+    server* dlhs = coord->get_server(lhs.dst);
+    server* drhs = coord->get_server(rhs.dst);
+    uint64_t wlhs = dlhs ? dlhs->weight : 0;
+    uint64_t wrhs = drhs ? drhs->weight : 0;
+    return wlhs > wrhs;
 }
 
 void
@@ -44,6 +44,7 @@
 #include "namespace.h"
 #include "common/hyperspace.h"
 #include "common/ids.h"
+#include "common/region_load.h"
 #include "common/server.h"
 #include "common/transfer.h"
 #include "coordinator/offline_server.h"
@@ -75,9 +76,11 @@ class coordinator
         void server_register(rsm_context* ctx,
                              const server_id& sid,
                              const po6::net::location& bind_to);
+        // a weight of 0 leaves the server's weight as it was
         void server_online(rsm_context* ctx,
                            const server_id& sid,
-                           const po6::net::location* bind_to);
+                           const po6::net::location* bind_to,
+                           uint64_t weight);
         void server_offline(rsm_context* ctx,
                             const server_id& sid);
         void server_shutdown(rsm_context* ctx,
@@ -109,6 +112,12 @@ class coordinator
         void transfer_complete(rsm_context* ctx,
                                const transfer_id& xid);
 
+    // load management
+    public:
+        void report_load(rsm_context* ctx,
+                         const server_id& sid,
+                         const std::vector<region_load>& loads);
+
     // config management
     public:
         void config_get(rsm_context* ctx);
@@ -160,8 +169,8 @@ class coordinator
         void initial_space_layout(rsm_context* ctx,
                                   space* s);
         region* get_region(const region_id& rid);
-        // intents
-        void setup_intents(rsm_context* ctx,
+        // intents; returns true if any region was not on its replica set
+        bool setup_intents(rsm_context* ctx,
                            const std::vector<replica_set>& replica_sets,
                            space* s, bool skip_transfers);
         // looks up region_intent* ri, removing any possibility of the user
@@ -176,6 +185,19 @@ class coordinator
         void del_region_intent(const region_id& rid);
         void remove_offline(const region_id& rid);
         void remove_offline(const server_id& sid);
+        // load
+        // the replica set for each of the subspace's regions, giving each
+        // set its weighted share of the reported load (or of the regions,
+        // if some are unreported)
+        void assign_regions(const subspace& ss,
+                            const std::vector<replica_set>& replica_sets,
+                            const std::vector<uint64_t>& set_weights,
+                            std::vector<size_t>* assignment);
+        bool region_weights(const subspace& ss,
+                            std::vector<uint64_t>* weights);
+        bool load_imbalanced(const subspace& ss);
+        // move whole regions off servers carrying more than their share
+        void rebalance_load(rsm_context* ctx);
         // transfers
         transfer* new_transfer(region* reg, const server_id& si);
         transfer* get_transfer(const region_id& rid);
@@ -213,6 +235,9 @@ class coordinator
         std::vector<offline_server> m_offline;
         // transfers
         std::vector<transfer> m_transfers;
+        // the latest load reported by the head of each region, sorted by id;
+        // snapshots older than SNAPSHOT_LOADS restore without any
+        std::vector<region_load> m_loads;
         // barriers
         uint64_t m_config_ack_through;
         server_barrier m_config_ack_barrier;
@@ -225,6 +250,11 @@ class coordinator
         server_barrier m_checkpoint_stable_barrier;
         // cached config
         std::auto_ptr<e::buffer> m_latest_config;
+        // the delta from m_published_version to the latest config; the
+        // published spaces are a copy of the ones last broadcast
+        std::auto_ptr<e::buffer> m_latest_delta;
+        std::vector<space> m_published_spaces;
+        uint64_t m_published_version;
         std::auto_ptr<e::buffer> m_response;
 
     private:
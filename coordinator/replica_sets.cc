@@ -27,6 +27,7 @@
 
 // STL
 #include <algorithm>
+#include <map>
 
 // HyperDex
 #include "coordinator/replica_sets.h"
@@ -35,6 +36,12 @@ using hyperdex::replica_set;
 using hyperdex::server;
 using hyperdex::server_id;
 
+// set weights are fixed point, averaging SET_WEIGHT_UNIT
+#define SET_WEIGHT_UNIT (static_cast<uint64_t>(1) << 16)
+#define SET_WEIGHT_ROUNDS 32
+// server weights above this are clamped so the fixed point cannot overflow
+#define MAX_SERVER_WEIGHT (static_cast<uint64_t>(1) << 20)
+
 namespace
 {
 
@@ -182,3 +189,125 @@ hyperdex :: compute_replica_sets(uint64_t R, uint64_t P,
         _permutation_replica_sets(R, P, permutation, servers, replica_storage, replica_sets);
     }
 }
+
+void
+hyperdex :: compute_replica_set_weights(const std::vector<replica_set>& replica_sets,
+                                        const std::vector<server>& servers,
+                                        std::vector<uint64_t>* weights)
+{
+    weights->assign(replica_sets.size(), SET_WEIGHT_UNIT);
+    std::map<server_id, uint64_t> capacity;
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        capacity[servers[i].id] = std::max(std::min(servers[i].weight, MAX_SERVER_WEIGHT),
+                                           uint64_t(1));
+    }
+
+    // number the servers that appear in the sets
+    std::map<server_id, size_t> index;
+    std::vector<uint64_t> target;
+    std::vector<std::vector<size_t> > members(replica_sets.size());
+
+    for (size_t i = 0; i < replica_sets.size(); ++i)
+    {
+        for (size_t j = 0; j < replica_sets[i].size(); ++j)
+        {
+            server_id sid = replica_sets[i][j];
+            std::map<server_id, size_t>::iterator it = index.find(sid);
+
+            if (it == index.end())
+            {
+                std::map<server_id, uint64_t>::iterator c = capacity.find(sid);
+                it = index.insert(std::make_pair(sid, target.size())).first;
+                target.push_back(c != capacity.end() ? c->second : uint64_t(server::DEFAULT_WEIGHT));
+            }
+
+            members[i].push_back(it->second);
+        }
+    }
+
+    // sets whose servers are all unavailable take nothing, unless no set
+    // has a server
+    for (size_t i = 0; !target.empty() && i < members.size(); ++i)
+    {
+        if (members[i].empty())
+        {
+            (*weights)[i] = 0;
+        }
+    }
+
+    uint64_t total_target = 0;
+    bool uniform = true;
+
+    for (size_t i = 0; i < target.size(); ++i)
+    {
+        total_target += target[i];
+        uniform = uniform && target[i] == target[0];
+    }
+
+    if (uniform)
+    {
+        return;
+    }
+
+    // Repeatedly scale each set by how far its members are from their share.
+    // This is iterative proportional fitting, in integers so that every
+    // coordinator replica computes the same weights.
+    std::vector<uint64_t> load(target.size());
+    std::vector<uint64_t> ratio(target.size());
+
+    for (unsigned round = 0; round < SET_WEIGHT_ROUNDS; ++round)
+    {
+        uint64_t total_load = 0;
+        std::fill(load.begin(), load.end(), 0);
+
+        for (size_t i = 0; i < members.size(); ++i)
+        {
+            for (size_t j = 0; j < members[i].size(); ++j)
+            {
+                load[members[i][j]] += (*weights)[i];
+                total_load += (*weights)[i];
+            }
+        }
+
+        for (size_t i = 0; i < target.size(); ++i)
+        {
+            uint64_t share = (total_load * target[i]) / total_target;
+            ratio[i] = load[i] > 0 ? (share * SET_WEIGHT_UNIT) / load[i] : SET_WEIGHT_UNIT;
+            ratio[i] = std::min(ratio[i], 16 * SET_WEIGHT_UNIT);
+        }
+
+        uint64_t total_weight = 0;
+
+        for (size_t i = 0; i < members.size(); ++i)
+        {
+            if (members[i].empty())
+            {
+                continue;
+            }
+
+            uint64_t r = 0;
+
+            for (size_t j = 0; j < members[i].size(); ++j)
+            {
+                r += ratio[members[i][j]];
+            }
+
+            r /= members[i].size();
+            (*weights)[i] = std::max(((*weights)[i] * r) / SET_WEIGHT_UNIT, uint64_t(1));
+            total_weight += (*weights)[i];
+        }
+
+        // keep the average at SET_WEIGHT_UNIT
+        const uint64_t goal = replica_sets.size() * SET_WEIGHT_UNIT;
+
+        for (size_t i = 0; total_weight > 0 && i < weights->size(); ++i)
+        {
+            if (!members[i].empty())
+            {
+                (*weights)[i] = std::max(((*weights)[i] * goal) / total_weight, uint64_t(1));
+            }
+        }
+    }
+}
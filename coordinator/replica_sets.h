@@ -63,6 +63,15 @@ compute_replica_sets(uint64_t R, uint64_t P,
                      std::vector<server_id>* replica_storage,
                      std::vector<replica_set>* replica_sets);
 
+// The share of the regions each replica set should hold, in proportion to
+// the returned weights.  Sets are weighed so that each server's total share
+// follows its own weight as closely as the sets it belongs to allow; when
+// every server weighs the same, so does every set.
+void
+compute_replica_set_weights(const std::vector<replica_set>& replica_sets,
+                            const std::vector<server>& servers,
+                            std::vector<uint64_t>* weights);
+
 END_HYPERDEX_NAMESPACE
 
 #endif // hyperdex_coordinator_replica_sets_h_
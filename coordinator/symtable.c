@@ -58,6 +58,7 @@ struct state_machine HYPERDEX_API rsm = {
      {"index_rm", hyperdex_coordinator_index_rm},
      {"transfer_go_live", hyperdex_coordinator_transfer_go_live},
      {"transfer_complete", hyperdex_coordinator_transfer_complete},
+     {"report_load", hyperdex_coordinator_report_load},
      {"checkpoint_stable", hyperdex_coordinator_checkpoint_stable},
      {"periodic", hyperdex_coordinator_periodic},
      {"read_only", hyperdex_coordinator_read_only},
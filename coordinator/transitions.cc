@@ -30,6 +30,7 @@
 
 // STL
 #include <string>
+#include <vector>
 
 // HyperDex
 #include "common/coordinator_returncode.h"
@@ -70,6 +71,7 @@ void*
 hyperdex_coordinator_create(struct rsm_context* ctx)
 {
     rsm_cond_create(ctx, "config");
+    rsm_cond_create(ctx, "config_delta");
     rsm_cond_create(ctx, "ack");
     rsm_cond_create(ctx, "stable");
     rsm_cond_create(ctx, "checkpoint");
@@ -181,18 +183,26 @@ hyperdex_coordinator_server_online(struct rsm_context* ctx,
     PROTECT_UNINITIALIZED;
     server_id sid;
     po6::net::location bind_to;
+    uint64_t weight = 0;
     e::unpacker up(data, data_sz);
     up = up >> sid;
 
     if (!up.error() && !up.remain())
     {
-        c->server_online(ctx, sid, NULL);
+        c->server_online(ctx, sid, NULL, weight);
     }
     else
     {
         up = up >> bind_to;
+
+        // older daemons don't send a weight
+        if (!up.error() && up.remain())
+        {
+            up = up >> weight;
+        }
+
         CHECK_UNPACK(server_online);
-        c->server_online(ctx, sid, &bind_to);
+        c->server_online(ctx, sid, &bind_to, weight);
     }
 }
 
@@ -382,6 +392,19 @@ hyperdex_coordinator_transfer_complete(struct rsm_context* ctx,
     c->transfer_complete(ctx, xid);
 }
 
+void
+hyperdex_coordinator_report_load(struct rsm_context* ctx,
+                                 void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    server_id sid;
+    std::vector<region_load> loads;
+    e::unpacker up(data, data_sz);
+    up = up >> sid >> loads;
+    CHECK_UNPACK(report_load);
+    c->report_load(ctx, sid, loads);
+}
+
 void
 hyperdex_coordinator_checkpoint_stable(struct rsm_context* ctx,
                                        void* obj, const char* data, size_t data_sz)
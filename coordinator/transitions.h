@@ -79,6 +79,8 @@ TRANSITION(index_rm);
 TRANSITION(transfer_go_live);
 TRANSITION(transfer_complete);
 
+TRANSITION(report_load);
+
 TRANSITION(checkpoint_stable);
 TRANSITION(checkpoints);
 
@@ -0,0 +1,250 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <cassert>
+
+// STL
+#include <algorithm>
+
+// HyperDex
+#include "daemon/buffer_pool.h"
+
+using hyperdex::buffer_pool;
+
+#define SMALLEST_CLASS 32
+#define THREAD_CACHE_BYTES (256 * 1024)
+#define DEPOT_MULTIPLIER 4
+
+namespace
+{
+
+// the cache installed by the current thread, if any
+__thread buffer_pool::thread_cache* s_cache = NULL;
+
+} // namespace
+
+const size_t buffer_pool::CLASSES;
+
+buffer_pool :: buffer_pool()
+    : m_depot_mtx()
+    , m_depot()
+    , m_created()
+    , m_reused()
+    , m_recycled()
+    , m_discarded()
+{
+}
+
+buffer_pool :: ~buffer_pool() throw ()
+{
+    for (size_t c = 0; c < CLASSES; ++c)
+    {
+        for (size_t i = 0; i < m_depot[c].size(); ++i)
+        {
+            delete m_depot[c][i];
+        }
+    }
+}
+
+std::auto_ptr<e::buffer>
+buffer_pool :: create(size_t sz)
+{
+    size_t c = class_for_request(sz);
+
+    if (c >= CLASSES)
+    {
+        m_created.tap();
+        return std::auto_ptr<e::buffer>(e::buffer::create(sz));
+    }
+
+    thread_cache* tc = cache();
+    e::buffer* buf = NULL;
+
+    if (tc && !tc->m_free[c].empty())
+    {
+        buf = tc->m_free[c].back();
+        tc->m_free[c].pop_back();
+    }
+    else
+    {
+        buf = depot_get(c);
+    }
+
+    if (buf)
+    {
+        m_reused.tap();
+        buf->clear();
+        return std::auto_ptr<e::buffer>(buf);
+    }
+
+    m_created.tap();
+    return std::auto_ptr<e::buffer>(e::buffer::create(class_size(c)));
+}
+
+void
+buffer_pool :: recycle(std::auto_ptr<e::buffer> buf)
+{
+    if (!buf.get())
+    {
+        return;
+    }
+
+    size_t c = class_for_capacity(buf->capacity());
+
+    if (c >= CLASSES)
+    {
+        m_discarded.tap();
+        return;
+    }
+
+    thread_cache* tc = cache();
+
+    if (tc && tc->m_free[c].size() < class_limit(c))
+    {
+        tc->m_free[c].push_back(buf.release());
+    }
+    else if (depot_put(c, buf.get()))
+    {
+        buf.release();
+    }
+    else
+    {
+        m_discarded.tap();
+        return;
+    }
+
+    m_recycled.tap();
+}
+
+size_t
+buffer_pool :: class_size(size_t c)
+{
+    return SMALLEST_CLASS << (2 * c);
+}
+
+size_t
+buffer_pool :: class_limit(size_t c)
+{
+    size_t limit = THREAD_CACHE_BYTES / class_size(c);
+    return std::max(size_t(2), std::min(size_t(64), limit));
+}
+
+size_t
+buffer_pool :: class_for_request(size_t sz)
+{
+    for (size_t c = 0; c < CLASSES; ++c)
+    {
+        if (sz <= class_size(c))
+        {
+            return c;
+        }
+    }
+
+    return CLASSES;
+}
+
+size_t
+buffer_pool :: class_for_capacity(size_t cap)
+{
+    // don't let a few huge messages pin memory in the top class
+    if (cap < class_size(0) || cap > 2 * class_size(CLASSES - 1))
+    {
+        return CLASSES;
+    }
+
+    size_t c = 0;
+
+    while (c + 1 < CLASSES && class_size(c + 1) <= cap)
+    {
+        ++c;
+    }
+
+    return c;
+}
+
+buffer_pool::thread_cache*
+buffer_pool :: cache()
+{
+    return s_cache && s_cache->m_bp == this ? s_cache : NULL;
+}
+
+e::buffer*
+buffer_pool :: depot_get(size_t c)
+{
+    po6::threads::mutex::hold hold(&m_depot_mtx);
+
+    if (m_depot[c].empty())
+    {
+        return NULL;
+    }
+
+    e::buffer* buf = m_depot[c].back();
+    m_depot[c].pop_back();
+    return buf;
+}
+
+bool
+buffer_pool :: depot_put(size_t c, e::buffer* buf)
+{
+    po6::threads::mutex::hold hold(&m_depot_mtx);
+
+    if (m_depot[c].size() >= class_limit(c) * DEPOT_MULTIPLIER)
+    {
+        return false;
+    }
+
+    m_depot[c].push_back(buf);
+    return true;
+}
+
+buffer_pool :: thread_cache :: thread_cache(buffer_pool* bp)
+    : m_bp(bp)
+    , m_prev(s_cache)
+    , m_free()
+{
+    s_cache = this;
+}
+
+buffer_pool :: thread_cache :: ~thread_cache() throw ()
+{
+    assert(s_cache == this);
+    s_cache = m_prev;
+
+    for (size_t c = 0; c < CLASSES; ++c)
+    {
+        for (size_t i = 0; i < m_free[c].size(); ++i)
+        {
+            if (!m_bp->depot_put(c, m_free[c][i]))
+            {
+                delete m_free[c][i];
+            }
+        }
+    }
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_buffer_pool_h_
+#define hyperdex_daemon_buffer_pool_h_
+
+// STL
+#include <memory>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/buffer.h>
+
+// HyperDex
+#include "namespace.h"
+#include "daemon/performance_counter.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A size-classed free list of message buffers.  Each network thread installs a
+// thread_cache so that the common case of recycling a request buffer and then
+// allocating a response touches neither the allocator nor a lock.  Threads
+// without a cache, and caches that overflow, share a mutex-protected depot.
+//
+// Busybee takes ownership of every buffer that is sent, so only buffers that
+// we receive find their way back into the pool.
+class buffer_pool
+{
+    public:
+        class thread_cache;
+        const static size_t CLASSES = 7;
+
+    public:
+        buffer_pool();
+        ~buffer_pool() throw ();
+
+    public:
+        // the returned buffer has a capacity of at least sz and a size of 0
+        std::auto_ptr<e::buffer> create(size_t sz);
+        // take back a buffer that is no longer referenced
+        void recycle(std::auto_ptr<e::buffer> buf);
+
+    public:
+        uint64_t created() const { return m_created.read(); }
+        uint64_t reused() const { return m_reused.read(); }
+        uint64_t recycled() const { return m_recycled.read(); }
+        uint64_t discarded() const { return m_discarded.read(); }
+
+    private:
+        static size_t class_size(size_t c);
+        static size_t class_limit(size_t c);
+        // smallest class that can satisfy a request of sz bytes
+        static size_t class_for_request(size_t sz);
+        // largest class whose requests a buffer of capacity cap satisfies
+        static size_t class_for_capacity(size_t cap);
+        thread_cache* cache();
+        e::buffer* depot_get(size_t c);
+        bool depot_put(size_t c, e::buffer* buf);
+
+    private:
+        po6::threads::mutex m_depot_mtx;
+        std::vector<e::buffer*> m_depot[CLASSES];
+        performance_counter m_created;
+        performance_counter m_reused;
+        performance_counter m_recycled;
+        performance_counter m_discarded;
+
+    private:
+        buffer_pool(const buffer_pool&);
+        buffer_pool& operator = (const buffer_pool&);
+};
+
+// Constructing a thread_cache makes it the cache for the calling thread until
+// it is destroyed, at which point its buffers are handed to the depot.
+class buffer_pool::thread_cache
+{
+    public:
+        thread_cache(buffer_pool* bp);
+        ~thread_cache() throw ();
+
+    private:
+        friend class buffer_pool;
+
+    private:
+        buffer_pool* m_bp;
+        thread_cache* m_prev;
+        std::vector<e::buffer*> m_free[CLASSES];
+
+    private:
+        thread_cache(const thread_cache&);
+        thread_cache& operator = (const thread_cache&);
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_buffer_pool_h_
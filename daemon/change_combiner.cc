@@ -0,0 +1,78 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <assert.h>
+
+// HyperDex
+#include "daemon/change_combiner.h"
+
+using hyperdex::change_combiner;
+
+change_combiner :: change_combiner(const schema& sc, const e::slice& key,
+                                   std::auto_ptr<e::arena> memory,
+                                   const std::vector<e::slice>& value)
+    : m_sc(sc)
+    , m_key(key)
+    , m_memory(memory)
+    , m_spare(new e::arena())
+    , m_value(value)
+    , m_scratch(value.size())
+{
+}
+
+change_combiner :: ~change_combiner() throw ()
+{
+}
+
+bool
+change_combiner :: fold(const std::vector<funcall>& funcs)
+{
+    assert(m_memory.get());
+
+    if (apply_funcs(m_sc, funcs, m_key, m_value, m_spare.get(), &m_scratch) < funcs.size())
+    {
+        // drop whatever the failed fold wrote
+        m_spare.reset(new e::arena());
+        return false;
+    }
+
+    // the new value lives entirely in m_spare; the old one can go
+    m_value.swap(m_scratch);
+    std::auto_ptr<e::arena> stale(m_memory);
+    m_memory = m_spare;
+    m_spare.reset(new e::arena());
+    return true;
+}
+
+std::auto_ptr<e::arena>
+change_combiner :: memory()
+{
+    return m_memory;
+}
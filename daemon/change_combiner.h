@@ -0,0 +1,84 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_change_combiner_h_
+#define hyperdex_daemon_change_combiner_h_
+
+// STL
+#include <memory>
+#include <vector>
+
+// e
+#include <e/arena.h>
+#include <e/slice.h>
+
+// HyperDex
+#include "namespace.h"
+#include "common/funcall.h"
+#include "common/schema.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// Folds a run of queued changes into one value, one change at a time.
+// apply_funcs writes every attribute of its result into the arena it is
+// given, so each fold needs only the arena holding the current value and the
+// one it writes into.  The two trade places after every fold and the stale
+// one is emptied, so a batch holds at most two copies of the value no matter
+// how many changes it folds.
+class change_combiner
+{
+    public:
+        // value must already live entirely in memory
+        change_combiner(const schema& sc, const e::slice& key,
+                        std::auto_ptr<e::arena> memory,
+                        const std::vector<e::slice>& value);
+        ~change_combiner() throw ();
+
+    public:
+        // apply funcs on top of the current value; if any of them fails, the
+        // value is left as it was and fold returns false
+        bool fold(const std::vector<funcall>& funcs);
+        const std::vector<e::slice>& value() const { return m_value; }
+        // the arena holding value(); the combiner must not fold afterwards
+        std::auto_ptr<e::arena> memory();
+
+    private:
+        change_combiner(const change_combiner&);
+        change_combiner& operator = (const change_combiner&);
+
+    private:
+        const schema& m_sc;
+        const e::slice m_key;
+        std::auto_ptr<e::arena> m_memory;
+        std::auto_ptr<e::arena> m_spare;
+        std::vector<e::slice> m_value;
+        std::vector<e::slice> m_scratch;
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_change_combiner_h_
@@ -31,9 +31,15 @@
 #include "config.h"
 #endif
 
+// C
+#include <string.h>
+
 // Google Log
 #include <glog/logging.h>
 
+// e
+#include <e/atomic.h>
+
 // HyperDex
 #include "daemon/communication.h"
 #include "daemon/daemon.h"
@@ -41,6 +47,19 @@
 using hyperdex::communication;
 using hyperdex::reconfigure_returncode;
 
+// messages at most this large may be coalesced
+#define COALESCE_MESSAGE_BYTES 1024
+// a destination's outbox is sent as soon as it holds this much
+#define COALESCE_FRAME_BYTES 16384
+
+namespace
+{
+
+// the outbox installed by the current thread, if any
+__thread communication::outbox* s_outbox = NULL;
+
+} // namespace
+
 //////////////////////////////// Early Messages ////////////////////////////////
 
 class communication::early_message
@@ -81,9 +100,13 @@ communication :: early_message :: ~early_message() throw ()
 
 communication :: communication(daemon* d)
     : m_daemon(d)
+    , m_buffers()
     , m_busybee_mapper(&m_daemon->m_config)
     , m_busybee()
     , m_early_messages()
+    , m_coalesce(false)
+    , m_batches()
+    , m_coalesced()
 {
 }
 
@@ -93,10 +116,12 @@ communication :: ~communication() throw ()
 
 bool
 communication :: setup(const po6::net::location& bind_to,
-                       unsigned threads)
+                       unsigned threads,
+                       bool coalesce)
 {
     m_busybee.reset(new busybee_mta(&m_daemon->m_gc, &m_busybee_mapper, bind_to, m_daemon->m_us.get(), threads));
     m_busybee->set_ignore_signals();
+    m_coalesce = coalesce;
     return true;
 }
 
@@ -109,13 +134,19 @@ void
 communication :: reconfigure(const configuration&,
                              const configuration& new_config,
                              const server_id&)
+{
+    deliver_early_messages(new_config.version());
+}
+
+void
+communication :: deliver_early_messages(uint64_t version)
 {
     e::lockfree_fifo<early_message> ems;
     early_message em;
 
     while (m_early_messages.pop(&em))
     {
-        if (em.config_version <= new_config.version())
+        if (em.config_version <= version)
         {
             m_busybee->deliver(em.id, em.msg);
         }
@@ -131,7 +162,7 @@ communication :: reconfigure(const configuration&,
     }
 }
 
-bool
+communication::send_status
 communication :: send_client(const virtual_server_id& from,
                              const server_id& to,
                              network_msgtype msg_type,
@@ -139,10 +170,10 @@ communication :: send_client(const virtual_server_id& from,
 {
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VC);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from) &&
+    if (m_daemon->m_us != m_daemon->m_config->get_server_id(from) &&
         from != virtual_server_id(UINT64_MAX))
     {
-        return false;
+        return SEND_FAILED;
     }
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
@@ -152,37 +183,11 @@ communication :: send_client(const virtual_server_id& from,
     LOG(INFO) << "SEND " << from << "->" << to << " " << msg_type << " " << msg->hex();
 #endif
 
-    if (to == m_daemon->m_us)
-    {
-        m_busybee->deliver(to.get(), msg);
-    }
-    else
-    {
-        busybee_returncode rc = m_busybee->send(to.get(), msg);
-
-        switch (rc)
-        {
-            case BUSYBEE_SUCCESS:
-                break;
-            case BUSYBEE_DISRUPTED:
-                handle_disruption(to.get());
-                return false;
-            case BUSYBEE_SHUTDOWN:
-            case BUSYBEE_POLLFAILED:
-            case BUSYBEE_ADDFDFAIL:
-            case BUSYBEE_TIMEOUT:
-            case BUSYBEE_EXTERNAL:
-            case BUSYBEE_INTERRUPTED:
-            default:
-                LOG(ERROR) << "BusyBee unexpectedly returned " << rc;
-                return false;
-        }
-    }
-
-    return true;
+    // clients cannot unpack batches
+    return transmit_now(to, msg);
 }
 
-bool
+communication::send_status
 communication :: send(const virtual_server_id& from,
                       const server_id& to,
                       network_msgtype msg_type,
@@ -190,56 +195,29 @@ communication :: send(const virtual_server_id& from,
 {
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from))
+    if (m_daemon->m_us != m_daemon->m_config->get_server_id(from))
     {
-        return false;
+        return SEND_FAILED;
     }
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 1;
     virtual_server_id vto(UINT64_MAX);
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get() << from.get();
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config->version() << vto.get() << from.get();
 
     if (to == server_id())
     {
-        return false;
+        return SEND_FAILED;
     }
 
 #ifdef HD_LOG_ALL_MESSAGES
     LOG(INFO) << "SEND " << from << "->" << to << " " << msg_type << " " << msg->hex();
 #endif
 
-    if (to == m_daemon->m_us)
-    {
-        m_busybee->deliver(to.get(), msg);
-    }
-    else
-    {
-        busybee_returncode rc = m_busybee->send(to.get(), msg);
-
-        switch (rc)
-        {
-            case BUSYBEE_SUCCESS:
-                break;
-            case BUSYBEE_DISRUPTED:
-                handle_disruption(to.get());
-                return false;
-            case BUSYBEE_SHUTDOWN:
-            case BUSYBEE_POLLFAILED:
-            case BUSYBEE_ADDFDFAIL:
-            case BUSYBEE_TIMEOUT:
-            case BUSYBEE_EXTERNAL:
-            case BUSYBEE_INTERRUPTED:
-            default:
-                LOG(ERROR) << "BusyBee unexpectedly returned " << rc;
-                return false;
-        }
-    }
-
-    return true;
+    return transmit(to, msg);
 }
 
-bool
+communication::send_status
 communication :: send(const virtual_server_id& from,
                       const virtual_server_id& vto,
                       network_msgtype msg_type,
@@ -247,56 +225,29 @@ communication :: send(const virtual_server_id& from,
 {
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from))
+    if (m_daemon->m_us != m_daemon->m_config->get_server_id(from))
     {
-        return false;
+        return SEND_FAILED;
     }
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 1;
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get() << from.get();
-    server_id to = m_daemon->m_config.get_server_id(vto);
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config->version() << vto.get() << from.get();
+    server_id to = m_daemon->m_config->get_server_id(vto);
 
     if (to == server_id())
     {
-        return false;
+        return SEND_FAILED;
     }
 
 #ifdef HD_LOG_ALL_MESSAGES
     LOG(INFO) << "SEND " << from << "->" << vto << " " << msg_type << " " << msg->hex();
 #endif
 
-    if (to == m_daemon->m_us)
-    {
-        m_busybee->deliver(to.get(), msg);
-    }
-    else
-    {
-        busybee_returncode rc = m_busybee->send(to.get(), msg);
-
-        switch (rc)
-        {
-            case BUSYBEE_SUCCESS:
-                break;
-            case BUSYBEE_DISRUPTED:
-                handle_disruption(to.get());
-                return false;
-            case BUSYBEE_SHUTDOWN:
-            case BUSYBEE_POLLFAILED:
-            case BUSYBEE_ADDFDFAIL:
-            case BUSYBEE_TIMEOUT:
-            case BUSYBEE_EXTERNAL:
-            case BUSYBEE_INTERRUPTED:
-            default:
-                LOG(ERROR) << "BusyBee unexpectedly returned " << rc;
-                return false;
-        }
-    }
-
-    return true;
+    return transmit(to, msg);
 }
 
-bool
+communication::send_status
 communication :: send(const virtual_server_id& vto,
                       network_msgtype msg_type,
                       std::auto_ptr<e::buffer> msg)
@@ -305,49 +256,22 @@ communication :: send(const virtual_server_id& vto,
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 0;
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get();
-    server_id to = m_daemon->m_config.get_server_id(vto);
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config->version() << vto.get();
+    server_id to = m_daemon->m_config->get_server_id(vto);
 
     if (to == server_id())
     {
-        return false;
+        return SEND_FAILED;
     }
 
 #ifdef HD_LOG_ALL_MESSAGES
     LOG(INFO) << "SEND ->" << vto << " " << msg_type << " " << msg->hex();
 #endif
 
-    if (to == m_daemon->m_us)
-    {
-        m_busybee->deliver(to.get(), msg);
-    }
-    else
-    {
-        busybee_returncode rc = m_busybee->send(to.get(), msg);
-
-        switch (rc)
-        {
-            case BUSYBEE_SUCCESS:
-                break;
-            case BUSYBEE_DISRUPTED:
-                handle_disruption(to.get());
-                return false;
-            case BUSYBEE_SHUTDOWN:
-            case BUSYBEE_POLLFAILED:
-            case BUSYBEE_ADDFDFAIL:
-            case BUSYBEE_TIMEOUT:
-            case BUSYBEE_EXTERNAL:
-            case BUSYBEE_INTERRUPTED:
-            default:
-                LOG(ERROR) << "BusyBee unexpectedly returned " << rc;
-                return false;
-        }
-    }
-
-    return true;
+    return transmit(to, msg);
 }
 
-bool
+communication::send_status
 communication :: send_exact(const virtual_server_id& from,
                             const virtual_server_id& vto,
                             network_msgtype msg_type,
@@ -355,53 +279,26 @@ communication :: send_exact(const virtual_server_id& from,
 {
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from))
+    if (m_daemon->m_us != m_daemon->m_config->get_server_id(from))
     {
-        return false;
+        return SEND_FAILED;
     }
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 1 | 2;
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get() << from.get();
-    server_id to = m_daemon->m_config.get_server_id(vto);
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config->version() << vto.get() << from.get();
+    server_id to = m_daemon->m_config->get_server_id(vto);
 
     if (to == server_id())
     {
-        return false;
+        return SEND_FAILED;
     }
 
 #ifdef HD_LOG_ALL_MESSAGES
     LOG(INFO) << "SEND " << from << "->" << vto << " " << msg_type << " " << msg->hex();
 #endif
 
-    if (to == m_daemon->m_us)
-    {
-        m_busybee->deliver(to.get(), msg);
-    }
-    else
-    {
-        busybee_returncode rc = m_busybee->send(to.get(), msg);
-
-        switch (rc)
-        {
-            case BUSYBEE_SUCCESS:
-                break;
-            case BUSYBEE_DISRUPTED:
-                handle_disruption(to.get());
-                return false;
-            case BUSYBEE_SHUTDOWN:
-            case BUSYBEE_POLLFAILED:
-            case BUSYBEE_ADDFDFAIL:
-            case BUSYBEE_TIMEOUT:
-            case BUSYBEE_EXTERNAL:
-            case BUSYBEE_INTERRUPTED:
-            default:
-                LOG(ERROR) << "BusyBee unexpectedly returned " << rc;
-                return false;
-        }
-    }
-
-    return true;
+    return transmit(to, msg);
 }
 
 bool
@@ -471,26 +368,47 @@ communication :: recv(e::garbage_collector::thread_state* ts,
             continue;
         }
 
+        // the configuration may be republished at any time; judge the whole
+        // message against one version of it
+        const configuration* config = e::atomic::load_ptr_acquire(&m_daemon->m_config);
         bool from_valid = true;
-        bool to_valid = m_daemon->m_us == m_daemon->m_config.get_server_id(*vto) ||
+        bool to_valid = m_daemon->m_us == config->get_server_id(*vto) ||
                         *vto == virtual_server_id(UINT64_MAX);
 
         // If this is a virtual-virtual message
         if ((flags & 0x1))
         {
-            from_valid = *from == m_daemon->m_config.get_server_id(virtual_server_id(vidf));
+            from_valid = *from == config->get_server_id(virtual_server_id(vidf));
         }
 
         // No matter what, wait for the config the sender saw
-        if (version > m_daemon->m_config.version())
+        if (version > config->version())
         {
             early_message em(version, id, *msg);
             m_early_messages.push(em);
+            // if the configuration moved on while we were queueing, the
+            // reconfiguration may have drained the queue before our push
+            config = e::atomic::load_ptr_acquire(&m_daemon->m_config);
+
+            if (version <= config->version())
+            {
+                deliver_early_messages(config->version());
+            }
+
             continue;
         }
 
-        if ((flags & 0x2) && version < m_daemon->m_config.version())
+        if ((flags & 0x2) && version < config->version())
         {
+            m_buffers.recycle(*msg);
+            continue;
+        }
+
+        // Unpack a frame of coalesced messages and receive each on its own
+        if (*msg_type == PACKET_BATCH)
+        {
+            debatch(id, *up);
+            m_buffers.recycle(*msg);
             continue;
         }
 
@@ -512,11 +430,200 @@ communication :: recv(e::garbage_collector::thread_state* ts,
     }
 }
 
+void
+communication :: flush()
+{
+    outbox* ob = this_outbox();
+
+    if (!ob)
+    {
+        return;
+    }
+
+    while (!ob->m_queues.empty())
+    {
+        flush(ob, ob->m_queues.begin()->first);
+    }
+}
+
+communication::outbox*
+communication :: this_outbox()
+{
+    return s_outbox && s_outbox->m_comm == this ? s_outbox : NULL;
+}
+
+communication::send_status
+communication :: transmit(const server_id& to, std::auto_ptr<e::buffer> msg)
+{
+    outbox* ob = m_coalesce && to != m_daemon->m_us ? this_outbox() : NULL;
+
+    if (!ob)
+    {
+        return transmit_now(to, msg);
+    }
+
+    // large messages go out on their own, but not ahead of those before them
+    if (msg->size() > COALESCE_MESSAGE_BYTES)
+    {
+        flush(ob, to.get());
+        return transmit_now(to, msg);
+    }
+
+    size_t* bytes = &ob->m_bytes[to.get()];
+    *bytes += msg->size();
+    ob->m_queues[to.get()].push_back(msg.release());
+
+    if (*bytes >= COALESCE_FRAME_BYTES)
+    {
+        return flush(ob, to.get());
+    }
+
+    return SEND_QUEUED;
+}
+
+communication::send_status
+communication :: transmit_now(const server_id& to, std::auto_ptr<e::buffer> msg)
+{
+    if (to == m_daemon->m_us)
+    {
+        m_busybee->deliver(to.get(), msg);
+    }
+    else
+    {
+        busybee_returncode rc = m_busybee->send(to.get(), msg);
+
+        switch (rc)
+        {
+            case BUSYBEE_SUCCESS:
+                break;
+            case BUSYBEE_DISRUPTED:
+                handle_disruption(to.get());
+                return SEND_FAILED;
+            case BUSYBEE_SHUTDOWN:
+            case BUSYBEE_POLLFAILED:
+            case BUSYBEE_ADDFDFAIL:
+            case BUSYBEE_TIMEOUT:
+            case BUSYBEE_EXTERNAL:
+            case BUSYBEE_INTERRUPTED:
+            default:
+                LOG(ERROR) << "BusyBee unexpectedly returned " << rc;
+                return SEND_FAILED;
+        }
+    }
+
+    return SEND_SENT;
+}
+
+communication::send_status
+communication :: flush(outbox* ob, uint64_t to)
+{
+    outbox::queue_map_t::iterator it = ob->m_queues.find(to);
+
+    if (it == ob->m_queues.end())
+    {
+        return SEND_SENT;
+    }
+
+    std::vector<e::buffer*> msgs;
+    msgs.swap(it->second);
+    ob->m_queues.erase(it);
+    ob->m_bytes.erase(to);
+
+    if (msgs.size() == 1)
+    {
+        return transmit_now(server_id(to), std::auto_ptr<e::buffer>(msgs[0]));
+    }
+
+    // each message keeps its own header, minus busybee's
+    size_t sz = HYPERDEX_HEADER_SIZE_SV + sizeof(uint32_t);
+
+    for (size_t i = 0; i < msgs.size(); ++i)
+    {
+        sz += sizeof(uint32_t) + msgs[i]->size() - BUSYBEE_HEADER_SIZE;
+    }
+
+    std::auto_ptr<e::buffer> frame(m_buffers.create(sz));
+    uint8_t mt = static_cast<uint8_t>(PACKET_BATCH);
+    uint8_t flags = 0;
+    virtual_server_id vto(UINT64_MAX);
+    uint32_t count = msgs.size();
+    e::packer pa = frame->pack_at(BUSYBEE_HEADER_SIZE)
+        << mt << flags << m_daemon->m_config->version() << vto.get() << count;
+
+    for (size_t i = 0; i < msgs.size(); ++i)
+    {
+        std::auto_ptr<e::buffer> msg(msgs[i]);
+        pa = pa << e::slice(msg->data() + BUSYBEE_HEADER_SIZE,
+                            msg->size() - BUSYBEE_HEADER_SIZE);
+        m_buffers.recycle(msg);
+    }
+
+    m_batches.tap();
+
+    for (size_t i = 0; i < msgs.size(); ++i)
+    {
+        m_coalesced.tap();
+    }
+
+    return transmit_now(server_id(to), frame);
+}
+
+void
+communication :: debatch(uint64_t id, e::unpacker up)
+{
+    uint32_t count;
+    up = up >> count;
+
+    for (uint32_t i = 0; !up.error() && i < count; ++i)
+    {
+        e::slice inner;
+        up = up >> inner;
+
+        if (up.error())
+        {
+            break;
+        }
+
+        std::auto_ptr<e::buffer> msg(m_buffers.create(BUSYBEE_HEADER_SIZE + inner.size()));
+        msg->resize(BUSYBEE_HEADER_SIZE + inner.size());
+        memmove(msg->data() + BUSYBEE_HEADER_SIZE, inner.data(), inner.size());
+        m_busybee->deliver(id, msg);
+    }
+
+    if (up.error())
+    {
+        LOG(WARNING) << "dropping the rest of a malformed message batch from " << server_id(id);
+    }
+}
+
 void
 communication :: handle_disruption(uint64_t id)
 {
-    if (m_daemon->m_config.get_address(server_id(id)) != po6::net::location())
+    if (m_daemon->m_config->get_address(server_id(id)) != po6::net::location())
+    {
+        m_daemon->m_coord->report_tcp_disconnect(m_daemon->m_config->version(), server_id(id));
+    }
+}
+
+////////////////////////////////// Outboxes ///////////////////////////////////
+
+communication :: outbox :: outbox(communication* comm)
+    : m_comm(comm)
+    , m_prev(s_outbox)
+    , m_queues()
+    , m_bytes()
+{
+    s_outbox = this;
+}
+
+communication :: outbox :: ~outbox() throw ()
+{
+    assert(s_outbox == this);
+
+    while (!m_queues.empty())
     {
-        m_daemon->m_coord->report_tcp_disconnect(m_daemon->m_config.version(), server_id(id));
+        m_comm->flush(this, m_queues.begin()->first);
     }
+
+    s_outbox = m_prev;
 }
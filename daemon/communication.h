@@ -29,7 +29,9 @@
 #define hyperdex_daemon_communication_h_
 
 // STL
+#include <map>
 #include <memory>
+#include <vector>
 
 // BusyBee
 #include <busybee_constants.h>
@@ -44,6 +46,8 @@
 #include "common/ids.h"
 #include "common/mapper.h"
 #include "common/network_msgtype.h"
+#include "daemon/buffer_pool.h"
+#include "daemon/performance_counter.h"
 #include "daemon/reconfigure_returncode.h"
 
 #define HYPERDEX_HEADER_SIZE_VC (BUSYBEE_HEADER_SIZE \
@@ -67,6 +71,20 @@ class daemon;
 
 class communication
 {
+    public:
+        class outbox;
+
+        // A message is either handed to busybee (SENT), or held in the
+        // calling thread's outbox until its next flush (QUEUED).  Failures of
+        // queued messages surface as a disruption of the destination, which
+        // the coordinator turns into a new configuration.
+        enum send_status
+        {
+            SEND_FAILED,
+            SEND_SENT,
+            SEND_QUEUED
+        };
+
     public:
         communication(daemon* d);
         ~communication() throw ();
@@ -78,34 +96,51 @@ class communication
         void wake_one() { m_busybee->wake_one(); }
 
     public:
+        // with coalesce, small messages sent by threads that have an outbox
+        // are packed into one frame per destination
         bool setup(const po6::net::location& bind_to,
-                   unsigned threads);
+                   unsigned threads,
+                   bool coalesce);
         void teardown();
         void reconfigure(const configuration& old_config,
                          const configuration& new_config,
                          const server_id& us);
 
+    public:
+        // Message buffers come from a pool; buffers that are received and not
+        // passed on should be recycled so they can carry the response
+        std::auto_ptr<e::buffer> create_buffer(size_t sz) { return m_buffers.create(sz); }
+        void recycle_buffer(std::auto_ptr<e::buffer> msg) { m_buffers.recycle(msg); }
+        buffer_pool* buffers() { return &m_buffers; }
+
+    public:
+        // Send everything coalesced in this thread's outbox.  Threads with an
+        // outbox must call this before they wait for more work.
+        void flush();
+        uint64_t batches_sent() const { return m_batches.read(); }
+        uint64_t messages_coalesced() const { return m_coalesced.read(); }
+
     public:
         // Send data to another server (pretending to be a client)
-        bool send_client(const virtual_server_id& from,
+        send_status send_client(const virtual_server_id& from,
+                                const server_id& to,
+                                network_msgtype msg_type,
+                                std::auto_ptr<e::buffer> msg);
+        send_status send(const virtual_server_id& from,
                          const server_id& to,
                          network_msgtype msg_type,
                          std::auto_ptr<e::buffer> msg);
-        bool send(const virtual_server_id& from,
-                  const server_id& to,
-                  network_msgtype msg_type,
-                  std::auto_ptr<e::buffer> msg);
-        bool send(const virtual_server_id& from,
-                  const virtual_server_id& to,
-                  network_msgtype msg_type,
-                  std::auto_ptr<e::buffer> msg);
-        bool send(const virtual_server_id& to,
-                  network_msgtype msg_type,
-                  std::auto_ptr<e::buffer> msg);
-        bool send_exact(const virtual_server_id& from,
-                        const virtual_server_id& to,
-                        network_msgtype msg_type,
-                        std::auto_ptr<e::buffer> msg);
+        send_status send(const virtual_server_id& from,
+                         const virtual_server_id& to,
+                         network_msgtype msg_type,
+                         std::auto_ptr<e::buffer> msg);
+        send_status send(const virtual_server_id& to,
+                         network_msgtype msg_type,
+                         std::auto_ptr<e::buffer> msg);
+        send_status send_exact(const virtual_server_id& from,
+                               const virtual_server_id& to,
+                               network_msgtype msg_type,
+                               std::auto_ptr<e::buffer> msg);
         bool recv(e::garbage_collector::thread_state* ts,
                   server_id* from,
                   virtual_server_id* vfrom,
@@ -118,6 +153,16 @@ class communication
         class early_message;
 
     private:
+        outbox* this_outbox();
+        // hand msg to busybee, or to this thread's outbox
+        send_status transmit(const server_id& to, std::auto_ptr<e::buffer> msg);
+        send_status transmit_now(const server_id& to, std::auto_ptr<e::buffer> msg);
+        // send the messages coalesced for one destination
+        send_status flush(outbox* ob, uint64_t to);
+        void debatch(uint64_t id, e::unpacker up);
+        // hand back to busybee the early messages for configurations up to
+        // and including version
+        void deliver_early_messages(uint64_t version);
         void handle_disruption(uint64_t id);
 
     private:
@@ -126,9 +171,36 @@ class communication
 
     private:
         daemon* m_daemon;
+        buffer_pool m_buffers;
         mapper m_busybee_mapper;
         std::auto_ptr<busybee_mta> m_busybee;
         e::lockfree_fifo<early_message> m_early_messages;
+        bool m_coalesce;
+        performance_counter m_batches;
+        performance_counter m_coalesced;
+};
+
+// Constructing an outbox makes it the calling thread's outbox until it is
+// destroyed, at which point anything left in it is sent.
+class communication::outbox
+{
+    public:
+        outbox(communication* comm);
+        ~outbox() throw ();
+
+    private:
+        friend class communication;
+        typedef std::map<uint64_t, std::vector<e::buffer*> > queue_map_t;
+
+    private:
+        communication* m_comm;
+        outbox* m_prev;
+        queue_map_t m_queues;
+        std::map<uint64_t, size_t> m_bytes;
+
+    private:
+        outbox(const outbox&);
+        outbox& operator = (const outbox&);
 };
 
 END_HYPERDEX_NAMESPACE
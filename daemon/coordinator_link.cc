@@ -40,6 +40,7 @@
 #include <e/serialization.h>
 
 // HyperDex
+#include "common/configuration_delta.h"
 #include "common/coordinator_returncode.h"
 #include "daemon/coordinator_link.h"
 #include "daemon/daemon.h"
@@ -253,7 +254,7 @@ coordinator_link :: maintain()
             if (m_config_id < 0)
             {
                 m_config_status = REPLICANT_SUCCESS;
-                m_config_id = replicant_client_cond_follow(m_repl, "hyperdex", "config",
+                m_config_id = replicant_client_cond_follow(m_repl, "hyperdex", "config_delta",
                                                            &m_config_status, &m_config_state,
                                                            &m_config_data, &m_config_data_sz);
             }
@@ -303,7 +304,7 @@ coordinator_link :: maintain()
 
         if (id == m_config_id && m_config_status == REPLICANT_SUCCESS)
         {
-            if (!process_configuration(m_config_data, m_config_data_sz))
+            if (!process_configuration_delta(m_config_data, m_config_data_sz))
             {
                 increment_sleep(&m_sleep_ms);
                 LOG(ERROR) << "received an invalid configuration from the coordinator";
@@ -444,6 +445,16 @@ coordinator_link :: report_tcp_disconnect(uint64_t config_version, const server_
     make_rpc(r);
 }
 
+void
+coordinator_link :: report_load(const std::vector<region_load>& loads)
+{
+    e::compat::shared_ptr<rpc> r(new rpc());
+    r->func = "report_load";
+    r->flags = 0;
+    e::packer(&r->input) << m_daemon->m_us << loads;
+    make_rpc(r);
+}
+
 void
 coordinator_link :: make_rpc(e::compat::shared_ptr<rpc> r)
 {
@@ -475,6 +486,14 @@ coordinator_link :: synchronous_call(const char* log_action, const char* func,
                                      char** output, size_t* output_sz)
 {
     po6::threads::mutex::hold hold(&m_mtx);
+    return synchronous_call_no_synchro(log_action, func, input, input_sz, output, output_sz);
+}
+
+bool
+coordinator_link :: synchronous_call_no_synchro(const char* log_action, const char* func,
+                                                const char* input, size_t input_sz,
+                                                char** output, size_t* output_sz)
+{
     replicant_returncode status;
     int64_t rid = replicant_client_call(m_repl, "hyperdex", func, input, input_sz,
                                         REPLICANT_CALL_ROBUST, &status, output, output_sz);
@@ -530,11 +549,38 @@ coordinator_link :: process_configuration(const char* str, size_t str_sz)
     return true;
 }
 
+bool
+coordinator_link :: process_configuration_delta(const char* str, size_t str_sz)
+{
+    e::unpacker up(str, str_sz);
+    configuration_delta delta;
+    up = up >> delta;
+
+    if (!up.error() && m_config.apply_delta(delta))
+    {
+        return true;
+    }
+
+    char* output = NULL;
+    size_t output_sz = 0;
+
+    if (!synchronous_call_no_synchro("get current configuration", "config_get",
+                                     NULL, 0, &output, &output_sz))
+    {
+        return false;
+    }
+
+    assert(output);
+    e::guard g_output = e::makeguard(free, output);
+    return process_configuration(output, output_sz);
+}
+
 bool
 coordinator_link :: bring_online()
 {
     std::string enter_input;
-    e::packer(&enter_input) << m_daemon->m_us << m_daemon->m_bind_to;
+    e::packer(&enter_input) << m_daemon->m_us << m_daemon->m_bind_to
+                            << m_daemon->m_capacity_weight;
     std::string exit_input;
     e::packer(&exit_input) << m_daemon->m_us;
     
@@ -30,6 +30,7 @@
 
 // STL
 #include <map>
+#include <vector>
 
 // po6
 #include <po6/threads/mutex.h>
@@ -44,6 +45,7 @@
 #include "namespace.h"
 #include "common/configuration.h"
 #include "common/ids.h"
+#include "common/region_load.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 class daemon;
@@ -75,6 +77,8 @@ class coordinator_link
         void transfer_go_live(const transfer_id& id);
         void transfer_complete(const transfer_id& id);
         void report_tcp_disconnect(uint64_t config_version, const server_id& id);
+        // not retried; the next report supersedes a lost one
+        void report_load(const std::vector<region_load>& loads);
 
     private:
         struct rpc;
@@ -83,7 +87,13 @@ class coordinator_link
         bool synchronous_call(const char* log_action, const char* func,
                               const char* input, size_t input_sz,
                               char** output, size_t* output_sz);
+        bool synchronous_call_no_synchro(const char* log_action, const char* func,
+                                         const char* input, size_t input_sz,
+                                         char** output, size_t* output_sz);
         bool process_configuration(const char* config, size_t config_sz);
+        // apply a "config_delta" broadcast, fetching the whole configuration
+        // if the delta does not follow the one we have; call holding m_mtx
+        bool process_configuration_delta(const char* delta, size_t delta_sz);
         bool bring_online();
 
     private:
@@ -36,6 +36,7 @@
 #include <unistd.h>
 
 // STL
+#include <algorithm>
 #include <sstream>
 
 // Google Log
@@ -47,6 +48,7 @@
 #include <po6/time.h>
 
 // e
+#include <e/atomic.h>
 #include <e/endian.h>
 #include <e/strescape.h>
 
@@ -61,6 +63,9 @@
 #include <mach/mach.h>
 #endif
 
+// how often the heads of regions report their load to the coordinator
+#define LOAD_REPORT_INTERVAL (30ULL * 1000ULL * 1000ULL * 1000ULL)
+
 using po6::threads::make_obj_func;
 using hyperdex::daemon;
 
@@ -96,17 +101,25 @@ handle_debug(int /*signum*/)
 daemon :: daemon()
     : m_us()
     , m_bind_to()
+    , m_capacity_weight(0)
     , m_threads()
+    , m_workers()
     , m_gc()
     , m_gc_ts()
     , m_coord()
     , m_data_dir()
+    , m_io()
     , m_data(this)
     , m_comm(this)
     , m_repl(this)
     , m_stm(this)
     , m_sm(this)
-    , m_config()
+    , m_dispatch(&m_gc)
+    , m_config(new configuration())
+    , m_reported_versions()
+    , m_protect_forwards()
+    , m_next_forward(1)
+    , m_forwards()
     , m_protect_pause()
     , m_can_pause(&m_protect_pause)
     , m_paused(false)
@@ -123,14 +136,24 @@ daemon :: daemon()
     , m_perf_chain_op()
     , m_perf_chain_subspace()
     , m_perf_chain_ack()
+    , m_perf_chain_nack()
+    , m_perf_chain_truncate()
     , m_perf_xfer_handshake_syn()
     , m_perf_xfer_handshake_synack()
     , m_perf_xfer_handshake_ack()
     , m_perf_xfer_handshake_wiped()
     , m_perf_xfer_op()
     , m_perf_xfer_ack()
+    , m_perf_xfer_bulk()
     , m_perf_backup()
     , m_perf_perf_counters()
+    , m_perf_truncate_space()
+    , m_perf_hot_keys()
+    , m_perf_slow_ops()
+    , m_perf_read_forwarded()
+    , m_region_stats()
+    , m_traces()
+    , m_slow_ops()
     , m_block_stat_path()
     , m_stat_collector(make_obj_func(&daemon::collect_stats, this))
     , m_protect_stats()
@@ -143,6 +166,7 @@ daemon :: daemon()
 daemon :: ~daemon() throw ()
 {
     m_gc.deregister_thread(&m_gc_ts);
+    delete m_config;
 }
 
 static bool
@@ -183,7 +207,19 @@ daemon :: run(bool daemonize,
               po6::net::location bind_to,
               bool set_coordinator,
               po6::net::hostname coordinator,
-              unsigned threads)
+              unsigned threads,
+              uint64_t value_log_threshold,
+              bool thread_per_core,
+              unsigned client_share,
+              unsigned replication_share,
+              unsigned background_share,
+              bool delta_replication,
+              bool coalesce_messages,
+              uint64_t background_latency_target,
+              uint64_t background_bandwidth,
+              uint64_t capacity_weight,
+              uint64_t slow_op_threshold,
+              std::string slow_op_log)
 {
     if (!install_signal_handler(SIGHUP, exit_on_signal) ||
         !install_signal_handler(SIGINT, exit_on_signal) ||
@@ -263,8 +299,15 @@ daemon :: run(bool daemonize,
     po6::net::hostname saved_coordinator;
     LOG(INFO) << "initializing local storage";
     m_data_dir = data;
+    m_io.setup(background_latency_target, background_bandwidth);
+
+    if (!m_slow_ops.setup(slow_op_threshold, slow_op_log))
+    {
+        PLOG(ERROR) << "could not open the slow operation log " << slow_op_log;
+        return EXIT_FAILURE;
+    }
 
-    if (!m_data.initialize(data, &saved, &saved_us, &saved_bind_to, &saved_coordinator))
+    if (!m_data.initialize(data, value_log_threshold, &saved, &saved_us, &saved_bind_to, &saved_coordinator))
     {
         return EXIT_FAILURE;
     }
@@ -304,6 +347,7 @@ daemon :: run(bool daemonize,
     }
 
     m_bind_to = bind_to;
+    m_capacity_weight = capacity_weight;
     m_coord.reset(new coordinator_link(this, coordinator.address.c_str(), coordinator.port));
 
     if (!saved)
@@ -337,11 +381,24 @@ daemon :: run(bool daemonize,
     }
 
     determine_block_stat_path(data);
-    m_comm.setup(bind_to, threads);
-    m_repl.setup();
+    m_comm.setup(bind_to, threads, coalesce_messages);
+    m_repl.setup(delta_replication);
     m_stm.setup();
     m_sm.setup();
 
+    if (thread_per_core)
+    {
+        m_dispatch.setup(threads, client_share, replication_share, background_share);
+
+        for (size_t i = 0; i < threads; ++i)
+        {
+            using namespace po6::threads;
+            e::compat::shared_ptr<thread> t(new thread(make_obj_func(&daemon::worker, this, i)));
+            m_workers.push_back(t);
+            t->start();
+        }
+    }
+
     for (size_t i = 0; i < threads; ++i)
     {
         using namespace po6::threads;
@@ -354,6 +411,7 @@ daemon :: run(bool daemonize,
     uint64_t checkpoint = 0;
     uint64_t checkpoint_stable = 0;
     uint64_t checkpoint_gc = 0;
+    uint64_t next_load_report = 0;
 
     while (__sync_fetch_and_add(&s_interrupts, 0) < 2)
     {
@@ -379,30 +437,36 @@ daemon :: run(bool daemonize,
             m_coord->shutdown();
         }
 
-        if (m_config.version() > 0 &&
-            m_config.version() == m_coord->checkpoint_config_version() &&
+        if (m_config->version() > 0 &&
+            m_config->version() == m_coord->checkpoint_config_version() &&
             checkpoint < m_coord->checkpoint())
         {
             checkpoint = m_coord->checkpoint();
             m_repl.begin_checkpoint(checkpoint);
         }
 
-        if (m_config.version() > 0 &&
-            m_config.version() == m_coord->checkpoint_config_version() &&
+        if (m_config->version() > 0 &&
+            m_config->version() == m_coord->checkpoint_config_version() &&
             checkpoint_stable < m_coord->checkpoint_stable())
         {
             checkpoint_stable = m_coord->checkpoint_stable();
             m_repl.end_checkpoint(checkpoint_stable);
         }
 
-        if (m_config.version() > 0 &&
-            m_config.version() == m_coord->checkpoint_config_version() &&
+        if (m_config->version() > 0 &&
+            m_config->version() == m_coord->checkpoint_config_version() &&
             checkpoint_gc < m_coord->checkpoint_gc())
         {
             checkpoint_gc = m_coord->checkpoint_gc();
             m_data.set_checkpoint_gc(checkpoint_gc);
         }
 
+        if (m_config->version() > 0 &&
+            po6::monotonic_time() >= next_load_report)
+        {
+            report_region_load();
+            next_load_report = po6::monotonic_time() + LOAD_REPORT_INTERVAL;
+        }
 
         m_gc.offline(&m_gc_ts);
         bool have_config = m_coord->maintain();
@@ -413,7 +477,7 @@ daemon :: run(bool daemonize,
             continue;
         }
 
-        const configuration& old_config(m_config);
+        const configuration& old_config(*m_config);
         const configuration& new_config(m_coord->config());
 
         if (old_config.cluster() != 0 &&
@@ -461,17 +525,33 @@ daemon :: run(bool daemonize,
             continue;
         }
 
-        LOG(INFO) << "moving to configuration version=" << new_config.version()
-                  << "; pausing all activity while we reconfigure";
-        this->pause();
-        m_comm.reconfigure(old_config, new_config, m_us);
-        m_data.reconfigure(old_config, new_config, m_us);
-        m_repl.reconfigure(old_config, new_config, m_us);
-        m_stm.reconfigure(old_config, new_config, m_us);
-        m_sm.reconfigure(old_config, new_config, m_us);
-        m_config = new_config;
-        this->unpause();
-        LOG(INFO) << "reconfiguration complete; resuming normal operation";
+        if (!reconfiguration_affects_us(old_config, new_config))
+        {
+            // none of our regions changed, so there is nothing to quiesce;
+            // the workers pick up the new configuration with their next
+            // message
+            LOG(INFO) << "moving to configuration version=" << new_config.version()
+                      << "; our regions are unchanged so activity continues";
+            publish_config(new_config);
+            m_comm.reconfigure(old_config, new_config, m_us);
+            m_repl.reconfigure_version();
+        }
+        else
+        {
+            LOG(INFO) << "moving to configuration version=" << new_config.version()
+                      << "; pausing all activity while we reconfigure";
+            this->pause();
+            m_comm.reconfigure(old_config, new_config, m_us);
+            m_data.reconfigure(old_config, new_config, m_us);
+            m_repl.reconfigure(old_config, new_config, m_us);
+            m_stm.reconfigure(old_config, new_config, m_us);
+            m_sm.reconfigure(old_config, new_config, m_us);
+            m_region_stats.reconfigure(new_config, m_us);
+            publish_config(new_config);
+            abort_forwarded_reads();
+            this->unpause();
+            LOG(INFO) << "reconfiguration complete; resuming normal operation";
+        }
 
         // let the coordinator know we've moved to this config
         m_coord->config_ack(new_config.version());
@@ -486,6 +566,13 @@ daemon :: run(bool daemonize,
         m_threads[i]->join();
     }
 
+    m_dispatch.shutdown();
+
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        m_workers[i]->join();
+    }
+
     m_sm.teardown();
     m_stm.teardown();
     m_repl.teardown();
@@ -511,12 +598,14 @@ daemon :: pause()
     m_repl.pause();
     m_data.pause();
     m_comm.pause();
+    m_dispatch.pause();
 }
 
 void
 daemon :: unpause()
 {
     po6::threads::mutex::hold hold(&m_protect_pause);
+    m_dispatch.unpause();
     m_comm.unpause();
     m_data.unpause();
     m_repl.unpause();
@@ -527,12 +616,228 @@ daemon :: unpause()
     m_can_pause.signal();
 }
 
+static bool
+same_regions(const configuration& old_config,
+             const configuration& new_config,
+             const std::vector<region_id>& regions)
+{
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        virtual_server_id o = old_config.head_of_region(regions[i]);
+        virtual_server_id n = new_config.head_of_region(regions[i]);
+
+        while (o != virtual_server_id() && n != virtual_server_id())
+        {
+            if (o != n || old_config.get_server_id(o) != new_config.get_server_id(n))
+            {
+                return false;
+            }
+
+            o = old_config.next_in_region(o);
+            n = new_config.next_in_region(n);
+        }
+
+        if (o != n)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool
+same_transfers(const configuration& old_config,
+               const configuration& new_config,
+               std::vector<transfer> old_xfers,
+               std::vector<transfer> new_xfers)
+{
+    if (old_xfers.size() != new_xfers.size())
+    {
+        return false;
+    }
+
+    std::sort(old_xfers.begin(), old_xfers.end());
+    std::sort(new_xfers.begin(), new_xfers.end());
+
+    for (size_t i = 0; i < old_xfers.size(); ++i)
+    {
+        if (old_xfers[i].id != new_xfers[i].id ||
+            old_config.is_transfer_live(old_xfers[i].id) !=
+            new_config.is_transfer_live(new_xfers[i].id))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+daemon :: reconfiguration_affects_us(const configuration& old_config,
+                                     const configuration& new_config)
+{
+    if (old_config.version() == 0 ||
+        old_config.get_state(m_us) != new_config.get_state(m_us) ||
+        old_config.read_only() != new_config.read_only())
+    {
+        return true;
+    }
+
+    // chains in our spaces, including the neighboring subspaces that our
+    // regions forward to
+    std::vector<region_id> old_regions;
+    std::vector<region_id> new_regions;
+    old_config.space_regions(m_us, &old_regions);
+    new_config.space_regions(m_us, &new_regions);
+
+    if (old_regions != new_regions ||
+        !same_regions(old_config, new_config, new_regions))
+    {
+        return true;
+    }
+
+    old_regions.clear();
+    new_regions.clear();
+    old_config.mapped_regions(m_us, &old_regions);
+    new_config.mapped_regions(m_us, &new_regions);
+
+    if (old_regions != new_regions)
+    {
+        return true;
+    }
+
+    old_regions.clear();
+    new_regions.clear();
+    old_config.key_regions(m_us, &old_regions);
+    new_config.key_regions(m_us, &new_regions);
+
+    if (old_regions != new_regions)
+    {
+        return true;
+    }
+
+    old_regions.clear();
+    new_regions.clear();
+    old_config.transfers_in_regions(m_us, &old_regions);
+    new_config.transfers_in_regions(m_us, &new_regions);
+    std::vector<region_id> old_out;
+    std::vector<region_id> new_out;
+    old_config.transfers_out_regions(m_us, &old_out);
+    new_config.transfers_out_regions(m_us, &new_out);
+    old_regions.insert(old_regions.end(), old_out.begin(), old_out.end());
+    new_regions.insert(new_regions.end(), new_out.begin(), new_out.end());
+
+    if (old_regions != new_regions ||
+        !same_regions(old_config, new_config, new_regions))
+    {
+        return true;
+    }
+
+    std::vector<transfer> old_xfers;
+    std::vector<transfer> new_xfers;
+    old_config.transfers_in(m_us, &old_xfers);
+    new_config.transfers_in(m_us, &new_xfers);
+    old_config.transfers_out(m_us, &old_xfers);
+    new_config.transfers_out(m_us, &new_xfers);
+
+    if (!same_transfers(old_config, new_config, old_xfers, new_xfers))
+    {
+        return true;
+    }
+
+    std::vector<std::pair<region_id, index_id> > old_indices;
+    std::vector<std::pair<region_id, index_id> > new_indices;
+    old_config.all_indices(m_us, &old_indices);
+    new_config.all_indices(m_us, &new_indices);
+    std::sort(old_indices.begin(), old_indices.end());
+    std::sort(new_indices.begin(), new_indices.end());
+    return old_indices != new_indices;
+}
+
 void
-daemon :: loop(size_t thread)
+daemon :: report_region_load()
+{
+    std::vector<region_id> regions;
+    m_config->mapped_regions(m_us, &regions);
+    std::vector<region_load> loads;
+    std::map<region_id, uint64_t> versions;
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        const region_id& ri(regions[i]);
+
+        if (m_config->head_of_region(ri) != m_config->get_virtual(ri, m_us))
+        {
+            continue;
+        }
+
+        // every write to a key region takes the next version, so the
+        // versions since the last report count the writes
+        uint64_t version = m_data.max_version(ri);
+        uint64_t ops = 0;
+        std::map<region_id, uint64_t>::iterator it = m_reported_versions.find(ri);
+
+        if (it != m_reported_versions.end() && it->second <= version)
+        {
+            ops = version - it->second;
+        }
+
+        versions[ri] = version;
+        loads.push_back(region_load(ri, m_data.approximate_size(ri), ops));
+    }
+
+    m_reported_versions.swap(versions);
+
+    if (!loads.empty())
+    {
+        m_coord->report_load(loads);
+    }
+}
+
+void
+daemon :: publish_config(const configuration& config)
+{
+    const configuration* prev = m_config;
+    const configuration* next = new configuration(config);
+    e::atomic::store_ptr_release(&m_config, next);
+    m_gc.collect(const_cast<configuration*>(prev), e::garbage_collector::free_ptr<configuration>);
+}
+
+// In thread-per-core mode the network threads, which only receive and steer
+// messages, share the last quarter of the cores and the workers get the rest,
+// so that no worker shares its core with a network thread.  This only sets
+// affinity; the key and search state tables are still shared by all threads.
+static void
+core_range(bool network, bool per_core, size_t* first, size_t* count)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t cores = online > 0 ? online : 1;
+    size_t network_cores = std::max(cores / 4, size_t(1));
+
+    if (!per_core || cores < 2)
+    {
+        *first = 0;
+        *count = cores;
+    }
+    else if (network)
+    {
+        *first = cores - network_cores;
+        *count = network_cores;
+    }
+    else
+    {
+        *first = 0;
+        *count = cores - network_cores;
+    }
+}
+
+static bool
+setup_thread(const char* what, size_t thread, size_t first_core, size_t cores)
 {
     sigset_t ss;
 
-    size_t core = thread % sysconf(_SC_NPROCESSORS_ONLN);
+    size_t core = first_core + thread % cores;
 #ifdef __LINUX__
     cpu_set_t cpuset;
     CPU_ZERO(&cpuset);
@@ -549,12 +854,12 @@ daemon :: loop(size_t thread)
                       THREAD_AFFINITY_POLICY_COUNT);
 #endif
 
-    LOG(INFO) << "network thread " << thread << " started on core " << core;
+    LOG(INFO) << what << " thread " << thread << " started on core " << core;
 
     if (sigfillset(&ss) < 0)
     {
         PLOG(ERROR) << "sigfillset";
-        return;
+        return false;
     }
 
     sigdelset(&ss, SIGPROF);
@@ -562,11 +867,28 @@ daemon :: loop(size_t thread)
     if (pthread_sigmask(SIG_SETMASK, &ss, NULL) < 0)
     {
         PLOG(ERROR) << "could not block signals";
+        return false;
+    }
+
+    return true;
+}
+
+void
+daemon :: loop(size_t thread)
+{
+    size_t first_core;
+    size_t cores;
+    core_range(true, m_dispatch.workers() > 0, &first_core, &cores);
+
+    if (!setup_thread("network", thread, first_core, cores))
+    {
         return;
     }
 
     e::garbage_collector::thread_state ts;
     m_gc.register_thread(&ts);
+    buffer_pool::thread_cache buffers(m_comm.buffers());
+    communication::outbox outbox(&m_comm);
 
     server_id from;
     virtual_server_id vfrom;
@@ -579,108 +901,20 @@ daemon :: loop(size_t thread)
     {
         assert(from != server_id());
         assert(vto != virtual_server_id());
+        region_id ri;
 
-        switch (type)
+        // in thread-per-core mode, only the region's owner may process it
+        if (m_dispatch.workers() > 0 &&
+            (ri = m_config->get_region_id(vto)) != region_id())
         {
-            case REQ_GET:
-                process_req_get(from, vfrom, vto, msg, up);
-                m_perf_req_get.tap();
-                break;
-            case REQ_GET_PARTIAL:
-                process_req_get_partial(from, vfrom, vto, msg, up);
-                m_perf_req_get_partial.tap();
-                break;
-            case REQ_ATOMIC:
-                process_req_atomic(from, vfrom, vto, msg, up);
-                m_perf_req_atomic.tap();
-                break;
-            case REQ_SEARCH_START:
-                process_req_search_start(from, vfrom, vto, msg, up);
-                m_perf_req_search_start.tap();
-                break;
-            case REQ_SEARCH_NEXT:
-                process_req_search_next(from, vfrom, vto, msg, up);
-                m_perf_req_search_next.tap();
-                break;
-            case REQ_SEARCH_STOP:
-                process_req_search_stop(from, vfrom, vto, msg, up);
-                m_perf_req_search_stop.tap();
-                break;
-            case REQ_SORTED_SEARCH:
-                process_req_sorted_search(from, vfrom, vto, msg, up);
-                m_perf_req_sorted_search.tap();
-                break;
-            case REQ_COUNT:
-                process_req_count(from, vfrom, vto, msg, up);
-                m_perf_req_count.tap();
-                break;
-            case REQ_SEARCH_DESCRIBE:
-                process_req_search_describe(from, vfrom, vto, msg, up);
-                m_perf_req_search_describe.tap();
-                break;
-            case REQ_GROUP_ATOMIC:
-                process_req_group_atomic(from, vfrom, vto, msg, up);
-                m_perf_req_group_atomic.tap();
-                break;
-            case CHAIN_OP:
-                process_chain_op(from, vfrom, vto, msg, up);
-                m_perf_chain_op.tap();
-                break;
-            case CHAIN_SUBSPACE:
-                process_chain_subspace(from, vfrom, vto, msg, up);
-                m_perf_chain_subspace.tap();
-                break;
-            case CHAIN_ACK:
-                process_chain_ack(from, vfrom, vto, msg, up);
-                m_perf_chain_ack.tap();
-                break;
-            case XFER_HS:
-                process_xfer_handshake_syn(from, vfrom, vto, msg, up);
-                m_perf_xfer_handshake_syn.tap();
-                break;
-            case XFER_HSA:
-                process_xfer_handshake_synack(from, vfrom, vto, msg, up);
-                m_perf_xfer_handshake_synack.tap();
-                break;
-            case XFER_HA:
-                process_xfer_handshake_ack(from, vfrom, vto, msg, up);
-                m_perf_xfer_handshake_ack.tap();
-                break;
-            case XFER_HW:
-                process_xfer_handshake_wiped(from, vfrom, vto, msg, up);
-                m_perf_xfer_handshake_wiped.tap();
-                break;
-            case XFER_OP:
-                process_xfer_op(from, vfrom, vto, msg, up);
-                m_perf_xfer_op.tap();
-                break;
-            case XFER_ACK:
-                process_xfer_ack(from, vfrom, vto, msg, up);
-                m_perf_xfer_ack.tap();
-                break;
-            case BACKUP:
-                process_backup(from, vfrom, vto, msg, up);
-                m_perf_backup.tap();
-            case PERF_COUNTERS:
-                process_perf_counters(from, vfrom, vto, msg, up);
-                m_perf_perf_counters.tap();
-                break;
-            case RESP_GET:
-            case RESP_GET_PARTIAL:
-            case RESP_ATOMIC:
-            case RESP_GROUP_ATOMIC:
-            case RESP_SEARCH_ITEM:
-            case RESP_SEARCH_DONE:
-            case RESP_SORTED_SEARCH:
-            case RESP_COUNT:
-            case RESP_SEARCH_DESCRIBE:
-            case CONFIGMISMATCH:
-            case PACKET_NOP:
-            default:
-                LOG(INFO) << "received " << type << " message which servers do not process";
-                break;
+            m_dispatch.enqueue(m_dispatch.owner(ri), from, vfrom, vto, type, msg, up);
+        }
+        else
+        {
+            process_message(from, vfrom, vto, type, msg, up);
         }
 
+        m_comm.flush();
         m_gc.quiescent_state(&ts);
     }
 
@@ -688,13 +922,196 @@ daemon :: loop(size_t thread)
     LOG(INFO) << "network thread shutting down";
 }
 
+void
+daemon :: worker(size_t thread)
+{
+    size_t first_core;
+    size_t cores;
+    core_range(false, true, &first_core, &cores);
+
+    if (!setup_thread("worker", thread, first_core, cores))
+    {
+        return;
+    }
+
+    e::garbage_collector::thread_state ts;
+    m_gc.register_thread(&ts);
+    buffer_pool::thread_cache buffers(m_comm.buffers());
+    communication::outbox outbox(&m_comm);
+
+    server_id from;
+    virtual_server_id vfrom;
+    virtual_server_id vto;
+    network_msgtype type;
+    std::auto_ptr<e::buffer> msg;
+    e::unpacker up;
+
+    while (m_dispatch.dequeue(thread, &ts, &from, &vfrom, &vto, &type, &msg, &up))
+    {
+        process_message(from, vfrom, vto, type, msg, up);
+        m_comm.flush();
+        m_gc.quiescent_state(&ts);
+    }
+
+    m_gc.deregister_thread(&ts);
+    LOG(INFO) << "worker thread shutting down";
+}
+
+void
+daemon :: process_message(server_id from,
+                          virtual_server_id vfrom,
+                          virtual_server_id vto,
+                          network_msgtype type,
+                          std::auto_ptr<e::buffer> msg,
+                          e::unpacker up)
+{
+    // client latency tells the IO scheduler how much background work to allow
+    const bool timed = m_io.enabled() &&
+                       dispatcher::classify(type) == dispatcher::CLIENT;
+    const uint64_t start = timed ? po6::monotonic_time() : 0;
+
+    switch (type)
+    {
+        case REQ_GET:
+            process_req_get(from, vfrom, vto, msg, up);
+            m_perf_req_get.tap();
+            break;
+        case REQ_GET_PARTIAL:
+            process_req_get_partial(from, vfrom, vto, msg, up);
+            m_perf_req_get_partial.tap();
+            break;
+        case REQ_ATOMIC:
+            process_req_atomic(from, vfrom, vto, msg, up);
+            m_perf_req_atomic.tap();
+            break;
+        case REQ_SEARCH_START:
+            process_req_search_start(from, vfrom, vto, msg, up);
+            m_perf_req_search_start.tap();
+            break;
+        case REQ_SEARCH_NEXT:
+            process_req_search_next(from, vfrom, vto, msg, up);
+            m_perf_req_search_next.tap();
+            break;
+        case REQ_SEARCH_STOP:
+            process_req_search_stop(from, vfrom, vto, msg, up);
+            m_perf_req_search_stop.tap();
+            break;
+        case REQ_SORTED_SEARCH:
+            process_req_sorted_search(from, vfrom, vto, msg, up);
+            m_perf_req_sorted_search.tap();
+            break;
+        case REQ_COUNT:
+            process_req_count(from, vfrom, vto, msg, up);
+            m_perf_req_count.tap();
+            break;
+        case REQ_SEARCH_DESCRIBE:
+            process_req_search_describe(from, vfrom, vto, msg, up);
+            m_perf_req_search_describe.tap();
+            break;
+        case REQ_GROUP_ATOMIC:
+            process_req_group_atomic(from, vfrom, vto, msg, up);
+            m_perf_req_group_atomic.tap();
+            break;
+        case CHAIN_OP:
+            process_chain_op(from, vfrom, vto, msg, up);
+            m_perf_chain_op.tap();
+            break;
+        case CHAIN_SUBSPACE:
+            process_chain_subspace(from, vfrom, vto, msg, up);
+            m_perf_chain_subspace.tap();
+            break;
+        case CHAIN_ACK:
+            process_chain_ack(from, vfrom, vto, msg, up);
+            m_perf_chain_ack.tap();
+            break;
+        case CHAIN_NACK:
+            process_chain_nack(from, vfrom, vto, msg, up);
+            m_perf_chain_nack.tap();
+            break;
+        case CHAIN_TRUNCATE:
+            process_chain_truncate(from, vfrom, vto, msg, up);
+            m_perf_chain_truncate.tap();
+            break;
+        case XFER_HS:
+            process_xfer_handshake_syn(from, vfrom, vto, msg, up);
+            m_perf_xfer_handshake_syn.tap();
+            break;
+        case XFER_HSA:
+            process_xfer_handshake_synack(from, vfrom, vto, msg, up);
+            m_perf_xfer_handshake_synack.tap();
+            break;
+        case XFER_HA:
+            process_xfer_handshake_ack(from, vfrom, vto, msg, up);
+            m_perf_xfer_handshake_ack.tap();
+            break;
+        case XFER_HW:
+            process_xfer_handshake_wiped(from, vfrom, vto, msg, up);
+            m_perf_xfer_handshake_wiped.tap();
+            break;
+        case XFER_OP:
+            process_xfer_op(from, vfrom, vto, msg, up);
+            m_perf_xfer_op.tap();
+            break;
+        case XFER_ACK:
+            process_xfer_ack(from, vfrom, vto, msg, up);
+            m_perf_xfer_ack.tap();
+            break;
+        case XFER_BULK:
+            process_xfer_bulk(from, vfrom, vto, msg, up);
+            m_perf_xfer_bulk.tap();
+            break;
+        case BACKUP:
+            process_backup(from, vfrom, vto, msg, up);
+            m_perf_backup.tap();
+            break;
+        case PERF_COUNTERS:
+            process_perf_counters(from, vfrom, vto, msg, up);
+            m_perf_perf_counters.tap();
+            break;
+        case TRUNCATE_SPACE:
+            process_truncate_space(from, vfrom, vto, msg, up);
+            m_perf_truncate_space.tap();
+            break;
+        case HOT_KEYS:
+            process_hot_keys(from, vfrom, vto, msg, up);
+            m_perf_hot_keys.tap();
+            break;
+        case SLOW_OPS:
+            process_slow_ops(from, vfrom, vto, msg, up);
+            m_perf_slow_ops.tap();
+            break;
+        case RESP_GET:
+        case RESP_GET_PARTIAL:
+            process_resp_read(from, vfrom, vto, type, msg, up);
+            break;
+        case RESP_ATOMIC:
+        case RESP_GROUP_ATOMIC:
+        case RESP_SEARCH_ITEM:
+        case RESP_SEARCH_DONE:
+        case RESP_SORTED_SEARCH:
+        case RESP_COUNT:
+        case RESP_SEARCH_DESCRIBE:
+        case CONFIGMISMATCH:
+        case PACKET_NOP:
+        default:
+            LOG(INFO) << "received " << type << " message which servers do not process";
+            break;
+    }
+
+    if (timed)
+    {
+        m_io.observe(po6::monotonic_time() - start);
+    }
+}
+
 void
 daemon :: process_req_get(server_id from,
-                          virtual_server_id,
+                          virtual_server_id vfrom,
                           virtual_server_id vto,
                           std::auto_ptr<e::buffer> msg,
                           e::unpacker up)
 {
+    const uint64_t start = m_slow_ops.enabled() ? po6::monotonic_time() : 0;
     uint64_t nonce;
     e::slice key;
     bool has_auth = false;
@@ -713,16 +1130,34 @@ daemon :: process_req_get(server_id from,
         return;
     }
 
-    region_id ri = m_config.get_region_id(vto);
+    region_id ri = m_config->get_region_id(vto);
+
+    if (forward_read_if_dirty(from, vfrom, vto, ri, key, nonce, REQ_GET, &msg))
+    {
+        return;
+    }
+
+    // forwarded reads are answered to the forwarding server
+    const size_t hdr = vfrom == virtual_server_id()
+                     ? HYPERDEX_HEADER_SIZE_VC
+                     : HYPERDEX_HEADER_SIZE_VV;
     bool has_value = false;
     std::vector<e::slice> value;
     uint64_t version;
     datalayer::reference ref;
     network_returncode result;
 
-    switch (m_data.get(ri, key, &value, &version, &ref))
+    switch (m_data.get_pinned(ri, key, &value, &version, &ref))
     {
         case datalayer::SUCCESS:
+            // truncated, but the wiper has yet to delete it
+            if (version < m_repl.truncated_before(ri))
+            {
+                value.clear();
+                result = NET_NOTFOUND;
+                break;
+            }
+
             has_value = true;
             result = NET_SUCCESS;
             break;
@@ -739,25 +1174,28 @@ daemon :: process_req_get(server_id from,
             break;
     }
 
-    const schema* sc = m_config.get_schema(ri);
+    m_region_stats.count(ri, region_stats::GET, pack_size(value), key);
+    const schema* sc = m_config->get_schema(ri);
 
     if (!auth_verify_read(*sc, has_value, &value, (has_auth ? &aw : NULL)))
     {
-        size_t sz = HYPERDEX_HEADER_SIZE_VC
+        size_t sz = hdr
                   + sizeof(uint64_t)
                   + sizeof(uint16_t);
-        msg.reset(e::buffer::create(sz));
-        msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << static_cast<uint16_t>(NET_UNAUTHORIZED);
+        m_comm.recycle_buffer(msg);
+        msg = m_comm.create_buffer(sz);
+        msg->pack_at(hdr) << nonce << static_cast<uint16_t>(NET_UNAUTHORIZED);
     }
     else
     {
         sanitize_secrets(*sc, &value);
-        size_t sz = HYPERDEX_HEADER_SIZE_VC
+        size_t sz = hdr
                   + sizeof(uint64_t)
                   + sizeof(uint16_t)
                   + pack_size(value);
-        msg.reset(e::buffer::create(sz));
-        e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+        m_comm.recycle_buffer(msg);
+        msg = m_comm.create_buffer(sz);
+        e::packer pa = msg->pack_at(hdr);
         pa = pa << nonce << static_cast<uint16_t>(result);
 
         if (result == NET_SUCCESS)
@@ -766,16 +1204,22 @@ daemon :: process_req_get(server_id from,
         }
     }
 
-    m_comm.send_client(vto, from, RESP_GET, msg);
+    if (m_slow_ops.enabled())
+    {
+        log_slow_get(ri, start, msg->size());
+    }
+
+    respond_to_read(from, vfrom, vto, RESP_GET, msg);
 }
 
 void
 daemon :: process_req_get_partial(server_id from,
-                                  virtual_server_id,
+                                  virtual_server_id vfrom,
                                   virtual_server_id vto,
                                   std::auto_ptr<e::buffer> msg,
                                   e::unpacker up)
 {
+    const uint64_t start = m_slow_ops.enabled() ? po6::monotonic_time() : 0;
     uint64_t nonce;
     e::slice key;
     std::vector<uint16_t> attrs;
@@ -795,7 +1239,17 @@ daemon :: process_req_get_partial(server_id from,
         return;
     }
 
-    region_id ri = m_config.get_region_id(vto);
+    region_id ri = m_config->get_region_id(vto);
+
+    if (forward_read_if_dirty(from, vfrom, vto, ri, key, nonce, REQ_GET_PARTIAL, &msg))
+    {
+        return;
+    }
+
+    // forwarded reads are answered to the forwarding server
+    const size_t hdr = vfrom == virtual_server_id()
+                     ? HYPERDEX_HEADER_SIZE_VC
+                     : HYPERDEX_HEADER_SIZE_VV;
     std::sort(attrs.begin(), attrs.end());
     bool has_value = false;
     std::vector<e::slice> value;
@@ -803,9 +1257,17 @@ daemon :: process_req_get_partial(server_id from,
     datalayer::reference ref;
     network_returncode result;
 
-    switch (m_data.get(ri, key, &value, &version, &ref))
+    switch (m_data.get_pinned(ri, key, &value, &version, &ref))
     {
         case datalayer::SUCCESS:
+            // truncated, but the wiper has yet to delete it
+            if (version < m_repl.truncated_before(ri))
+            {
+                value.clear();
+                result = NET_NOTFOUND;
+                break;
+            }
+
             has_value = true;
             result = NET_SUCCESS;
             break;
@@ -822,26 +1284,29 @@ daemon :: process_req_get_partial(server_id from,
             break;
     }
 
-    const schema* sc = m_config.get_schema(ri);
+    m_region_stats.count(ri, region_stats::GET, pack_size(value), key);
+    const schema* sc = m_config->get_schema(ri);
 
     if (!auth_verify_read(*sc, has_value, &value, (has_auth ? &aw : NULL)))
     {
-        size_t sz = HYPERDEX_HEADER_SIZE_VC
+        size_t sz = hdr
                   + sizeof(uint64_t)
                   + sizeof(uint16_t);
-        msg.reset(e::buffer::create(sz));
-        msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << static_cast<uint16_t>(NET_UNAUTHORIZED);
+        m_comm.recycle_buffer(msg);
+        msg = m_comm.create_buffer(sz);
+        msg->pack_at(hdr) << nonce << static_cast<uint16_t>(NET_UNAUTHORIZED);
     }
     else
     {
         sanitize_secrets(*sc, &value);
-        size_t sz = HYPERDEX_HEADER_SIZE_VC
+        size_t sz = hdr
                   + sizeof(uint64_t)
                   + sizeof(uint16_t)
                   + pack_size(value)
                   + value.size() * sizeof(uint16_t);
-        msg.reset(e::buffer::create(sz));
-        e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+        m_comm.recycle_buffer(msg);
+        msg = m_comm.create_buffer(sz);
+        e::packer pa = msg->pack_at(hdr);
         pa = pa << nonce << static_cast<uint16_t>(result);
 
         if (result == NET_SUCCESS)
@@ -858,15 +1323,194 @@ daemon :: process_req_get_partial(server_id from,
         }
     }
 
-    m_comm.send_client(vto, from, RESP_GET_PARTIAL, msg);
+    if (m_slow_ops.enabled())
+    {
+        log_slow_get(ri, start, msg->size());
+    }
+
+    respond_to_read(from, vfrom, vto, RESP_GET_PARTIAL, msg);
 }
 
-void
-daemon :: process_req_atomic(server_id from,
-                             virtual_server_id,
-                             virtual_server_id vto,
-                             std::auto_ptr<e::buffer> msg,
-                             e::unpacker up)
+static std::auto_ptr<e::buffer>
+config_mismatch(uint64_t nonce)
+{
+    size_t sz = HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
+    return msg;
+}
+
+bool
+daemon :: forward_read_if_dirty(server_id from,
+                                virtual_server_id vfrom,
+                                virtual_server_id vto,
+                                const region_id& ri,
+                                const e::slice& key,
+                                uint64_t nonce,
+                                network_msgtype type,
+                                std::auto_ptr<e::buffer>* msg)
+{
+    // only forward on behalf of clients; the tail answers from its own disk
+    if (vfrom != virtual_server_id() || m_repl.key_is_clean(ri, key))
+    {
+        return false;
+    }
+
+    virtual_server_id tail = m_config->tail_of_region(ri);
+
+    if (tail == vto || tail == virtual_server_id())
+    {
+        return false;
+    }
+
+    forwarded_read fr;
+    fr.client = from;
+    fr.vto = vto;
+    fr.tail = tail;
+    fr.nonce = nonce;
+    uint64_t id;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect_forwards);
+        id = m_next_forward++;
+        m_forwards[id] = fr;
+    }
+
+    // pass the request through untouched, except for the nonce
+    e::slice whole = (*msg)->as_slice();
+    const size_t off = HYPERDEX_HEADER_SIZE_SV + sizeof(uint64_t);
+    assert(whole.size() >= off);
+    size_t sz = HYPERDEX_HEADER_SIZE_VV
+              + sizeof(uint64_t)
+              + whole.size() - off;
+    std::auto_ptr<e::buffer> fwd(m_comm.create_buffer(sz));
+    fwd->pack_at(HYPERDEX_HEADER_SIZE_VV)
+        << id << e::pack_memmove(whole.data() + off, whole.size() - off);
+    m_comm.recycle_buffer(*msg);
+    m_perf_read_forwarded.tap();
+
+    // A forward left in the outbox that later fails disrupts the tail; the
+    // configuration that follows answers every outstanding forward with
+    // CONFIGMISMATCH, so only an immediate failure is handled here.
+    if (m_comm.send(vto, tail, type, fwd) == communication::SEND_FAILED)
+    {
+        po6::threads::mutex::hold hold(&m_protect_forwards);
+        m_forwards.erase(id);
+        m_comm.send_client(vto, from, CONFIGMISMATCH, config_mismatch(nonce));
+    }
+
+    return true;
+}
+
+void
+daemon :: respond_to_read(server_id from,
+                          virtual_server_id vfrom,
+                          virtual_server_id vto,
+                          network_msgtype type,
+                          std::auto_ptr<e::buffer> msg)
+{
+    if (vfrom == virtual_server_id())
+    {
+        m_comm.send_client(vto, from, type, msg);
+    }
+    else
+    {
+        m_comm.send(vto, vfrom, type, msg);
+    }
+}
+
+void
+daemon :: log_slow_get(const region_id& ri, uint64_t start, uint64_t bytes)
+{
+    uint64_t latency = po6::monotonic_time() - start;
+
+    if (!m_slow_ops.slow(latency))
+    {
+        return;
+    }
+
+    const space* sp = m_config->get_space(ri);
+    slow_log::record r;
+    r.when = po6::wallclock_time();
+    r.latency = latency;
+    r.rows = 1;
+    r.bytes = bytes;
+    r.op = slow_log::GET;
+    r.space = sp ? sp->name : "";
+    r.plan = "get";
+    m_slow_ops.add(r);
+}
+
+void
+daemon :: process_resp_read(server_id,
+                            virtual_server_id vfrom,
+                            virtual_server_id,
+                            network_msgtype type,
+                            std::auto_ptr<e::buffer> msg,
+                            e::unpacker up)
+{
+    uint64_t id;
+
+    if ((up >> id).error())
+    {
+        LOG(WARNING) << "unpack of " << type << " failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    forwarded_read fr;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect_forwards);
+        std::map<uint64_t, forwarded_read>::iterator it = m_forwards.find(id);
+
+        // already failed back to the client by a reconfiguration
+        if (it == m_forwards.end() || it->second.tail != vfrom)
+        {
+            return;
+        }
+
+        fr = it->second;
+        m_forwards.erase(it);
+    }
+
+    e::slice whole = msg->as_slice();
+    const size_t off = HYPERDEX_HEADER_SIZE_VV + sizeof(uint64_t);
+    assert(whole.size() >= off);
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + whole.size() - off;
+    std::auto_ptr<e::buffer> resp(m_comm.create_buffer(sz));
+    resp->pack_at(HYPERDEX_HEADER_SIZE_VC)
+        << fr.nonce << e::pack_memmove(whole.data() + off, whole.size() - off);
+    m_comm.recycle_buffer(msg);
+    m_comm.send_client(fr.vto, fr.client, type, resp);
+}
+
+void
+daemon :: abort_forwarded_reads()
+{
+    std::map<uint64_t, forwarded_read> forwards;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect_forwards);
+        forwards.swap(m_forwards);
+    }
+
+    // the tail may have moved; let the clients retry
+    for (std::map<uint64_t, forwarded_read>::iterator it = forwards.begin();
+            it != forwards.end(); ++it)
+    {
+        m_comm.send_client(it->second.vto, it->second.client, CONFIGMISMATCH,
+                           config_mismatch(it->second.nonce));
+    }
+}
+
+void
+daemon :: process_req_atomic(server_id from,
+                             virtual_server_id,
+                             virtual_server_id vto,
+                             std::auto_ptr<e::buffer> msg,
+                             e::unpacker up)
 {
     // initialize nonce from pseudo-random memory
     uint64_t nonce;
@@ -880,6 +1524,9 @@ daemon :: process_req_atomic(server_id from,
         return;
     }
 
+    const region_id ri(m_config->get_region_id(vto));
+    m_region_stats.count(ri, region_stats::ATOMIC, msg->size(), kc->key);
+    m_traces.record(kc->trace_id, trace_ring::CLIENT_ATOMIC, ri.get(), 0);
     m_repl.client_atomic(from, vto, nonce, kc, msg);
 }
 
@@ -900,6 +1547,7 @@ daemon :: process_req_search_start(server_id from,
         return;
     }
 
+    m_region_stats.count(m_config->get_region_id(vto), region_stats::SEARCH, 0);
     m_sm.start(from, vto, msg, nonce, search_id, &checks);
 }
 
@@ -919,6 +1567,8 @@ daemon :: process_req_search_next(server_id from,
         return;
     }
 
+    // the item we send back can reuse the request's buffer
+    m_comm.recycle_buffer(msg);
     m_sm.next(from, vto, nonce, search_id);
 }
 
@@ -960,6 +1610,7 @@ daemon :: process_req_sorted_search(server_id from,
         return;
     }
 
+    m_region_stats.count(m_config->get_region_id(vto), region_stats::SEARCH, 0);
     m_sm.sorted_search(from, vto, nonce, &checks, limit, sort_by, flags & 0x1);
 }
 
@@ -979,6 +1630,7 @@ daemon :: process_req_count(server_id from,
         return;
     }
 
+    m_region_stats.count(m_config->get_region_id(vto), region_stats::SEARCH, 0);
     m_sm.count(from, vto, nonce, &checks);
 }
 
@@ -998,6 +1650,7 @@ daemon :: process_req_search_describe(server_id from,
         return;
     }
 
+    m_region_stats.count(m_config->get_region_id(vto), region_stats::SEARCH, 0);
     m_sm.search_describe(from, vto, nonce, &checks);
 }
 
@@ -1030,13 +1683,31 @@ daemon :: process_chain_op(server_id,
                            std::auto_ptr<e::buffer> msg,
                            e::unpacker up)
 {
-    uint8_t flags;
+    uint8_t flags = 0;
     uint64_t old_version;
     uint64_t new_version;
     e::slice key;
     std::vector<e::slice> value;
+    key_operation::delta_t delta;
+    up = up >> flags >> old_version >> new_version >> key;
 
-    if ((up >> flags >> old_version >> new_version >> key >> value).error())
+    if (flags & 4)
+    {
+        up = up >> delta;
+    }
+    else
+    {
+        up = up >> value;
+    }
+
+    uint64_t trace_id = 0;
+
+    if (!up.error() && up.remain() >= sizeof(uint64_t))
+    {
+        up = up >> trace_id;
+    }
+
+    if (up.error())
     {
         LOG(WARNING) << "unpack of CHAIN_OP failed; here's some hex:  " << msg->hex();
         return;
@@ -1044,7 +1715,10 @@ daemon :: process_chain_op(server_id,
 
     bool fresh = flags & 1;
     bool has_value = flags & 2;
-    m_repl.chain_op(vfrom, vto, old_version, new_version, fresh, has_value, key, value, msg);
+    const region_id ri(m_config->get_region_id(vto));
+    m_region_stats.count(ri, region_stats::CHAIN, msg->size(), key);
+    m_traces.record(trace_id, trace_ring::CHAIN_OP_RECV, ri.get(), new_version);
+    m_repl.chain_op(vfrom, vto, old_version, new_version, fresh, has_value, key, value, delta, msg, trace_id);
 }
 
 void
@@ -1063,15 +1737,27 @@ daemon :: process_chain_subspace(server_id,
     region_id this_new_region;
     region_id next_region;
 
-    if ((up >> old_version >> new_version >> key >> value >>
-               prev_region >> this_old_region >> this_new_region >> next_region).error())
+    uint64_t trace_id = 0;
+    up = up >> old_version >> new_version >> key >> value
+            >> prev_region >> this_old_region >> this_new_region >> next_region;
+
+    if (!up.error() && up.remain() >= sizeof(uint64_t))
+    {
+        up = up >> trace_id;
+    }
+
+    if (up.error())
     {
         LOG(WARNING) << "unpack of CHAIN_SUBSPACE failed; here's some hex:  " << msg->hex();
         return;
     }
 
+    const region_id ri(m_config->get_region_id(vto));
+    m_region_stats.count(ri, region_stats::CHAIN, msg->size(), key);
+    m_traces.record(trace_id, trace_ring::CHAIN_SUBSPACE_RECV, ri.get(), new_version);
     m_repl.chain_subspace(vfrom, vto, old_version, new_version, key, value, msg,
-                          prev_region, this_old_region, this_new_region, next_region);
+                          prev_region, this_old_region, this_new_region, next_region,
+                          trace_id);
 }
 
 void
@@ -1083,16 +1769,62 @@ daemon :: process_chain_ack(server_id,
 {
     uint64_t version;
     e::slice key;
+    uint64_t trace_id = 0;
+    up = up >> version >> key;
 
-    if ((up >> version >> key).error())
+    if (!up.error() && up.remain() >= sizeof(uint64_t))
+    {
+        up = up >> trace_id;
+    }
+
+    if (up.error())
     {
         LOG(WARNING) << "unpack of CHAIN_ACK failed; here's some hex:  " << msg->hex();
         return;
     }
 
+    m_traces.record(trace_id, trace_ring::CHAIN_ACK_RECV, m_config->get_region_id(vto).get(), version);
     m_repl.chain_ack(vfrom, vto, version, key);
 }
 
+void
+daemon :: process_chain_nack(server_id,
+                             virtual_server_id vfrom,
+                             virtual_server_id vto,
+                             std::auto_ptr<e::buffer> msg,
+                             e::unpacker up)
+{
+    uint64_t version;
+    e::slice key;
+
+    if ((up >> version >> key).error())
+    {
+        LOG(WARNING) << "unpack of CHAIN_NACK failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_repl.chain_nack(vfrom, vto, version, key);
+}
+
+void
+daemon :: process_chain_truncate(server_id,
+                                 virtual_server_id vfrom,
+                                 virtual_server_id vto,
+                                 std::auto_ptr<e::buffer> msg,
+                                 e::unpacker up)
+{
+    region_id key_region;
+    uint64_t version;
+
+    if ((up >> key_region >> version).error())
+    {
+        LOG(WARNING) << "unpack of CHAIN_TRUNCATE failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_repl.chain_truncate(vfrom, vto, key_region, version);
+}
+
 void
 daemon :: process_xfer_handshake_syn(server_id,
                                      virtual_server_id vfrom,
@@ -1120,14 +1852,22 @@ daemon :: process_xfer_handshake_synack(server_id from,
 {
     transfer_id xid;
     uint64_t timestamp;
+    uint8_t flags = 0;
+    up = up >> xid >> timestamp;
 
-    if ((up >> xid >> timestamp).error())
+    // older servers send no flags
+    if (up.remain())
+    {
+        up = up >> flags;
+    }
+
+    if (up.error())
     {
         LOG(WARNING) << "unpack of XFER_HSA failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    m_stm.handshake_synack(from, to, xid, timestamp);
+    m_stm.handshake_synack(from, to, xid, timestamp, flags & 0x1);
 }
 
 void
@@ -1212,6 +1952,45 @@ daemon :: process_xfer_ack(server_id from,
     m_stm.xfer_ack(from, vto, transfer_id(xid), seq_no);
 }
 
+void
+daemon :: process_xfer_bulk(server_id,
+                            virtual_server_id vfrom,
+                            virtual_server_id,
+                            std::auto_ptr<e::buffer> msg,
+                            e::unpacker up)
+{
+    uint8_t flags;
+    uint64_t xid;
+    uint64_t seq_no;
+    uint32_t count;
+    up = up >> flags >> xid >> seq_no >> count;
+    std::vector<bool> has_value;
+    std::vector<uint64_t> version;
+    std::vector<e::slice> key;
+    std::vector<std::vector<e::slice> > value;
+
+    for (uint32_t i = 0; !up.error() && i < count; ++i)
+    {
+        uint8_t obj_flags;
+        uint64_t obj_version;
+        e::slice obj_key;
+        std::vector<e::slice> obj_value;
+        up = up >> obj_flags >> obj_version >> obj_key >> obj_value;
+        has_value.push_back(obj_flags & 1);
+        version.push_back(obj_version);
+        key.push_back(obj_key);
+        value.push_back(obj_value);
+    }
+
+    if (up.error())
+    {
+        LOG(WARNING) << "unpack of XFER_BULK failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_stm.xfer_bulk(vfrom, transfer_id(xid), seq_no, msg, has_value, version, key, value);
+}
+
 void
 daemon :: process_backup(server_id from,
                          virtual_server_id,
@@ -1257,12 +2036,209 @@ daemon :: process_backup(server_id from,
               + sizeof(uint64_t)
               + sizeof(uint16_t)
               + pack_size(path);
-    msg.reset(e::buffer::create(sz));
+    m_comm.recycle_buffer(msg);
+    msg = m_comm.create_buffer(sz);
     e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
     pa = pa << nonce << static_cast<uint16_t>(result) << path;
     m_comm.send_client(vto, from, BACKUP, msg);
 }
 
+void
+daemon :: process_truncate_space(server_id from,
+                                 virtual_server_id,
+                                 virtual_server_id vto,
+                                 std::auto_ptr<e::buffer> msg,
+                                 e::unpacker up)
+{
+    uint64_t nonce;
+    e::slice _space;
+
+    if ((up >> nonce >> _space).error() ||
+        strnlen(reinterpret_cast<const char*>(_space.data()), _space.size()) == _space.size())
+    {
+        LOG(WARNING) << "unpack of TRUNCATE_SPACE failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    // Every server gets the request and truncates the key regions it leads.
+    // Each truncation is ordered with the region's writes; the replication
+    // layer answers once it is, and removes the objects in the background.
+    std::string space(reinterpret_cast<const char*>(_space.data()));
+    const schema* sc = m_config->get_schema(space.c_str());
+    network_returncode result = NET_SUCCESS;
+
+    if (!sc)
+    {
+        result = NET_NOTFOUND;
+    }
+    else
+    {
+        std::vector<region_id> point_leaders;
+        m_config->point_leaders(m_us, &point_leaders);
+        std::vector<region_id> regions;
+
+        for (size_t i = 0; i < point_leaders.size(); ++i)
+        {
+            if (m_config->get_schema(point_leaders[i]) == sc)
+            {
+                regions.push_back(point_leaders[i]);
+            }
+        }
+
+        if (!regions.empty())
+        {
+            LOG(INFO) << "truncating space \"" << e::strescape(space) << "\"";
+            m_repl.client_truncate(from, vto, nonce, regions);
+            return;
+        }
+    }
+
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint16_t);
+    m_comm.recycle_buffer(msg);
+    msg = m_comm.create_buffer(sz);
+    e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << static_cast<uint16_t>(result);
+    m_comm.send_client(vto, from, TRUNCATE_SPACE, msg);
+}
+
+void
+daemon :: process_hot_keys(server_id from,
+                           virtual_server_id,
+                           virtual_server_id vto,
+                           std::auto_ptr<e::buffer> msg,
+                           e::unpacker up)
+{
+    uint64_t nonce;
+    e::slice _space;
+    uint64_t n;
+
+    if ((up >> nonce >> _space >> n).error() ||
+        strnlen(reinterpret_cast<const char*>(_space.data()), _space.size()) == _space.size())
+    {
+        LOG(WARNING) << "unpack of HOT_KEYS failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    std::string space(reinterpret_cast<const char*>(_space.data()));
+    const schema* sc = m_config->get_schema(space.c_str());
+    network_returncode result = NET_SUCCESS;
+    // region, 0 for reads or 1 for writes, and the key's entry
+    std::vector<std::pair<std::pair<region_id, uint8_t>, hot_keys::entry> > hot;
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint16_t)
+              + sizeof(uint64_t);
+
+    if (!sc)
+    {
+        result = NET_NOTFOUND;
+    }
+    else
+    {
+        std::vector<region_id> regions;
+        m_config->mapped_regions(m_us, &regions);
+        n = std::min(n, static_cast<uint64_t>(hot_keys::CAPACITY));
+
+        for (size_t i = 0; i < regions.size(); ++i)
+        {
+            if (m_config->get_schema(regions[i]) != sc)
+            {
+                continue;
+            }
+
+            std::vector<hot_keys::entry> reads;
+            std::vector<hot_keys::entry> writes;
+            m_region_stats.top_keys(regions[i], n, &reads, &writes);
+
+            for (size_t j = 0; j < reads.size(); ++j)
+            {
+                hot.push_back(std::make_pair(std::make_pair(regions[i], 0), reads[j]));
+            }
+
+            for (size_t j = 0; j < writes.size(); ++j)
+            {
+                hot.push_back(std::make_pair(std::make_pair(regions[i], 1), writes[j]));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < hot.size(); ++i)
+    {
+        sz += sizeof(uint64_t) + sizeof(uint8_t)
+            + 2 * sizeof(uint64_t)
+            + pack_size(e::slice(hot[i].second.key));
+    }
+
+    m_comm.recycle_buffer(msg);
+    msg = m_comm.create_buffer(sz);
+    e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << static_cast<uint16_t>(result)
+            << static_cast<uint64_t>(hot.size());
+
+    for (size_t i = 0; i < hot.size(); ++i)
+    {
+        pa = pa << hot[i].first.first << hot[i].first.second
+                << hot[i].second.count << hot[i].second.error
+                << e::slice(hot[i].second.key);
+    }
+
+    m_comm.send_client(vto, from, HOT_KEYS, msg);
+}
+
+void
+daemon :: process_slow_ops(server_id from,
+                           virtual_server_id,
+                           virtual_server_id vto,
+                           std::auto_ptr<e::buffer> msg,
+                           e::unpacker up)
+{
+    uint64_t nonce;
+    uint64_t n;
+
+    if ((up >> nonce >> n).error())
+    {
+        LOG(WARNING) << "unpack of SLOW_OPS failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    std::vector<slow_log::record> records;
+    m_slow_ops.recent(std::min(n, static_cast<uint64_t>(slow_log::CAPACITY)), &records);
+    uint64_t suppressed = m_slow_ops.suppressed();
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint16_t)
+              + 2 * sizeof(uint64_t);
+
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        sz += 4 * sizeof(uint64_t)
+            + pack_size(e::slice(slow_log::name(records[i].op)))
+            + pack_size(e::slice(records[i].space))
+            + pack_size(e::slice(records[i].checks))
+            + pack_size(e::slice(records[i].plan));
+    }
+
+    m_comm.recycle_buffer(msg);
+    msg = m_comm.create_buffer(sz);
+    e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << static_cast<uint16_t>(NET_SUCCESS)
+            << suppressed << static_cast<uint64_t>(records.size());
+
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        pa = pa << records[i].when << records[i].latency
+                << records[i].rows << records[i].bytes
+                << e::slice(slow_log::name(records[i].op))
+                << e::slice(records[i].space)
+                << e::slice(records[i].checks)
+                << e::slice(records[i].plan);
+    }
+
+    m_comm.send_client(vto, from, SLOW_OPS, msg);
+}
+
 void
 daemon :: process_perf_counters(server_id from,
                                 virtual_server_id,
@@ -1309,7 +2285,8 @@ daemon :: process_perf_counters(server_id from,
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + out.size() + 1;
-    msg.reset(e::buffer::create(sz));
+    m_comm.recycle_buffer(msg);
+    msg = m_comm.create_buffer(sz);
     msg->pack_at(HYPERDEX_HEADER_SIZE_VC)
         << nonce << e::pack_memmove(out.c_str(), out.size() + 1);
     m_comm.send_client(vto, from, PERF_COUNTERS, msg);
@@ -1346,8 +2323,14 @@ daemon :: collect_stats()
         std::ostringstream ret;
         ret << target;
         collect_stats_msgs(&ret);
+        collect_stats_alloc(&ret);
+        collect_stats_queues(&ret);
+        collect_stats_budget(&ret);
+        collect_stats_indexing(&ret);
         collect_stats_leveldb(&ret);
         collect_stats_io(&ret);
+        collect_stats_regions(&ret);
+        collect_stats_traces(&ret);
         ret << "\n";
         std::string out = ret.str();
 
@@ -1380,9 +2363,62 @@ daemon :: collect_stats_msgs(std::ostringstream* ret)
     *ret << " msgs.chain_op=" << m_perf_chain_op.read();
     *ret << " msgs.chain_subspace=" << m_perf_chain_subspace.read();
     *ret << " msgs.chain_ack=" << m_perf_chain_ack.read();
+    *ret << " msgs.chain_nack=" << m_perf_chain_nack.read();
+    *ret << " msgs.chain_truncate=" << m_perf_chain_truncate.read();
     *ret << " msgs.xfer_op=" << m_perf_xfer_op.read();
     *ret << " msgs.xfer_ack=" << m_perf_xfer_ack.read();
+    *ret << " msgs.xfer_bulk=" << m_perf_xfer_bulk.read();
     *ret << " msgs.perf_counters=" << m_perf_perf_counters.read();
+    *ret << " msgs.read_forwarded=" << m_perf_read_forwarded.read();
+    *ret << " msgs.batches_sent=" << m_comm.batches_sent();
+    *ret << " msgs.coalesced=" << m_comm.messages_coalesced();
+}
+
+void
+daemon :: collect_stats_alloc(std::ostringstream* ret)
+{
+    buffer_pool* bp = m_comm.buffers();
+    *ret << " alloc.buffers_created=" << bp->created();
+    *ret << " alloc.buffers_reused=" << bp->reused();
+    *ret << " alloc.buffers_recycled=" << bp->recycled();
+    *ret << " alloc.buffers_discarded=" << bp->discarded();
+}
+
+void
+daemon :: collect_stats_queues(std::ostringstream* ret)
+{
+    *ret << " queue.client=" << m_dispatch.queued(dispatcher::CLIENT);
+    *ret << " queue.replication=" << m_dispatch.queued(dispatcher::REPLICATION);
+    *ret << " queue.background=" << m_dispatch.queued(dispatcher::BACKGROUND);
+    *ret << " queue.client_total=" << m_dispatch.enqueued(dispatcher::CLIENT);
+    *ret << " queue.replication_total=" << m_dispatch.enqueued(dispatcher::REPLICATION);
+    *ret << " queue.background_total=" << m_dispatch.enqueued(dispatcher::BACKGROUND);
+}
+
+void
+daemon :: collect_stats_budget(std::ostringstream* ret)
+{
+    *ret << " budget.disk_read=" << m_io.budget(io_scheduler::DISK_READ);
+    *ret << " budget.disk_write=" << m_io.budget(io_scheduler::DISK_WRITE);
+    *ret << " budget.network=" << m_io.budget(io_scheduler::NETWORK);
+    *ret << " budget.disk_read_bytes=" << m_io.consumed(io_scheduler::DISK_READ);
+    *ret << " budget.disk_write_bytes=" << m_io.consumed(io_scheduler::DISK_WRITE);
+    *ret << " budget.network_bytes=" << m_io.consumed(io_scheduler::NETWORK);
+    *ret << " budget.throttled=" << m_io.throttled();
+    *ret << " budget.client_p99_us=" << m_io.client_p99();
+}
+
+void
+daemon :: collect_stats_indexing(std::ostringstream* ret)
+{
+    uint64_t done = 0;
+    uint64_t total = 0;
+    uint64_t eta_s = 0;
+    bool building = m_data.index_build_progress(&done, &total, &eta_s);
+    *ret << " index.building=" << (building ? 1 : 0);
+    *ret << " index.build_bytes_done=" << done;
+    *ret << " index.build_bytes_total=" << total;
+    *ret << " index.build_eta_s=" << eta_s;
 }
 
 namespace
@@ -1404,6 +2440,8 @@ void
 daemon :: collect_stats_leveldb(std::ostringstream* ret)
 {
     *ret << " leveldb.size=" << m_data.approximate_size();
+    *ret << " vlog.segments=" << m_data.value_log_segments();
+    *ret << " vlog.bytes=" << m_data.value_log_bytes();
     std::string tmp;
 
     if (m_data.get_property(e::slice("leveldb.stats"), &tmp))
@@ -1477,6 +2515,30 @@ read_sys_block_star(std::vector<std::string>* blocks)
 
 } // namespace
 
+void
+daemon :: collect_stats_regions(std::ostringstream* ret)
+{
+    m_region_stats.collect(&m_data, ret);
+}
+
+void
+daemon :: collect_stats_traces(std::ostringstream* ret)
+{
+    std::vector<trace_ring::entry> entries;
+    m_traces.drain(&entries);
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const trace_ring::entry& e(entries[i]);
+        *ret << " trace." << e.trace_id
+             << "." << trace_ring::name(e.event)
+             << "." << e.region
+             << "=" << e.when;
+    }
+
+    *ret << " tracing.lost=" << m_traces.lost();
+}
+
 void
 daemon :: determine_block_stat_path(const std::string& data)
 {
@@ -28,6 +28,9 @@
 #ifndef hyperdex_daemon_daemon_h_
 #define hyperdex_daemon_daemon_h_
 
+// STL
+#include <map>
+
 // po6
 #include <po6/net/hostname.h>
 #include <po6/net/ipaddr.h>
@@ -44,13 +47,19 @@
 // HyperDex
 #include "namespace.h"
 #include "common/ids.h"
+#include "common/region_load.h"
 #include "daemon/communication.h"
 #include "daemon/coordinator_link.h"
 #include "daemon/datalayer.h"
+#include "daemon/dispatcher.h"
+#include "daemon/io_scheduler.h"
 #include "daemon/performance_counter.h"
+#include "daemon/region_stats.h"
 #include "daemon/replication_manager.h"
 #include "daemon/search_manager.h"
+#include "daemon/slow_log.h"
 #include "daemon/state_transfer_manager.h"
+#include "daemon/trace_ring.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 
@@ -70,7 +79,19 @@ class daemon
                 po6::net::location bind_to,
                 bool set_coordinator,
                 po6::net::hostname coordinator,
-                unsigned threads);
+                unsigned threads,
+                uint64_t value_log_threshold,
+                bool thread_per_core,
+                unsigned client_share,
+                unsigned replication_share,
+                unsigned background_share,
+                bool delta_replication,
+                bool coalesce_messages,
+                uint64_t background_latency_target,
+                uint64_t background_bandwidth,
+                uint64_t capacity_weight,
+                uint64_t slow_op_threshold,
+                std::string slow_op_log);
 
     private:
         // Pause and unpause all activity, e.g. for reconfiguration or
@@ -78,8 +99,22 @@ class daemon
         // thread must remain offline for entire time between pause/unpause.
         void pause();
         void unpause();
+        // true if moving from old_config to new_config changes anything about
+        // the regions this server serves: their chains, indices, and the
+        // transfers in and out of them
+        bool reconfiguration_affects_us(const configuration& old_config,
+                                        const configuration& new_config);
+        // install a copy of config as the current configuration; the old one
+        // stays valid until every thread passes through a quiescent state
+        void publish_config(const configuration& config);
+        // tell the coordinator the size and write rate of the regions we
+        // are the head of
+        void report_region_load();
         // process messages from the network threads
         void loop(size_t thread);
+        // process messages steered to this worker in thread-per-core mode
+        void worker(size_t thread);
+        void process_message(server_id from, virtual_server_id vfrom, virtual_server_id vto, network_msgtype type, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_req_get(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_req_get_partial(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_req_atomic(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
@@ -93,21 +128,41 @@ class daemon
         void process_chain_op(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_chain_subspace(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_chain_ack(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_chain_nack(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_chain_truncate(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_handshake_syn(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_handshake_synack(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_handshake_ack(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_handshake_wiped(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        // reads may be served by any replica in the key's region; a replica
+        // with writes in flight for the key asks the region's tail instead
+        bool forward_read_if_dirty(server_id from, virtual_server_id vfrom, virtual_server_id vto, const region_id& ri, const e::slice& key, uint64_t nonce, network_msgtype type, std::auto_ptr<e::buffer>* msg);
+        void respond_to_read(server_id from, virtual_server_id vfrom, virtual_server_id vto, network_msgtype type, std::auto_ptr<e::buffer> msg);
+        // log a GET that began at start if it was slow
+        void log_slow_get(const region_id& ri, uint64_t start, uint64_t bytes);
+        void process_resp_read(server_id from, virtual_server_id vfrom, virtual_server_id vto, network_msgtype type, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void abort_forwarded_reads();
         void process_xfer_op(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_ack(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_xfer_bulk(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_backup(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_perf_counters(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_truncate_space(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_hot_keys(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_slow_ops(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
 
     private:
         void collect_stats();
         void collect_stats_msgs(std::ostringstream* ret);
+        void collect_stats_alloc(std::ostringstream* ret);
+        void collect_stats_queues(std::ostringstream* ret);
+        void collect_stats_budget(std::ostringstream* ret);
+        void collect_stats_indexing(std::ostringstream* ret);
         void collect_stats_leveldb(std::ostringstream* ret);
         void determine_block_stat_path(const std::string& data);
         void collect_stats_io(std::ostringstream* ret);
+        void collect_stats_regions(std::ostringstream* ret);
+        void collect_stats_traces(std::ostringstream* ret);
 
     private:
         friend class background_thread;
@@ -122,17 +177,40 @@ class daemon
     private:
         server_id m_us;
         po6::net::location m_bind_to;
+        // sent to the coordinator when we come online; 0 keeps what it has
+        uint64_t m_capacity_weight;
         std::vector<e::compat::shared_ptr<po6::threads::thread> > m_threads;
+        std::vector<e::compat::shared_ptr<po6::threads::thread> > m_workers;
         e::garbage_collector m_gc;
         e::garbage_collector::thread_state m_gc_ts;
         std::auto_ptr<coordinator_link> m_coord;
         std::string m_data_dir;
+        // paces background work; outlives the layers whose threads use it
+        io_scheduler m_io;
         datalayer m_data;
         communication m_comm;
         replication_manager m_repl;
         state_transfer_manager m_stm;
         search_manager m_sm;
-        configuration m_config;
+        dispatcher m_dispatch;
+        // the current configuration; readers may use it until their next
+        // quiescent state, and a new configuration is published by swapping
+        // the pointer and collecting the old one through m_gc
+        const configuration* m_config;
+        // the region versions at our last load report; main thread only
+        std::map<region_id, uint64_t> m_reported_versions;
+        // reads forwarded to the tail, by the id we sent with them
+        struct forwarded_read
+        {
+            forwarded_read() : client(), vto(), tail(), nonce() {}
+            server_id client;
+            virtual_server_id vto;
+            virtual_server_id tail;
+            uint64_t nonce;
+        };
+        po6::threads::mutex m_protect_forwards;
+        uint64_t m_next_forward;
+        std::map<uint64_t, forwarded_read> m_forwards;
         // pause management
         po6::threads::mutex m_protect_pause;
         po6::threads::cond m_can_pause;
@@ -151,14 +229,27 @@ class daemon
         performance_counter m_perf_chain_op;
         performance_counter m_perf_chain_subspace;
         performance_counter m_perf_chain_ack;
+        performance_counter m_perf_chain_nack;
+        performance_counter m_perf_chain_truncate;
         performance_counter m_perf_xfer_handshake_syn;
         performance_counter m_perf_xfer_handshake_synack;
         performance_counter m_perf_xfer_handshake_ack;
         performance_counter m_perf_xfer_handshake_wiped;
         performance_counter m_perf_xfer_op;
         performance_counter m_perf_xfer_ack;
+        performance_counter m_perf_xfer_bulk;
         performance_counter m_perf_backup;
         performance_counter m_perf_perf_counters;
+        performance_counter m_perf_truncate_space;
+        performance_counter m_perf_hot_keys;
+        performance_counter m_perf_slow_ops;
+        performance_counter m_perf_read_forwarded;
+        // per-region load of the regions we replicate
+        region_stats m_region_stats;
+        // per-hop timestamps of traced writes
+        trace_ring m_traces;
+        // operations that took longer than --slow-op-threshold
+        slow_log m_slow_ops;
         // iostat-like stats
         std::string m_block_stat_path;
         // historical data
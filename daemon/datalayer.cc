@@ -66,6 +66,8 @@
 #include "daemon/datalayer_index_state.h"
 #include "daemon/datalayer_indexer_thread.h"
 #include "daemon/datalayer_iterator.h"
+#include "daemon/datalayer_value_log.h"
+#include "daemon/datalayer_value_log_gc_thread.h"
 #include "daemon/datalayer_wiper_thread.h"
 
 #define STRLENOF(x)	(sizeof(x)-1)
@@ -82,10 +84,14 @@ datalayer :: datalayer(daemon* d)
     , m_db()
     , m_indices()
     , m_versions()
+    , m_protect_truncations()
+    , m_get_size_hints()
     , m_checkpointer(new checkpointer_thread(d))
     , m_mediator(new wiper_indexer_mediator())
     , m_indexer(new indexer_thread(d, m_mediator.get()))
     , m_wiper(new wiper_thread(d, m_mediator.get()))
+    , m_vlog(new value_log())
+    , m_vlog_gc(new value_log_gc_thread(d))
 {
 }
 
@@ -94,12 +100,14 @@ datalayer :: ~datalayer() throw ()
     m_checkpointer->shutdown();
     m_indexer->shutdown();
     m_wiper->shutdown();
+    m_vlog_gc->shutdown();
 }
 
 #define FORMAT_1_6 "v1.6.0 format"
 
 bool
 datalayer :: initialize(const std::string& path,
+                        uint64_t value_log_threshold,
                         bool* saved,
                         server_id* saved_us,
                         po6::net::location* saved_bind_to,
@@ -208,9 +216,15 @@ datalayer :: initialize(const std::string& path,
         return false;
     }
 
+    if (!m_vlog->open(path, m_db, value_log_threshold))
+    {
+        return false;
+    }
+
     m_checkpointer->start();
     m_indexer->start();
     m_wiper->start();
+    m_vlog_gc->start();
     *saved = !first_time;
     return true;
 }
@@ -221,6 +235,8 @@ datalayer :: teardown()
     m_checkpointer->shutdown();
     m_indexer->shutdown();
     m_wiper->shutdown();
+    m_vlog_gc->shutdown();
+    m_vlog->close();
 }
 
 bool
@@ -255,6 +271,7 @@ datalayer :: pause()
     m_checkpointer->initiate_pause();
     m_indexer->initiate_pause();
     m_wiper->initiate_pause();
+    m_vlog_gc->initiate_pause();
 }
 
 void
@@ -263,6 +280,7 @@ datalayer :: unpause()
     m_checkpointer->unpause();
     m_indexer->unpause();
     m_wiper->unpause();
+    m_vlog_gc->unpause();
 }
 
 void
@@ -273,6 +291,7 @@ datalayer :: reconfigure(const configuration&,
     m_checkpointer->wait_until_paused();
     m_indexer->wait_until_paused();
     m_wiper->wait_until_paused();
+    m_vlog_gc->wait_until_paused();
 
     // indices that must exist
     std::vector<std::pair<region_id, index_id> > indices;
@@ -368,8 +387,17 @@ datalayer :: reconfigure(const configuration&,
     }
 
     m_versions.swap(&new_versions);
+
+    // every replica deletes its own copies of what truncations left
+    // behind, and picks up where a restart left off
+    std::vector<std::pair<region_id, uint64_t> > floors;
+    std::vector<std::pair<region_id, uint64_t> > truncations;
+    truncated_regions(&floors, &truncations);
+
+    m_wiper->set_truncations(truncations);
     m_indexer->kick();
     m_wiper->kick();
+    m_vlog_gc->kick();
 }
 
 void
@@ -388,6 +416,8 @@ datalayer :: debug_dump()
     m_mediator->debug_dump();
     m_indexer->debug_dump();
     m_wiper->debug_dump();
+    m_vlog->debug_dump();
+    m_vlog_gc->debug_dump();
 }
 
 bool
@@ -417,6 +447,36 @@ datalayer :: approximate_size()
     return ret;
 }
 
+uint64_t
+datalayer :: approximate_size(const region_id& ri)
+{
+    std::string start;
+    std::string limit;
+    encode_region_range('o', ri, &start, &limit);
+    leveldb::Range r(start, limit);
+    uint64_t ret = 0;
+    m_db->GetApproximateSizes(&r, 1, &ret);
+    return ret;
+}
+
+uint64_t
+datalayer :: value_log_segments()
+{
+    return m_vlog->segments();
+}
+
+uint64_t
+datalayer :: value_log_bytes()
+{
+    return m_vlog->bytes();
+}
+
+bool
+datalayer :: index_build_progress(uint64_t* done, uint64_t* total, uint64_t* eta_s)
+{
+    return m_indexer->progress(done, total, eta_s);
+}
+
 datalayer::returncode
 datalayer :: get(const region_id& ri,
                  const e::slice& key,
@@ -424,7 +484,7 @@ datalayer :: get(const region_id& ri,
                  uint64_t* version,
                  reference* ref)
 {
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     std::vector<char> scratch;
 
     // create the encoded key
@@ -435,21 +495,77 @@ datalayer :: get(const region_id& ri,
     leveldb::ReadOptions opts;
     opts.fill_cache = true;
     opts.verify_checksums = true;
-    leveldb::Status st = m_db->Get(opts, lkey, &ref->m_backing);
+    return read_object(opts, lkey, e::slice(), value, version, ref);
+}
 
-    if (st.ok())
-    {
-        e::slice v(ref->m_backing.data(), ref->m_backing.size());
-        return decode_value(v, value, version);
-    }
-    else if (st.IsNotFound())
+datalayer::returncode
+datalayer :: get_pinned(const region_id& ri,
+                        const e::slice& key,
+                        std::vector<e::slice>* value,
+                        uint64_t* version,
+                        reference* ref)
+{
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    std::vector<char> scratch;
+
+    // create the encoded key
+    leveldb::Slice lkey;
+    encode_key(ri, sc.attrs[0].type, key, &scratch, &lkey);
+
+    leveldb::ReadOptions opts;
+    opts.fill_cache = true;
+    opts.verify_checksums = true;
+
+    // DB::Get consults the bloom filters and is cheapest for small or missing
+    // objects.  It copies into a string, so regions with large objects use an
+    // iterator instead, decoding in place and leaving one copy into the
+    // response.  Attributes in the value log are read into the reference
+    // either way, so only what LevelDB holds counts toward the size.
+    if (e::atomic::load_64_nobarrier(get_size_hint(ri)) < PINNED_GET_THRESHOLD)
     {
-        return NOT_FOUND;
+        returncode rc = read_object(opts, lkey, e::slice(), value, version, ref);
+
+        if (rc == SUCCESS)
+        {
+            observe_get_size(ri, ref->m_backing.size());
+        }
+
+        return rc;
     }
-    else
+
+    for (unsigned attempt = 0; attempt < 3; ++attempt)
     {
-        return handle_error(st);
+        ref->m_pinned.reset(leveldb_snapshot_ptr(m_db, NULL), m_db->NewIterator(opts));
+        leveldb::Iterator* it = ref->m_pinned.get();
+        it->Seek(lkey);
+
+        if (!it->Valid())
+        {
+            return it->status().ok() ? NOT_FOUND : handle_error(it->status());
+        }
+
+        if (it->key() != lkey)
+        {
+            return NOT_FOUND;
+        }
+
+        e::slice v(it->value().data(), it->value().size());
+        returncode rc = decode_object(v, value, version, ref);
+
+        // see read_object for why NOT_FOUND warrants another read
+        if (rc != NOT_FOUND)
+        {
+            if (rc == SUCCESS)
+            {
+                observe_get_size(ri, v.size());
+            }
+
+            return rc;
+        }
     }
+
+    LOG(ERROR) << "value log pointer keeps pointing to collected segments";
+    return CORRUPTION;
 }
 
 datalayer::returncode
@@ -458,12 +574,13 @@ datalayer :: del(const region_id& ri,
                  const std::vector<e::slice>& old_value)
 {
     leveldb::WriteBatch updates;
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     std::vector<char> scratch;
 
     // create the encoded key
     leveldb::Slice lkey;
     encode_key(ri, sc.attrs[0].type, key, &scratch, &lkey);
+    value_log::hold hold(m_vlog.get(), lkey);
 
     // delete the actual object
     updates.Delete(lkey);
@@ -499,17 +616,28 @@ datalayer :: put(const region_id& ri,
                  uint64_t version)
 {
     leveldb::WriteBatch updates;
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     std::vector<char> scratch1;
     std::vector<char> scratch2;
 
     // create the encoded key
     leveldb::Slice lkey;
     encode_key(ri, sc.attrs[0].type, key, &scratch1, &lkey);
+    value_log::hold hold(m_vlog.get(), lkey);
+
+    // create the encoded value, moving large attributes to the value log
+    std::vector<e::slice> stored;
+    std::vector<bool> indirect;
+    std::vector<char> scratch3;
+    returncode rc = separate_values(lkey, new_value, &stored, &indirect, &scratch3);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
 
-    // create the encoded value
     leveldb::Slice lval;
-    encode_value(new_value, version, &scratch2, &lval);
+    encode_value(stored, indirect, version, &scratch2, &lval);
 
     // put the actual object
     updates.Put(lkey, lval);
@@ -546,17 +674,28 @@ datalayer :: overput(const region_id& ri,
                      uint64_t version)
 {
     leveldb::WriteBatch updates;
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     std::vector<char> scratch1;
     std::vector<char> scratch2;
 
     // create the encoded key
     leveldb::Slice lkey;
     encode_key(ri, sc.attrs[0].type, key, &scratch1, &lkey);
+    value_log::hold hold(m_vlog.get(), lkey);
+
+    // create the encoded value, moving large attributes to the value log
+    std::vector<e::slice> stored;
+    std::vector<bool> indirect;
+    std::vector<char> scratch3;
+    returncode rc = separate_values(lkey, new_value, &stored, &indirect, &scratch3);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
 
-    // create the encoded value
     leveldb::Slice lval;
-    encode_value(new_value, version, &scratch2, &lval);
+    encode_value(stored, indirect, version, &scratch2, &lval);
 
     // put the actual object
     updates.Put(lkey, lval);
@@ -589,7 +728,7 @@ datalayer::returncode
 datalayer :: uncertain_del(const region_id& ri,
                            const e::slice& key)
 {
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     std::vector<char> scratch;
 
     // create the encoded key
@@ -597,24 +736,16 @@ datalayer :: uncertain_del(const region_id& ri,
     encode_key(ri, sc.attrs[0].type, key, &scratch, &lkey);
 
     // perform the read
-    std::string ref;
+    reference ref;
     leveldb::ReadOptions opts;
     opts.fill_cache = true;
     opts.verify_checksums = true;
-    leveldb::Status st = m_db->Get(opts, lkey, &ref);
+    std::vector<e::slice> old_value;
+    uint64_t old_version;
+    returncode rc = read_object(opts, lkey, e::slice(), &old_value, &old_version, &ref);
 
-    if (st.ok())
+    if (rc == SUCCESS)
     {
-        std::vector<e::slice> old_value;
-        uint64_t old_version;
-        returncode rc = decode_value(e::slice(ref.data(), ref.size()),
-                                     &old_value, &old_version);
-
-        if (rc != SUCCESS)
-        {
-            return rc;
-        }
-
         if (old_value.size() + 1 != sc.attrs_sz)
         {
             return BAD_ENCODING;
@@ -622,13 +753,13 @@ datalayer :: uncertain_del(const region_id& ri,
 
         return del(ri, key, old_value);
     }
-    else if (st.IsNotFound())
+    else if (rc == NOT_FOUND)
     {
         return SUCCESS;
     }
     else
     {
-        return handle_error(st);
+        return rc;
     }
 }
 
@@ -638,7 +769,7 @@ datalayer :: uncertain_put(const region_id& ri,
                            const std::vector<e::slice>& new_value,
                            uint64_t version)
 {
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     std::vector<char> scratch;
 
     // create the encoded key
@@ -646,34 +777,133 @@ datalayer :: uncertain_put(const region_id& ri,
     encode_key(ri, sc.attrs[0].type, key, &scratch, &lkey);
 
     // perform the read
-    std::string ref;
+    reference ref;
     leveldb::ReadOptions opts;
     opts.fill_cache = true;
     opts.verify_checksums = true;
-    leveldb::Status st = m_db->Get(opts, lkey, &ref);
+    std::vector<e::slice> old_value;
+    uint64_t old_version;
+    returncode rc = read_object(opts, lkey, e::slice(), &old_value, &old_version, &ref);
 
-    if (st.ok())
+    if (rc == SUCCESS)
     {
+        if (old_value.size() + 1 != sc.attrs_sz)
+        {
+            return BAD_ENCODING;
+        }
+
+        return overput(ri, key, old_value, new_value, version);
+    }
+    else if (rc == NOT_FOUND)
+    {
+        return put(ri, key, new_value, version);
+    }
+    else
+    {
+        return rc;
+    }
+}
+
+datalayer::returncode
+datalayer :: uncertain_write(const region_id& ri,
+                             const std::vector<e::slice>& keys,
+                             const std::vector<const std::vector<e::slice>*>& values,
+                             const std::vector<uint64_t>& versions)
+{
+    assert(keys.size() == values.size());
+    assert(keys.size() == versions.size());
+
+    // Writers to the value log hold a stripe per key; rather than order the
+    // stripes of a whole batch, write such objects one at a time.
+    if (m_vlog->in_use())
+    {
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            returncode rc = values[i]
+                          ? uncertain_put(ri, keys[i], *values[i], versions[i])
+                          : uncertain_del(ri, keys[i]);
+
+            if (rc != SUCCESS)
+            {
+                return rc;
+            }
+        }
+
+        return SUCCESS;
+    }
+
+    leveldb::WriteBatch updates;
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    std::vector<const index*> indices;
+    find_indices(ri, &indices);
+    leveldb::ReadOptions opts;
+    opts.fill_cache = true;
+    opts.verify_checksums = true;
+    uint64_t version = 0;
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        // create the encoded key
+        std::vector<char> scratch1;
+        leveldb::Slice lkey;
+        encode_key(ri, sc.attrs[0].type, keys[i], &scratch1, &lkey);
+
+        // read the old value so its index entries may be removed
+        reference ref;
         std::vector<e::slice> old_value;
         uint64_t old_version;
-        returncode rc = decode_value(e::slice(ref.data(), ref.size()),
-                                     &old_value, &old_version);
+        returncode rc = read_object(opts, lkey, e::slice(), &old_value, &old_version, &ref);
 
-        if (rc != SUCCESS)
+        if (rc == SUCCESS && old_value.size() + 1 != sc.attrs_sz)
+        {
+            return BAD_ENCODING;
+        }
+        else if (rc != SUCCESS && rc != NOT_FOUND)
         {
             return rc;
         }
 
-        if (old_value.size() + 1 != sc.attrs_sz)
+        const std::vector<e::slice>* old = rc == SUCCESS ? &old_value : NULL;
+
+        if (values[i])
         {
-            return BAD_ENCODING;
+            std::vector<char> scratch2;
+            leveldb::Slice lval;
+            encode_value(*values[i], versions[i], &scratch2, &lval);
+            updates.Put(lkey, lval);
+            version = std::max(version, versions[i]);
+        }
+        else if (old)
+        {
+            updates.Delete(lkey);
+        }
+        else
+        {
+            continue;
         }
 
-        return overput(ri, key, old_value, new_value, version);
+        create_index_changes(sc, ri, indices, keys[i], old, values[i], &updates);
     }
-    else if (st.IsNotFound())
+
+    // ensure we've recorded a version at least as high as every key
+    if (version > 0)
     {
-        return put(ri, key, new_value, version);
+        write_version(ri, version, &updates);
+    }
+
+    // Perform the write
+    leveldb::WriteOptions wopts;
+    wopts.sync = false;
+    leveldb::Status st = m_db->Write(wopts, &updates);
+
+    if (st.ok())
+    {
+        if (version > 0)
+        {
+            update_memory_version(ri, version);
+        }
+
+        return SUCCESS;
     }
     else
     {
@@ -684,7 +914,10 @@ datalayer :: uncertain_put(const region_id& ri,
 datalayer::snapshot
 datalayer :: make_snapshot()
 {
-    return leveldb_snapshot_ptr(m_db, m_db->GetSnapshot());
+    uint64_t epoch = m_vlog->epoch();
+    leveldb_snapshot_ptr snap(m_db, m_db->GetSnapshot());
+    m_vlog->track(epoch, snap);
+    return snap;
 }
 
 datalayer::iterator*
@@ -693,7 +926,7 @@ datalayer :: make_search_iterator(snapshot snap,
                                   const std::vector<attribute_check>& checks,
                                   std::ostringstream* ostr)
 {
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     std::vector<e::intrusive_ptr<index_iterator> > iterators;
 
     // pull a set of range queries from checks
@@ -830,7 +1063,7 @@ datalayer :: backup(const e::slice& _name)
 
     if (st.ok())
     {
-        return true;
+        return m_vlog->backup(name.ToString());
     }
     else if (st.IsCorruption())
     {
@@ -849,6 +1082,64 @@ datalayer :: backup(const e::slice& _name)
     }
 }
 
+datalayer::returncode
+datalayer :: delete_range(const leveldb::Slice& start,
+                          const leveldb::Slice& limit,
+                          std::string* next)
+{
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
+    it->Seek(start);
+    leveldb::WriteBatch updates;
+    size_t keys = 0;
+    uint64_t bytes = 0;
+    next->clear();
+
+    while (it->Valid() && it->key().compare(limit) < 0)
+    {
+        if (keys >= RANGE_DELETE_BATCH)
+        {
+            next->assign(it->key().data(), it->key().size());
+            break;
+        }
+
+        updates.Delete(it->key());
+        bytes += it->key().size() + it->value().size();
+        ++keys;
+        it->Next();
+    }
+
+    if (!it->status().ok())
+    {
+        return handle_error(it->status());
+    }
+
+    if (keys == 0)
+    {
+        return SUCCESS;
+    }
+
+    leveldb::WriteOptions wopts;
+    wopts.sync = false;
+    leveldb::Status st = m_db->Write(wopts, &updates);
+
+    if (!st.ok())
+    {
+        return handle_error(st);
+    }
+
+    m_daemon->m_io.charge(io_scheduler::DISK_WRITE, bytes);
+    return SUCCESS;
+}
+
+void
+datalayer :: compact_range(const leveldb::Slice& start,
+                           const leveldb::Slice& limit)
+{
+    m_db->CompactRange(&start, &limit);
+}
+
 datalayer::returncode
 datalayer :: get_from_iterator(const region_id& ri,
                                const schema& sc,
@@ -869,26 +1160,17 @@ datalayer :: get_from_iterator(const region_id& ri,
     opts.fill_cache = true;
     opts.verify_checksums = true;
     opts.snapshot = iter->snap().get();
-    leveldb::Status st = m_db->Get(opts, lkey, &ref->m_backing);
+    returncode rc = read_object(opts, lkey, iter->key(), value, version, ref);
 
-    if (st.ok())
+    if (rc == SUCCESS)
     {
-        ref->m_backing += std::string(reinterpret_cast<const char*>(iter->key().data()), iter->key().size());
         *key = e::slice(ref->m_backing.data()
                         + ref->m_backing.size()
                         - iter->key().size(),
                         iter->key().size());
-        e::slice v(ref->m_backing.data(), ref->m_backing.size() - iter->key().size());
-        return decode_value(v, value, version);
-    }
-    else if (st.IsNotFound())
-    {
-        return NOT_FOUND;
-    }
-    else
-    {
-        return handle_error(st);
     }
+
+    return rc;
 }
 
 namespace
@@ -1104,6 +1386,105 @@ datalayer :: region_will_be_wiped(region_id rid)
     return m_wiper->region_will_be_wiped(rid);
 }
 
+datalayer::returncode
+datalayer :: mark_truncated(const region_id& ri, uint64_t version)
+{
+    return write_truncation(ri, version, false);
+}
+
+void
+datalayer :: truncated_regions(std::vector<std::pair<region_id, uint64_t> >* truncations,
+                               std::vector<std::pair<region_id, uint64_t> >* unwiped)
+{
+    truncations->clear();
+
+    if (unwiped)
+    {
+        unwiped->clear();
+    }
+
+    std::auto_ptr<leveldb::Iterator> it;
+    it.reset(m_db->NewIterator(leveldb::ReadOptions()));
+    char tbacking[TRUNCATION_BUF_SIZE];
+    encode_truncation(region_id(), tbacking);
+    it->Seek(leveldb::Slice(tbacking, TRUNCATION_BUF_SIZE));
+
+    while (it->Valid())
+    {
+        region_id ri;
+        e::slice key(it->key().data(), it->key().size());
+
+        if (decode_truncation(key, &ri) != SUCCESS ||
+            it->value().size() != sizeof(uint64_t) + sizeof(uint8_t))
+        {
+            break;
+        }
+
+        uint64_t version;
+        uint8_t wiped;
+        const char* ptr = it->value().data();
+        ptr = e::unpack64be(ptr, &version);
+        ptr = e::unpack8be(ptr, &wiped);
+        truncations->push_back(std::make_pair(ri, version));
+
+        if (unwiped && !wiped)
+        {
+            unwiped->push_back(std::make_pair(ri, version));
+        }
+
+        it->Next();
+    }
+}
+
+void
+datalayer :: request_truncate(const region_id& ri, uint64_t version)
+{
+    m_wiper->request_truncate(ri, version);
+}
+
+void
+datalayer :: mark_wiped(const region_id& ri, uint64_t version)
+{
+    write_truncation(ri, version, true);
+}
+
+datalayer::returncode
+datalayer :: write_truncation(const region_id& ri, uint64_t version, bool wiped)
+{
+    char tbacking[TRUNCATION_BUF_SIZE];
+    encode_truncation(ri, tbacking);
+    leveldb::Slice key(tbacking, TRUNCATION_BUF_SIZE);
+    char vbacking[sizeof(uint64_t) + sizeof(uint8_t)];
+    char* ptr = vbacking;
+    ptr = e::pack64be(version, ptr);
+    ptr = e::pack8be(wiped ? 1 : 0, ptr);
+    po6::threads::mutex::hold hold(&m_protect_truncations);
+    std::string val;
+    leveldb::Status st = m_db->Get(leveldb::ReadOptions(), key, &val);
+    uint64_t recorded = 0;
+
+    if (!st.ok() && !st.IsNotFound())
+    {
+        return handle_error(st);
+    }
+
+    if (st.ok() && val.size() == sizeof(vbacking))
+    {
+        e::unpack64be(val.data(), &recorded);
+    }
+
+    // a later truncation supersedes this one
+    if (wiped ? recorded != version : recorded >= version)
+    {
+        return SUCCESS;
+    }
+
+    leveldb::WriteOptions opts;
+    opts.sync = true;
+    st = m_db->Put(opts, key, leveldb::Slice(vbacking, sizeof(vbacking)));
+    return st.ok() ? SUCCESS : handle_error(st);
+}
+
 void
 datalayer :: request_wipe(const transfer_id& xid,
                           const region_id& ri)
@@ -1166,6 +1547,7 @@ datalayer :: replay_region_from_checkpoint(const region_id& ri,
 
     assert(!m_wiper->region_will_be_wiped(ri));
     *wipe = local_timestamp == "all";
+    uint64_t epoch = m_vlog->epoch();
     leveldb::ReplayIterator* iter;
     leveldb::Status st = m_db->GetReplayIterator(local_timestamp, &iter);
 
@@ -1176,8 +1558,9 @@ datalayer :: replay_region_from_checkpoint(const region_id& ri,
     }
 
     leveldb_replay_iterator_ptr ptr(m_db, iter);
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    return new replay_iterator(ri, ptr, index_encoding::lookup(sc.attrs[0].type));
+    m_vlog->track(epoch, ptr);
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    return new replay_iterator(this, ri, ptr, index_encoding::lookup(sc.attrs[0].type));
 }
 
 void
@@ -1362,7 +1745,7 @@ datalayer :: find_indices(const region_id& rid, std::vector<const index*>* indic
             continue;
         }
 
-        const index* idx = m_daemon->m_config.get_index(it->ii);
+        const index* idx = m_daemon->m_config->get_index(it->ii);
         assert(idx);
         indices->push_back(idx);
     }
@@ -1382,7 +1765,7 @@ datalayer :: find_indices(const region_id& rid, uint16_t attr,
             continue;
         }
 
-        const index* idx = m_daemon->m_config.get_index(it->ii);
+        const index* idx = m_daemon->m_config->get_index(it->ii);
         assert(idx);
 
         if (idx->attr == attr)
@@ -1392,6 +1775,179 @@ datalayer :: find_indices(const region_id& rid, uint16_t attr,
     }
 }
 
+datalayer::returncode
+datalayer :: read_object(const leveldb::ReadOptions& opts,
+                         const leveldb::Slice& lkey,
+                         const e::slice& suffix,
+                         std::vector<e::slice>* value,
+                         uint64_t* version,
+                         reference* ref)
+{
+    // Without a snapshot, the value log may collect a segment between our
+    // read of the pointer and our read of the value.  The collector rewrites
+    // the pointer before collecting, so reading again will find it.
+    for (unsigned attempt = 0; attempt < 3; ++attempt)
+    {
+        leveldb::Status st = m_db->Get(opts, lkey, &ref->m_backing);
+
+        if (st.IsNotFound())
+        {
+            return NOT_FOUND;
+        }
+        else if (!st.ok())
+        {
+            return handle_error(st);
+        }
+
+        const size_t sz = ref->m_backing.size();
+        ref->m_backing.append(reinterpret_cast<const char*>(suffix.data()), suffix.size());
+        e::slice v(ref->m_backing.data(), sz);
+        returncode rc = decode_object(v, value, version, ref);
+
+        if (rc != NOT_FOUND || opts.snapshot)
+        {
+            return rc == NOT_FOUND ? CORRUPTION : rc;
+        }
+    }
+
+    LOG(ERROR) << "value log pointer keeps pointing to collected segments";
+    return CORRUPTION;
+}
+
+datalayer::returncode
+datalayer :: decode_object(const e::slice& in,
+                           std::vector<e::slice>* value,
+                           uint64_t* version,
+                           reference* ref)
+{
+    std::vector<bool> indirect;
+    returncode rc = decode_value(in, value, &indirect, version);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
+
+    size_t sz = 0;
+
+    for (size_t i = 0; i < indirect.size(); ++i)
+    {
+        uint64_t segment;
+        uint64_t offset;
+        uint32_t length;
+
+        if (!indirect[i])
+        {
+            continue;
+        }
+
+        if (!decode_value_pointer((*value)[i], &segment, &offset, &length))
+        {
+            return BAD_ENCODING;
+        }
+
+        sz += length;
+    }
+
+    if (sz == 0)
+    {
+        return SUCCESS;
+    }
+
+    // size the backing once so the slices we hand out remain valid
+    ref->m_vlog_backing.resize(sz);
+    char* ptr = &ref->m_vlog_backing[0];
+
+    for (size_t i = 0; i < indirect.size(); ++i)
+    {
+        if (!indirect[i])
+        {
+            continue;
+        }
+
+        uint64_t segment;
+        uint64_t offset;
+        uint32_t length;
+        decode_value_pointer((*value)[i], &segment, &offset, &length);
+        rc = m_vlog->read((*value)[i], ptr);
+
+        if (rc != SUCCESS)
+        {
+            return rc;
+        }
+
+        (*value)[i] = e::slice(ptr, length);
+        ptr += length;
+    }
+
+    return SUCCESS;
+}
+
+datalayer::returncode
+datalayer :: separate_values(const leveldb::Slice& lkey,
+                             const std::vector<e::slice>& value,
+                             std::vector<e::slice>* stored,
+                             std::vector<bool>* indirect,
+                             std::vector<char>* scratch)
+{
+    *stored = value;
+    size_t separated = 0;
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        if (m_vlog->should_separate(value[i].size()))
+        {
+            ++separated;
+        }
+    }
+
+    if (separated == 0)
+    {
+        return SUCCESS;
+    }
+
+    indirect->resize(value.size(), false);
+    scratch->resize(separated * VALUE_POINTER_SIZE);
+    char* ptr = &scratch->front();
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        if (!m_vlog->should_separate(value[i].size()))
+        {
+            continue;
+        }
+
+        returncode rc = m_vlog->append(lkey, i, value[i], ptr);
+
+        if (rc != SUCCESS)
+        {
+            return rc;
+        }
+
+        (*stored)[i] = e::slice(ptr, VALUE_POINTER_SIZE);
+        (*indirect)[i] = true;
+        ptr += VALUE_POINTER_SIZE;
+    }
+
+    // the pointers must not reach LevelDB before the values are durable
+    return m_vlog->sync();
+}
+
+uint64_t*
+datalayer :: get_size_hint(const region_id& ri)
+{
+    return &m_get_size_hints[ri.get() & (GET_SIZE_HINTS - 1)];
+}
+
+void
+datalayer :: observe_get_size(const region_id& ri, uint64_t sz)
+{
+    // racing updates may lose a sample, which a moving average tolerates
+    uint64_t* hint = get_size_hint(ri);
+    uint64_t old = e::atomic::load_64_nobarrier(hint);
+    e::atomic::store_64_nobarrier(hint, old - old / 8 + sz / 8);
+}
+
 datalayer::returncode
 datalayer :: handle_error(leveldb::Status st)
 {
@@ -1415,6 +1971,8 @@ datalayer :: handle_error(leveldb::Status st)
 
 datalayer :: reference :: reference()
     : m_backing()
+    , m_vlog_backing()
+    , m_pinned()
 {
 }
 
@@ -1426,6 +1984,10 @@ void
 datalayer :: reference :: swap(reference* ref)
 {
     m_backing.swap(ref->m_backing);
+    m_vlog_backing.swap(ref->m_vlog_backing);
+    leveldb_iterator_ptr tmp(m_pinned);
+    m_pinned = ref->m_pinned;
+    ref->m_pinned = tmp;
 }
 
 std::ostream&
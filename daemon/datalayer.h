@@ -87,6 +87,13 @@ class datalayer
         typedef leveldb_snapshot_ptr snapshot;
         // must be pow2
         const static uint64_t REGION_PERIODIC = 65536;
+        // keys removed by one write of delete_range
+        const static size_t RANGE_DELETE_BATCH = 4096;
+        // get_pinned pins an iterator only in regions whose objects average
+        // at least this many bytes in LevelDB; smaller reads use DB::Get
+        const static uint64_t PINNED_GET_THRESHOLD = 16384;
+        // must be pow2
+        const static size_t GET_SIZE_HINTS = 1024;
 
     public:
         datalayer(daemon*);
@@ -94,6 +101,7 @@ class datalayer
 
     public:
         bool initialize(const std::string& path,
+                        uint64_t value_log_threshold,
                         bool* saved,
                         server_id* saved_us,
                         po6::net::location* saved_bind_to,
@@ -114,6 +122,13 @@ class datalayer
                           std::string* value);
         std::string get_timestamp();
         uint64_t approximate_size();
+        // bytes LevelDB holds for the region's objects
+        uint64_t approximate_size(const region_id& ri);
+        uint64_t value_log_segments();
+        uint64_t value_log_bytes();
+        // progress of the index build in flight, in approximate bytes of the
+        // region; false if nothing is being indexed
+        bool index_build_progress(uint64_t* done, uint64_t* total, uint64_t* eta_s);
 
     public:
         // retrieve the current value of a key
@@ -122,6 +137,15 @@ class datalayer
                        std::vector<e::slice>* value,
                        uint64_t* version,
                        reference* ref);
+        // like get, but for regions with large objects the value points
+        // directly into LevelDB's memtable or block cache, which ref pins
+        // until it is destroyed; only use this for references that are
+        // released soon after the read
+        returncode get_pinned(const region_id& ri,
+                              const e::slice& key,
+                              std::vector<e::slice>* value,
+                              uint64_t* version,
+                              reference* ref);
         // put, overput, or delete a key where the existing value is known
         returncode del(const region_id& ri,
                        const e::slice& key,
@@ -142,6 +166,12 @@ class datalayer
                                  const e::slice& key,
                                  const std::vector<e::slice>& new_value,
                                  uint64_t version);
+        // uncertain puts and deletes of distinct keys, applied as one LevelDB
+        // write; a NULL value deletes the key
+        returncode uncertain_write(const region_id& ri,
+                                   const std::vector<e::slice>& keys,
+                                   const std::vector<const std::vector<e::slice>*>& values,
+                                   const std::vector<uint64_t>& versions);
         // leveldb provides no failure mechanism for this, neither do we
         snapshot make_snapshot();
         // create iterators from snapshots
@@ -151,6 +181,16 @@ class datalayer
                                        std::ostringstream* ostr);
         // backups
         bool backup(const e::slice& name);
+        // range deletes: remove the keys in [start, limit), a batch of
+        // RANGE_DELETE_BATCH keys per write; "next" is where to resume, and
+        // is empty once the range is clear
+        returncode delete_range(const leveldb::Slice& start,
+                                const leveldb::Slice& limit,
+                                std::string* next);
+        // compact [start, limit) so that deleted keys stop taking up space
+        // and slowing down reads
+        void compact_range(const leveldb::Slice& start,
+                           const leveldb::Slice& limit);
         // get the object pointed to by the iterator
         returncode get_from_iterator(const region_id& ri,
                                      const schema& sc,
@@ -166,6 +206,14 @@ class datalayer
         returncode create_checkpoint(const region_timestamp& rt);
         void set_checkpoint_gc(uint64_t checkpoint_gc);
         void largest_checkpoint_for(const region_id& ri, uint64_t* checkpoint);
+        // truncation: objects of the key region older than version are
+        // gone, and every replica's wiper deletes its own copies of them.
+        // Each record keeps the latest truncation and whether its wipe
+        // finished; unwiped may be NULL.
+        returncode mark_truncated(const region_id& ri, uint64_t version);
+        void truncated_regions(std::vector<std::pair<region_id, uint64_t> >* truncations,
+                               std::vector<std::pair<region_id, uint64_t> >* unwiped);
+        void request_truncate(const region_id& ri, uint64_t version);
         bool region_will_be_wiped(region_id rid);
         void request_wipe(const transfer_id& xid,
                           const region_id& ri);
@@ -184,6 +232,8 @@ class datalayer
         class index_state;
         class checkpointer_thread;
         class indexer_thread;
+        class value_log;
+        class value_log_gc_thread;
         class wiper_thread;
         class wiper_indexer_mediator;
         datalayer(const datalayer&);
@@ -199,9 +249,36 @@ class datalayer
                           std::vector<const index*>* indices);
         void find_indices(const region_id& rid, uint16_t attr,
                           std::vector<const index*>* indices);
+        // read the object at lkey, appending suffix to the backing and
+        // resolving any attributes that live in the value log
+        returncode read_object(const leveldb::ReadOptions& opts,
+                               const leveldb::Slice& lkey,
+                               const e::slice& suffix,
+                               std::vector<e::slice>* value,
+                               uint64_t* version,
+                               reference* ref);
+        // decode a value that was read from LevelDB; returns NOT_FOUND if a
+        // value log segment it references has been collected
+        returncode decode_object(const e::slice& in,
+                                 std::vector<e::slice>* value,
+                                 uint64_t* version,
+                                 reference* ref);
+        // move large attributes to the value log; "stored" is what should go
+        // into LevelDB
+        returncode separate_values(const leveldb::Slice& lkey,
+                                   const std::vector<e::slice>& value,
+                                   std::vector<e::slice>* stored,
+                                   std::vector<bool>* indirect,
+                                   std::vector<char>* scratch);
 
         returncode handle_error(leveldb::Status st);
         void collect_lower_checkpoints(uint64_t checkpoint_gc);
+        returncode write_truncation(const region_id& ri, uint64_t version, bool wiped);
+        // record that the wiper is done, unless truncated again since
+        void mark_wiped(const region_id& ri, uint64_t version);
+        // moving average of the size of objects read from ri's slot
+        uint64_t* get_size_hint(const region_id& ri);
+        void observe_get_size(const region_id& ri, uint64_t sz);
 
         const static region_id defaultri;
         static uint64_t id(region_id ri) { return ri.get(); }
@@ -211,10 +288,14 @@ class datalayer
         leveldb_db_ptr m_db;
         std::vector<index_state> m_indices;
         e::ao_hash_map<region_id, uint64_t, id, defaultri> m_versions;
+        po6::threads::mutex m_protect_truncations;
+        uint64_t m_get_size_hints[GET_SIZE_HINTS];
         const std::auto_ptr<checkpointer_thread> m_checkpointer;
         const std::auto_ptr<wiper_indexer_mediator> m_mediator;
         const std::auto_ptr<indexer_thread> m_indexer;
         const std::auto_ptr<wiper_thread> m_wiper;
+        const std::auto_ptr<value_log> m_vlog;
+        const std::auto_ptr<value_log_gc_thread> m_vlog_gc;
 };
 
 class datalayer::reference
@@ -231,6 +312,10 @@ class datalayer::reference
 
     private:
         std::string m_backing;
+        // attributes read from the value log
+        std::string m_vlog_backing;
+        // keeps LevelDB's buffers alive for get_pinned
+        leveldb_iterator_ptr m_pinned;
 };
 
 std::ostream&
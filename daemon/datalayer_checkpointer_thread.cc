@@ -35,6 +35,8 @@
 #include "daemon/datalayer.h"
 #include "daemon/datalayer_checkpointer_thread.h"
 #include "daemon/datalayer_encodings.h"
+#include "daemon/datalayer_value_log.h"
+#include "daemon/datalayer_value_log_gc_thread.h"
 
 using hyperdex::datalayer;
 
@@ -173,8 +175,12 @@ datalayer :: checkpointer_thread :: collect_lower_checkpoints(uint64_t checkpoin
     if (m_gc_inhibit_permit_diff == 0)
     {
         m_daemon->m_data.m_db->AllowGarbageCollectBeforeTimestamp(lower_bound_timestamp);
+        m_daemon->m_data.m_vlog->allow_collect_before(lower_bound_timestamp);
         m_checkpoint_gced = m_checkpoint_target;
     }
 
     this->unlock();
+    // value log segments may only be unlinked once LevelDB has dropped the
+    // history that references them, so this is a natural time to collect
+    m_daemon->m_data.m_vlog_gc->kick();
 }
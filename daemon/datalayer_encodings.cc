@@ -36,6 +36,7 @@
 
 // HyperDex
 #include "daemon/datalayer_encodings.h"
+#include "daemon/datalayer_value_log.h"
 #include "daemon/index_info.h"
 
 using hyperdex::datalayer;
@@ -141,6 +142,16 @@ hyperdex :: encode_value(const std::vector<e::slice>& attrs,
                          uint64_t version,
                          std::vector<char>* backing,
                          leveldb::Slice* out)
+{
+    encode_value(attrs, std::vector<bool>(), version, backing, out);
+}
+
+void
+hyperdex :: encode_value(const std::vector<e::slice>& attrs,
+                         const std::vector<bool>& indirect,
+                         uint64_t version,
+                         std::vector<char>* backing,
+                         leveldb::Slice* out)
 {
     assert(attrs.size() < 65536);
     size_t sz = sizeof(uint64_t) + sizeof(uint16_t);
@@ -157,7 +168,16 @@ hyperdex :: encode_value(const std::vector<e::slice>& attrs,
 
     for (size_t i = 0; i < attrs.size(); ++i)
     {
-        ptr = e::pack32be(attrs[i].size(), ptr);
+        uint32_t attr_sz = attrs[i].size();
+        assert((attr_sz & VALUE_POINTER_FLAG) == 0);
+
+        if (i < indirect.size() && indirect[i])
+        {
+            assert(attr_sz == VALUE_POINTER_SIZE);
+            attr_sz |= VALUE_POINTER_FLAG;
+        }
+
+        ptr = e::pack32be(attr_sz, ptr);
         memmove(ptr, attrs[i].data(), attrs[i].size());
         ptr += attrs[i].size();
     }
@@ -168,6 +188,7 @@ hyperdex :: encode_value(const std::vector<e::slice>& attrs,
 datalayer::returncode
 hyperdex :: decode_value(const e::slice& in,
                          std::vector<e::slice>* attrs,
+                         std::vector<bool>* indirect,
                          uint64_t* version)
 {
     const uint8_t* ptr = in.data();
@@ -195,6 +216,11 @@ hyperdex :: decode_value(const e::slice& in,
 
     attrs->clear();
 
+    if (indirect)
+    {
+        indirect->clear();
+    }
+
     for (size_t i = 0; i < num_attrs; ++i)
     {
         uint32_t sz = 0;
@@ -208,6 +234,19 @@ hyperdex :: decode_value(const e::slice& in,
             return datalayer::BAD_ENCODING;
         }
 
+        bool is_pointer = (sz & VALUE_POINTER_FLAG) != 0;
+        sz &= ~VALUE_POINTER_FLAG;
+
+        if (is_pointer && (!indirect || sz != VALUE_POINTER_SIZE))
+        {
+            return datalayer::BAD_ENCODING;
+        }
+
+        if (indirect)
+        {
+            indirect->push_back(is_pointer);
+        }
+
         e::slice s(reinterpret_cast<const uint8_t*>(ptr), sz);
         ptr += sz;
         attrs->push_back(s);
@@ -279,6 +318,33 @@ hyperdex :: decode_checkpoint(const e::slice& in,
     return t == 'c' ? datalayer::SUCCESS : datalayer::BAD_ENCODING;
 }
 
+void
+hyperdex :: encode_truncation(const region_id& ri,
+                              char* out)
+{
+    char* ptr = out;
+    ptr = e::pack8be('t', ptr);
+    ptr = e::pack64be(ri.get(), ptr);
+}
+
+datalayer::returncode
+hyperdex :: decode_truncation(const e::slice& in,
+                              region_id* ri)
+{
+    if (in.size() != TRUNCATION_BUF_SIZE)
+    {
+        return datalayer::BAD_ENCODING;
+    }
+
+    const uint8_t* ptr = in.data();
+    uint8_t t;
+    uint64_t _ri;
+    ptr = e::unpack8be(ptr, &t);
+    ptr = e::unpack64be(ptr, &_ri);
+    *ri = region_id(_ri);
+    return t == 't' ? datalayer::SUCCESS : datalayer::BAD_ENCODING;
+}
+
 void
 hyperdex :: create_index_changes(const schema& sc,
                                  const region_id& ri,
@@ -340,3 +406,16 @@ hyperdex :: encode_bump(char* _ptr, char* _end)
 
     abort();
 }
+
+void
+hyperdex :: encode_region_range(uint8_t c, const region_id& ri,
+                                std::string* start, std::string* limit)
+{
+    char buf[sizeof(uint8_t) + VARINT_64_MAX_SIZE];
+    char* ptr = buf;
+    ptr = e::pack8be(c, ptr);
+    ptr = e::packvarint64(ri.get(), ptr);
+    start->assign(buf, ptr);
+    encode_bump(buf, ptr);
+    limit->assign(buf, ptr);
+}
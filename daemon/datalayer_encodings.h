@@ -72,11 +72,25 @@ encode_value(const std::vector<e::slice>& attrs,
              uint64_t version,
              std::vector<char>* backing,
              leveldb::Slice* out);
+// Attributes that live in the value log are stored as a fixed-size pointer
+// and flagged by setting the high bit of the attribute's size.  "indirect"
+// says which attributes are pointers; it may be shorter than attrs.
+void
+encode_value(const std::vector<e::slice>& attrs,
+             const std::vector<bool>& indirect,
+             uint64_t version,
+             std::vector<char>* backing,
+             leveldb::Slice* out);
+// If indirect is NULL, values that contain pointers are a BAD_ENCODING
 datalayer::returncode
 decode_value(const e::slice& in,
              std::vector<e::slice>* attrs,
+             std::vector<bool>* indirect,
              uint64_t* version);
 
+// Marks attributes held in the value log (see datalayer_value_log.h)
+#define VALUE_POINTER_FLAG 0x80000000U
+
 // Encode the record of an operation for which we have sent an ACK
 #define VERSION_BUF_SIZE (sizeof(uint8_t) + 2 * sizeof(uint64_t))
 void
@@ -99,6 +113,15 @@ decode_checkpoint(const e::slice& in,
                   region_id* ri,
                   uint64_t* checkpoint);
 
+// the version below which a truncated region's objects are gone
+#define TRUNCATION_BUF_SIZE (sizeof(uint8_t) + sizeof(uint64_t))
+void
+encode_truncation(const region_id& ri,
+                  char* out);
+datalayer::returncode
+decode_truncation(const e::slice& in,
+                  region_id* ri);
+
 void
 create_index_changes(const schema& sc,
                      const region_id& ri,
@@ -111,6 +134,11 @@ create_index_changes(const schema& sc,
 void
 encode_bump(char* start, char* end);
 
+// the range [start, limit) of every key that starts with c and the region
+void
+encode_region_range(uint8_t c, const region_id& ri,
+                    std::string* start, std::string* limit);
+
 END_HYPERDEX_NAMESPACE
 
 #endif // hyperdex_daemon_datalayer_encodings_h_
@@ -27,14 +27,28 @@
 
 #define __STDC_LIMIT_MACROS
 
+// POSIX
+#include <unistd.h>
+
+// STL
+#include <algorithm>
+
 // Google Log
 #include <glog/logging.h>
 
+// po6
+#include <po6/threads/thread.h>
+#include <po6/time.h>
+
 // e
+#include <e/atomic.h>
+#include <e/buffer.h>
+#include <e/compat.h>
 #include <e/endian.h>
 #include <e/varint.h>
 
 // HyperDex
+#include "common/serialization.h"
 #include "daemon/daemon.h"
 #include "daemon/datalayer_checkpointer_thread.h"
 #include "daemon/datalayer_encodings.h"
@@ -43,6 +57,25 @@
 #include "daemon/datalayer_wiper_thread.h"
 
 using hyperdex::datalayer;
+using po6::threads::make_obj_func;
+
+namespace
+{
+
+// progress of an unfinished build lives under 'b' + region + index
+leveldb::Slice
+encode_build_key(const hyperdex::region_id& ri,
+                 const hyperdex::index_id& ii,
+                 char* buf)
+{
+    char* ptr = buf;
+    ptr = e::pack8be('b', ptr);
+    ptr = e::packvarint64(ri.get(), ptr);
+    ptr = e::packvarint64(ii.get(), ptr);
+    return leveldb::Slice(buf, ptr - buf);
+}
+
+} // namespace
 
 datalayer :: indexer_thread :: indexer_thread(daemon* d, wiper_indexer_mediator* m)
     : background_thread(d)
@@ -53,7 +86,13 @@ datalayer :: indexer_thread :: indexer_thread(daemon* d, wiper_indexer_mediator*
     , m_current_region()
     , m_current_index()
     , m_interrupted_count(0)
-    , m_interrupted(false)
+    , m_interrupted(0)
+    , m_build_mtx()
+    , m_plan()
+    , m_build_failed(false)
+    , m_building(false)
+    , m_build_started(0)
+    , m_build_started_bytes(0)
 {
 }
 
@@ -70,7 +109,7 @@ datalayer :: indexer_thread :: thread_name()
 bool
 datalayer :: indexer_thread :: have_work()
 {
-    m_interrupted = false;
+    e::atomic::store_64_nobarrier(&m_interrupted, 0);
     m_mediator->clear_indexer_region();
     m_have_current = false;
     m_current_region = region_id();
@@ -85,7 +124,7 @@ datalayer :: indexer_thread :: have_work()
         // then we have work to do
         if (!is->is_usable() &&
             !m_mediator->region_conflicts_with_wiper(is->ri) &&
-            m_daemon->m_config.get_virtual(is->ri, m_daemon->m_us) != virtual_server_id())
+            m_daemon->m_config->get_virtual(is->ri, m_daemon->m_us) != virtual_server_id())
         {
             return true;
         }
@@ -105,10 +144,10 @@ datalayer :: indexer_thread :: copy_work()
         // currently being wiped, and it's something that we've been mapped to,
         // then we have work to do
         if (!is->is_usable() &&
-            m_daemon->m_config.get_virtual(is->ri, m_daemon->m_us) != virtual_server_id() &&
+            m_daemon->m_config->get_virtual(is->ri, m_daemon->m_us) != virtual_server_id() &&
             m_mediator->set_indexer_region(is->ri))
         {
-            m_config = m_daemon->m_config;
+            m_config = *m_daemon->m_config;
             m_have_current   = true;
             m_current_region = is->ri;
             m_current_index  = is->ii;
@@ -125,11 +164,6 @@ datalayer :: indexer_thread :: do_work()
         return;
     }
 
-    if (!wipe(m_current_region, m_current_index))
-    {
-        return;
-    }
-
     configuration config = m_config;
     leveldb_db_ptr db = m_daemon->m_data.m_db;
     const schema* sc = config.get_schema(m_current_region);
@@ -143,43 +177,94 @@ datalayer :: indexer_thread :: do_work()
     e::guard g1 = e::makeobjguard(*m_daemon->m_data.m_checkpointer,
                                   &checkpointer_thread::permit_gc);
     g1.use_variable();
+    e::guard g0 = e::makeobjguard(*this, &indexer_thread::clear_build);
+    g0.use_variable();
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t workers = std::min(MAX_WORKERS, size_t(std::max(cpus, 1L)));
+
+    // A build that was interrupted (e.g., by a restart) left its progress
+    // behind, and picks up where it left off.
+    if (!load_build(m_current_region, m_current_index))
+    {
+        if (!wipe(m_current_region, m_current_index))
+        {
+            return;
+        }
 
-    // Take a timestamp from the data layer.  We could just use a replay
-    // iterator for "all", but we wouldn't know which objects we indexed twice.
-    // By taking an iterator and then a replay iterator from the timestamp, we
-    // ensure that the majority of data gets indexed using "put" ops instead of
-    // the "get/put" pattern necessary to remove existing indices before adding.
-    std::string timestamp;
-    db->GetReplayTimestamp(&timestamp);
+        // Take a timestamp from the data layer.  We could just use a replay
+        // iterator for "all", but we wouldn't know which objects we indexed
+        // twice.  By taking an iterator and then a replay iterator from the
+        // timestamp, we ensure that the majority of data gets indexed using
+        // "put" ops instead of the "get/put" pattern necessary to remove
+        // existing indices before adding.
+        std::string timestamp;
+        db->GetReplayTimestamp(&timestamp);
+        split(m_current_region, workers * PARTS_PER_WORKER);
+        po6::threads::mutex::hold hold(&m_build_mtx);
+        m_plan.set_timestamp(timestamp);
+        std::string record;
+        m_plan.encode(&record);
+        char buf[sizeof(uint8_t) + 2 * VARINT_64_MAX_SIZE];
+        leveldb::Slice key = encode_build_key(m_current_region, m_current_index, buf);
+        leveldb::Status st = db->Put(leveldb::WriteOptions(), key, record);
+
+        if (!st.ok())
+        {
+            LOG(ERROR) << "error indexing: write failed: " << st.ToString();
+            return;
+        }
+    }
 
     // Take this offline
     this->offline();
     e::guard g2 = e::makeobjguard(*this, &indexer_thread::online);
     g2.use_variable();
 
-    // Now iterate over the data once.
-    std::auto_ptr<region_iterator> it(play(m_current_region, sc));
+    // Now iterate over the data once, with each worker taking parts of the
+    // region until none remain.
+    {
+        po6::threads::mutex::hold hold(&m_build_mtx);
+        m_plan.restart();
+        m_build_failed = false;
+        m_building = true;
+        m_build_started = po6::monotonic_time();
+        m_build_started_bytes = built_bytes();
+    }
 
-    if (!it.get())
+    std::vector<e::compat::shared_ptr<po6::threads::thread> > threads;
+
+    for (size_t i = 0; i < workers; ++i)
     {
-        return;
+        e::compat::shared_ptr<po6::threads::thread> t;
+        t.reset(new po6::threads::thread(make_obj_func(&indexer_thread::build_worker, this)));
+        threads.push_back(t);
+        t->start();
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i]->join();
     }
 
-    while (it->valid())
     {
-        if (!index_from_iterator(it.get(), sc, m_current_region, idxs))
+        po6::threads::mutex::hold hold(&m_build_mtx);
+
+        if (m_build_failed)
         {
             return;
         }
-
-        it->next();
     }
 
     // Now do it again from the checkpoint we took.
-    std::auto_ptr<replay_iterator> rit(replay(m_current_region, timestamp));
+    std::auto_ptr<replay_iterator> rit(replay(m_current_region, m_plan.timestamp()));
 
     if (!rit.get())
     {
+        // the timestamp of a resumed build may no longer be valid; discard
+        // the progress so the next attempt starts from scratch
+        char buf[sizeof(uint8_t) + 2 * VARINT_64_MAX_SIZE];
+        leveldb::Slice key = encode_build_key(m_current_region, m_current_index, buf);
+        db->Delete(leveldb::WriteOptions(), key);
         return;
     }
 
@@ -191,6 +276,7 @@ datalayer :: indexer_thread :: do_work()
         }
 
         rit->next();
+        m_daemon->m_io.wait(io_scheduler::DISK_WRITE);
     }
 
     // Pause writes so we can hit the end of the iterator.
@@ -231,7 +317,7 @@ datalayer :: indexer_thread :: debug_dump()
     LOG(INFO) << "have_current=" << (m_have_current ? "yes" : "no");
     LOG(INFO) << "current_region=" << m_current_region;
     LOG(INFO) << "current_index=" << m_current_index;
-    LOG(INFO) << "interrupted_count=" << m_interrupted_count;
+    LOG(INFO) << "interrupted_count=" << e::atomic::load_64_nobarrier(&m_interrupted_count);
     this->unlock();
 }
 
@@ -255,7 +341,12 @@ datalayer :: indexer_thread :: mark_usable(const region_id& ri, const index_id&
     leveldb::WriteOptions wo;
     leveldb::Slice key(buf, ptr - buf);
     leveldb::Slice val;
-    leveldb::Status st = m_daemon->m_data.m_db->Put(wo, key, val);
+    // and forget any progress made building it
+    char bbuf[sizeof(uint8_t) + 2 * VARINT_64_MAX_SIZE];
+    leveldb::WriteBatch updates;
+    updates.Put(key, val);
+    updates.Delete(encode_build_key(ri, ii, bbuf));
+    leveldb::Status st = m_daemon->m_data.m_db->Write(wo, &updates);
 
     if (!st.ok())
     {
@@ -278,23 +369,262 @@ datalayer :: indexer_thread :: mark_usable(const region_id& ri, const index_id&
     return true;
 }
 
+bool
+datalayer :: indexer_thread :: progress(uint64_t* done, uint64_t* total, uint64_t* eta_s)
+{
+    po6::threads::mutex::hold hold(&m_build_mtx);
+    *done = 0;
+    *total = 0;
+    *eta_s = 0;
+
+    if (!m_building)
+    {
+        return false;
+    }
+
+    *done = built_bytes();
+    *total = std::max(m_plan.total_bytes(), *done);
+    const uint64_t elapsed = po6::monotonic_time() - m_build_started;
+    const uint64_t rate = *done - std::min(*done, m_build_started_bytes);
+
+    if (rate > 0)
+    {
+        *eta_s = (double(*total - *done) * elapsed / rate) / 1000000000.;
+    }
+
+    return true;
+}
+
 bool
 datalayer :: indexer_thread :: interrupted()
 {
-    ++m_interrupted_count;
-    bool ret = m_interrupted;
+    // may be called from any of the build's threads, so the count and the
+    // cached answer are shared without holding the thread's lock
+    uint64_t count = __sync_add_and_fetch(&m_interrupted_count, 1);
 
-    if (m_interrupted_count % 1000 == 0)
+    if (count % 1000 == 0)
     {
         this->lock();
-        ret = this->is_shutdown();
-        m_interrupted = ret;
+        bool ret = this->is_shutdown();
         this->unlock();
+        e::atomic::store_64_nobarrier(&m_interrupted, ret ? 1 : 0);
+        return ret;
     }
 
+    return e::atomic::load_64_nobarrier(&m_interrupted) != 0;
+}
+
+bool
+datalayer :: indexer_thread :: stopping()
+{
+    this->lock();
+    bool ret = this->is_shutdown();
+    this->unlock();
     return ret;
 }
 
+void
+datalayer :: indexer_thread :: split(const region_id& ri, size_t parts)
+{
+    // carve the region into 256 ranges on the first byte of the key and
+    // group adjacent ranges into parts of roughly equal size
+    const size_t sz = object_prefix_sz(ri);
+    std::vector<char> buf(sz);
+    encode_object_prefix(ri, &buf[0]);
+    const std::string prefix(&buf[0], sz);
+    encode_bump(&buf[0], &buf[0] + sz);
+    const std::string end(&buf[0], sz);
+    std::vector<std::string> bounds;
+    bounds.push_back(prefix);
+
+    for (unsigned b = 1; b < 256; ++b)
+    {
+        bounds.push_back(prefix + char(b));
+    }
+
+    bounds.push_back(end);
+    std::vector<leveldb::Range> ranges(256);
+
+    for (size_t b = 0; b < 256; ++b)
+    {
+        ranges[b].start = bounds[b];
+        ranges[b].limit = bounds[b + 1];
+    }
+
+    std::vector<uint64_t> sizes(256);
+    m_daemon->m_data.m_db->GetApproximateSizes(&ranges[0], 256, &sizes[0]);
+    po6::threads::mutex::hold hold(&m_build_mtx);
+    m_plan.split(bounds, sizes, parts);
+}
+
+void
+datalayer :: indexer_thread :: build_worker()
+{
+    const schema* sc = m_config.get_schema(m_current_region);
+    std::vector<const index*> idxs(1, m_config.get_index(m_current_index));
+
+    while (true)
+    {
+        size_t idx;
+        std::string next;
+        std::string limit;
+
+        {
+            po6::threads::mutex::hold hold(&m_build_mtx);
+
+            if (m_build_failed || !m_plan.claim(&idx, &next, &limit))
+            {
+                return;
+            }
+        }
+
+        if (!build_part(idx, next, limit, sc, idxs))
+        {
+            po6::threads::mutex::hold hold(&m_build_mtx);
+            m_build_failed = true;
+            return;
+        }
+    }
+}
+
+bool
+datalayer :: indexer_thread :: build_part(size_t idx,
+                                          const std::string& next,
+                                          const std::string& limit,
+                                          const schema* sc,
+                                          const std::vector<const index*>& idxs)
+{
+    std::auto_ptr<region_iterator> it(play(m_current_region, sc));
+
+    if (!it.get())
+    {
+        return false;
+    }
+
+    it->restrict(next, limit);
+    leveldb::WriteBatch updates;
+    uint64_t objects = 0;
+
+    while (it->valid())
+    {
+        if (!index_from_iterator(it.get(), sc, m_current_region, idxs, &updates))
+        {
+            return false;
+        }
+
+        it->next();
+        ++objects;
+
+        if (objects % OBJECTS_PER_CHECKPOINT == 0 && it->valid())
+        {
+            if (!checkpoint(idx, it->internal_key(), false, &updates) ||
+                stopping())
+            {
+                return false;
+            }
+
+            m_daemon->m_io.wait(io_scheduler::DISK_WRITE);
+        }
+    }
+
+    return checkpoint(idx, leveldb::Slice(), true, &updates);
+}
+
+bool
+datalayer :: indexer_thread :: checkpoint(size_t idx,
+                                          const leveldb::Slice& next,
+                                          bool done,
+                                          leveldb::WriteBatch* updates)
+{
+    // the progress record is written with the index entries that it covers,
+    // and under the lock so that workers' records are not reordered
+    po6::threads::mutex::hold hold(&m_build_mtx);
+    m_plan.advance(idx, next.ToString(), done);
+    std::string record;
+    m_plan.encode(&record);
+    char buf[sizeof(uint8_t) + 2 * VARINT_64_MAX_SIZE];
+    updates->Put(encode_build_key(m_current_region, m_current_index, buf), record);
+    leveldb::WriteOptions opts;
+    opts.sync = false;
+    leveldb::Status st = m_daemon->m_data.m_db->Write(opts, updates);
+    updates->Clear();
+
+    if (!st.ok())
+    {
+        returncode rc = m_daemon->m_data.handle_error(st);
+        LOG(ERROR) << "error indexing: " << rc;
+        return false;
+    }
+
+    return true;
+}
+
+bool
+datalayer :: indexer_thread :: load_build(const region_id& ri, const index_id& ii)
+{
+    char buf[sizeof(uint8_t) + 2 * VARINT_64_MAX_SIZE];
+    leveldb::Slice key = encode_build_key(ri, ii, buf);
+    std::string record;
+    leveldb::Status st = m_daemon->m_data.m_db->Get(leveldb::ReadOptions(), key, &record);
+
+    if (!st.ok())
+    {
+        return false;
+    }
+
+    po6::threads::mutex::hold hold(&m_build_mtx);
+
+    if (!m_plan.decode(record))
+    {
+        LOG(ERROR) << "discarding unreadable progress of index " << ii
+                   << " on region " << ri;
+        m_plan.clear();
+        return false;
+    }
+
+    LOG(INFO) << "resuming the build of index " << ii << " on region " << ri;
+    return true;
+}
+
+uint64_t
+datalayer :: indexer_thread :: built_bytes()
+{
+    // approximate, in the same units as the total, how much of each part has
+    // been covered
+    const std::vector<index_build_plan::part>& parts(m_plan.parts());
+    std::vector<leveldb::Range> ranges(parts.size());
+
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        ranges[i].start = parts[i].start;
+        ranges[i].limit = parts[i].done ? parts[i].limit : parts[i].next;
+    }
+
+    std::vector<uint64_t> sizes(parts.size());
+
+    if (!ranges.empty())
+    {
+        m_daemon->m_data.m_db->GetApproximateSizes(&ranges[0], ranges.size(), &sizes[0]);
+    }
+
+    uint64_t ret = 0;
+
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        ret += sizes[i];
+    }
+
+    return ret;
+}
+
+void
+datalayer :: indexer_thread :: clear_build()
+{
+    po6::threads::mutex::hold hold(&m_build_mtx);
+    m_plan.clear();
+    m_building = false;
+}
+
 datalayer::region_iterator*
 datalayer :: indexer_thread :: play(const region_id& ri, const schema* sc)
 {
@@ -310,6 +640,7 @@ datalayer :: indexer_thread :: play(const region_id& ri, const schema* sc)
 datalayer::replay_iterator*
 datalayer :: indexer_thread :: replay(const region_id& ri, const std::string& timestamp)
 {
+    uint64_t epoch = m_daemon->m_data.m_vlog->epoch();
     leveldb::ReplayIterator* riip;
     leveldb::Status st = m_daemon->m_data.m_db->GetReplayIterator(timestamp, &riip);
 
@@ -320,8 +651,9 @@ datalayer :: indexer_thread :: replay(const region_id& ri, const std::string& ti
     }
 
     leveldb_replay_iterator_ptr ptr(m_daemon->m_data.m_db, riip);
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    return new replay_iterator(ri, ptr, index_encoding::lookup(sc.attrs[0].type));
+    m_daemon->m_data.m_vlog->track(epoch, ptr);
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    return new replay_iterator(&m_daemon->m_data, ri, ptr, index_encoding::lookup(sc.attrs[0].type));
 }
 
 bool
@@ -333,26 +665,32 @@ datalayer :: indexer_thread :: wipe(const region_id& ri, const index_id& ii)
 bool
 datalayer :: indexer_thread :: wipe_common(uint8_t c, const region_id& ri, const index_id& ii)
 {
-    std::auto_ptr<leveldb::Iterator> it;
-    it.reset(m_daemon->m_data.m_db->NewIterator(leveldb::ReadOptions()));
     char backing[sizeof(uint8_t) + 2 * VARINT_64_MAX_SIZE];
     char* ptr = backing;
     ptr = e::pack8be(c, ptr);
     ptr = e::packvarint64(ri.get(), ptr);
     ptr = e::packvarint64(ii.get(), ptr);
-    leveldb::Slice prefix(backing, ptr - backing);
-    it->Seek(prefix);
+    const std::string start(backing, ptr);
+    encode_bump(backing, ptr);
+    const std::string limit(backing, ptr);
+    std::string next(start);
 
-    while (it->key().starts_with(prefix))
+    do
     {
-        if (interrupted())
+        if (stopping())
         {
             return false;
         }
 
-        m_daemon->m_data.m_db->Delete(leveldb::WriteOptions(), it->key());
-        it->Next();
+        returncode rc = m_daemon->m_data.delete_range(next, limit, &next);
+
+        if (rc != SUCCESS)
+        {
+            LOG(ERROR) << "error indexing: " << rc;
+            return false;
+        }
     }
+    while (!next.empty());
 
     return true;
 }
@@ -361,13 +699,9 @@ bool
 datalayer :: indexer_thread :: index_from_iterator(region_iterator* it,
                                                    const schema* sc,
                                                    const region_id& ri,
-                                                   const std::vector<const index*>& idxs)
+                                                   const std::vector<const index*>& idxs,
+                                                   leveldb::WriteBatch* updates)
 {
-    if (interrupted())
-    {
-        return false;
-    }
-
     e::slice key;
     std::vector<e::slice> value;
     uint64_t version;
@@ -382,20 +716,9 @@ datalayer :: indexer_thread :: index_from_iterator(region_iterator* it,
         return false;
     }
 
-    leveldb::WriteBatch batch;
-    create_index_changes(*sc, ri, idxs, key, NULL, &value, &batch);
-
-    leveldb::WriteOptions opts;
-    opts.sync = false;
-    leveldb::Status st = m_daemon->m_data.m_db->Write(opts, &batch);
-
-    if (!st.ok())
-    {
-        rc = m_daemon->m_data.handle_error(st);
-        LOG(ERROR) << "error indexing: " << rc;
-        return false;
-    }
-
+    create_index_changes(*sc, ri, idxs, key, NULL, &value, updates);
+    m_daemon->m_io.charge(io_scheduler::DISK_READ, key.size() + pack_size(value));
+    m_daemon->m_io.charge(io_scheduler::DISK_WRITE, key.size() + pack_size(value));
     return true;
 }
 
@@ -439,25 +762,15 @@ datalayer :: indexer_thread :: index_from_replay_iterator(replay_iterator* rit,
     std::vector<char> scratch;
     leveldb::Slice lkey;
     encode_key(ri, sc->attrs[0].type, key, &scratch, &lkey);
-    std::string ref2;
+    datalayer::reference ref2;
     leveldb::ReadOptions opts;
     opts.verify_checksums = true;
-    leveldb::Status st = m_daemon->m_data.m_db->Get(opts, lkey, &ref2);
     std::vector<e::slice> _old_value;
+    uint64_t old_version;
+    rc = m_daemon->m_data.read_object(opts, lkey, e::slice(), &_old_value, &old_version, &ref2);
 
-    if (st.ok())
+    if (rc == SUCCESS)
     {
-        uint64_t old_version;
-        rc = decode_value(e::slice(ref2.data(), ref2.size()),
-                          &_old_value, &old_version);
-
-        if (rc != SUCCESS)
-        {
-            rc = m_daemon->m_data.handle_error(st);
-            LOG(ERROR) << "error indexing: " << rc;
-            return false;
-        }
-
         if (_old_value.size() + 1 != sc->attrs_sz)
         {
             LOG(ERROR) << "error indexing: " << BAD_ENCODING;
@@ -466,22 +779,26 @@ datalayer :: indexer_thread :: index_from_replay_iterator(replay_iterator* rit,
 
         old_value = &_old_value;
     }
-    else if (st.IsNotFound())
+    else if (rc == NOT_FOUND)
     {
         old_value = NULL;
     }
     else
     {
-        rc = m_daemon->m_data.handle_error(st);
         LOG(ERROR) << "error indexing: " << rc;
         return false;
     }
 
     leveldb::WriteBatch batch;
     create_index_changes(*sc, ri, idxs, key, old_value, new_value, &batch);
+    uint64_t bytes = key.size()
+                   + (old_value ? pack_size(*old_value) : 0)
+                   + (new_value ? pack_size(*new_value) : 0);
+    m_daemon->m_io.charge(io_scheduler::DISK_READ, bytes);
+    m_daemon->m_io.charge(io_scheduler::DISK_WRITE, bytes);
     leveldb::WriteOptions wopts;
     wopts.sync = false;
-    st = m_daemon->m_data.m_db->Write(wopts, &batch);
+    leveldb::Status st = m_daemon->m_data.m_db->Write(wopts, &batch);
 
     if (!st.ok())
     {
@@ -28,12 +28,20 @@
 #ifndef hyperdex_daemon_datalayer_indexer_h_
 #define hyperdex_daemon_datalayer_indexer_h_
 
+// STL
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
 // HyperDex
 #include "daemon/background_thread.h"
 #include "daemon/datalayer.h"
 #include "daemon/datalayer_encodings.h"
 #include "daemon/datalayer_iterator.h"
 #include "daemon/datalayer_wiper_indexer_mediator.h"
+#include "daemon/index_build_plan.h"
 #include "daemon/index_info.h"
 #include "daemon/leveldb.h"
 
@@ -53,9 +61,29 @@ class hyperdex::datalayer::indexer_thread : public hyperdex::background_thread
         void debug_dump();
         void kick();
         bool mark_usable(const region_id& ri, const index_id& ii);
+        // progress of the build in flight, in approximate on-disk bytes
+        bool progress(uint64_t* done, uint64_t* total, uint64_t* eta_s);
+
+    private:
+        const static size_t MAX_WORKERS = 8;
+        const static size_t PARTS_PER_WORKER = 4;
+        const static uint64_t OBJECTS_PER_CHECKPOINT = 1024;
 
     private:
         bool interrupted();
+        bool stopping();
+        void split(const region_id& ri, size_t parts);
+        void build_worker();
+        bool build_part(size_t idx,
+                        const std::string& next,
+                        const std::string& limit,
+                        const schema* sc,
+                        const std::vector<const index*>& idxs);
+        bool checkpoint(size_t idx, const leveldb::Slice& next, bool done,
+                        leveldb::WriteBatch* updates);
+        bool load_build(const region_id& ri, const index_id& ii);
+        uint64_t built_bytes();
+        void clear_build();
         region_iterator* play(const region_id& ri, const schema* sc);
         replay_iterator* replay(const region_id& ri,
                                 const std::string& timestamp);
@@ -64,7 +92,8 @@ class hyperdex::datalayer::indexer_thread : public hyperdex::background_thread
         bool index_from_iterator(region_iterator* it,
                                  const schema* sc,
                                  const region_id& ri,
-                                 const std::vector<const index*>& idxs);
+                                 const std::vector<const index*>& idxs,
+                                 leveldb::WriteBatch* updates);
         bool index_from_replay_iterator(replay_iterator* rit,
                                         const schema* sc,
                                         const region_id& ri,
@@ -77,8 +106,16 @@ class hyperdex::datalayer::indexer_thread : public hyperdex::background_thread
         bool m_have_current;
         region_id m_current_region;
         index_id m_current_index;
+        // read by the replay pass without the thread's lock
         uint64_t m_interrupted_count;
-        bool m_interrupted;
+        uint64_t m_interrupted;
+        // state of the build shared with the workers
+        po6::threads::mutex m_build_mtx;
+        index_build_plan m_plan;
+        bool m_build_failed;
+        bool m_building;
+        uint64_t m_build_started;
+        uint64_t m_build_started_bytes;
 
     private:
         indexer_thread(const indexer_thread&);
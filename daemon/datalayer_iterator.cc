@@ -27,6 +27,9 @@
 
 #define __STDC_LIMIT_MACROS
 
+// po6
+#include <po6/time.h>
+
 // e
 #include <e/endian.h>
 #include <e/varint.h>
@@ -72,12 +75,63 @@ internal_key_compare(const e::slice& lhs, const e::slice& rhs)
 
 //////////////////////////////// class iterator ////////////////////////////////
 
+class datalayer::iterator::stopwatch
+{
+    public:
+        stopwatch(iterator* it)
+            : m_it(it), m_start(it->m_timed ? po6::monotonic_time() : 0) {}
+        ~stopwatch() throw ()
+        {
+            if (m_it->m_timed)
+            {
+                m_it->m_nanos += po6::monotonic_time() - m_start;
+            }
+        }
+
+    private:
+        stopwatch(const stopwatch&);
+        stopwatch& operator = (const stopwatch&);
+
+    private:
+        iterator* m_it;
+        uint64_t m_start;
+};
+
 datalayer :: iterator :: iterator(leveldb_snapshot_ptr s)
     : m_ref(0)
+    , m_produced(0)
+    , m_rejected(0)
+    , m_seeks(0)
+    , m_bytes_read(0)
+    , m_nanos(0)
+    , m_timed(false)
     , m_snap(s)
 {
 }
 
+std::ostream&
+datalayer :: iterator :: analyze(std::ostream& out, const std::string& indent) const
+{
+    out << indent << *this
+        << " rows=" << m_produced
+        << " rejected=" << m_rejected
+        << " seeks=" << m_seeks
+        << " bytes=" << m_bytes_read;
+
+    if (m_timed)
+    {
+        out << " time=" << m_nanos << "ns";
+    }
+
+    return out << "\n";
+}
+
+void
+datalayer :: iterator :: enable_timing()
+{
+    m_timed = true;
+}
+
 leveldb_snapshot_ptr
 datalayer :: iterator :: snap()
 {
@@ -88,12 +142,30 @@ datalayer :: iterator :: ~iterator() throw ()
 {
 }
 
+void
+datalayer :: iterator :: tally_seek(leveldb::Iterator* it)
+{
+    ++m_seeks;
+    tally_step(it);
+}
+
+void
+datalayer :: iterator :: tally_step(leveldb::Iterator* it)
+{
+    if (it->Valid())
+    {
+        m_bytes_read += it->key().size() + it->value().size();
+    }
+}
+
 ///////////////////////////// class replay_iterator ////////////////////////////
 
-datalayer :: replay_iterator :: replay_iterator(const region_id& ri,
+datalayer :: replay_iterator :: replay_iterator(datalayer* dl,
+                                                const region_id& ri,
                                                 leveldb_replay_iterator_ptr ptr,
                                                 const index_encoding* ie)
-    : m_ri(ri)
+    : m_dl(dl)
+    , m_ri(ri)
     , m_iter(ptr.get())
     , m_ptr(ptr)
     , m_decoded()
@@ -158,6 +230,21 @@ datalayer :: replay_iterator :: key()
     return e::slice(&m_decoded.front(), decoded_sz);
 }
 
+void
+datalayer :: region_iterator :: restrict(const leveldb::Slice& start,
+                                         const leveldb::Slice& limit)
+{
+    m_limit.assign(limit.data(), limit.size());
+    m_iter->Seek(start);
+    tally_seek(m_iter.get());
+}
+
+leveldb::Slice
+datalayer :: region_iterator :: internal_key()
+{
+    return m_iter->key();
+}
+
 datalayer::returncode
 datalayer :: replay_iterator :: unpack_value(std::vector<e::slice>* value,
                                              uint64_t* version,
@@ -165,7 +252,10 @@ datalayer :: replay_iterator :: unpack_value(std::vector<e::slice>* value,
 {
     ref->m_backing.assign(m_iter->value().data(), m_iter->value().size());
     e::slice v(ref->m_backing.data(), ref->m_backing.size());
-    return decode_value(v, value, version);
+    // the replay iterator is tracked by the value log, so every segment it
+    // references remains on disk
+    returncode rc = m_dl->decode_object(v, value, version, ref);
+    return rc == NOT_FOUND ? CORRUPTION : rc;
 }
 
 leveldb::Status
@@ -222,6 +312,7 @@ datalayer :: region_iterator :: region_iterator(leveldb_iterator_ptr iter,
     : iterator(iter.snap())
     , m_iter(iter)
     , m_ri(ri)
+    , m_limit()
     , m_decoded()
     , m_ie(ie)
 {
@@ -230,6 +321,7 @@ datalayer :: region_iterator :: region_iterator(leveldb_iterator_ptr iter,
     ptr = e::pack8be('o', ptr);
     ptr = e::packvarint64(ri.get(), ptr);
     m_iter->Seek(leveldb::Slice(buf, ptr - buf));
+    tally_seek(m_iter.get());
 }
 
 datalayer :: region_iterator :: ~region_iterator() throw ()
@@ -245,6 +337,8 @@ datalayer :: region_iterator :: describe(std::ostream& out) const
 bool
 datalayer :: region_iterator :: valid()
 {
+    stopwatch sw(this);
+
     if (!m_iter->Valid())
     {
         return false;
@@ -264,13 +358,17 @@ datalayer :: region_iterator :: valid()
         return false;
     }
 
-    return region_id(ri) == m_ri;
+    return region_id(ri) == m_ri &&
+           (m_limit.empty() || k.compare(leveldb::Slice(m_limit)) < 0);
 }
 
 void
 datalayer :: region_iterator :: next()
 {
+    stopwatch sw(this);
+    ++m_produced;
     m_iter->Next();
+    tally_step(m_iter.get());
 }
 
 uint64_t
@@ -384,6 +482,7 @@ datalayer :: range_index_iterator :: range_index_iterator(leveldb_snapshot_ptr s
     }
 
     m_iter->Seek(e2level(m_range_lower));
+    tally_seek(m_iter.get());
 }
 
 datalayer :: range_index_iterator :: ~range_index_iterator() throw ()
@@ -393,6 +492,8 @@ datalayer :: range_index_iterator :: ~range_index_iterator() throw ()
 bool
 datalayer :: range_index_iterator :: valid()
 {
+    stopwatch sw(this);
+
     while (!m_invalid && m_iter->Valid())
     {
         if (!m_iter->key().starts_with(e2level(m_prefix)))
@@ -421,13 +522,17 @@ datalayer :: range_index_iterator :: valid()
 
         if (m_has_lower && internal_key_compare(m_value_lower, iv) > 0)
         {
+            ++m_rejected;
             m_iter->Next();
+            tally_step(m_iter.get());
             continue;
         }
 
         if (m_has_upper && internal_key_compare(m_value_upper, iv) < 0)
         {
+            ++m_rejected;
             m_iter->Next();
+            tally_step(m_iter.get());
             continue;
         }
 
@@ -440,7 +545,10 @@ datalayer :: range_index_iterator :: valid()
 void
 datalayer :: range_index_iterator :: next()
 {
+    stopwatch sw(this);
+    ++m_produced;
     m_iter->Next();
+    tally_step(m_iter.get());
 }
 
 uint64_t
@@ -503,12 +611,14 @@ datalayer :: range_index_iterator :: sorted()
 void
 datalayer :: range_index_iterator :: seek(const e::slice& ik)
 {
+    stopwatch sw(this);
     leveldb::Slice in = m_iter->key();
     e::slice v;
     e::slice k;
     decode_entry(level2e(in), &v, &k);
     encode_entry(v, ik, &m_scratch, &k);
     m_iter->Seek(e2level(k));
+    tally_seek(m_iter.get());
 }
 
 bool
@@ -670,6 +780,8 @@ datalayer :: intersect_iterator :: ~intersect_iterator() throw ()
 bool
 datalayer :: intersect_iterator :: valid()
 {
+    stopwatch sw(this);
+
     while (!m_invalid && m_iters[0]->valid())
     {
         bool retry = false;
@@ -689,6 +801,7 @@ datalayer :: intersect_iterator :: valid()
 
             if (cmp < 0)
             {
+                ++m_rejected;
                 m_iters[0]->seek(m_iters[i]->internal_key());
                 retry = true;
                 break;
@@ -710,6 +823,8 @@ datalayer :: intersect_iterator :: valid()
 void
 datalayer :: intersect_iterator :: next()
 {
+    stopwatch sw(this);
+    ++m_produced;
     m_iters[0]->next();
 }
 
@@ -758,9 +873,43 @@ datalayer :: intersect_iterator :: sorted()
 void
 datalayer :: intersect_iterator :: seek(const e::slice& k)
 {
+    stopwatch sw(this);
     return m_iters[0]->seek(k);
 }
 
+std::ostream&
+datalayer :: intersect_iterator :: analyze(std::ostream& out, const std::string& indent) const
+{
+    out << indent << "intersect_iterator"
+        << " rows=" << m_produced
+        << " rejected=" << m_rejected;
+
+    if (m_timed)
+    {
+        out << " time=" << m_nanos << "ns";
+    }
+
+    out << "\n";
+
+    for (size_t i = 0; i < m_iters.size(); ++i)
+    {
+        m_iters[i]->analyze(out, indent + "  ");
+    }
+
+    return out;
+}
+
+void
+datalayer :: intersect_iterator :: enable_timing()
+{
+    iterator::enable_timing();
+
+    for (size_t i = 0; i < m_iters.size(); ++i)
+    {
+        m_iters[i]->enable_timing();
+    }
+}
+
 ///////////////////////////// class search_iterator ////////////////////////////
 
 datalayer :: search_iterator :: search_iterator(datalayer* dl,
@@ -792,6 +941,8 @@ datalayer :: search_iterator :: describe(std::ostream& out) const
 bool
 datalayer :: search_iterator :: valid()
 {
+    stopwatch sw(this);
+
     if (m_error != SUCCESS)
     {
         return false;
@@ -799,7 +950,7 @@ datalayer :: search_iterator :: valid()
 
     // Don't try to optimize by replacing m_ri with a const schema* because it
     // won't persist across reconfigurations
-    const schema& sc(*m_dl->m_daemon->m_config.get_schema(m_ri));
+    const schema& sc(*m_dl->m_daemon->m_config->get_schema(m_ri));
 
     uint64_t version;
     std::vector<e::slice> value;
@@ -814,33 +965,40 @@ datalayer :: search_iterator :: valid()
         std::vector<char> kbacking;
         leveldb::Slice lkey;
         encode_key(m_ri, sc.attrs[0].type, m_iter->key(), &kbacking, &lkey);
-        leveldb::Status st = m_dl->m_db->Get(opts, lkey, &ref.m_backing);
+        datalayer::returncode rc = m_dl->read_object(opts, lkey, e::slice(), &value, &version, &ref);
+        ++m_seeks;
 
-        if (st.ok())
+        if (rc == SUCCESS)
         {
-            e::slice v(ref.m_backing.data(), ref.m_backing.size());
-            datalayer::returncode rc = decode_value(v, &value, &version);
+            ++m_num_gets;
+            m_bytes_read += lkey.size();
 
-            if (rc != SUCCESS)
+            for (size_t i = 0; i < value.size(); ++i)
             {
-                m_error = rc;
-                return false;
+                m_bytes_read += value[i].size();
             }
-
-            ++m_num_gets;
         }
         else
         {
-            m_error = m_dl->handle_error(st);
+            m_error = rc;
             return false;
         }
 
+        // truncated, but the wiper has yet to delete it
+        if (version < m_dl->m_daemon->m_repl.truncated_before(m_ri, m_iter->key()))
+        {
+            ++m_rejected;
+            m_iter->next();
+            continue;
+        }
+
         if (passes_attribute_checks(sc, *m_checks, m_iter->key(), value) == m_checks->size())
         {
             return true;
         }
         else
         {
+            ++m_rejected;
             m_iter->next();
         }
     }
@@ -852,6 +1010,8 @@ datalayer :: search_iterator :: valid()
 void
 datalayer :: search_iterator :: next()
 {
+    stopwatch sw(this);
+    ++m_produced;
     m_iter->next();
 }
 
@@ -866,3 +1026,28 @@ datalayer :: search_iterator :: key()
 {
     return m_iter->key();
 }
+
+std::ostream&
+datalayer :: search_iterator :: analyze(std::ostream& out, const std::string& indent) const
+{
+    out << indent << "search_iterator"
+        << " rows=" << m_produced
+        << " rejected=" << m_rejected
+        << " seeks=" << m_seeks
+        << " bytes=" << m_bytes_read;
+
+    if (m_timed)
+    {
+        out << " time=" << m_nanos << "ns";
+    }
+
+    out << "\n";
+    return m_iter->analyze(out, indent + "  ");
+}
+
+void
+datalayer :: search_iterator :: enable_timing()
+{
+    iterator::enable_timing();
+    m_iter->enable_timing();
+}
@@ -51,6 +51,13 @@ class datalayer::iterator
         // REQUIRES: valid
         virtual e::slice key() = 0;
         virtual std::ostream& describe(std::ostream&) const = 0;
+        // write the runtime statistics of this iterator and those it wraps,
+        // one line per iterator
+        virtual std::ostream& analyze(std::ostream&, const std::string& indent) const;
+        // time every call into this iterator and those it wraps
+        virtual void enable_timing();
+        // objects this iterator examined, whether or not it handed them out
+        uint64_t rows_examined() const { return m_produced + m_rejected; }
 
     public:
         leveldb_snapshot_ptr snap();
@@ -62,6 +69,24 @@ class datalayer::iterator
         void dec() { --m_ref; if (m_ref == 0) delete this; }
         size_t m_ref;
 
+    protected:
+        class stopwatch;
+        // count a LevelDB seek and whatever it landed on
+        void tally_seek(leveldb::Iterator* it);
+        // count a LevelDB step and whatever it landed on
+        void tally_step(leveldb::Iterator* it);
+        // rows handed to the caller
+        uint64_t m_produced;
+        // rows examined and skipped by this iterator
+        uint64_t m_rejected;
+        // LevelDB seeks and point reads
+        uint64_t m_seeks;
+        // key and value bytes read from LevelDB
+        uint64_t m_bytes_read;
+        // time spent within this iterator, including those it wraps
+        uint64_t m_nanos;
+        bool m_timed;
+
     private:
         leveldb_snapshot_ptr m_snap;
 };
@@ -69,7 +94,7 @@ class datalayer::iterator
 class datalayer::replay_iterator
 {
     public:
-        replay_iterator(const region_id& ri, leveldb_replay_iterator_ptr ptr, const index_encoding* ie);
+        replay_iterator(datalayer* dl, const region_id& ri, leveldb_replay_iterator_ptr ptr, const index_encoding* ie);
 
     public:
         bool valid();
@@ -82,6 +107,7 @@ class datalayer::replay_iterator
         leveldb::Status status();
 
     private:
+        datalayer* m_dl;
         region_id m_ri;
         leveldb::ReplayIterator* m_iter;
         leveldb_replay_iterator_ptr m_ptr;
@@ -124,6 +150,12 @@ class datalayer::region_iterator : public iterator
         virtual e::slice key();
         virtual std::ostream& describe(std::ostream&) const;
 
+    public:
+        // confine the iterator to encoded keys in [start, limit); an empty
+        // limit extends to the end of the region
+        void restrict(const leveldb::Slice& start, const leveldb::Slice& limit);
+        leveldb::Slice internal_key();
+
     private:
         region_iterator(const region_iterator&);
         region_iterator& operator = (const region_iterator&);
@@ -131,6 +163,7 @@ class datalayer::region_iterator : public iterator
     private:
         leveldb_iterator_ptr m_iter;
         region_id m_ri;
+        std::string m_limit;
         std::vector<char> m_decoded;
         const index_encoding *const m_ie;
 };
@@ -217,6 +250,8 @@ class datalayer::intersect_iterator : public index_iterator
         virtual e::slice internal_key();
         virtual bool sorted();
         virtual void seek(const e::slice& internal_key);
+        virtual std::ostream& analyze(std::ostream&, const std::string& indent) const;
+        virtual void enable_timing();
 
     private:
         std::vector<e::intrusive_ptr<index_iterator> > m_iters;
@@ -240,6 +275,8 @@ class datalayer::search_iterator : public iterator
         virtual uint64_t cost(leveldb::DB*);
         virtual e::slice key();
         virtual std::ostream& describe(std::ostream&) const;
+        virtual std::ostream& analyze(std::ostream&, const std::string& indent) const;
+        virtual void enable_timing();
 
     private:
         search_iterator(const search_iterator&);
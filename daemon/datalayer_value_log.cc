@@ -0,0 +1,946 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// POSIX
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// STL
+#include <algorithm>
+
+// Google Log
+#include <glog/logging.h>
+
+// po6
+#include <po6/path.h>
+
+// e
+#include <e/endian.h>
+
+// HyperDex
+#include "cityhash/city.h"
+#include "daemon/datalayer_value_log.h"
+
+using hyperdex::datalayer;
+
+#define RECORD_HEADER_SIZE (2 * sizeof(uint32_t) + sizeof(uint16_t))
+
+namespace
+{
+
+bool
+pread_fully(int fd, char* buf, size_t sz, uint64_t off)
+{
+    while (sz > 0)
+    {
+        ssize_t ret = pread(fd, buf, sz, off);
+
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (ret <= 0)
+        {
+            return false;
+        }
+
+        buf += ret;
+        sz -= ret;
+        off += ret;
+    }
+
+    return true;
+}
+
+bool
+pwrite_fully(int fd, const char* buf, size_t sz, uint64_t off)
+{
+    while (sz > 0)
+    {
+        ssize_t ret = pwrite(fd, buf, sz, off);
+
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (ret <= 0)
+        {
+            return false;
+        }
+
+        buf += ret;
+        sz -= ret;
+        off += ret;
+    }
+
+    return true;
+}
+
+bool
+parse_segment_name(const char* name, uint64_t* segment)
+{
+    size_t len = strlen(name);
+
+    if (len != 21 || strcmp(name + 16, ".vlog") != 0)
+    {
+        return false;
+    }
+
+    char* end = NULL;
+    *segment = strtoull(name, &end, 16);
+    return end == name + 16 && *segment > 0;
+}
+
+} // namespace
+
+void
+hyperdex :: encode_value_pointer(uint64_t segment,
+                                 uint64_t offset,
+                                 uint32_t length,
+                                 char* out)
+{
+    char* ptr = out;
+    ptr = e::pack64be(segment, ptr);
+    ptr = e::pack64be(offset, ptr);
+    ptr = e::pack32be(length, ptr);
+}
+
+bool
+hyperdex :: decode_value_pointer(const e::slice& in,
+                                 uint64_t* segment,
+                                 uint64_t* offset,
+                                 uint32_t* length)
+{
+    if (in.size() != VALUE_POINTER_SIZE)
+    {
+        return false;
+    }
+
+    const uint8_t* ptr = in.data();
+    ptr = e::unpack64be(ptr, segment);
+    ptr = e::unpack64be(ptr, offset);
+    ptr = e::unpack32be(ptr, length);
+    return true;
+}
+
+const size_t datalayer::value_log::STRIPES;
+const uint64_t datalayer::value_log::SEGMENT_SIZE;
+const uint64_t datalayer::value_log::RESCAN_DISTANCE;
+
+datalayer :: value_log :: segment :: segment()
+    : fd()
+    , size(0)
+    , pending(0)
+    , sealed(false)
+    , dirty(false)
+    , retired(false)
+    , retired_epoch(0)
+    , retired_timestamp()
+    , scanned_at(0)
+    , live(0)
+{
+}
+
+datalayer :: value_log :: segment :: ~segment() throw ()
+{
+}
+
+datalayer :: value_log :: value_log()
+    : m_base()
+    , m_path()
+    , m_db()
+    , m_threshold(0)
+    , m_in_use(false)
+    , m_protect()
+    , m_segments()
+    , m_head(0)
+    , m_epoch(0)
+    , m_gc_timestamp()
+    , m_synced(&m_protect)
+    , m_syncing(false)
+    , m_sync_started(0)
+    , m_sync_finished(0)
+    , m_sync_failed(0)
+    , m_snapshots()
+    , m_replays()
+{
+}
+
+datalayer :: value_log :: ~value_log() throw ()
+{
+}
+
+bool
+datalayer :: value_log :: open(const std::string& path,
+                               leveldb_db_ptr db,
+                               uint64_t threshold)
+{
+    std::string real;
+
+    if (!po6::path::realpath(path, &real))
+    {
+        PLOG(ERROR) << "could not resolve the data directory";
+        return false;
+    }
+
+    po6::threads::mutex::hold hold(&m_protect);
+    m_base = real;
+    m_path = po6::path::join(real, "vlog");
+    m_db = db;
+    m_threshold = threshold;
+    struct stat st;
+
+    if (stat(m_path.c_str(), &st) < 0)
+    {
+        if (errno != ENOENT)
+        {
+            PLOG(ERROR) << "could not stat the value log directory";
+            return false;
+        }
+
+        if (m_threshold == 0)
+        {
+            m_in_use = false;
+            return true;
+        }
+
+        if (mkdir(m_path.c_str(), S_IRWXU) < 0)
+        {
+            PLOG(ERROR) << "could not create the value log directory";
+            return false;
+        }
+    }
+
+    DIR* dir = opendir(m_path.c_str());
+
+    if (!dir)
+    {
+        PLOG(ERROR) << "could not open the value log directory";
+        return false;
+    }
+
+    struct dirent* ent = NULL;
+
+    while ((ent = readdir(dir)))
+    {
+        uint64_t id = 0;
+
+        if (!parse_segment_name(ent->d_name, &id))
+        {
+            continue;
+        }
+
+        e::compat::shared_ptr<po6::io::fd> fd(new po6::io::fd(::open(segment_path(id).c_str(), O_RDONLY)));
+
+        if (fd->get() < 0 || fstat(fd->get(), &st) < 0)
+        {
+            PLOG(ERROR) << "could not open value log segment " << segment_path(id);
+            closedir(dir);
+            return false;
+        }
+
+        segment* s = &m_segments[id];
+        s->fd = fd;
+        s->size = st.st_size;
+        s->sealed = true;
+        m_head = std::max(m_head, id);
+    }
+
+    closedir(dir);
+
+    if (m_threshold > 0 && !roll())
+    {
+        return false;
+    }
+
+    m_in_use = !m_segments.empty();
+    LOG(INFO) << "value log has " << m_segments.size() << " segments"
+              << " and separates values of " << m_threshold << " bytes or more"
+              << (m_threshold == 0 ? " (disabled)" : "");
+    return true;
+}
+
+void
+datalayer :: value_log :: close()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    m_snapshots.clear();
+    m_replays.clear();
+    m_segments.clear();
+    m_db.reset();
+}
+
+datalayer::returncode
+datalayer :: value_log :: append(const leveldb::Slice& lkey, uint16_t attr,
+                                 const e::slice& value,
+                                 char* pointer)
+{
+    const uint64_t rec_sz = RECORD_HEADER_SIZE + lkey.size() + value.size();
+    e::compat::shared_ptr<po6::io::fd> fd;
+    uint64_t id = 0;
+    uint64_t off = 0;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect);
+        segment_map_t::iterator it = m_segments.find(m_head);
+
+        if (it == m_segments.end() || it->second.sealed ||
+            (it->second.size > 0 && it->second.size + rec_sz > SEGMENT_SIZE))
+        {
+            if (!roll())
+            {
+                return IO_ERROR;
+            }
+
+            it = m_segments.find(m_head);
+            assert(it != m_segments.end());
+        }
+
+        id = it->first;
+        off = it->second.size;
+        fd = it->second.fd;
+        it->second.size += rec_sz;
+        ++it->second.pending;
+    }
+
+    std::vector<char> header(RECORD_HEADER_SIZE + lkey.size());
+    char* ptr = &header.front();
+    ptr = e::pack32be(lkey.size(), ptr);
+    ptr = e::pack16be(attr, ptr);
+    ptr = e::pack32be(value.size(), ptr);
+    memmove(ptr, lkey.data(), lkey.size());
+    bool ok = pwrite_fully(fd->get(), &header.front(), header.size(), off) &&
+              pwrite_fully(fd->get(), reinterpret_cast<const char*>(value.data()),
+                           value.size(), off + header.size());
+
+    {
+        po6::threads::mutex::hold hold(&m_protect);
+        segment_map_t::iterator it = m_segments.find(id);
+        assert(it != m_segments.end());
+        assert(it->second.pending > 0);
+        --it->second.pending;
+        it->second.dirty = it->second.dirty || ok;
+    }
+
+    if (!ok)
+    {
+        PLOG(ERROR) << "could not append to value log segment " << segment_path(id);
+        return IO_ERROR;
+    }
+
+    encode_value_pointer(id, off + header.size(), value.size(), pointer);
+    return SUCCESS;
+}
+
+datalayer::returncode
+datalayer :: value_log :: sync()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    // any sync that starts from here on covers every append completed so far
+    const uint64_t ticket = m_sync_started + 1;
+
+    while (m_sync_finished < ticket)
+    {
+        if (m_syncing)
+        {
+            m_synced.wait();
+            continue;
+        }
+
+        m_syncing = true;
+        const uint64_t generation = ++m_sync_started;
+        std::vector<std::pair<uint64_t, e::compat::shared_ptr<po6::io::fd> > > dirty;
+
+        for (segment_map_t::iterator it = m_segments.begin();
+                it != m_segments.end(); ++it)
+        {
+            if (it->second.dirty)
+            {
+                dirty.push_back(std::make_pair(it->first, it->second.fd));
+                it->second.dirty = false;
+            }
+        }
+
+        m_protect.unlock();
+        std::vector<uint64_t> failed;
+
+        for (size_t i = 0; i < dirty.size(); ++i)
+        {
+            if (fdatasync(dirty[i].second->get()) < 0)
+            {
+                PLOG(ERROR) << "could not sync value log segment " << segment_path(dirty[i].first);
+                failed.push_back(dirty[i].first);
+            }
+        }
+
+        m_protect.lock();
+
+        for (size_t i = 0; i < failed.size(); ++i)
+        {
+            segment_map_t::iterator it = m_segments.find(failed[i]);
+
+            if (it != m_segments.end())
+            {
+                it->second.dirty = true;
+            }
+        }
+
+        if (!failed.empty())
+        {
+            m_sync_failed = generation;
+        }
+
+        m_sync_finished = generation;
+        m_syncing = false;
+        m_synced.broadcast();
+    }
+
+    return m_sync_failed >= ticket ? IO_ERROR : SUCCESS;
+}
+
+datalayer::returncode
+datalayer :: value_log :: read(const e::slice& pointer, char* out)
+{
+    uint64_t id;
+    uint64_t off;
+    uint32_t len;
+
+    if (!decode_value_pointer(pointer, &id, &off, &len))
+    {
+        return BAD_ENCODING;
+    }
+
+    uint64_t size = 0;
+    e::compat::shared_ptr<po6::io::fd> fd = segment_fd(id, &size);
+
+    if (!fd)
+    {
+        return NOT_FOUND;
+    }
+
+    if (off + len > size)
+    {
+        LOG(ERROR) << "value log pointer " << id << ":" << off << ":" << len
+                   << " is beyond the end of the segment";
+        return CORRUPTION;
+    }
+
+    if (!pread_fully(fd->get(), out, len, off))
+    {
+        PLOG(ERROR) << "could not read from value log segment " << segment_path(id);
+        return IO_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+bool
+datalayer :: value_log :: backup(const std::string& name)
+{
+    std::string dir(po6::path::join(po6::path::join(m_base, "backup-" + name), "vlog"));
+    std::vector<uint64_t> ids;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect);
+
+        if (!m_in_use)
+        {
+            return true;
+        }
+
+        // LevelDB's backup is already on disk, so everything it references is
+        // in a segment below the new head
+        if (m_threshold > 0 && !roll())
+        {
+            return false;
+        }
+
+        for (segment_map_t::iterator it = m_segments.begin();
+                it != m_segments.end(); ++it)
+        {
+            if (it->first != m_head || it->second.sealed)
+            {
+                ids.push_back(it->first);
+            }
+        }
+    }
+
+    if (mkdir(dir.c_str(), S_IRWXU) < 0 && errno != EEXIST)
+    {
+        PLOG(ERROR) << "could not create value log backup directory " << dir;
+        return false;
+    }
+
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        std::string src(segment_path(ids[i]));
+        std::string dst(po6::path::join(dir, po6::path::basename(src)));
+
+        if (link(src.c_str(), dst.c_str()) < 0 && errno != EEXIST)
+        {
+            PLOG(ERROR) << "could not link value log segment " << src << " into backup";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+datalayer :: value_log :: debug_dump()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    LOG(INFO) << "value log =====================================================================";
+    LOG(INFO) << "path=" << m_path;
+    LOG(INFO) << "threshold=" << m_threshold;
+    LOG(INFO) << "head=" << m_head;
+    LOG(INFO) << "epoch=" << m_epoch;
+    LOG(INFO) << "gc_timestamp=" << m_gc_timestamp;
+    LOG(INFO) << "tracked snapshots=" << m_snapshots.size()
+              << " replay iterators=" << m_replays.size();
+
+    for (segment_map_t::iterator it = m_segments.begin();
+            it != m_segments.end(); ++it)
+    {
+        LOG(INFO) << "segment " << it->first
+                  << " size=" << it->second.size
+                  << " pending=" << it->second.pending
+                  << " sealed=" << (it->second.sealed ? "yes" : "no")
+                  << " retired=" << (it->second.retired ? "yes" : "no")
+                  << " scanned_at=" << it->second.scanned_at
+                  << " live=" << it->second.live;
+    }
+}
+
+uint64_t
+datalayer :: value_log :: segments()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    return m_segments.size();
+}
+
+uint64_t
+datalayer :: value_log :: bytes()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    uint64_t ret = 0;
+
+    for (segment_map_t::iterator it = m_segments.begin();
+            it != m_segments.end(); ++it)
+    {
+        ret += it->second.size;
+    }
+
+    return ret;
+}
+
+uint64_t
+datalayer :: value_log :: epoch()
+{
+    if (!m_in_use)
+    {
+        return 0;
+    }
+
+    po6::threads::mutex::hold hold(&m_protect);
+    return m_epoch;
+}
+
+void
+datalayer :: value_log :: track(uint64_t e, const leveldb_snapshot_ptr& snap)
+{
+    if (!m_in_use)
+    {
+        return;
+    }
+
+    po6::threads::mutex::hold hold(&m_protect);
+    prune_tracked();
+    m_snapshots.push_back(std::make_pair(e, snap));
+}
+
+void
+datalayer :: value_log :: track(uint64_t e, const leveldb_replay_iterator_ptr& iter)
+{
+    if (!m_in_use)
+    {
+        return;
+    }
+
+    po6::threads::mutex::hold hold(&m_protect);
+    prune_tracked();
+    m_replays.push_back(std::make_pair(e, iter));
+}
+
+void
+datalayer :: value_log :: allow_collect_before(const std::string& timestamp)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    m_gc_timestamp = timestamp;
+}
+
+bool
+datalayer :: value_log :: next_candidate(uint64_t* id)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    // rescan each segment about once per full turn of the log
+    const uint64_t distance = std::max(RESCAN_DISTANCE, uint64_t(m_segments.size()));
+
+    for (segment_map_t::iterator it = m_segments.begin();
+            it != m_segments.end(); ++it)
+    {
+        segment* s = &it->second;
+
+        if (!s->sealed || s->retired || s->pending > 0)
+        {
+            continue;
+        }
+
+        if (s->scanned_at == 0 || m_head - s->scanned_at >= distance)
+        {
+            *id = it->first;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+datalayer :: value_log :: set_liveness(uint64_t id, uint64_t live, uint64_t)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    segment_map_t::iterator it = m_segments.find(id);
+
+    if (it != m_segments.end())
+    {
+        it->second.scanned_at = m_head;
+        it->second.live = live;
+    }
+}
+
+void
+datalayer :: value_log :: retire(uint64_t id)
+{
+    // every live record has been rewritten, so the timestamp taken here is
+    // past the last write that references this segment
+    std::string timestamp;
+    m_db->GetReplayTimestamp(&timestamp);
+    po6::threads::mutex::hold hold(&m_protect);
+    segment_map_t::iterator it = m_segments.find(id);
+
+    if (it != m_segments.end())
+    {
+        it->second.retired = true;
+        it->second.retired_epoch = ++m_epoch;
+        it->second.retired_timestamp = timestamp;
+    }
+}
+
+size_t
+datalayer :: value_log :: unlink_retired()
+{
+    std::vector<uint64_t> ids;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect);
+        prune_tracked();
+        const uint64_t oldest = oldest_tracked_epoch();
+        const bool gc_all = m_gc_timestamp == "now";
+        const bool gc_some = !gc_all && !m_gc_timestamp.empty() &&
+                             m_db->ValidateTimestamp(m_gc_timestamp);
+        segment_map_t::iterator it = m_segments.begin();
+
+        while (it != m_segments.end())
+        {
+            segment* s = &it->second;
+
+            if (s->retired && oldest >= s->retired_epoch &&
+                (gc_all || (gc_some && m_db->CompareTimestamps(s->retired_timestamp, m_gc_timestamp) <= 0)))
+            {
+                ids.push_back(it->first);
+                m_segments.erase(it++);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    // readers that still hold the fd may finish; new readers see NOT_FOUND
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        if (unlink(segment_path(ids[i]).c_str()) < 0)
+        {
+            PLOG(ERROR) << "could not unlink value log segment " << segment_path(ids[i]);
+        }
+    }
+
+    return ids.size();
+}
+
+e::compat::shared_ptr<po6::io::fd>
+datalayer :: value_log :: segment_fd(uint64_t id, uint64_t* size)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    segment_map_t::iterator it = m_segments.find(id);
+
+    if (it == m_segments.end())
+    {
+        return e::compat::shared_ptr<po6::io::fd>();
+    }
+
+    *size = it->second.size;
+    return it->second.fd;
+}
+
+std::string
+datalayer :: value_log :: segment_path(uint64_t id)
+{
+    char buf[32];
+    sprintf(buf, "%016llx.vlog", static_cast<unsigned long long>(id));
+    return po6::path::join(m_path, buf);
+}
+
+bool
+datalayer :: value_log :: roll()
+{
+    segment_map_t::iterator it = m_segments.find(m_head);
+
+    if (it != m_segments.end())
+    {
+        it->second.sealed = true;
+    }
+
+    uint64_t id = m_head + 1;
+    std::string path(segment_path(id));
+    e::compat::shared_ptr<po6::io::fd> fd(new po6::io::fd(::open(path.c_str(), O_RDWR|O_CREAT|O_EXCL, S_IRUSR|S_IWUSR)));
+
+    if (fd->get() < 0)
+    {
+        PLOG(ERROR) << "could not create value log segment " << path;
+        return false;
+    }
+
+    // sync() only covers the segment's contents, so make its name durable now
+    po6::io::fd dir(::open(m_path.c_str(), O_RDONLY));
+
+    if (dir.get() < 0 || fsync(dir.get()) < 0)
+    {
+        PLOG(ERROR) << "could not sync the value log directory";
+        unlink(path.c_str());
+        return false;
+    }
+
+    segment* s = &m_segments[id];
+    s->fd = fd;
+    m_head = id;
+    m_in_use = true;
+    return true;
+}
+
+void
+datalayer :: value_log :: prune_tracked()
+{
+    // an entry that only we reference has been released by its user
+    snapshot_list_t::iterator sit = m_snapshots.begin();
+
+    while (sit != m_snapshots.end())
+    {
+        if (sit->second.use_count() <= 1)
+        {
+            sit = m_snapshots.erase(sit);
+        }
+        else
+        {
+            ++sit;
+        }
+    }
+
+    replay_list_t::iterator rit = m_replays.begin();
+
+    while (rit != m_replays.end())
+    {
+        if (rit->second.use_count() <= 1)
+        {
+            rit = m_replays.erase(rit);
+        }
+        else
+        {
+            ++rit;
+        }
+    }
+}
+
+uint64_t
+datalayer :: value_log :: oldest_tracked_epoch()
+{
+    // entries are appended in epoch order
+    uint64_t oldest = UINT64_MAX;
+
+    if (!m_snapshots.empty())
+    {
+        oldest = std::min(oldest, m_snapshots.front().first);
+    }
+
+    if (!m_replays.empty())
+    {
+        oldest = std::min(oldest, m_replays.front().first);
+    }
+
+    return oldest;
+}
+
+po6::threads::mutex*
+datalayer :: value_log :: stripe(const leveldb::Slice& lkey)
+{
+    uint64_t h = CityHash64(lkey.data(), lkey.size());
+    return &m_stripes[h & (STRIPES - 1)];
+}
+
+datalayer :: value_log :: hold :: hold(value_log* vl, const leveldb::Slice& lkey)
+    : m_mtx(vl->in_use() ? vl->stripe(lkey) : NULL)
+{
+    if (m_mtx)
+    {
+        m_mtx->lock();
+    }
+}
+
+datalayer :: value_log :: hold :: ~hold() throw ()
+{
+    if (m_mtx)
+    {
+        m_mtx->unlock();
+    }
+}
+
+datalayer :: value_log :: segment_reader :: segment_reader(value_log* vl, uint64_t id)
+    : m_fd()
+    , m_size(0)
+    , m_offset(0)
+    , m_have(false)
+    , m_error(false)
+    , m_key()
+    , m_attr(0)
+    , m_value_offset(0)
+    , m_value_size(0)
+{
+    m_fd = vl->segment_fd(id, &m_size);
+    m_error = !m_fd;
+
+    if (m_fd)
+    {
+        m_have = read_record();
+    }
+}
+
+datalayer :: value_log :: segment_reader :: ~segment_reader() throw ()
+{
+}
+
+bool
+datalayer :: value_log :: segment_reader :: valid()
+{
+    return m_have && !m_error;
+}
+
+void
+datalayer :: value_log :: segment_reader :: next()
+{
+    m_offset += record_size();
+    m_have = read_record();
+}
+
+leveldb::Slice
+datalayer :: value_log :: segment_reader :: key() const
+{
+    return leveldb::Slice(m_key.empty() ? NULL : &m_key.front(), m_key.size());
+}
+
+uint64_t
+datalayer :: value_log :: segment_reader :: record_size() const
+{
+    return RECORD_HEADER_SIZE + m_key.size() + m_value_size;
+}
+
+bool
+datalayer :: value_log :: segment_reader :: read_record()
+{
+    if (m_offset == m_size)
+    {
+        return false;
+    }
+
+    char header[RECORD_HEADER_SIZE];
+    uint32_t key_sz = 0;
+
+    if (m_offset + RECORD_HEADER_SIZE > m_size ||
+        !pread_fully(m_fd->get(), header, RECORD_HEADER_SIZE, m_offset))
+    {
+        m_error = true;
+        return false;
+    }
+
+    const char* ptr = header;
+    ptr = e::unpack32be(ptr, &key_sz);
+    ptr = e::unpack16be(ptr, &m_attr);
+    ptr = e::unpack32be(ptr, &m_value_size);
+
+    if (key_sz == 0 ||
+        m_offset + RECORD_HEADER_SIZE + key_sz + m_value_size > m_size)
+    {
+        m_error = true;
+        return false;
+    }
+
+    m_key.resize(key_sz);
+
+    if (!pread_fully(m_fd->get(), &m_key.front(), key_sz, m_offset + RECORD_HEADER_SIZE))
+    {
+        m_error = true;
+        return false;
+    }
+
+    m_value_offset = m_offset + RECORD_HEADER_SIZE + key_sz;
+    return true;
+}
@@ -0,0 +1,245 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_daemon_datalayer_value_log_h_
+#define hyperdex_daemon_datalayer_value_log_h_
+
+// STL
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/io/fd.h>
+#include <po6/threads/cond.h>
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/compat.h>
+#include <e/slice.h>
+
+// HyperDex
+#include "daemon/datalayer.h"
+#include "daemon/leveldb.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// Pointers into the value log
+#define VALUE_POINTER_SIZE (2 * sizeof(uint64_t) + sizeof(uint32_t))
+void
+encode_value_pointer(uint64_t segment,
+                     uint64_t offset,
+                     uint32_t length,
+                     char* out);
+bool
+decode_value_pointer(const e::slice& in,
+                     uint64_t* segment,
+                     uint64_t* offset,
+                     uint32_t* length);
+
+END_HYPERDEX_NAMESPACE
+
+// The value log holds attribute values that are too large to be cheaply
+// rewritten by every LevelDB compaction.  Values are appended to immutable
+// segment files and LevelDB stores a pointer in place of the value.
+//
+// Each record in a segment is:
+//      key size (4B) | attr (2B) | value size (4B) | LevelDB key | value
+// and pointers refer to the value portion of the record directly.
+//
+// Appends are not durable on their own.  Callers must sync() after appending
+// and before the LevelDB write carrying the pointer is issued, so that no
+// durable pointer can ever refer to bytes that were lost in a crash.
+// Concurrent callers share a single fdatasync per segment.
+//
+// Segments are reclaimed by the value_log_gc_thread, which moves live records
+// to the head of the log and then retires the segment.  A retired segment is
+// only unlinked once no snapshot or replay iterator that predates its
+// retirement remains, and the checkpointer has allowed LevelDB to collect
+// every replay timestamp that could still reference it.
+
+class hyperdex::datalayer::value_log
+{
+    public:
+        class hold;
+        class segment_reader;
+        // must be pow2
+        const static size_t STRIPES = 256;
+
+    public:
+        value_log();
+        ~value_log() throw ();
+
+    public:
+        bool open(const std::string& path,
+                  leveldb_db_ptr db,
+                  uint64_t threshold);
+        void close();
+        // true if the value log has segments or may write them
+        bool in_use() const { return m_in_use; }
+        bool should_separate(size_t sz) const
+        { return m_threshold > 0 && sz >= m_threshold; }
+        returncode append(const leveldb::Slice& lkey, uint16_t attr,
+                          const e::slice& value,
+                          char* pointer /*VALUE_POINTER_SIZE*/);
+        // make every completed append durable
+        returncode sync();
+        // read the value into out, which must be large enough; returns
+        // NOT_FOUND if the segment has been unlinked
+        returncode read(const e::slice& pointer, char* out);
+        // link the segments into the LevelDB backup with the given name
+        bool backup(const std::string& name);
+        void debug_dump();
+        // stats
+        uint64_t segments();
+        uint64_t bytes();
+
+    public:
+        // Track objects that may read old pointers.  The epoch must be read
+        // before the LevelDB object is created.
+        uint64_t epoch();
+        void track(uint64_t epoch, const leveldb_snapshot_ptr& snap);
+        void track(uint64_t epoch, const leveldb_replay_iterator_ptr& iter);
+        // called by the checkpointer when LevelDB may collect history
+        void allow_collect_before(const std::string& timestamp);
+        // garbage collection
+        bool next_candidate(uint64_t* segment);
+        void set_liveness(uint64_t segment, uint64_t live, uint64_t total);
+        void retire(uint64_t segment);
+        size_t unlink_retired();
+        e::compat::shared_ptr<po6::io::fd> segment_fd(uint64_t segment,
+                                                      uint64_t* size);
+
+    private:
+        struct segment
+        {
+            segment();
+            ~segment() throw ();
+            e::compat::shared_ptr<po6::io::fd> fd;
+            uint64_t size;
+            uint64_t pending;
+            bool sealed;
+            bool dirty;
+            bool retired;
+            uint64_t retired_epoch;
+            std::string retired_timestamp;
+            uint64_t scanned_at;
+            uint64_t live;
+        };
+        typedef std::map<uint64_t, segment> segment_map_t;
+        typedef std::list<std::pair<uint64_t, leveldb_snapshot_ptr> > snapshot_list_t;
+        typedef std::list<std::pair<uint64_t, leveldb_replay_iterator_ptr> > replay_list_t;
+        const static uint64_t SEGMENT_SIZE = 64ULL * 1024ULL * 1024ULL;
+        const static uint64_t RESCAN_DISTANCE = 4;
+
+    private:
+        std::string segment_path(uint64_t segment);
+        bool roll(); // call with m_protect held
+        void prune_tracked(); // call with m_protect held
+        uint64_t oldest_tracked_epoch(); // call with m_protect held
+        po6::threads::mutex* stripe(const leveldb::Slice& lkey);
+
+    private:
+        std::string m_base;
+        std::string m_path;
+        leveldb_db_ptr m_db;
+        uint64_t m_threshold;
+        bool m_in_use;
+        po6::threads::mutex m_protect;
+        segment_map_t m_segments;
+        uint64_t m_head;
+        uint64_t m_epoch;
+        std::string m_gc_timestamp;
+        po6::threads::cond m_synced;
+        bool m_syncing;
+        uint64_t m_sync_started;
+        uint64_t m_sync_finished;
+        uint64_t m_sync_failed;
+        snapshot_list_t m_snapshots;
+        replay_list_t m_replays;
+        po6::threads::mutex m_stripes[STRIPES];
+
+    private:
+        value_log(const value_log&);
+        value_log& operator = (const value_log&);
+};
+
+// Writers hold the stripe for a key across the LevelDB write so that the
+// garbage collector never overwrites a newer value with a relocated pointer.
+class hyperdex::datalayer::value_log::hold
+{
+    public:
+        hold(value_log* vl, const leveldb::Slice& lkey);
+        ~hold() throw ();
+
+    private:
+        po6::threads::mutex* m_mtx;
+
+    private:
+        hold(const hold&);
+        hold& operator = (const hold&);
+};
+
+class hyperdex::datalayer::value_log::segment_reader
+{
+    public:
+        segment_reader(value_log* vl, uint64_t segment);
+        ~segment_reader() throw ();
+
+    public:
+        bool valid();
+        void next();
+        bool error() const { return m_error; }
+        // REQUIRES: valid
+        leveldb::Slice key() const;
+        uint16_t attr() const { return m_attr; }
+        uint64_t offset() const { return m_value_offset; }
+        uint32_t length() const { return m_value_size; }
+        uint64_t record_size() const;
+
+    private:
+        bool read_record();
+
+    private:
+        e::compat::shared_ptr<po6::io::fd> m_fd;
+        uint64_t m_size;
+        uint64_t m_offset;
+        bool m_have;
+        bool m_error;
+        std::vector<char> m_key;
+        uint16_t m_attr;
+        uint64_t m_value_offset;
+        uint32_t m_value_size;
+
+    private:
+        segment_reader(const segment_reader&);
+        segment_reader& operator = (const segment_reader&);
+};
+
+#endif // hyperdex_daemon_datalayer_value_log_h_
@@ -0,0 +1,410 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <cstring>
+
+// Google Log
+#include <glog/logging.h>
+
+// e
+#include <e/guard.h>
+
+// HyperDex
+#include "daemon/daemon.h"
+#include "daemon/datalayer_encodings.h"
+#include "daemon/datalayer_value_log.h"
+#include "daemon/datalayer_value_log_gc_thread.h"
+#include "daemon/datalayer_wiper_thread.h"
+
+using hyperdex::datalayer;
+
+struct datalayer::value_log_gc_thread::relocation
+{
+    relocation() : key(), attr(), offset(), pointer() {}
+    std::string key;
+    uint16_t attr;
+    uint64_t offset;
+    char pointer[VALUE_POINTER_SIZE];
+};
+
+// a segment is rewritten once at least half of it is garbage
+#define GC_LIVE_NUMERATOR 1
+#define GC_LIVE_DENOMINATOR 2
+
+datalayer :: value_log_gc_thread :: value_log_gc_thread(daemon* d)
+    : background_thread(d)
+    , m_daemon(d)
+    , m_kicks(0)
+    , m_kicks_done(0)
+    , m_kicks_target(0)
+    , m_segments_scanned(0)
+    , m_segments_retired(0)
+    , m_segments_unlinked(0)
+    , m_bytes_relocated(0)
+    , m_interrupted_count(0)
+    , m_interrupted(false)
+{
+}
+
+datalayer :: value_log_gc_thread :: ~value_log_gc_thread() throw ()
+{
+}
+
+const char*
+datalayer :: value_log_gc_thread :: thread_name()
+{
+    return "value log gc";
+}
+
+bool
+datalayer :: value_log_gc_thread :: have_work()
+{
+    m_interrupted = false;
+    return m_kicks_done < m_kicks &&
+           m_daemon->m_data.m_vlog->in_use();
+}
+
+void
+datalayer :: value_log_gc_thread :: copy_work()
+{
+    m_kicks_target = m_kicks;
+}
+
+void
+datalayer :: value_log_gc_thread :: do_work()
+{
+    value_log* vlog = m_daemon->m_data.m_vlog.get();
+    // nothing here depends on the configuration, so reconfiguration may
+    // proceed while we work
+    this->offline();
+    size_t unlinked = vlog->unlink_retired();
+    uint64_t segment;
+
+    while (!interrupted() && vlog->next_candidate(&segment))
+    {
+        collect_segment(segment);
+    }
+
+    unlinked += vlog->unlink_retired();
+    this->online();
+
+    this->lock();
+    m_segments_unlinked += unlinked;
+    m_kicks_done = m_kicks_target;
+    this->unlock();
+}
+
+void
+datalayer :: value_log_gc_thread :: debug_dump()
+{
+    this->lock();
+    LOG(INFO) << "value log gc thread ===========================================================";
+    LOG(INFO) << "kicks=" << m_kicks;
+    LOG(INFO) << "kicks_done=" << m_kicks_done;
+    LOG(INFO) << "segments_scanned=" << m_segments_scanned;
+    LOG(INFO) << "segments_retired=" << m_segments_retired;
+    LOG(INFO) << "segments_unlinked=" << m_segments_unlinked;
+    LOG(INFO) << "bytes_relocated=" << m_bytes_relocated;
+    LOG(INFO) << "interrupted_count=" << m_interrupted_count;
+    this->unlock();
+}
+
+void
+datalayer :: value_log_gc_thread :: kick()
+{
+    this->lock();
+    ++m_kicks;
+    this->wakeup();
+    this->unlock();
+}
+
+bool
+datalayer :: value_log_gc_thread :: interrupted()
+{
+    ++m_interrupted_count;
+    bool ret = m_interrupted;
+
+    if (m_interrupted_count % 1000 == 0)
+    {
+        this->lock();
+        ret = this->is_shutdown();
+        m_interrupted = ret;
+        this->unlock();
+    }
+
+    return ret;
+}
+
+void
+datalayer :: value_log_gc_thread :: collect_segment(uint64_t segment)
+{
+    value_log* vlog = m_daemon->m_data.m_vlog.get();
+    uint64_t live = 0;
+    uint64_t total = 0;
+
+    {
+        value_log::segment_reader sr(vlog, segment);
+
+        for (; sr.valid(); sr.next())
+        {
+            if (interrupted())
+            {
+                return;
+            }
+
+            std::string raw;
+            size_t pointer_offset;
+            returncode rc = check_record(sr.key(), sr.attr(), segment, sr.offset(),
+                                         &raw, &pointer_offset);
+            total += sr.record_size();
+
+            if (rc == SUCCESS)
+            {
+                live += sr.record_size();
+            }
+            else if (rc != NOT_FOUND)
+            {
+                LOG(ERROR) << "value log gc could not check a record in segment "
+                           << segment << ": " << rc;
+                return;
+            }
+        }
+
+        if (sr.error())
+        {
+            // a torn append leaves a hole; keep the segment around
+            LOG(WARNING) << "value log segment " << segment << " has a corrupt "
+                         << "record after " << total << " bytes; not collecting it";
+            vlog->set_liveness(segment, total, total);
+            return;
+        }
+    }
+
+    vlog->set_liveness(segment, live, total);
+    this->lock();
+    ++m_segments_scanned;
+    this->unlock();
+
+    if (live * GC_LIVE_DENOMINATOR > total * GC_LIVE_NUMERATOR)
+    {
+        return;
+    }
+
+    // Relocated writes bypass the wiper's bookkeeping, so hold the wiper at
+    // its current region for the duration; regions that are (or will be)
+    // wiped are treated as garbage by check_record.
+    m_daemon->m_data.inhibit_wiping();
+    e::guard g = e::makeobjguard(m_daemon->m_data, &datalayer::permit_wiping);
+    g.use_variable();
+    // Copy every live record before repointing any of them, so that a single
+    // sync makes all the copies durable before LevelDB can refer to them.
+    value_log::segment_reader sr(vlog, segment);
+    std::vector<relocation> relocated;
+    uint64_t bytes = 0;
+
+    for (; sr.valid(); sr.next())
+    {
+        if (interrupted() || !copy_record(sr, segment, &relocated))
+        {
+            return;
+        }
+
+        bytes += sr.length();
+    }
+
+    if (sr.error() || vlog->sync() != SUCCESS)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < relocated.size(); ++i)
+    {
+        if (!repoint_record(relocated[i], segment))
+        {
+            return;
+        }
+    }
+
+    vlog->retire(segment);
+    this->lock();
+    ++m_segments_retired;
+    m_bytes_relocated += bytes;
+    this->unlock();
+}
+
+datalayer::returncode
+datalayer :: value_log_gc_thread :: check_record(const leveldb::Slice& key,
+                                                 uint16_t attr,
+                                                 uint64_t segment,
+                                                 uint64_t offset,
+                                                 std::string* raw,
+                                                 size_t* pointer_offset)
+{
+    region_id ri;
+    e::slice internal_key;
+
+    if (!decode_key(key, &ri, &internal_key))
+    {
+        return BAD_ENCODING;
+    }
+
+    if (m_daemon->m_data.region_will_be_wiped(ri))
+    {
+        return NOT_FOUND;
+    }
+
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = true;
+    leveldb::Status st = m_daemon->m_data.m_db->Get(opts, key, raw);
+
+    if (st.IsNotFound())
+    {
+        return NOT_FOUND;
+    }
+    else if (!st.ok())
+    {
+        return m_daemon->m_data.handle_error(st);
+    }
+
+    std::vector<e::slice> attrs;
+    std::vector<bool> indirect;
+    uint64_t version;
+    returncode rc = decode_value(e::slice(raw->data(), raw->size()),
+                                 &attrs, &indirect, &version);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
+
+    if (attr >= attrs.size() || !indirect[attr])
+    {
+        return NOT_FOUND;
+    }
+
+    uint64_t ptr_segment;
+    uint64_t ptr_offset;
+    uint32_t ptr_length;
+
+    if (!decode_value_pointer(attrs[attr], &ptr_segment, &ptr_offset, &ptr_length) ||
+        ptr_segment != segment || ptr_offset != offset)
+    {
+        return NOT_FOUND;
+    }
+
+    *pointer_offset = attrs[attr].data()
+                    - reinterpret_cast<const uint8_t*>(raw->data());
+    return SUCCESS;
+}
+
+bool
+datalayer :: value_log_gc_thread :: copy_record(const value_log::segment_reader& sr,
+                                                uint64_t segment,
+                                                std::vector<relocation>* relocated)
+{
+    value_log* vlog = m_daemon->m_data.m_vlog.get();
+    std::string raw;
+    size_t pointer_offset;
+    returncode rc = check_record(sr.key(), sr.attr(), segment, sr.offset(),
+                                 &raw, &pointer_offset);
+
+    if (rc == NOT_FOUND)
+    {
+        return true;
+    }
+    else if (rc != SUCCESS)
+    {
+        LOG(ERROR) << "value log gc could not check a record in segment "
+                   << segment << ": " << rc;
+        return false;
+    }
+
+    std::vector<char> value(sr.length());
+    rc = vlog->read(e::slice(&raw[pointer_offset], VALUE_POINTER_SIZE),
+                    value.empty() ? NULL : &value.front());
+
+    if (rc != SUCCESS)
+    {
+        LOG(ERROR) << "value log gc could not read a record in segment "
+                   << segment << ": " << rc;
+        return false;
+    }
+
+    relocated->push_back(relocation());
+    relocation* r = &relocated->back();
+    r->key.assign(sr.key().data(), sr.key().size());
+    r->attr = sr.attr();
+    r->offset = sr.offset();
+    e::slice v(value.empty() ? NULL : &value.front(), value.size());
+    return vlog->append(sr.key(), sr.attr(), v, r->pointer) == SUCCESS;
+}
+
+bool
+datalayer :: value_log_gc_thread :: repoint_record(const relocation& r,
+                                                   uint64_t segment)
+{
+    value_log* vlog = m_daemon->m_data.m_vlog.get();
+    leveldb::Slice key(r.key.data(), r.key.size());
+    value_log::hold hold(vlog, key);
+    std::string raw;
+    size_t pointer_offset;
+    returncode rc = check_record(key, r.attr, segment, r.offset,
+                                 &raw, &pointer_offset);
+
+    // overwritten since the copy was made; the copy is now garbage
+    if (rc == NOT_FOUND)
+    {
+        return true;
+    }
+    else if (rc != SUCCESS)
+    {
+        LOG(ERROR) << "value log gc could not check a record in segment "
+                   << segment << ": " << rc;
+        return false;
+    }
+
+    // the pointer is fixed-size, so the rest of the object (and its indices)
+    // are unchanged
+    memmove(&raw[pointer_offset], r.pointer, VALUE_POINTER_SIZE);
+    leveldb::WriteOptions wopts;
+    wopts.sync = false;
+    leveldb::Status st = m_daemon->m_data.m_db->Put(wopts, key,
+                                                    leveldb::Slice(raw.data(), raw.size()));
+
+    if (!st.ok())
+    {
+        m_daemon->m_data.handle_error(st);
+        return false;
+    }
+
+    return true;
+}
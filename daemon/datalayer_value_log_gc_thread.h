@@ -0,0 +1,94 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_daemon_datalayer_value_log_gc_thread_h_
+#define hyperdex_daemon_datalayer_value_log_gc_thread_h_
+
+// STL
+#include <string>
+#include <vector>
+
+// HyperDex
+#include "daemon/background_thread.h"
+#include "daemon/datalayer.h"
+#include "daemon/datalayer_value_log.h"
+
+class hyperdex::datalayer::value_log_gc_thread : public hyperdex::background_thread
+{
+    public:
+        value_log_gc_thread(daemon* d);
+        ~value_log_gc_thread() throw ();
+
+    public:
+        virtual const char* thread_name();
+        virtual bool have_work();
+        virtual void copy_work();
+        virtual void do_work();
+
+    public:
+        void debug_dump();
+        void kick();
+
+    private:
+        struct relocation;
+        bool interrupted();
+        void collect_segment(uint64_t segment);
+        // SUCCESS if the record is the live copy of the attribute, NOT_FOUND
+        // if it is garbage, and an error otherwise.  On SUCCESS, raw holds
+        // the LevelDB value and pointer_offset locates the pointer within it.
+        returncode check_record(const leveldb::Slice& key,
+                                uint16_t attr,
+                                uint64_t segment,
+                                uint64_t offset,
+                                std::string* raw,
+                                size_t* pointer_offset);
+        // copy a live record to the head of the log
+        bool copy_record(const value_log::segment_reader& sr,
+                         uint64_t segment,
+                         std::vector<relocation>* relocated);
+        // point LevelDB at the copy once the head of the log is durable
+        bool repoint_record(const relocation& r, uint64_t segment);
+
+    private:
+        daemon* m_daemon;
+        uint64_t m_kicks; // under lock
+        uint64_t m_kicks_done; // under lock
+        uint64_t m_kicks_target; // do_work; no lock; copy of m_kicks
+        uint64_t m_segments_scanned;
+        uint64_t m_segments_retired;
+        uint64_t m_segments_unlinked;
+        uint64_t m_bytes_relocated;
+        uint64_t m_interrupted_count;
+        bool m_interrupted;
+
+    private:
+        value_log_gc_thread(const value_log_gc_thread&);
+        value_log_gc_thread& operator = (const value_log_gc_thread&);
+};
+
+#endif // hyperdex_daemon_datalayer_value_log_gc_thread_h_
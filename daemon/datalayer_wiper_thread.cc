@@ -27,6 +27,12 @@
 
 #define __STDC_LIMIT_MACROS
 
+// C
+#include <time.h>
+
+// STL
+#include <algorithm>
+
 // Google Log
 #include <glog/logging.h>
 
@@ -36,9 +42,11 @@
 
 // HyperDex
 #include "daemon/daemon.h"
+#include "daemon/datalayer_encodings.h"
 #include "daemon/datalayer_index_state.h"
 #include "daemon/datalayer_indexer_thread.h"
 #include "daemon/datalayer_wiper_thread.h"
+#include "daemon/index_info.h"
 
 using hyperdex::datalayer;
 
@@ -50,6 +58,11 @@ datalayer :: wiper_thread :: wiper_thread(daemon* d, wiper_indexer_mediator* m)
     , m_have_current(false)
     , m_wipe_current_xid()
     , m_wipe_current_rid()
+    , m_truncating()
+    , m_truncate_current(false)
+    , m_truncate_batch()
+    , m_truncate_region(0)
+    , m_truncate_next()
     , m_wiping_inhibit_permit_diff(0)
     , m_interrupted_count(0)
     , m_interrupted(false)
@@ -74,21 +87,34 @@ datalayer :: wiper_thread :: have_work()
     m_have_current = false;
     m_wipe_current_xid = transfer_id();
     m_wipe_current_rid = region_id();
-    return !m_wiping.empty() && m_wiping_inhibit_permit_diff == 0 &&
-           !m_mediator->region_conflicts_with_indexer(m_wiping.front().second);
+    m_truncate_current = false;
+    return can_wipe() || !m_truncating.empty();
 }
 
 void
 datalayer :: wiper_thread :: copy_work()
 {
-    m_wipe_current_xid = m_wiping.front().first;
-    m_wipe_current_rid = m_wiping.front().second;
-    m_have_current = m_mediator->set_wiper_region(m_wipe_current_rid);
+    if (can_wipe())
+    {
+        m_wipe_current_xid = m_wiping.front().first;
+        m_wipe_current_rid = m_wiping.front().second;
+        m_have_current = m_mediator->set_wiper_region(m_wipe_current_rid);
+    }
+    else
+    {
+        m_truncate_current = true;
+    }
 }
 
 void
 datalayer :: wiper_thread :: do_work()
 {
+    if (m_truncate_current)
+    {
+        truncate();
+        return;
+    }
+
     if (!m_have_current)
     {
         return;
@@ -112,6 +138,13 @@ datalayer :: wiper_thread :: debug_dump()
     LOG(INFO) << "have_current=" << (m_have_current ? "yes" : "no");
     LOG(INFO) << "wipe_current_xid=" << m_wipe_current_xid;
     LOG(INFO) << "wipe_current_rid=" << m_wipe_current_rid;
+    LOG(INFO) << "truncating:";
+
+    for (truncate_list_t::iterator it = m_truncating.begin(); it != m_truncating.end(); ++it)
+    {
+        LOG(INFO) << "  " << it->first << " before version " << it->second;
+    }
+
     LOG(INFO) << "wiping_inhibit_permit_diff=" << m_wiping_inhibit_permit_diff;
     LOG(INFO) << "interrupted_count=" << m_interrupted_count;
     this->unlock();
@@ -166,6 +199,27 @@ datalayer :: wiper_thread :: request_wipe(transfer_id xid,
     this->unlock();
 }
 
+void
+datalayer :: wiper_thread :: request_truncate(region_id ri, uint64_t version)
+{
+    this->lock();
+    m_truncating.push_back(std::make_pair(ri, version));
+    this->wakeup();
+    this->unlock();
+}
+
+void
+datalayer :: wiper_thread :: set_truncations(const std::vector<std::pair<region_id, uint64_t> >& truncations)
+{
+    this->lock();
+    m_truncating.clear();
+    m_truncating.insert(m_truncating.end(), truncations.begin(), truncations.end());
+    m_truncate_batch.clear();
+    m_truncate_region = 0;
+    m_truncate_next.clear();
+    this->unlock();
+}
+
 void
 datalayer :: wiper_thread :: kick()
 {
@@ -174,6 +228,13 @@ datalayer :: wiper_thread :: kick()
     this->unlock();
 }
 
+bool
+datalayer :: wiper_thread :: can_wipe()
+{
+    return !m_wiping.empty() && m_wiping_inhibit_permit_diff == 0 &&
+           !m_mediator->region_conflicts_with_indexer(m_wiping.front().second);
+}
+
 bool
 datalayer :: wiper_thread :: interrupted()
 {
@@ -262,6 +323,7 @@ datalayer :: wiper_thread :: wipe_checkpoints(region_id rid)
         }
 
         m_daemon->m_data.m_db->Delete(leveldb::WriteOptions(), it->key());
+        m_daemon->m_io.consume(io_scheduler::DISK_WRITE, it->key().size());
         it->Next();
     }
 }
@@ -282,23 +344,212 @@ datalayer :: wiper_thread :: wipe_objects(region_id rid)
 void
 datalayer :: wiper_thread :: wipe_common(uint8_t c, region_id rid)
 {
-    std::auto_ptr<leveldb::Iterator> it;
-    it.reset(m_daemon->m_data.m_db->NewIterator(leveldb::ReadOptions()));
-    char backing[sizeof(uint8_t) + VARINT_64_MAX_SIZE];
-    char* ptr = backing;
-    ptr = e::pack8be(c, ptr);
-    ptr = e::packvarint64(rid.get(), ptr);
-    leveldb::Slice prefix(backing, ptr - backing);
-    it->Seek(prefix);
-
-    while (it->key().starts_with(prefix))
+    std::string start;
+    std::string limit;
+    encode_region_range(c, rid, &start, &limit);
+    std::string next(start);
+
+    // each pass deletes a whole batch, so look for shutdown every time
+    do
     {
-        if (interrupted())
+        this->lock();
+        m_interrupted = m_interrupted || this->is_shutdown();
+        this->unlock();
+
+        if (m_interrupted)
         {
             return;
         }
 
-        m_daemon->m_data.m_db->Delete(leveldb::WriteOptions(), it->key());
-        it->Next();
+        returncode rc = m_daemon->m_data.delete_range(next, limit, &next);
+
+        if (rc != SUCCESS)
+        {
+            LOG(ERROR) << "error wiping " << rid << ": " << rc;
+            m_interrupted = true;
+            return;
+        }
+
+        m_daemon->m_io.wait(io_scheduler::DISK_WRITE);
+    }
+    while (!next.empty());
+
+    // drop the tombstones now rather than when compaction gets around to it
+    m_daemon->m_data.compact_range(start, limit);
+}
+
+void
+datalayer :: wiper_thread :: truncate()
+{
+    const configuration* config = m_daemon->m_config;
+
+    if (m_truncate_batch.empty())
+    {
+        this->lock();
+        truncate_list_t truncating(m_truncating);
+        this->unlock();
+        assert(!truncating.empty());
+        const space* sp = config->get_space(truncating.front().first);
+
+        // Only the key region's head can know of a truncation before the
+        // writes ordered ahead of it are through; it waits for them so that
+        // none can name a value it deleted.
+        for (truncate_list_t::iterator it = truncating.begin();
+                it != truncating.end(); ++it)
+        {
+            if (config->get_space(it->first) == sp &&
+                m_daemon->m_repl.truncate_is_ordered(it->first, it->second))
+            {
+                m_truncate_batch.push_back(*it);
+            }
+        }
+
+        if (m_truncate_batch.empty())
+        {
+            struct timespec ts;
+            ts.tv_sec = 0;
+            ts.tv_nsec = 10 * 1000 * 1000;
+            nanosleep(&ts, NULL);
+            return;
+        }
+
+        std::sort(m_truncate_batch.begin(), m_truncate_batch.end());
+        m_truncate_region = 0;
+        m_truncate_next.clear();
+    }
+
+    // every region of the space we hold, in any subspace, has copies of the
+    // key regions' objects
+    const space* sp = config->get_space(m_truncate_batch.front().first);
+    std::vector<region_id> all_regions;
+    std::vector<region_id> regions;
+    config->space_regions(m_daemon->m_us, &all_regions);
+
+    for (size_t i = 0; sp && i < all_regions.size(); ++i)
+    {
+        if (config->get_space(all_regions[i]) == sp)
+        {
+            regions.push_back(all_regions[i]);
+        }
     }
+
+    std::sort(regions.begin(), regions.end());
+
+    // The scan only finds the objects; each is deleted through its key
+    // state so that a write to it cannot interleave.  It stays online, so a
+    // reconfiguration waits for the batch.
+    std::vector<std::pair<region_id, std::string> > keys;
+    std::vector<uint64_t> floors;
+
+    while (m_truncate_region < regions.size() && keys.size() < RANGE_DELETE_BATCH)
+    {
+        const region_id& rid(regions[m_truncate_region]);
+        const schema* sc = config->get_schema(rid);
+        const index_encoding* ie = index_encoding::lookup(sc->attrs[0].type);
+        std::string start;
+        std::string limit;
+        encode_region_range('o', rid, &start, &limit);
+        leveldb::ReadOptions opts;
+        opts.fill_cache = false;
+        std::auto_ptr<leveldb::Iterator> it(m_daemon->m_data.m_db->NewIterator(opts));
+        it->Seek(m_truncate_next.empty() ? leveldb::Slice(start) : leveldb::Slice(m_truncate_next));
+        m_truncate_next.clear();
+        std::vector<e::slice> attrs;
+        std::vector<bool> indirect;
+
+        while (it->Valid() && it->key().compare(limit) < 0)
+        {
+            if (keys.size() >= RANGE_DELETE_BATCH)
+            {
+                m_truncate_next.assign(it->key().data(), it->key().size());
+                break;
+            }
+
+            region_id ri;
+            e::slice ikey;
+            uint64_t version = 0;
+
+            if (decode_key(it->key(), &ri, &ikey) &&
+                decode_value(e::slice(it->value().data(), it->value().size()),
+                             &attrs, &indirect, &version) == SUCCESS)
+            {
+                std::vector<char> buf(ie->decoded_size(ikey) + 1);
+                ie->decode(ikey, &buf[0]);
+                std::string key(&buf[0], buf.size() - 1);
+                std::pair<region_id, uint64_t> kr(config->key_region(rid, e::slice(key)), 0);
+                std::vector<std::pair<region_id, uint64_t> >::iterator floor;
+                floor = std::lower_bound(m_truncate_batch.begin(), m_truncate_batch.end(), kr);
+
+                if (floor != m_truncate_batch.end() &&
+                    floor->first == kr.first &&
+                    version < floor->second)
+                {
+                    keys.push_back(std::make_pair(rid, key));
+                    floors.push_back(floor->second);
+                }
+            }
+
+            it->Next();
+        }
+
+        if (!it->status().ok())
+        {
+            LOG(ERROR) << "error truncating " << rid << ": " << it->status().ToString();
+            m_truncate_next.clear();
+        }
+
+        if (m_truncate_next.empty())
+        {
+            ++m_truncate_region;
+        }
+    }
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        m_daemon->m_repl.wipe_truncated(keys[i].first, e::slice(keys[i].second), floors[i]);
+        m_daemon->m_io.wait(io_scheduler::DISK_WRITE);
+    }
+
+    if (m_truncate_region < regions.size())
+    {
+        return;
+    }
+
+    // drop the tombstones now rather than when compaction gets around to
+    // it; only then is the truncation done
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        std::string start;
+        std::string limit;
+        encode_region_range('o', regions[i], &start, &limit);
+        m_daemon->m_data.compact_range(start, limit);
+        encode_region_range('i', regions[i], &start, &limit);
+        m_daemon->m_data.compact_range(start, limit);
+    }
+
+    this->lock();
+
+    for (size_t i = 0; i < m_truncate_batch.size(); ++i)
+    {
+        truncate_list_t::iterator it = std::find(m_truncating.begin(),
+                                                 m_truncating.end(),
+                                                 m_truncate_batch[i]);
+
+        if (it != m_truncating.end())
+        {
+            m_truncating.erase(it);
+        }
+    }
+
+    this->unlock();
+
+    for (size_t i = 0; i < m_truncate_batch.size(); ++i)
+    {
+        m_daemon->m_data.mark_wiped(m_truncate_batch[i].first, m_truncate_batch[i].second);
+        LOG(INFO) << "done truncating " << m_truncate_batch[i].first
+                  << " before version " << m_truncate_batch[i].second;
+    }
+
+    m_truncate_batch.clear();
+    m_truncate_region = 0;
 }
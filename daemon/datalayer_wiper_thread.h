@@ -57,10 +57,18 @@ class hyperdex::datalayer::wiper_thread : public hyperdex::background_thread
         bool region_will_be_wiped(region_id rid);
         void request_wipe(transfer_id xid,
                           region_id ri);
+        // remove this replica's copies of the key region's objects older
+        // than version, from every region of the space it holds, one batch
+        // at a time
+        void request_truncate(region_id ri, uint64_t version);
+        // replace the pending truncations; call while paused
+        void set_truncations(const std::vector<std::pair<region_id, uint64_t> >& truncations);
         void kick();
 
     private:
+        bool can_wipe();
         bool interrupted();
+        void truncate();
         void wipe(transfer_id xid, region_id rid);
         void wipe_checkpoints(region_id rid);
         void wipe_indices(region_id rid);
@@ -75,6 +83,15 @@ class hyperdex::datalayer::wiper_thread : public hyperdex::background_thread
         bool m_have_current;
         transfer_id m_wipe_current_xid;
         region_id m_wipe_current_rid;
+        typedef std::list<std::pair<region_id, uint64_t> > truncate_list_t;
+        truncate_list_t m_truncating;
+        bool m_truncate_current;
+        // the truncations of one space the current scan removes, sorted by
+        // key region; the scan resumes at m_truncate_next in the
+        // m_truncate_region'th region of the space that we hold
+        std::vector<std::pair<region_id, uint64_t> > m_truncate_batch;
+        size_t m_truncate_region;
+        std::string m_truncate_next;
         uint64_t m_wiping_inhibit_permit_diff;
         uint64_t m_interrupted_count;
         bool m_interrupted;
@@ -0,0 +1,391 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <cassert>
+
+// STL
+#include <algorithm>
+
+// po6
+#include <po6/threads/cond.h>
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/atomic.h>
+#include <e/lockfree_mpsc_fifo.h>
+
+// HyperDex
+#include "daemon/dispatcher.h"
+
+using hyperdex::dispatcher;
+
+class dispatcher::message
+{
+    public:
+        message(const server_id& from,
+                const virtual_server_id& vfrom,
+                const virtual_server_id& vto,
+                network_msgtype msg_type,
+                std::auto_ptr<e::buffer> msg,
+                const e::unpacker& up);
+        ~message() throw ();
+
+    public:
+        server_id from;
+        virtual_server_id vfrom;
+        virtual_server_id vto;
+        network_msgtype msg_type;
+        std::auto_ptr<e::buffer> msg;
+        e::unpacker up;
+
+    private:
+        message(const message&);
+        message& operator = (const message&);
+};
+
+dispatcher :: message :: message(const server_id& f,
+                                 const virtual_server_id& vf,
+                                 const virtual_server_id& vt,
+                                 network_msgtype mt,
+                                 std::auto_ptr<e::buffer> m,
+                                 const e::unpacker& u)
+    : from(f)
+    , vfrom(vf)
+    , vto(vt)
+    , msg_type(mt)
+    , msg(m)
+    , up(u)
+{
+}
+
+dispatcher :: message :: ~message() throw ()
+{
+}
+
+class dispatcher::worker
+{
+    public:
+        worker();
+        ~worker() throw ();
+
+    public:
+        e::lockfree_mpsc_fifo<message> queues[CLASSES];
+        // weighted round robin state; only the worker touches these
+        size_t cursor;
+        unsigned credit[CLASSES];
+        // set while the worker may be waiting on wakeup; producers only take
+        // the lock when it is set
+        uint64_t sleeping;
+        po6::threads::mutex mtx;
+        po6::threads::cond wakeup;
+        po6::threads::cond parked_cond;
+        bool parked;
+
+    private:
+        worker(const worker&);
+        worker& operator = (const worker&);
+};
+
+dispatcher :: worker :: worker()
+    : queues()
+    , cursor(0)
+    , credit()
+    , sleeping(0)
+    , mtx()
+    , wakeup(&mtx)
+    , parked_cond(&mtx)
+    , parked(false)
+{
+}
+
+dispatcher :: worker :: ~worker() throw ()
+{
+}
+
+const size_t dispatcher::CLASSES;
+
+dispatcher::traffic_class
+dispatcher :: classify(network_msgtype msg_type)
+{
+    switch (msg_type)
+    {
+        case REQ_GET:
+        case REQ_GET_PARTIAL:
+        case REQ_ATOMIC:
+        case REQ_SEARCH_START:
+        case REQ_SEARCH_NEXT:
+        case REQ_SEARCH_STOP:
+        case REQ_SORTED_SEARCH:
+        case REQ_COUNT:
+        case REQ_SEARCH_DESCRIBE:
+        case REQ_GROUP_ATOMIC:
+        case RESP_GET:
+        case RESP_GET_PARTIAL:
+            return CLIENT;
+        case CHAIN_OP:
+        case CHAIN_SUBSPACE:
+        case CHAIN_ACK:
+        case CHAIN_NACK:
+        case CHAIN_TRUNCATE:
+            return REPLICATION;
+        case XFER_OP:
+        case XFER_ACK:
+        case XFER_HS:
+        case XFER_HSA:
+        case XFER_HA:
+        case XFER_HW:
+        case XFER_BULK:
+        case BACKUP:
+        case PERF_COUNTERS:
+        case TRUNCATE_SPACE:
+        case HOT_KEYS:
+        case SLOW_OPS:
+        case RESP_ATOMIC:
+        case RESP_SEARCH_ITEM:
+        case RESP_SEARCH_DONE:
+        case RESP_SORTED_SEARCH:
+        case RESP_COUNT:
+        case RESP_SEARCH_DESCRIBE:
+        case RESP_GROUP_ATOMIC:
+        case CONFIGMISMATCH:
+        case PACKET_NOP:
+        default:
+            return BACKGROUND;
+    }
+}
+
+dispatcher :: dispatcher(e::garbage_collector* gc)
+    : m_gc(gc)
+    , m_workers()
+    , m_shares()
+    , m_depth()
+    , m_enqueued()
+    , m_paused(0)
+    , m_shutdown(0)
+{
+}
+
+dispatcher :: ~dispatcher() throw ()
+{
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        for (size_t c = 0; c < CLASSES; ++c)
+        {
+            message* m;
+
+            while (m_workers[i]->queues[c].pop(m_gc, &m))
+            {
+                delete m;
+            }
+        }
+    }
+}
+
+void
+dispatcher :: setup(unsigned workers,
+                    unsigned client_share,
+                    unsigned replication_share,
+                    unsigned background_share)
+{
+    assert(m_workers.empty());
+    m_shares[CLIENT] = std::max(client_share, 1U);
+    m_shares[REPLICATION] = std::max(replication_share, 1U);
+    m_shares[BACKGROUND] = std::max(background_share, 1U);
+
+    for (unsigned i = 0; i < workers; ++i)
+    {
+        m_workers.push_back(e::compat::shared_ptr<worker>(new worker()));
+    }
+}
+
+void
+dispatcher :: enqueue(size_t idx,
+                      const server_id& from,
+                      const virtual_server_id& vfrom,
+                      const virtual_server_id& vto,
+                      network_msgtype msg_type,
+                      std::auto_ptr<e::buffer> msg,
+                      const e::unpacker& up)
+{
+    assert(idx < m_workers.size());
+    worker* w = m_workers[idx].get();
+    traffic_class tc = classify(msg_type);
+    e::atomic::increment_64_nobarrier(&m_depth[tc], 1);
+    m_enqueued[tc].tap();
+    w->queues[tc].push(new message(from, vfrom, vto, msg_type, msg, up));
+    e::atomic::memory_barrier();
+
+    if (e::atomic::load_64_acquire(&w->sleeping))
+    {
+        wake(w);
+    }
+}
+
+bool
+dispatcher :: dequeue(size_t idx,
+                      e::garbage_collector::thread_state* ts,
+                      server_id* from,
+                      virtual_server_id* vfrom,
+                      virtual_server_id* vto,
+                      network_msgtype* msg_type,
+                      std::auto_ptr<e::buffer>* msg,
+                      e::unpacker* up)
+{
+    assert(idx < m_workers.size());
+    worker* w = m_workers[idx].get();
+    message* m = NULL;
+
+    while (!pop(w, &m))
+    {
+        po6::threads::mutex::hold hold(&w->mtx);
+        e::atomic::store_64_release(&w->sleeping, 1);
+        e::atomic::memory_barrier();
+
+        // recheck now that producers will see we're sleeping
+        if (pop(w, &m))
+        {
+            e::atomic::store_64_release(&w->sleeping, 0);
+            break;
+        }
+
+        if (e::atomic::load_64_acquire(&m_shutdown))
+        {
+            e::atomic::store_64_release(&w->sleeping, 0);
+            return false;
+        }
+
+        if (e::atomic::load_64_acquire(&m_paused))
+        {
+            w->parked = true;
+            w->parked_cond.broadcast();
+        }
+
+        // only unpause clears parked; were the worker to clear it on waking,
+        // a pause issued before it wakes would see it parked and return
+        // while it goes on to process messages
+        m_gc->offline(ts);
+        w->wakeup.wait();
+        m_gc->online(ts);
+        e::atomic::store_64_release(&w->sleeping, 0);
+    }
+
+    assert(m);
+    *from = m->from;
+    *vfrom = m->vfrom;
+    *vto = m->vto;
+    *msg_type = m->msg_type;
+    *msg = m->msg;
+    *up = m->up;
+    delete m;
+    return true;
+}
+
+void
+dispatcher :: pause()
+{
+    e::atomic::store_64_release(&m_paused, 1);
+    e::atomic::memory_barrier();
+
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        worker* w = m_workers[i].get();
+        po6::threads::mutex::hold hold(&w->mtx);
+
+        while (!w->parked)
+        {
+            w->wakeup.signal();
+            w->parked_cond.wait();
+        }
+    }
+}
+
+void
+dispatcher :: unpause()
+{
+    e::atomic::store_64_release(&m_paused, 0);
+    e::atomic::memory_barrier();
+
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        worker* w = m_workers[i].get();
+        po6::threads::mutex::hold hold(&w->mtx);
+        w->parked = false;
+        w->wakeup.signal();
+    }
+}
+
+void
+dispatcher :: shutdown()
+{
+    e::atomic::store_64_release(&m_shutdown, 1);
+    e::atomic::memory_barrier();
+
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        wake(m_workers[i].get());
+    }
+}
+
+uint64_t
+dispatcher :: queued(traffic_class tc) const
+{
+    return e::atomic::load_64_nobarrier(&m_depth[tc]);
+}
+
+void
+dispatcher :: wake(worker* w)
+{
+    po6::threads::mutex::hold hold(&w->mtx);
+    w->wakeup.signal();
+}
+
+bool
+dispatcher :: pop(worker* w, message** m)
+{
+    // Serve up to "share" messages from the class under the cursor, then move
+    // on.  A class that runs dry forfeits the rest of its turn.  Two passes
+    // guarantee every class is checked with fresh credit.
+    for (size_t i = 0; i < 2 * CLASSES; ++i)
+    {
+        size_t c = w->cursor;
+
+        if (w->credit[c] > 0 && w->queues[c].pop(m_gc, m))
+        {
+            --w->credit[c];
+            e::atomic::increment_64_nobarrier(&m_depth[c], -1);
+            return true;
+        }
+
+        w->credit[c] = m_shares[c];
+        w->cursor = (c + 1) % CLASSES;
+    }
+
+    return false;
+}
@@ -0,0 +1,134 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_dispatcher_h_
+#define hyperdex_daemon_dispatcher_h_
+
+// STL
+#include <memory>
+#include <vector>
+
+// e
+#include <e/buffer.h>
+#include <e/compat.h>
+#include <e/garbage_collector.h>
+
+// HyperDex
+#include "namespace.h"
+#include "common/ids.h"
+#include "common/network_msgtype.h"
+#include "daemon/performance_counter.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// In thread-per-core mode every region is owned by exactly one worker thread.
+// The network threads only receive messages and steer them onto the owning
+// worker's queue, so a region's messages are processed by one worker on its
+// own core.  This is affinity only: key and search state still live in the
+// daemon-wide tables, and background threads such as the retransmitter still
+// reach them from other cores.  The state_hash_table's locks are still
+// shared by every core, so this does not remove the contention that stops
+// the daemon scaling past about eight threads.
+//
+// Each worker keeps one queue per traffic class and serves them by weighted
+// round robin, so a burst of transfer or replication traffic cannot starve
+// client requests queued behind it.
+class dispatcher
+{
+    public:
+        enum traffic_class
+        {
+            CLIENT,
+            REPLICATION,
+            BACKGROUND
+        };
+        const static size_t CLASSES = 3;
+        static traffic_class classify(network_msgtype msg_type);
+
+    public:
+        dispatcher(e::garbage_collector* gc);
+        ~dispatcher() throw ();
+
+    public:
+        // shares are the relative number of messages served from each class
+        // when all of them are backlogged
+        void setup(unsigned workers,
+                   unsigned client_share,
+                   unsigned replication_share,
+                   unsigned background_share);
+        size_t workers() const { return m_workers.size(); }
+        size_t owner(const region_id& ri) const { return ri.get() % m_workers.size(); }
+        // called by network threads; never blocks
+        void enqueue(size_t worker,
+                     const server_id& from,
+                     const virtual_server_id& vfrom,
+                     const virtual_server_id& vto,
+                     network_msgtype msg_type,
+                     std::auto_ptr<e::buffer> msg,
+                     const e::unpacker& up);
+        // called by a worker; blocks until there is a message, returns false
+        // once the dispatcher is shut down and the queue has been drained
+        bool dequeue(size_t worker,
+                     e::garbage_collector::thread_state* ts,
+                     server_id* from,
+                     virtual_server_id* vfrom,
+                     virtual_server_id* vto,
+                     network_msgtype* msg_type,
+                     std::auto_ptr<e::buffer>* msg,
+                     e::unpacker* up);
+        // The network threads must be paused before the workers.  Pause
+        // returns once every worker has drained its queue and gone idle.
+        void pause();
+        void unpause();
+        void shutdown();
+        // messages currently queued, and queued ever, for the class
+        uint64_t queued(traffic_class tc) const;
+        uint64_t enqueued(traffic_class tc) const { return m_enqueued[tc].read(); }
+
+    private:
+        class message;
+        class worker;
+        void wake(worker* w);
+        bool pop(worker* w, message** m);
+
+    private:
+        e::garbage_collector* m_gc;
+        std::vector<e::compat::shared_ptr<worker> > m_workers;
+        unsigned m_shares[CLASSES];
+        uint64_t m_depth[CLASSES];
+        performance_counter m_enqueued[CLASSES];
+        uint64_t m_paused;
+        uint64_t m_shutdown;
+
+    private:
+        dispatcher(const dispatcher&);
+        dispatcher& operator = (const dispatcher&);
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_dispatcher_h_
@@ -0,0 +1,126 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <string.h>
+
+// STL
+#include <algorithm>
+
+// HyperDex
+#include "daemon/hot_keys.h"
+
+using hyperdex::hot_keys;
+
+namespace
+{
+
+bool
+more_frequent(const hot_keys::entry& lhs, const hot_keys::entry& rhs)
+{
+    return lhs.count > rhs.count;
+}
+
+} // namespace
+
+hot_keys :: hot_keys(uint64_t sample_every)
+    : m_sample_every(std::max(sample_every, static_cast<uint64_t>(1)))
+    , m_ticks(0)
+    , m_mtx()
+    , m_current()
+    , m_previous()
+    , m_rotated(false)
+{
+    m_current.reserve(CAPACITY);
+}
+
+hot_keys :: ~hot_keys() throw ()
+{
+}
+
+void
+hot_keys :: observe(const e::slice& key)
+{
+    if (__sync_add_and_fetch(&m_ticks, 1) % m_sample_every != 0)
+    {
+        return;
+    }
+
+    po6::threads::mutex::hold hold(&m_mtx);
+    size_t smallest = 0;
+
+    for (size_t i = 0; i < m_current.size(); ++i)
+    {
+        if (m_current[i].key.size() == key.size() &&
+            memcmp(m_current[i].key.data(), key.data(), key.size()) == 0)
+        {
+            ++m_current[i].count;
+            return;
+        }
+
+        if (m_current[i].count < m_current[smallest].count)
+        {
+            smallest = i;
+        }
+    }
+
+    if (m_current.size() < CAPACITY)
+    {
+        m_current.push_back(entry(key, 1, 0));
+        return;
+    }
+
+    uint64_t count = m_current[smallest].count;
+    m_current[smallest] = entry(key, count + 1, count);
+}
+
+void
+hot_keys :: top(size_t n, std::vector<entry>* entries)
+{
+    {
+        po6::threads::mutex::hold hold(&m_mtx);
+        *entries = m_rotated ? m_previous : m_current;
+    }
+
+    std::sort(entries->begin(), entries->end(), more_frequent);
+    entries->resize(std::min(entries->size(), n));
+
+    for (size_t i = 0; i < entries->size(); ++i)
+    {
+        (*entries)[i].count *= m_sample_every;
+        (*entries)[i].error *= m_sample_every;
+    }
+}
+
+void
+hot_keys :: rotate()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_previous.swap(m_current);
+    m_current.clear();
+    m_rotated = true;
+}
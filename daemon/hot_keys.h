@@ -0,0 +1,97 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_hot_keys_h_
+#define hyperdex_daemon_hot_keys_h_
+
+// STL
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/slice.h>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A Space-Saving sketch of the most frequent keys in a stream.  It keeps
+// CAPACITY counters; a key that has no counter takes over the smallest one
+// and inherits its count, which becomes the bound on the key's overcount.
+// Only every sample_every-th key is counted, and reported counts are scaled
+// back up, so the mutex is rarely taken on the hot path.
+//
+// Counting happens in periods; top() reports the last completed period so
+// that the answer does not shrink right after a rotation.
+class hot_keys
+{
+    public:
+        const static size_t CAPACITY = 32;
+        struct entry
+        {
+            entry() : key(), count(0), error(0) {}
+            entry(const e::slice& k, uint64_t c, uint64_t err)
+                : key(reinterpret_cast<const char*>(k.data()), k.size())
+                , count(c), error(err) {}
+            std::string key;
+            uint64_t count;
+            uint64_t error;
+        };
+
+    public:
+        hot_keys(uint64_t sample_every);
+        ~hot_keys() throw ();
+
+    public:
+        // any number of threads may observe concurrently
+        void observe(const e::slice& key);
+        // the n most frequent keys of the last completed period, or of the
+        // current period if none has completed, most frequent first
+        void top(size_t n, std::vector<entry>* entries);
+        // end the current period
+        void rotate();
+
+    private:
+        hot_keys(const hot_keys&);
+        hot_keys& operator = (const hot_keys&);
+
+    private:
+        const uint64_t m_sample_every;
+        uint64_t m_ticks;
+        po6::threads::mutex m_mtx;
+        std::vector<entry> m_current;
+        std::vector<entry> m_previous;
+        bool m_rotated;
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_hot_keys_h_
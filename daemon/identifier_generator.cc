@@ -83,6 +83,13 @@ identifier_generator :: peek(const region_id& ri) const
     return val;
 }
 
+bool
+identifier_generator :: peek(const region_id& ri, uint64_t* id) const
+{
+    e::atomic::memory_barrier();
+    return m_generators.get(ri, id);
+}
+
 uint64_t
 identifier_generator :: generate_id(const region_id& ri)
 {
@@ -50,6 +50,9 @@ class identifier_generator
         bool bump(const region_id& ri, uint64_t id);
         // look at the next identifier, and store it in "id"
         uint64_t peek(const region_id& ri) const;
+        // like peek, but returns false rather than aborting for unmanaged
+        // regions
+        bool peek(const region_id& ri, uint64_t* id) const;
         // generate one unique identifier, and store it in "id"
         uint64_t generate_id(const region_id& ri);
 
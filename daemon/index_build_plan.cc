@@ -0,0 +1,203 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <cassert>
+
+// STL
+#include <memory>
+
+// e
+#include <e/buffer.h>
+#include <e/serialization.h>
+
+// HyperDex
+#include "daemon/index_build_plan.h"
+
+using hyperdex::index_build_plan;
+
+index_build_plan :: index_build_plan()
+    : m_timestamp()
+    , m_parts()
+    , m_next_part(0)
+    , m_total_bytes(0)
+{
+}
+
+index_build_plan :: ~index_build_plan() throw ()
+{
+}
+
+void
+index_build_plan :: split(const std::vector<std::string>& bounds,
+                          const std::vector<uint64_t>& sizes,
+                          size_t parts)
+{
+    assert(!bounds.empty());
+    assert(sizes.size() + 1 == bounds.size());
+    assert(parts > 0);
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        total += sizes[i];
+    }
+
+    m_parts.clear();
+    m_parts.push_back(part());
+    m_parts.back().start = bounds[0];
+    m_parts.back().next = bounds[0];
+    uint64_t cumulative = 0;
+
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        if (m_parts.size() < parts &&
+            cumulative > total / parts * m_parts.size())
+        {
+            m_parts.back().limit = bounds[i];
+            m_parts.push_back(part());
+            m_parts.back().start = bounds[i];
+            m_parts.back().next = bounds[i];
+        }
+
+        cumulative += sizes[i];
+    }
+
+    m_parts.back().limit = bounds.back();
+    m_next_part = 0;
+    m_total_bytes = total;
+}
+
+void
+index_build_plan :: clear()
+{
+    m_timestamp.clear();
+    m_parts.clear();
+    m_next_part = 0;
+    m_total_bytes = 0;
+}
+
+bool
+index_build_plan :: claim(size_t* idx, std::string* next, std::string* limit)
+{
+    while (m_next_part < m_parts.size() && m_parts[m_next_part].done)
+    {
+        ++m_next_part;
+    }
+
+    if (m_next_part >= m_parts.size())
+    {
+        return false;
+    }
+
+    *idx = m_next_part;
+    *next = m_parts[m_next_part].next;
+    *limit = m_parts[m_next_part].limit;
+    ++m_next_part;
+    return true;
+}
+
+void
+index_build_plan :: advance(size_t idx, const std::string& next, bool done)
+{
+    assert(idx < m_parts.size());
+    m_parts[idx].next = next;
+    m_parts[idx].done = done;
+}
+
+void
+index_build_plan :: encode(std::string* out) const
+{
+    size_t sz = pack_size(e::slice(m_timestamp))
+              + sizeof(uint32_t) + sizeof(uint64_t);
+
+    for (size_t i = 0; i < m_parts.size(); ++i)
+    {
+        sz += pack_size(e::slice(m_parts[i].start))
+            + pack_size(e::slice(m_parts[i].limit))
+            + pack_size(e::slice(m_parts[i].next))
+            + sizeof(uint8_t);
+    }
+
+    std::auto_ptr<e::buffer> buf(e::buffer::create(sz));
+    e::packer pa = buf->pack_at(0);
+    pa = pa << e::slice(m_timestamp) << uint32_t(m_parts.size());
+
+    for (size_t i = 0; i < m_parts.size(); ++i)
+    {
+        pa = pa << e::slice(m_parts[i].start)
+                << e::slice(m_parts[i].limit)
+                << e::slice(m_parts[i].next)
+                << uint8_t(m_parts[i].done ? 1 : 0);
+    }
+
+    pa = pa << m_total_bytes;
+    out->assign(reinterpret_cast<const char*>(buf->data()), buf->size());
+}
+
+bool
+index_build_plan :: decode(const std::string& in)
+{
+    e::unpacker up(in.data(), in.size());
+    e::slice timestamp;
+    uint32_t parts = 0;
+    up = up >> timestamp >> parts;
+
+    if (up.error() || parts == 0 || parts > up.remain())
+    {
+        return false;
+    }
+
+    std::vector<part> loaded(parts);
+    uint64_t total = 0;
+
+    for (size_t i = 0; !up.error() && i < parts; ++i)
+    {
+        e::slice start;
+        e::slice limit;
+        e::slice next;
+        uint8_t done = 0;
+        up = up >> start >> limit >> next >> done;
+        loaded[i].start.assign(start.cdata(), start.size());
+        loaded[i].limit.assign(limit.cdata(), limit.size());
+        loaded[i].next.assign(next.cdata(), next.size());
+        loaded[i].done = done != 0;
+    }
+
+    up = up >> total;
+
+    if (up.error())
+    {
+        return false;
+    }
+
+    m_timestamp.assign(timestamp.cdata(), timestamp.size());
+    m_parts.swap(loaded);
+    m_next_part = 0;
+    m_total_bytes = total;
+    return true;
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_index_build_plan_h_
+#define hyperdex_daemon_index_build_plan_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// The first pass of an index build is split into parts at key boundaries and
+// spread across a pool of workers.  Each part remembers where to resume, and
+// the plan is stored alongside the index entries it covers so that an
+// interrupted build picks up where it left off.
+//
+// External synchronization required.
+class index_build_plan
+{
+    public:
+        struct part
+        {
+            part() : start(), limit(), next(), done(false) {}
+            std::string start;
+            std::string limit;
+            std::string next;
+            bool done;
+        };
+
+    public:
+        index_build_plan();
+        ~index_build_plan() throw ();
+
+    public:
+        // group the ranges [bounds[i], bounds[i + 1]), whose approximate
+        // sizes are given, into at most "parts" parts of similar size
+        void split(const std::vector<std::string>& bounds,
+                   const std::vector<uint64_t>& sizes,
+                   size_t parts);
+        void clear();
+        const std::string& timestamp() const { return m_timestamp; }
+        void set_timestamp(const std::string& ts) { m_timestamp = ts; }
+        uint64_t total_bytes() const { return m_total_bytes; }
+        const std::vector<part>& parts() const { return m_parts; }
+        // hand out each unfinished part once, from the first
+        void restart() { m_next_part = 0; }
+        bool claim(size_t* idx, std::string* next, std::string* limit);
+        // parts()[idx] has been indexed up to, but not including, next
+        void advance(size_t idx, const std::string& next, bool done);
+        void encode(std::string* out) const;
+        bool decode(const std::string& in);
+
+    private:
+        std::string m_timestamp;
+        std::vector<part> m_parts;
+        size_t m_next_part;
+        uint64_t m_total_bytes;
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_index_build_plan_h_
@@ -0,0 +1,269 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <string.h>
+
+// POSIX
+#include <time.h>
+
+// STL
+#include <algorithm>
+
+// po6
+#include <po6/time.h>
+
+// e
+#include <e/atomic.h>
+
+// HyperDex
+#include "daemon/io_scheduler.h"
+
+using hyperdex::io_scheduler;
+
+const size_t io_scheduler::RESOURCES;
+const size_t io_scheduler::HISTOGRAM;
+const uint64_t io_scheduler::ADJUST_INTERVAL;
+const uint64_t io_scheduler::WAIT_MAX;
+const uint64_t io_scheduler::MIN_SAMPLES;
+
+io_scheduler :: io_scheduler()
+    : m_target(0)
+    , m_bandwidth(0)
+    , m_throttled()
+    , m_protect()
+    , m_adjusted(0)
+    , m_p99(0)
+{
+    memset(m_histogram, 0, sizeof(m_histogram));
+    memset(m_consumed, 0, sizeof(m_consumed));
+    memset(m_seen, 0, sizeof(m_seen));
+}
+
+io_scheduler :: ~io_scheduler() throw ()
+{
+}
+
+void
+io_scheduler :: setup(uint64_t target, uint64_t bandwidth)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    m_target = target;
+    m_bandwidth = bandwidth;
+    uint64_t now = po6::monotonic_time();
+
+    for (size_t i = 0; i < RESOURCES; ++i)
+    {
+        m_buckets[i].rate = bandwidth;
+        m_buckets[i].tokens = 0;
+        m_buckets[i].refilled = now;
+    }
+
+    m_adjusted = now;
+}
+
+void
+io_scheduler :: observe(uint64_t nanos)
+{
+    uint64_t micros = nanos / 1000;
+    size_t idx = micros == 0 ? 0 : 64 - __builtin_clzll(micros);
+    idx = std::min(idx, HISTOGRAM - 1);
+    e::atomic::increment_64_nobarrier(&m_histogram[idx], 1);
+}
+
+void
+io_scheduler :: charge(resource r, uint64_t bytes)
+{
+    e::atomic::increment_64_nobarrier(&m_consumed[r], bytes);
+
+    if (!enabled())
+    {
+        return;
+    }
+
+    po6::threads::mutex::hold hold(&m_protect);
+    uint64_t now = po6::monotonic_time();
+    adjust(now);
+    refill(&m_buckets[r], now);
+    m_buckets[r].tokens -= std::min(bytes, uint64_t(INT64_MAX / 2));
+}
+
+bool
+io_scheduler :: exhausted(resource r)
+{
+    if (!enabled())
+    {
+        return false;
+    }
+
+    po6::threads::mutex::hold hold(&m_protect);
+    uint64_t now = po6::monotonic_time();
+    adjust(now);
+    refill(&m_buckets[r], now);
+    return m_buckets[r].tokens < 0;
+}
+
+void
+io_scheduler :: wait(resource r)
+{
+    if (!enabled())
+    {
+        return;
+    }
+
+    uint64_t nanos = 0;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect);
+        uint64_t now = po6::monotonic_time();
+        adjust(now);
+        bucket* b = &m_buckets[r];
+        refill(b, now);
+
+        if (b->tokens >= 0)
+        {
+            return;
+        }
+
+        double debt = -b->tokens;
+        double delay = debt * 1e9 / std::max(b->rate, uint64_t(1));
+        nanos = std::min(delay, double(WAIT_MAX));
+    }
+
+    m_throttled.tap();
+    timespec ts;
+    ts.tv_sec = nanos / 1000000000ULL;
+    ts.tv_nsec = nanos % 1000000000ULL;
+    nanosleep(&ts, NULL);
+}
+
+uint64_t
+io_scheduler :: budget(resource r)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    return m_buckets[r].rate;
+}
+
+uint64_t
+io_scheduler :: consumed(resource r) const
+{
+    return e::atomic::load_64_nobarrier(&m_consumed[r]);
+}
+
+uint64_t
+io_scheduler :: client_p99()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    return m_p99;
+}
+
+void
+io_scheduler :: refill(bucket* b, uint64_t now)
+{
+    if (now <= b->refilled)
+    {
+        return;
+    }
+
+    // never bank more than a tenth of a second of budget
+    uint64_t elapsed = std::min(now - b->refilled, uint64_t(1000000000ULL)) / 1000ULL;
+    int64_t burst = b->rate / 10;
+    int64_t tokens = b->tokens + int64_t(b->rate * elapsed / 1000000ULL);
+    b->tokens = std::min(tokens, burst);
+    b->refilled = now;
+}
+
+void
+io_scheduler :: adjust(uint64_t now)
+{
+    if (now < m_adjusted + ADJUST_INTERVAL)
+    {
+        return;
+    }
+
+    m_adjusted = now;
+    m_p99 = percentile99();
+    const uint64_t floor = std::max(m_bandwidth / 64, uint64_t(64 * 1024));
+    const uint64_t step = std::max(m_bandwidth / 16, uint64_t(1));
+
+    for (size_t i = 0; i < RESOURCES; ++i)
+    {
+        bucket* b = &m_buckets[i];
+        refill(b, now);
+
+        if (m_p99 > m_target)
+        {
+            b->rate = std::max(b->rate / 2, std::min(floor, m_bandwidth));
+        }
+        else
+        {
+            b->rate = std::min(b->rate + step, m_bandwidth);
+        }
+    }
+}
+
+uint64_t
+io_scheduler :: percentile99()
+{
+    uint64_t delta[HISTOGRAM];
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < HISTOGRAM; ++i)
+    {
+        uint64_t count = e::atomic::load_64_nobarrier(&m_histogram[i]);
+        delta[i] = count - m_seen[i];
+        m_seen[i] = count;
+        total += delta[i];
+    }
+
+    // too few requests to say clients are suffering
+    if (total < MIN_SAMPLES)
+    {
+        return 0;
+    }
+
+    uint64_t rank = total - total / 100;
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < HISTOGRAM; ++i)
+    {
+        if (seen + delta[i] >= rank)
+        {
+            // interpolate within [2^(i-1), 2^i) microseconds
+            uint64_t lower = i == 0 ? 0 : 1ULL << (i - 1);
+            uint64_t upper = 1ULL << i;
+            return lower + (upper - lower) * (rank - seen) / delta[i];
+        }
+
+        seen += delta[i];
+    }
+
+    return 1ULL << (HISTOGRAM - 1);
+}
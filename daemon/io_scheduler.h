@@ -0,0 +1,133 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_daemon_io_scheduler_h_
+#define hyperdex_daemon_io_scheduler_h_
+
+// C
+#include <stdint.h>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// HyperDex
+#include "namespace.h"
+#include "daemon/performance_counter.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// Token buckets that pace background work (state transfer, wiping, index
+// builds) so that it cannot crowd out clients.  Each resource refills at its
+// budget in bytes per second.  Work may overdraw a bucket; background threads
+// then wait until the debt is repaid, and foreground threads stop starting
+// new background work.
+//
+// Budgets follow the latency of client requests.  Every interval in which
+// the 99th percentile exceeds the target halves the budgets; every interval
+// within the target raises them by a fixed step, up to the configured
+// bandwidth.
+class io_scheduler
+{
+    public:
+        enum resource
+        {
+            DISK_READ,
+            DISK_WRITE,
+            NETWORK
+        };
+        const static size_t RESOURCES = 3;
+
+    public:
+        io_scheduler();
+        ~io_scheduler() throw ();
+
+    public:
+        // target is the client p99 in microseconds, and zero leaves background
+        // work unpaced; bandwidth is the most each resource may use per second
+        void setup(uint64_t target, uint64_t bandwidth);
+        bool enabled() const { return m_target > 0; }
+        // report the time, in nanoseconds, taken to serve a client request;
+        // any number of threads may call this simultaneously
+        void observe(uint64_t nanos);
+        // take bytes from the bucket without waiting
+        void charge(resource r, uint64_t bytes);
+        // is the bucket overdrawn?
+        bool exhausted(resource r);
+        // sleep while the bucket is overdrawn, for at most WAIT_MAX
+        // nanoseconds so the caller can notice it has been interrupted
+        void wait(resource r);
+        void consume(resource r, uint64_t bytes) { charge(r, bytes); wait(r); }
+
+    public:
+        // current budget in bytes per second
+        uint64_t budget(resource r);
+        uint64_t consumed(resource r) const;
+        uint64_t throttled() const { return m_throttled.read(); }
+        // client p99 in microseconds as of the last adjustment
+        uint64_t client_p99();
+
+    private:
+        struct bucket
+        {
+            bucket() : rate(0), tokens(0), refilled(0) {}
+            uint64_t rate;
+            int64_t tokens;
+            uint64_t refilled;
+        };
+        // latencies are bucketed by powers of two microseconds
+        const static size_t HISTOGRAM = 40;
+        const static uint64_t ADJUST_INTERVAL = 100ULL * 1000ULL * 1000ULL;
+        const static uint64_t WAIT_MAX = 100ULL * 1000ULL * 1000ULL;
+        const static uint64_t MIN_SAMPLES = 16;
+
+    private:
+        // call with m_protect held
+        void refill(bucket* b, uint64_t now);
+        void adjust(uint64_t now);
+        uint64_t percentile99();
+
+    private:
+        uint64_t m_target;
+        uint64_t m_bandwidth;
+        uint64_t m_histogram[HISTOGRAM];
+        uint64_t m_consumed[RESOURCES];
+        performance_counter m_throttled;
+        po6::threads::mutex m_protect;
+        bucket m_buckets[RESOURCES];
+        uint64_t m_seen[HISTOGRAM];
+        uint64_t m_adjusted;
+        uint64_t m_p99;
+
+    private:
+        io_scheduler(const io_scheduler&);
+        io_scheduler& operator = (const io_scheduler&);
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_io_scheduler_h_
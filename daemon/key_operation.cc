@@ -53,16 +53,35 @@ key_operation :: key_operation(uint64_t old_version,
     , m_sent()
     , m_value(_value)
     , m_memory(memory)
+    , m_delta()
     , m_type(UNKNOWN)
     , m_this_old_region()
     , m_this_new_region()
     , m_prev_region()
     , m_next_region()
+    , m_pending()
+    , m_trace_id(0)
 {
 }
 
 key_operation :: ~key_operation() throw ()
 {
+    if (m_pending)
+    {
+        m_pending->pending_dec();
+    }
+}
+
+void
+key_operation :: track_pending(const e::compat::shared_ptr<region_stats::counters>& c)
+{
+    assert(!m_pending);
+    m_pending = c;
+
+    if (m_pending)
+    {
+        m_pending->pending_inc();
+    }
 }
 
 void
@@ -114,6 +133,7 @@ key_operation :: debug_dump()
 {
     LOG(INFO) << "    unique op id: prev=" << m_prev_version << " this=" << m_this_version;
     LOG(INFO) << "    has value: " << (m_has_value ? "yes" : "no");
+    LOG(INFO) << "    delta: " << m_delta.size() << " funcall lists";
     LOG(INFO) << "    recv: version=" << m_recv_config_version << " from=" << m_recv;
     LOG(INFO) << "    sent: version=" << m_sent_config_version << " to=" << m_sent;
     LOG(INFO) << "    fresh: " << (m_fresh ? "yes" : "no");
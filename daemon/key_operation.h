@@ -30,19 +30,28 @@
 
 // STL
 #include <memory>
+#include <vector>
 
 // e
 #include <e/arena.h>
+#include <e/compat.h>
 #include <e/intrusive_ptr.h>
 
 // HyperDex
 #include "namespace.h"
+#include "common/funcall.h"
 #include "common/ids.h"
+#include "daemon/region_stats.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 
 class key_operation
 {
+    public:
+        // funcall lists that, applied in order to the previous version,
+        // produce this op's value
+        typedef std::vector<std::vector<funcall> > delta_t;
+
     public:
         key_operation(uint64_t old_version,
                       uint64_t new_version,
@@ -97,6 +106,20 @@ class key_operation
         bool has_value() { return m_has_value; }
         const std::vector<e::slice>& value() { return m_value; }
 
+        // replicate as a delta rather than the full value; the funcalls'
+        // arguments must live in this op's memory
+        void set_delta(const delta_t& delta) { m_delta = delta; }
+        void clear_delta() { m_delta.clear(); }
+        bool has_delta() const { return !m_delta.empty(); }
+        const delta_t& delta() const { return m_delta; }
+
+        // count this op in the region's pending depth until it is destroyed
+        void track_pending(const e::compat::shared_ptr<region_stats::counters>& c);
+
+        // nonzero if a client asked to trace the write this op carries
+        void set_trace_id(uint64_t trace_id) { m_trace_id = trace_id; }
+        uint64_t trace_id() const { return m_trace_id; }
+
         void debug_dump();
 
     private:
@@ -119,12 +142,15 @@ class key_operation
 
         const std::vector<e::slice> m_value;
         const std::auto_ptr<e::arena> m_memory;
+        delta_t m_delta;
 
         enum { UNKNOWN, CONTINUOUS, DISCONTINUOUS } m_type;
         region_id m_this_old_region;
         region_id m_this_new_region;
         region_id m_prev_region;
         region_id m_next_region;
+        e::compat::shared_ptr<region_stats::counters> m_pending;
+        uint64_t m_trace_id;
 
     private:
         key_operation(const key_operation&);
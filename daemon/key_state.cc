@@ -27,13 +27,18 @@
 
 #define __STDC_LIMIT_MACROS
 
+// C
+#include <string.h>
+
 // Google Log
 #include <glog/logging.h>
 
 // HyperDex
+#include "common/funcall.h"
 #include "common/hash.h"
 #include "common/network_returncode.h"
 #include "daemon/auth.h"
+#include "daemon/change_combiner.h"
 #include "daemon/daemon.h"
 #include "daemon/key_region.h"
 #include "daemon/key_state.h"
@@ -83,15 +88,17 @@ struct key_state::deferred_key_change
 
 struct key_state::client_response
 {
-    client_response() : respond_after(0), client(), nonce(), ret() {}
+    client_response() : respond_after(0), client(), nonce(), ret(), trace_id(0) {}
     client_response(uint64_t _respond_after,
                     server_id _client,
                     uint64_t _nonce,
-                    network_returncode _ret)
+                    network_returncode _ret,
+                    uint64_t _trace_id)
         : respond_after(_respond_after)
         , client(_client)
         , nonce(_nonce)
         , ret(_ret)
+        , trace_id(_trace_id)
     {
     }
     ~client_response() throw () {}
@@ -106,6 +113,7 @@ struct key_state::client_response
     server_id client;
     uint64_t nonce;
     network_returncode ret;
+    uint64_t trace_id;
 };
 
 key_state :: key_state(const key_region& kr)
@@ -116,6 +124,7 @@ key_state :: key_state(const key_region& kr)
     , m_chain_ops()
     , m_chain_subspaces()
     , m_chain_acks()
+    , m_chain_nacks()
     , m_lock()
     , m_avail(&m_lock)
     , m_someone_is_working_the_state_machine(false)
@@ -263,14 +272,18 @@ struct key_state::stub_chain_op
                   bool _fresh,
                   bool _has_value,
                   const std::vector<e::slice>& _value,
-                  std::auto_ptr<e::buffer> _backing)
+                  const key_operation::delta_t& _delta,
+                  std::auto_ptr<e::buffer> _backing,
+                  uint64_t _trace_id)
         : from(_from)
         , old_version(_old_version)
         , new_version(_new_version)
         , fresh(_fresh)
         , has_value(_has_value)
         , value(_value)
+        , delta(_delta)
         , backing(_backing)
+        , trace_id(_trace_id)
     {
     }
     ~stub_chain_op() throw () {}
@@ -281,7 +294,9 @@ struct key_state::stub_chain_op
     bool fresh;
     bool has_value;
     std::vector<e::slice> value;
+    key_operation::delta_t delta;
     std::auto_ptr<e::buffer> backing;
+    uint64_t trace_id;
 };
 
 void
@@ -294,18 +309,20 @@ key_state :: enqueue_chain_op(replication_manager* rm,
                               bool fresh,
                               bool has_value,
                               const std::vector<e::slice>& value,
-                              std::auto_ptr<e::buffer> backing)
+                              const key_operation::delta_t& delta,
+                              std::auto_ptr<e::buffer> backing,
+                              uint64_t trace_id)
 {
     bool have_it = possibly_takeover_state_machine();
 
     if (have_it)
     {
-        do_chain_op(rm, us, sc, from, old_version, new_version, fresh, has_value, value, backing);
+        do_chain_op(rm, us, sc, from, old_version, new_version, fresh, has_value, value, delta, backing, trace_id);
         work_state_machine_with_work_bit(rm, us, sc);
     }
     else
     {
-        m_chain_ops.push(new stub_chain_op(from, old_version, new_version, fresh, has_value, value, backing));
+        m_chain_ops.push(new stub_chain_op(from, old_version, new_version, fresh, has_value, value, delta, backing, trace_id));
         someone_needs_to_work_the_state_machine();
         work_state_machine_or_pass_the_buck(rm, us, sc);
     }
@@ -321,7 +338,8 @@ struct key_state::stub_chain_subspace
                         const region_id& _prev_region,
                         const region_id& _this_old_region,
                         const region_id& _this_new_region,
-                        const region_id& _next_region)
+                        const region_id& _next_region,
+                        uint64_t _trace_id)
         : from(_from)
         , old_version(_old_version)
         , new_version(_new_version)
@@ -331,6 +349,7 @@ struct key_state::stub_chain_subspace
         , this_old_region(_this_old_region)
         , this_new_region(_this_new_region)
         , next_region(_next_region)
+        , trace_id(_trace_id)
     {
     }
     ~stub_chain_subspace() throw () {}
@@ -344,6 +363,7 @@ struct key_state::stub_chain_subspace
     region_id this_old_region;
     region_id this_new_region;
     region_id next_region;
+    uint64_t trace_id;
 };
 
 void
@@ -358,18 +378,19 @@ key_state :: enqueue_chain_subspace(replication_manager* rm,
                                     const region_id& prev_region,
                                     const region_id& this_old_region,
                                     const region_id& this_new_region,
-                                    const region_id& next_region)
+                                    const region_id& next_region,
+                                    uint64_t trace_id)
 {
     bool have_it = possibly_takeover_state_machine();
 
     if (have_it)
     {
-        do_chain_subspace(rm, us, sc, from, old_version, new_version, value, backing, prev_region, this_old_region, this_new_region, next_region);
+        do_chain_subspace(rm, us, sc, from, old_version, new_version, value, backing, prev_region, this_old_region, this_new_region, next_region, trace_id);
         work_state_machine_with_work_bit(rm, us, sc);
     }
     else
     {
-        m_chain_subspaces.push(new stub_chain_subspace(from, old_version, new_version, value, backing, prev_region, this_old_region, this_new_region, next_region));
+        m_chain_subspaces.push(new stub_chain_subspace(from, old_version, new_version, value, backing, prev_region, this_old_region, this_new_region, next_region, trace_id));
         someone_needs_to_work_the_state_machine();
         work_state_machine_or_pass_the_buck(rm, us, sc);
     }
@@ -411,6 +432,42 @@ key_state :: enqueue_chain_ack(replication_manager* rm,
     }
 }
 
+struct key_state::stub_chain_nack
+{
+    stub_chain_nack(const virtual_server_id& _to,
+                    uint64_t _version)
+        : to(_to)
+        , version(_version)
+    {
+    }
+    ~stub_chain_nack() throw () {}
+
+    virtual_server_id to;
+    uint64_t version;
+};
+
+void
+key_state :: enqueue_chain_nack(replication_manager* rm,
+                                const virtual_server_id& us,
+                                const schema& sc,
+                                const virtual_server_id& to,
+                                uint64_t version)
+{
+    bool have_it = possibly_takeover_state_machine();
+
+    if (have_it)
+    {
+        do_chain_nack(rm, us, to, version);
+        work_state_machine_with_work_bit(rm, us, sc);
+    }
+    else
+    {
+        m_chain_nacks.push(new stub_chain_nack(to, version));
+        someone_needs_to_work_the_state_machine();
+        work_state_machine_or_pass_the_buck(rm, us, sc);
+    }
+}
+
 void
 key_state :: work_state_machine(replication_manager* rm,
                                 const virtual_server_id& us,
@@ -458,6 +515,36 @@ key_state :: max_version()
     return ret;
 }
 
+void
+key_state :: wipe_truncated(replication_manager* rm, uint64_t truncated_before)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+
+    while (m_someone_is_working_the_state_machine)
+    {
+        m_avail.wait();
+    }
+
+    // leave the key to the state machine if a write is under way; writes
+    // from after the truncation do not follow the old value
+    if (m_someone_needs_to_work_the_state_machine ||
+        !m_committable_empty || !m_blocked_empty ||
+        !m_deferred_empty || !m_changes_empty ||
+        !m_has_old_value || m_old_version >= truncated_before)
+    {
+        return;
+    }
+
+    if (rm->m_daemon->m_data.del(m_ri, m_key, m_old_value) != datalayer::SUCCESS)
+    {
+        LOG(ERROR) << "could not delete truncated object from " << m_ri;
+        return;
+    }
+
+    // keep the version so that the next write still lines up
+    m_has_old_value = false;
+}
+
 void
 key_state :: reconfigure(e::garbage_collector* gc)
 {
@@ -472,6 +559,7 @@ key_state :: reconfigure(e::garbage_collector* gc)
     stub_chain_op* sco;
     stub_chain_subspace* scs;
     stub_chain_ack* scack;
+    stub_chain_nack* scnack;
 
     while (m_client_atomics.pop(gc, &sca))
     {
@@ -493,6 +581,11 @@ key_state :: reconfigure(e::garbage_collector* gc)
         delete scack;
     }
 
+    while (m_chain_nacks.pop(gc, &scnack))
+    {
+        delete scnack;
+    }
+
     m_deferred.clear();
     CHECK_INVARIANTS();
 }
@@ -511,6 +604,7 @@ key_state :: reset(e::garbage_collector* gc)
     stub_chain_op* sco;
     stub_chain_subspace* scs;
     stub_chain_ack* scack;
+    stub_chain_nack* scnack;
 
     while (m_client_atomics.pop(gc, &sca))
     {
@@ -532,6 +626,11 @@ key_state :: reset(e::garbage_collector* gc)
         delete scack;
     }
 
+    while (m_chain_nacks.pop(gc, &scnack))
+    {
+        delete scnack;
+    }
+
     m_someone_is_working_the_state_machine = false;
     m_someone_needs_to_work_the_state_machine = false;
     m_avail.broadcast();
@@ -560,7 +659,7 @@ key_state :: resend_committable(replication_manager* rm,
             it != m_committable.end(); ++it)
     {
         // skip those messages already sent in this version
-        if ((*it)->sent_version() >= rm->m_daemon->m_config.version())
+        if ((*it)->sent_version() >= rm->m_daemon->m_config->version())
         {
             continue;
         }
@@ -763,6 +862,7 @@ key_state :: work_state_machine_with_work_bit(replication_manager* rm,
         stub_chain_op* sco;
         stub_chain_subspace* scs;
         stub_chain_ack* scack;
+        stub_chain_nack* scnack;
 
         while (m_client_atomics.pop(gc, &sca))
         {
@@ -772,14 +872,15 @@ key_state :: work_state_machine_with_work_bit(replication_manager* rm,
 
         while (m_chain_ops.pop(gc, &sco))
         {
-            do_chain_op(rm, us, sc, sco->from, sco->old_version, sco->new_version, sco->fresh, sco->has_value, sco->value, sco->backing);
+            do_chain_op(rm, us, sc, sco->from, sco->old_version, sco->new_version, sco->fresh, sco->has_value, sco->value, sco->delta, sco->backing, sco->trace_id);
             delete sco;
         }
 
         while (m_chain_subspaces.pop(gc, &scs))
         {
             do_chain_subspace(rm, us, sc, scs->from, scs->old_version, scs->new_version, scs->value, scs->backing,
-                              scs->prev_region, scs->this_old_region, scs->this_new_region, scs->next_region);
+                              scs->prev_region, scs->this_old_region, scs->this_new_region, scs->next_region,
+                              scs->trace_id);
             delete scs;
         }
 
@@ -789,6 +890,12 @@ key_state :: work_state_machine_with_work_bit(replication_manager* rm,
             delete scack;
         }
 
+        while (m_chain_nacks.pop(gc, &scnack))
+        {
+            do_chain_nack(rm, us, scnack->to, scnack->version);
+            delete scnack;
+        }
+
         bool did_work = false;
         CHECK_INVARIANTS();
 
@@ -877,27 +984,54 @@ key_state :: do_client_atomic(replication_manager* rm,
 void
 key_state :: do_chain_op(replication_manager* rm,
                          const virtual_server_id& us,
-                         const schema&,
+                         const schema& sc,
                          const virtual_server_id& from,
                          uint64_t old_version,
                          uint64_t new_version,
                          bool fresh,
                          bool has_value,
                          const std::vector<e::slice>& value,
-                         std::auto_ptr<e::buffer> backing)
+                         const key_operation::delta_t& delta,
+                         std::auto_ptr<e::buffer> backing,
+                         uint64_t trace_id)
 {
     e::intrusive_ptr<key_operation> op = get(new_version);
     std::auto_ptr<e::arena> memory(new e::arena());
     memory->takeover(backing.release());
 
+    if (!op && !delta.empty() && new_version > m_old_version)
+    {
+        std::vector<e::slice> rebuilt;
+
+        if (!apply_delta(sc, old_version, fresh, delta, memory.get(), &rebuilt))
+        {
+            // we don't have the version the delta is against; the sender
+            // will follow up with the full value
+            rm->send_nack(us, from, new_version, m_key);
+            return;
+        }
+
+        op = enqueue_continuous_key_op(old_version, new_version, fresh,
+                                       true, rebuilt, memory);
+        op->track_pending(rm->m_daemon->m_region_stats.get(m_ri));
+        // the delta's funcalls point into the message now owned by op
+        op->set_delta(delta);
+    }
+
     if (!op)
     {
         op = enqueue_continuous_key_op(old_version, new_version, fresh,
                                        has_value, value, memory);
+        op->track_pending(rm->m_daemon->m_region_stats.get(m_ri));
     }
 
     assert(op);
-    op->set_recv(rm->m_daemon->m_config.version(), from);
+    op->set_recv(rm->m_daemon->m_config->version(), from);
+
+    if (trace_id)
+    {
+        op->set_trace_id(trace_id);
+    }
 
     if (op->ackable())
     {
@@ -917,7 +1051,8 @@ key_state :: do_chain_subspace(replication_manager* rm,
                                const region_id& prev_region,
                                const region_id& this_old_region,
                                const region_id& this_new_region,
-                               const region_id& next_region)
+                               const region_id& next_region,
+                               uint64_t trace_id)
 {
     e::intrusive_ptr<key_operation> op = get(new_version);
     std::auto_ptr<e::arena> memory(new e::arena());
@@ -929,10 +1064,16 @@ key_state :: do_chain_subspace(replication_manager* rm,
                                           value, memory,
                                           prev_region, this_old_region,
                                           this_new_region, next_region);
+        op->track_pending(rm->m_daemon->m_region_stats.get(m_ri));
     }
 
     assert(op);
-    op->set_recv(rm->m_daemon->m_config.version(), from);
+    op->set_recv(rm->m_daemon->m_config->version(), from);
+
+    if (trace_id)
+    {
+        op->set_trace_id(trace_id);
+    }
 
     if (op->ackable())
     {
@@ -957,7 +1098,7 @@ key_state :: do_chain_ack(replication_manager* rm,
         return;
     }
 
-    if (!op->sent_to(rm->m_daemon->m_config.version(), from))
+    if (!op->sent_to(rm->m_daemon->m_config->version(), from))
     {
         return;
     }
@@ -967,6 +1108,28 @@ key_state :: do_chain_ack(replication_manager* rm,
     rm->collect(m_ri, op);
 }
 
+void
+key_state :: do_chain_nack(replication_manager* rm,
+                           const virtual_server_id& us,
+                           const virtual_server_id& to,
+                           uint64_t version)
+{
+    e::intrusive_ptr<key_operation> op = get(version);
+
+    if (!op || !op->has_delta())
+    {
+        return;
+    }
+
+    op->clear_delta();
+
+    if (op->sent_to(rm->m_daemon->m_config->version(), to))
+    {
+        op->set_sent(0, virtual_server_id());
+        rm->send_message(us, m_key, op);
+    }
+}
+
 void
 key_state :: add_response(const client_response& cr)
 {
@@ -984,6 +1147,7 @@ key_state :: send_responses(replication_manager* rm,
     {
         const client_response& cr(m_client_responses_heap[0]);
         rm->respond_to_client(us, cr.client, cr.nonce, cr.ret);
+        rm->m_daemon->m_traces.record(cr.trace_id, trace_ring::CLIENT_RESPONSE, m_ri.get(), cr.respond_after);
 
         std::pop_heap(m_client_responses_heap.begin(),
                       m_client_responses_heap.end());
@@ -1116,6 +1280,62 @@ key_state :: get_latest(bool* has_old_value,
     }
 }
 
+bool
+key_state :: truncated_between(replication_manager* rm,
+                               uint64_t old_version,
+                               uint64_t new_version)
+{
+    uint64_t truncated_before = rm->truncated_before(m_ri);
+    return 0 < old_version &&
+           old_version < truncated_before &&
+           truncated_before < new_version;
+}
+
+bool
+key_state :: apply_delta(const schema& sc,
+                         uint64_t old_version,
+                         bool fresh,
+                         const key_operation::delta_t& delta,
+                         e::arena* memory,
+                         std::vector<e::slice>* value)
+{
+    std::vector<e::slice> base(sc.attrs_sz - 1);
+
+    // a fresh op was computed by the point leader from an empty object
+    if (!fresh)
+    {
+        e::intrusive_ptr<key_operation> prev = get(old_version);
+
+        if (prev && prev->has_value())
+        {
+            base = prev->value();
+        }
+        else if (!prev && m_old_version == old_version && m_has_old_value)
+        {
+            base = m_old_value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    value->resize(sc.attrs_sz - 1);
+
+    for (size_t i = 0; i < delta.size(); ++i)
+    {
+        if (apply_funcs(sc, delta[i], m_key, base, memory, value) < delta[i].size())
+        {
+            return false;
+        }
+
+        base.swap(*value);
+    }
+
+    value->swap(base);
+    return true;
+}
+
 bool
 key_state :: drain_queue(replication_manager* rm,
                          const virtual_server_id& us,
@@ -1178,8 +1398,70 @@ key_state :: drain_queue(replication_manager* rm,
     return did_work;
 }
 
+namespace
+{
+
+// the most queued changes folded into a single version
+const size_t COMBINE_MAX = 64;
+
+// changes that apply cleanly to any value of the key, regardless of what the
+// changes queued ahead of them did
+bool
+combinable(const hyperdex::key_change& kc)
+{
+    if (kc.erase || kc.fail_if_not_found || kc.fail_if_found ||
+        !kc.checks.empty() || kc.funcs.empty())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < kc.funcs.size(); ++i)
+    {
+        switch (kc.funcs[i].name)
+        {
+            case hyperdex::FUNC_NUM_ADD:
+            case hyperdex::FUNC_NUM_SUB:
+            case hyperdex::FUNC_LIST_LPUSH:
+            case hyperdex::FUNC_LIST_RPUSH:
+            case hyperdex::FUNC_SET_ADD:
+            case hyperdex::FUNC_MAP_ADD:
+                break;
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void
+copy_slice(e::arena* memory, e::slice* s)
+{
+    unsigned char* tmp = NULL;
+    memory->allocate(s->size(), &tmp);
+    memmove(tmp, s->data(), s->size());
+    *s = e::slice(tmp, s->size());
+}
+
+// copy funcs into memory so that they outlive the client's message
 void
-key_state :: drain_changes(replication_manager*,
+copy_funcs(const std::vector<hyperdex::funcall>& funcs,
+           e::arena* memory,
+           std::vector<hyperdex::funcall>* out)
+{
+    *out = funcs;
+
+    for (size_t i = 0; i < out->size(); ++i)
+    {
+        copy_slice(memory, &(*out)[i].arg1);
+        copy_slice(memory, &(*out)[i].arg2);
+    }
+}
+
+} // namespace
+
+void
+key_state :: drain_changes(replication_manager* rm,
                            const virtual_server_id&,
                            const schema& sc)
 {
@@ -1200,17 +1482,24 @@ key_state :: drain_changes(replication_manager*,
     m_changes.pop_front();
     key_change* kc = dkc->kc.get();
 
-    if (!auth_verify_write(sc, has_old_value, old_value, *kc))
+    // A value from before a truncation may still be stored until the
+    // wiper deletes it, but the change must not see it.  The operation is
+    // fresh, because a replica's wiper may already have removed the value
+    // it would otherwise follow.
+    const bool truncated = truncated_between(rm, old_version, dkc->version);
+    const bool visible = has_old_value && !truncated;
+
+    if (!auth_verify_write(sc, visible, old_value, *kc))
     {
-        add_response(client_response(old_version, dkc->from, dkc->nonce, NET_UNAUTHORIZED));
+        add_response(client_response(old_version, dkc->from, dkc->nonce, NET_UNAUTHORIZED, kc->trace_id));
         return;
     }
 
-    network_returncode nrc = kc->check(sc, has_old_value, old_value);
+    network_returncode nrc = kc->check(sc, visible, old_value);
 
     if (nrc != NET_SUCCESS)
     {
-        add_response(client_response(old_version, dkc->from, dkc->nonce, nrc));
+        add_response(client_response(old_version, dkc->from, dkc->nonce, nrc, kc->trace_id));
         return;
     }
 
@@ -1221,7 +1510,10 @@ key_state :: drain_changes(replication_manager*,
                                false, std::vector<e::slice>(sc.attrs_sz - 1),
                                std::auto_ptr<e::arena>());
         op->set_continuous();
-        add_response(client_response(dkc->version, dkc->from, dkc->nonce, NET_SUCCESS));
+        op->track_pending(rm->m_daemon->m_region_stats.get(m_ri));
+        op->set_trace_id(kc->trace_id);
+        rm->m_daemon->m_traces.record(kc->trace_id, trace_ring::ORDERED, m_ri.get(), dkc->version);
+        add_response(client_response(dkc->version, dkc->from, dkc->nonce, NET_SUCCESS, kc->trace_id));
         m_deferred.push_back(op);
         return;
     }
@@ -1231,7 +1523,7 @@ key_state :: drain_changes(replication_manager*,
 
     // if there is no old value, pretend it is "new_value" which is
     // zero-initialized
-    if (!has_old_value)
+    if (!visible)
     {
         old_value = &new_value;
     }
@@ -1240,16 +1532,97 @@ key_state :: drain_changes(replication_manager*,
 
     if (funcs_passed < kc->funcs.size())
     {
-        add_response(client_response(old_version, dkc->from, dkc->nonce, NET_CMPFAIL));
+        add_response(client_response(old_version, dkc->from, dkc->nonce, NET_CMPFAIL, kc->trace_id));
         return;
     }
 
+    std::vector<e::intrusive_ptr<deferred_key_change> > applied;
+    applied.push_back(dkc);
+    uint64_t version = dkc->version;
+
+    // While an earlier update to this key is in flight, fold the commutative
+    // updates queued behind this one into it.  They are applied in order, so
+    // the result is the same as issuing them one at a time, but the chain
+    // sees one version, one CHAIN_OP, and one disk write.  Each client still
+    // gets its own response once the combined version commits.
+    if (!m_committable.empty() && combinable(*kc))
+    {
+        change_combiner combined(sc, m_key, memory, new_value);
+
+        while (!m_changes.empty() &&
+               applied.size() < COMBINE_MAX &&
+               combinable(*m_changes.front()->kc) &&
+               !truncated_between(rm, version, m_changes.front()->version))
+        {
+            e::intrusive_ptr<deferred_key_change> next = m_changes.front();
+            m_changes.pop_front();
+            const key_change& nkc(*next->kc);
+
+            if (!auth_verify_write(sc, true, &combined.value(), nkc))
+            {
+                add_response(client_response(old_version, next->from, next->nonce, NET_UNAUTHORIZED, nkc.trace_id));
+                continue;
+            }
+
+            if (!combined.fold(nkc.funcs))
+            {
+                add_response(client_response(old_version, next->from, next->nonce, NET_CMPFAIL, nkc.trace_id));
+                continue;
+            }
+
+            version = next->version;
+            applied.push_back(next);
+        }
+
+        new_value = combined.value();
+        memory = combined.memory();
+    }
+
+    // ship the funcalls instead of the value when they are much smaller, as
+    // when appending to a large list or document
+    key_operation::delta_t delta;
+
+    // replicas would apply the funcalls to the truncated value
+    if (rm->m_delta_replication && !truncated)
+    {
+        size_t delta_sz = 0;
+
+        for (size_t i = 0; i < applied.size(); ++i)
+        {
+            delta_sz += pack_size(applied[i]->kc->funcs);
+        }
+
+        if (delta_sz * 2 < pack_size(new_value))
+        {
+            delta.resize(applied.size());
+
+            for (size_t i = 0; i < applied.size(); ++i)
+            {
+                copy_funcs(applied[i]->kc->funcs, memory.get(), &delta[i]);
+            }
+        }
+    }
+
     e::intrusive_ptr<key_operation> op;
-    op = new key_operation(old_version, dkc->version, !has_old_value,
+    op = new key_operation(old_version, version, !visible,
                            true, new_value, memory);
     op->set_continuous();
-    add_response(client_response(dkc->version, dkc->from, dkc->nonce, NET_SUCCESS));
+    op->set_delta(delta);
+    op->track_pending(rm->m_daemon->m_region_stats.get(m_ri));
     m_deferred.push_back(op);
+
+    for (size_t i = 0; i < applied.size(); ++i)
+    {
+        const uint64_t trace_id = applied[i]->kc->trace_id;
+        add_response(client_response(version, applied[i]->from, applied[i]->nonce, NET_SUCCESS, trace_id));
+        rm->m_daemon->m_traces.record(trace_id, trace_ring::ORDERED, m_ri.get(), version);
+
+        // the chain can follow only one trace; it follows the first
+        if (op->trace_id() == 0)
+        {
+            op->set_trace_id(trace_id);
+        }
+    }
 }
 
 bool
@@ -1293,7 +1666,7 @@ key_state :: drain_deferred(replication_manager* rm,
 
     if (op->is_continuous())
     {
-        hash_objects(&rm->m_daemon->m_config, m_ri, sc,
+        hash_objects(rm->m_daemon->m_config, m_ri, sc,
                      op->has_value(), op->value(),
                      has_old_value, old_value ? *old_value : op->value(), op);
     }
@@ -1313,8 +1686,8 @@ key_state :: drain_deferred(replication_manager* rm,
     // check that the sender was the correct sender
     if (op->is_continuous() &&
         op->recv_from() != virtual_server_id() &&
-        rm->m_daemon->m_config.next_in_region(op->recv_from()) != us &&
-        !rm->m_daemon->m_config.subspace_adjacent(op->recv_from(), us))
+        rm->m_daemon->m_config->next_in_region(op->recv_from()) != us &&
+        !rm->m_daemon->m_config->subspace_adjacent(op->recv_from(), us))
     {
         LOG(WARNING) << "dropping deferred CHAIN_OP which didn't come from the right host: "
                      << "we're using key " << e::slice(state_key().key).hex() << " in region "
@@ -1326,8 +1699,8 @@ key_state :: drain_deferred(replication_manager* rm,
 
     if (op->is_discontinuous() &&
         op->recv_from() != virtual_server_id() &&
-        rm->m_daemon->m_config.next_in_region(op->recv_from()) != us &&
-        rm->m_daemon->m_config.tail_of_region(op->this_old_region()) != op->recv_from())
+        rm->m_daemon->m_config->next_in_region(op->recv_from()) != us &&
+        rm->m_daemon->m_config->tail_of_region(op->this_old_region()) != op->recv_from())
     {
         LOG(WARNING) << "dropping deferred CHAIN_SUBSPACE which didn't come from the right host: "
                      << "we're using key " << e::slice(state_key().key).hex() << " in region "
@@ -1399,6 +1772,7 @@ key_state :: drain_committable(replication_manager* rm,
         assert(op);
         assert(op->this_version() == version);
         datalayer::returncode rc = datalayer::SUCCESS;
+        rm->m_daemon->m_traces.record(op->trace_id(), trace_ring::WRITE_START, m_ri.get(), version);
 
         // if this is a case where we are to remove the object from disk
         // because of a delete or the first half of a subspace transfer
@@ -1423,6 +1797,8 @@ key_state :: drain_committable(replication_manager* rm,
             }
         }
 
+        rm->m_daemon->m_traces.record(op->trace_id(), trace_ring::WRITE_DONE, m_ri.get(), version);
+
         switch (rc)
         {
             case datalayer::SUCCESS:
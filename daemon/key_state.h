@@ -74,7 +74,9 @@ class key_state
                               bool fresh,
                               bool has_value,
                               const std::vector<e::slice>& value,
-                              std::auto_ptr<e::buffer> backing);
+                              const key_operation::delta_t& delta,
+                              std::auto_ptr<e::buffer> backing,
+                              uint64_t trace_id);
         void enqueue_chain_subspace(replication_manager* rm,
                                     const virtual_server_id& us,
                                     const schema& sc,
@@ -86,17 +88,27 @@ class key_state
                                     const region_id& prev_region,
                                     const region_id& this_old_region,
                                     const region_id& this_new_region,
-                                    const region_id& next_region);
+                                    const region_id& next_region,
+                                    uint64_t trace_id);
         void enqueue_chain_ack(replication_manager* rm,
                                 const virtual_server_id& us,
                                 const schema& sc,
                                 const virtual_server_id& from,
                                uint64_t version);
+        // "to" could not apply the delta for version; send it the value
+        void enqueue_chain_nack(replication_manager* rm,
+                                const virtual_server_id& us,
+                                const schema& sc,
+                                const virtual_server_id& to,
+                                uint64_t version);
         void work_state_machine(replication_manager* rm,
                                 const virtual_server_id& us,
                                 const schema& sc);
 
         uint64_t max_version();
+        // delete the stored value if it is older than truncated_before and no
+        // write to the key is in flight here
+        void wipe_truncated(replication_manager* rm, uint64_t truncated_before);
         void reconfigure(e::garbage_collector* gc);
         void reset(e::garbage_collector* gc);
 
@@ -113,6 +125,7 @@ class key_state
         struct stub_chain_op;
         struct stub_chain_subspace;
         struct stub_chain_ack;
+        struct stub_chain_nack;
         struct client_response;
         typedef std::list<e::intrusive_ptr<key_operation> > key_operation_list_t;
         typedef std::list<e::intrusive_ptr<deferred_key_change> > key_change_list_t;
@@ -148,7 +161,9 @@ class key_state
                          bool fresh,
                          bool has_value,
                          const std::vector<e::slice>& value,
-                         std::auto_ptr<e::buffer> backing);
+                         const key_operation::delta_t& delta,
+                         std::auto_ptr<e::buffer> backing,
+                         uint64_t trace_id);
         void do_chain_subspace(replication_manager* rm,
                                const virtual_server_id& us,
                                const schema& sc,
@@ -160,12 +175,17 @@ class key_state
                                const region_id& prev_region,
                                const region_id& this_old_region,
                                const region_id& this_new_region,
-                               const region_id& next_region);
+                               const region_id& next_region,
+                               uint64_t trace_id);
         void do_chain_ack(replication_manager* rm,
                           const virtual_server_id& us,
                           const schema& sc,
                           const virtual_server_id& from,
                           uint64_t version);
+        void do_chain_nack(replication_manager* rm,
+                           const virtual_server_id& us,
+                           const virtual_server_id& to,
+                           uint64_t version);
         void add_response(const client_response& cr);
         void send_responses(replication_manager* rm,
                             const virtual_server_id& us);
@@ -186,9 +206,22 @@ class key_state
                                          const region_id& this_old_region,
                                          const region_id& this_new_region,
                                          const region_id& next_region);
+        // rebuild the value a delta produces from the version it is
+        // against; false if that version is unknown here
+        bool apply_delta(const schema& sc,
+                         uint64_t old_version,
+                         bool fresh,
+                         const key_operation::delta_t& delta,
+                         e::arena* memory,
+                         std::vector<e::slice>* value);
         void get_latest(bool* has_old_value,
                         uint64_t* old_version,
                         const std::vector<e::slice>** old_value);
+        // true if a truncation falls between the two versions, so that the
+        // old value does not exist for the new one
+        bool truncated_between(replication_manager* rm,
+                               uint64_t old_version,
+                               uint64_t new_version);
         bool drain_queue(replication_manager* rm,
                          const virtual_server_id& us,
                          const schema& sc,
@@ -237,6 +270,7 @@ class key_state
         e::lockfree_mpsc_fifo<stub_chain_op> m_chain_ops;
         e::lockfree_mpsc_fifo<stub_chain_subspace> m_chain_subspaces;
         e::lockfree_mpsc_fifo<stub_chain_ack> m_chain_acks;
+        e::lockfree_mpsc_fifo<stub_chain_nack> m_chain_nacks;
 
     // protected state, synchronized by m_lock;
     private:
@@ -87,6 +87,7 @@ class leveldb_release_ptr
     public:
         T* get() const { return m_resource->ptr; }
         leveldb::DB* db() const { return m_db.get(); }
+        long use_count() const { return m_resource.use_count(); }
         void reset(leveldb_db_ptr d, T* t)
         { m_db = d; m_resource.reset(new wrapper(d, t)); }
 
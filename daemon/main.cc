@@ -27,7 +27,16 @@
 
 #define __STDC_LIMIT_MACROS
 
+// C
+#include <cmath>
+#include <cstdlib>
+
+// POSIX
+#include <sys/statvfs.h>
+#include <unistd.h>
+
 // STL
+#include <algorithm>
 #include <stdexcept>
 
 // Google Log
@@ -44,8 +53,71 @@
 #include <busybee_utils.h>
 
 // HyperDex
+#include "common/server.h"
 #include "daemon/daemon.h"
 
+// Derived weights share the unit of the default weight:  a reference server
+// with REFERENCE_DISK_GB of disk and REFERENCE_CORES cores weighs
+// server::DEFAULT_WEIGHT, so derived, given and default weights compare.
+#define REFERENCE_DISK_GB 1024
+#define REFERENCE_CORES 8
+
+// the weight to register with the coordinator:  a number, or the size of
+// the data directory's filesystem ("disk"), the number of cores ("cpu"), or
+// the geometric mean of the two ("both"), each relative to the reference
+static bool
+capacity_weight(const char* spec, const char* data, uint64_t* weight)
+{
+    double disk = 0;
+    double cpu = 0;
+
+    if (strcmp(spec, "disk") == 0 || strcmp(spec, "both") == 0)
+    {
+        struct statvfs buf;
+
+        if (statvfs(data, &buf) < 0)
+        {
+            return false;
+        }
+
+        double gb = static_cast<double>(buf.f_blocks) * buf.f_frsize / (1ULL << 30);
+        disk = gb * hyperdex::server::DEFAULT_WEIGHT / REFERENCE_DISK_GB;
+    }
+
+    if (strcmp(spec, "cpu") == 0 || strcmp(spec, "both") == 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        double cores = n > 0 ? n : 0;
+        cpu = cores * hyperdex::server::DEFAULT_WEIGHT / REFERENCE_CORES;
+    }
+
+    if (strcmp(spec, "disk") == 0)
+    {
+        *weight = disk + 0.5;
+    }
+    else if (strcmp(spec, "cpu") == 0)
+    {
+        *weight = cpu + 0.5;
+    }
+    else if (strcmp(spec, "both") == 0)
+    {
+        *weight = sqrt(disk * cpu) + 0.5;
+    }
+    else
+    {
+        char* end = NULL;
+        *weight = strtoull(spec, &end, 10);
+
+        if (*spec == '\0' || *end != '\0')
+        {
+            return false;
+        }
+    }
+
+    *weight = std::max(*weight, static_cast<uint64_t>(1));
+    return true;
+}
+
 int
 main(int argc, const char* argv[])
 {
@@ -61,6 +133,18 @@ main(int argc, const char* argv[])
     const char* coordinator_host = "127.0.0.1";
     long coordinator_port = 1982;
     long threads = 0;
+    long value_log_threshold = 0;
+    bool thread_per_core = false;
+    long client_share = 4;
+    long replication_share = 2;
+    long background_share = 1;
+    bool delta_replication = false;
+    bool coalesce_messages = false;
+    long background_latency_target = 0;
+    long background_bandwidth = 256;
+    const char* capacity = NULL;
+    long slow_op_threshold = 0;
+    const char* slow_op_log = "";
     bool log_immediate = false;
 
     e::argparser ap;
@@ -95,6 +179,42 @@ main(int argc, const char* argv[])
     ap.arg().name('t', "threads")
             .description("the number of threads which will handle network traffic")
             .metavar("N").as_long(&threads);
+    ap.arg().long_name("value-log-threshold")
+            .description("store attribute values of at least this many bytes in a separate value log (default: 0, disabled)")
+            .metavar("bytes").as_long(&value_log_threshold);
+    ap.arg().long_name("thread-per-core")
+            .description("give each region's messages to a single worker thread, pinned to its own core and scheduled by traffic class")
+            .set_true(&thread_per_core);
+    ap.arg().long_name("client-share")
+            .description("in --thread-per-core mode, relative share of work for client requests (default: 4)")
+            .metavar("N").as_long(&client_share);
+    ap.arg().long_name("replication-share")
+            .description("in --thread-per-core mode, relative share of work for replication (default: 2)")
+            .metavar("N").as_long(&replication_share);
+    ap.arg().long_name("background-share")
+            .description("in --thread-per-core mode, relative share of work for transfers and backups (default: 1)")
+            .metavar("N").as_long(&background_share);
+    ap.arg().long_name("delta-replication")
+            .description("replicate small updates to large objects as the update rather than the whole object (every server must support it)")
+            .set_true(&delta_replication);
+    ap.arg().long_name("coalesce-messages")
+            .description("send small messages bound for the same server in one frame (every server must support it)")
+            .set_true(&coalesce_messages);
+    ap.arg().long_name("background-latency-target")
+            .description("slow transfers, wipes, and index builds whenever the client p99 exceeds this many microseconds (default: 0, never)")
+            .metavar("us").as_long(&background_latency_target);
+    ap.arg().long_name("background-bandwidth")
+            .description("most MB/s that background work may read, write, or send when paced (default: 256)")
+            .metavar("MB").as_long(&background_bandwidth);
+    ap.arg().long_name("capacity-weight")
+            .description("how much this server should hold relative to the others, where 100 is a server with 1TB of disk and 8 cores: a number, or \"disk\", \"cpu\", or \"both\" to derive it from this host on that scale (default: 100, or the last weight given)")
+            .metavar("W").as_string(&capacity);
+    ap.arg().long_name("slow-op-threshold")
+            .description("log searches, counts, group operations, and GETs that take at least this many milliseconds (default: 0, never)")
+            .metavar("ms").as_long(&slow_op_threshold);
+    ap.arg().long_name("slow-op-log")
+            .description("also append the slow operation log to this file, rotating it to file.1 as it grows (default: keep it in memory only)")
+            .metavar("file").as_string(&slow_op_log);
     ap.arg().long_name("log-immediate")
             .description("immediately flush all log output")
             .set_true(&log_immediate).hidden();
@@ -123,6 +243,46 @@ main(int argc, const char* argv[])
         return EXIT_FAILURE;
     }
 
+    if (value_log_threshold < 0)
+    {
+        std::cerr << "value-log-threshold cannot be negative" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (client_share <= 0 || client_share > 1000 ||
+        replication_share <= 0 || replication_share > 1000 ||
+        background_share <= 0 || background_share > 1000)
+    {
+        std::cerr << "traffic shares must be between 1 and 1000" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (background_latency_target < 0)
+    {
+        std::cerr << "background-latency-target cannot be negative" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (background_bandwidth <= 0)
+    {
+        std::cerr << "background-bandwidth must be positive" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (slow_op_threshold < 0)
+    {
+        std::cerr << "slow-op-threshold cannot be negative" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    uint64_t weight = 0;
+
+    if (capacity && !capacity_weight(capacity, data, &weight))
+    {
+        std::cerr << "cannot interpret capacity-weight \"" << capacity << "\"" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     po6::net::ipaddr listen_ip;
     po6::net::location bind_to;
 
@@ -196,7 +356,14 @@ main(int argc, const char* argv[])
                      std::string(pidfile), has_pidfile,
                      listen, bind_to,
                      coordinator, po6::net::hostname(coordinator_host, coordinator_port),
-                     threads);
+                     threads, value_log_threshold, thread_per_core,
+                     client_share, replication_share, background_share,
+                     delta_replication, coalesce_messages,
+                     background_latency_target,
+                     background_bandwidth * 1024ULL * 1024ULL,
+                     weight,
+                     slow_op_threshold * 1000ULL * 1000ULL,
+                     std::string(slow_op_log));
     }
     catch (std::exception& e)
     {
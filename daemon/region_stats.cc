@@ -0,0 +1,337 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <assert.h>
+#include <stdlib.h>
+
+// STL
+#include <algorithm>
+#include <map>
+
+// e
+#include <e/atomic.h>
+
+// HyperDex
+#include "daemon/datalayer.h"
+#include "daemon/region_stats.h"
+
+using hyperdex::region_id;
+using hyperdex::region_stats;
+
+const region_id region_stats::defaultri;
+
+region_stats :: region_stats()
+    : m_counters()
+    , m_protect()
+    , m_all()
+    , m_collections(0)
+{
+}
+
+region_stats :: ~region_stats() throw ()
+{
+}
+
+void
+region_stats :: count(const region_id& ri, op_type t, uint64_t bytes)
+{
+    e::compat::shared_ptr<counters> c;
+
+    if (m_counters.get(ri, &c))
+    {
+        c->tap(t, bytes);
+    }
+}
+
+void
+region_stats :: count(const region_id& ri, op_type t, uint64_t bytes,
+                      const e::slice& key)
+{
+    e::compat::shared_ptr<counters> c;
+
+    if (!m_counters.get(ri, &c))
+    {
+        return;
+    }
+
+    c->tap(t, bytes);
+
+    if (t == GET)
+    {
+        c->m_reads.observe(key);
+    }
+    else if (t == ATOMIC || t == CHAIN)
+    {
+        c->m_writes.observe(key);
+    }
+}
+
+void
+region_stats :: top_keys(const region_id& ri, size_t n,
+                         std::vector<hot_keys::entry>* reads,
+                         std::vector<hot_keys::entry>* writes)
+{
+    e::compat::shared_ptr<counters> c;
+    reads->clear();
+    writes->clear();
+
+    if (m_counters.get(ri, &c))
+    {
+        c->m_reads.top(n, reads);
+        c->m_writes.top(n, writes);
+    }
+}
+
+e::compat::shared_ptr<region_stats::counters>
+region_stats :: get(const region_id& ri)
+{
+    e::compat::shared_ptr<counters> c;
+    m_counters.get(ri, &c);
+    return c;
+}
+
+namespace
+{
+
+void
+output(const char* prefix, const std::string& name,
+       const region_stats::values& v,
+       uint64_t keys, std::ostringstream* ret)
+{
+    *ret << " " << prefix << "." << name << ".gets=" << v.gets;
+    *ret << " " << prefix << "." << name << ".atomics=" << v.atomics;
+    *ret << " " << prefix << "." << name << ".searches=" << v.searches;
+    *ret << " " << prefix << "." << name << ".chain_ops=" << v.chain_ops;
+    *ret << " " << prefix << "." << name << ".bytes_read=" << v.bytes_read;
+    *ret << " " << prefix << "." << name << ".bytes_written=" << v.bytes_written;
+    *ret << " " << prefix << "." << name << ".pending=" << v.pending;
+    *ret << " " << prefix << "." << name << ".keys=" << keys;
+}
+
+} // namespace
+
+void
+region_stats :: collect(datalayer* data, std::ostringstream* ret)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    const bool estimate = m_collections % KEY_ESTIMATE_PERIOD == 0;
+    const bool rotate = m_collections % HOT_KEY_PERIOD == HOT_KEY_PERIOD - 1;
+    ++m_collections;
+    std::map<std::string, values> spaces;
+    std::map<std::string, uint64_t> space_keys;
+    std::map<std::string, bool> space_changed;
+
+    for (size_t i = 0; i < m_all.size(); ++i)
+    {
+        counters* c = m_all[i].get();
+
+        if (rotate)
+        {
+            c->m_reads.rotate();
+            c->m_writes.rotate();
+        }
+
+        values v;
+        c->read(&v);
+        bool changed = v != c->m_reported;
+
+        // the key count is a rough estimate: the bytes LevelDB holds for
+        // the region over the mean size of the writes it has seen
+        if (estimate)
+        {
+            uint64_t writes = v.atomics + v.chain_ops;
+            uint64_t keys = c->m_keys;
+            c->m_disk_bytes = data->approximate_size(c->m_ri);
+
+            if (writes > 0 && v.bytes_written > 0)
+            {
+                keys = c->m_disk_bytes / std::max<uint64_t>(v.bytes_written / writes, 1);
+            }
+
+            changed = changed || keys != c->m_keys;
+            c->m_keys = keys;
+        }
+
+        spaces[c->m_space] += v;
+        space_keys[c->m_space] += c->m_keys;
+        space_changed[c->m_space] = space_changed[c->m_space] || changed;
+
+        if (changed)
+        {
+            std::ostringstream name;
+            name << c->m_ri.get();
+            output("region", name.str(), v, c->m_keys, ret);
+            c->m_reported = v;
+        }
+    }
+
+    for (std::map<std::string, values>::iterator it = spaces.begin();
+            it != spaces.end(); ++it)
+    {
+        if (space_changed[it->first])
+        {
+            output("space", it->first, it->second, space_keys[it->first], ret);
+        }
+    }
+}
+
+void
+region_stats :: reconfigure(const configuration& config, const server_id& us)
+{
+    std::vector<region_id> regions;
+    config.mapped_regions(us, &regions);
+    counters_map_t new_counters;
+    std::vector<e::compat::shared_ptr<counters> > all;
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        e::compat::shared_ptr<counters> c;
+
+        if (!m_counters.get(regions[i], &c))
+        {
+            const space* s = config.get_space(regions[i]);
+            assert(s);
+            c = e::compat::shared_ptr<counters>(new counters(regions[i], s->name));
+        }
+
+        assert(c);
+        new_counters.put(regions[i], c);
+        all.push_back(c);
+    }
+
+    po6::threads::mutex::hold hold(&m_protect);
+    m_counters.swap(&new_counters);
+    m_all.swap(all);
+}
+
+region_stats :: values :: values()
+    : gets(0)
+    , atomics(0)
+    , searches(0)
+    , chain_ops(0)
+    , bytes_read(0)
+    , bytes_written(0)
+    , pending(0)
+{
+}
+
+bool
+region_stats :: values :: operator != (const values& rhs) const
+{
+    return gets != rhs.gets ||
+           atomics != rhs.atomics ||
+           searches != rhs.searches ||
+           chain_ops != rhs.chain_ops ||
+           bytes_read != rhs.bytes_read ||
+           bytes_written != rhs.bytes_written ||
+           pending != rhs.pending;
+}
+
+region_stats::values&
+region_stats :: values :: operator += (const values& rhs)
+{
+    gets += rhs.gets;
+    atomics += rhs.atomics;
+    searches += rhs.searches;
+    chain_ops += rhs.chain_ops;
+    bytes_read += rhs.bytes_read;
+    bytes_written += rhs.bytes_written;
+    pending += rhs.pending;
+    return *this;
+}
+
+region_stats :: counters :: counters(const region_id& ri, const std::string& sp)
+    : m_ri(ri)
+    , m_space(sp)
+    , m_live()
+    , m_reported()
+    , m_disk_bytes(0)
+    , m_keys(0)
+    , m_reads(HOT_KEY_SAMPLE)
+    , m_writes(HOT_KEY_SAMPLE)
+{
+}
+
+region_stats :: counters :: ~counters() throw ()
+{
+}
+
+void
+region_stats :: counters :: pending_inc()
+{
+    e::atomic::increment_64_nobarrier(&m_live.pending, 1);
+}
+
+void
+region_stats :: counters :: pending_dec()
+{
+    e::atomic::increment_64_nobarrier(&m_live.pending, UINT64_MAX);
+}
+
+void
+region_stats :: counters :: tap(op_type t, uint64_t bytes)
+{
+    switch (t)
+    {
+        case GET:
+            e::atomic::increment_64_nobarrier(&m_live.gets, 1);
+            e::atomic::increment_64_nobarrier(&m_live.bytes_read, bytes);
+            break;
+        case ATOMIC:
+            e::atomic::increment_64_nobarrier(&m_live.atomics, 1);
+            e::atomic::increment_64_nobarrier(&m_live.bytes_written, bytes);
+            break;
+        case SEARCH:
+            e::atomic::increment_64_nobarrier(&m_live.searches, 1);
+            e::atomic::increment_64_nobarrier(&m_live.bytes_read, bytes);
+            break;
+        case SEARCH_ITEM:
+            e::atomic::increment_64_nobarrier(&m_live.bytes_read, bytes);
+            break;
+        case CHAIN:
+            e::atomic::increment_64_nobarrier(&m_live.chain_ops, 1);
+            e::atomic::increment_64_nobarrier(&m_live.bytes_written, bytes);
+            break;
+        default:
+            abort();
+    }
+}
+
+void
+region_stats :: counters :: read(values* v)
+{
+    v->gets = e::atomic::load_64_nobarrier(&m_live.gets);
+    v->atomics = e::atomic::load_64_nobarrier(&m_live.atomics);
+    v->searches = e::atomic::load_64_nobarrier(&m_live.searches);
+    v->chain_ops = e::atomic::load_64_nobarrier(&m_live.chain_ops);
+    v->bytes_read = e::atomic::load_64_nobarrier(&m_live.bytes_read);
+    v->bytes_written = e::atomic::load_64_nobarrier(&m_live.bytes_written);
+    v->pending = e::atomic::load_64_nobarrier(&m_live.pending);
+}
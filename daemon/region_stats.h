@@ -0,0 +1,168 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_region_stats_h_
+#define hyperdex_daemon_region_stats_h_
+
+// STL
+#include <sstream>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/ao_hash_map.h>
+#include <e/compat.h>
+#include <e/slice.h>
+
+// HyperDex
+#include "namespace.h"
+#include "common/configuration.h"
+#include "common/ids.h"
+#include "daemon/hot_keys.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+class datalayer;
+
+// Per-region load counters for the regions this server replicates.  Workers
+// tap them without locks; the stats thread reports the ones that changed,
+// per region and summed per space, so operators can find hot regions.
+class region_stats
+{
+    public:
+        enum op_type
+        {
+            GET,
+            ATOMIC,
+            SEARCH,
+            // bytes returned by a search already counted as SEARCH
+            SEARCH_ITEM,
+            CHAIN
+        };
+        class counters;
+        // the counters of one region, or their sum over one space
+        struct values
+        {
+            values();
+            bool operator != (const values& rhs) const;
+            values& operator += (const values& rhs);
+            uint64_t gets;
+            uint64_t atomics;
+            uint64_t searches;
+            uint64_t chain_ops;
+            uint64_t bytes_read;
+            uint64_t bytes_written;
+            uint64_t pending;
+        };
+        // how often, in calls to collect, to refresh the key estimates
+        const static uint64_t KEY_ESTIMATE_PERIOD = 100;
+        // how often, in calls to collect, to start a new hot key period
+        const static uint64_t HOT_KEY_PERIOD = 100;
+        // one in this many reads and writes is sampled for hot keys
+        const static uint64_t HOT_KEY_SAMPLE = 16;
+
+    public:
+        region_stats();
+        ~region_stats() throw ();
+
+    // concurrent methods; regions we do not replicate are ignored
+    public:
+        // count one op of type t on ri that read or wrote "bytes"
+        void count(const region_id& ri, op_type t, uint64_t bytes);
+        // as above, and sample key as read (GET) or written (ATOMIC, CHAIN)
+        void count(const region_id& ri, op_type t, uint64_t bytes,
+                   const e::slice& key);
+        // the n hottest keys read from and written to ri in the last period
+        void top_keys(const region_id& ri, size_t n,
+                      std::vector<hot_keys::entry>* reads,
+                      std::vector<hot_keys::entry>* writes);
+        // the counters for ri, or NULL
+        e::compat::shared_ptr<counters> get(const region_id& ri);
+
+    // called from the stats thread
+    public:
+        // append " region.<id>.<counter>=" for the regions whose counters
+        // changed since the last call, and " space.<name>.<counter>=" for
+        // their spaces
+        void collect(datalayer* data, std::ostringstream* ret);
+
+    // external synchronization required; nothing can call the concurrent
+    // methods
+    public:
+        void reconfigure(const configuration& config, const server_id& us);
+
+    private:
+        region_stats(const region_stats&);
+        region_stats& operator = (const region_stats&);
+        static uint64_t id(region_id ri) { return ri.get(); }
+
+    private:
+        const static region_id defaultri;
+        typedef e::ao_hash_map<region_id, e::compat::shared_ptr<counters>, id, defaultri> counters_map_t;
+        counters_map_t m_counters;
+        po6::threads::mutex m_protect;
+        std::vector<e::compat::shared_ptr<counters> > m_all;
+        uint64_t m_collections;
+};
+
+class region_stats::counters
+{
+    public:
+        counters(const region_id& ri, const std::string& space);
+        ~counters() throw ();
+
+    public:
+        // key_operations waiting in the region's key_states
+        void pending_inc();
+        void pending_dec();
+
+    private:
+        friend class region_stats;
+        void tap(op_type t, uint64_t bytes);
+        void read(values* v);
+
+    private:
+        const region_id m_ri;
+        const std::string m_space;
+        values m_live;
+        // owned by the stats thread
+        values m_reported;
+        uint64_t m_disk_bytes;
+        uint64_t m_keys;
+        hot_keys m_reads;
+        hot_keys m_writes;
+
+    private:
+        counters(const counters&);
+        counters& operator = (const counters&);
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_region_stats_h_
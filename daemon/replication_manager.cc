@@ -32,6 +32,7 @@
 
 // STL
 #include <algorithm>
+#include <list>
 
 // Google Log
 #include <glog/logging.h>
@@ -49,6 +50,25 @@ using hyperdex::key_state;
 using hyperdex::reconfigure_returncode;
 using hyperdex::replication_manager;
 
+struct replication_manager::truncate_request
+{
+    truncate_request() : from(), to(), nonce(), regions(), versions(), result(NET_SUCCESS) {}
+    truncate_request(const server_id& f,
+                     const virtual_server_id& t,
+                     uint64_t n,
+                     const std::vector<region_id>& r)
+        : from(f), to(t), nonce(n), regions(r), versions(), result(NET_SUCCESS) {}
+
+    server_id from;
+    virtual_server_id to;
+    uint64_t nonce;
+    std::vector<region_id> regions;
+    // the version each region was truncated before, until it is forwarded;
+    // zero once forwarded or if the region could not be truncated
+    std::vector<uint64_t> versions;
+    network_returncode result;
+};
+
 class replication_manager::retransmitter_thread : public hyperdex::background_thread
 {
     public:
@@ -63,10 +83,19 @@ class replication_manager::retransmitter_thread : public hyperdex::background_th
 
     public:
         void trigger();
+        void truncate(const truncate_request& tr);
+        // tell the chain about past truncations again, for the sake of
+        // replicas that joined since
+        void resend_truncations();
 
     public:
         replication_manager* m_rm;
         uint64_t m_trigger;
+        std::list<truncate_request> m_truncates;
+        bool m_resend_truncations;
+        bool m_have_truncate;
+        truncate_request m_truncate;
+        bool m_resend_now;
 
     private:
         retransmitter_thread(const retransmitter_thread&);
@@ -79,12 +108,17 @@ replication_manager :: replication_manager(daemon* d)
     , m_idgen()
     , m_idcol(&d->m_gc)
     , m_stable()
+    , m_truncated()
     , m_retransmitter(new retransmitter_thread(d))
     , m_protect_stable_stuff()
     , m_checkpoint(0)
     , m_need_check(0)
     , m_timestamps()
     , m_unstable()
+    , m_protect_truncations()
+    , m_ordered_truncations()
+    , m_truncations_waiting(0)
+    , m_delta_replication(false)
 {
     po6::threads::mutex::hold hold(&m_protect_stable_stuff);
     check_is_needed();
@@ -96,8 +130,9 @@ replication_manager :: ~replication_manager() throw ()
 }
 
 bool
-replication_manager :: setup()
+replication_manager :: setup(bool delta_replication)
 {
+    m_delta_replication = delta_replication;
     m_retransmitter->start();
     return true;
 }
@@ -134,6 +169,36 @@ replication_manager :: reconfigure(const configuration&,
     m_idgen.adopt(&key_regions[0], key_regions.size());
     m_idcol.adopt(&key_regions[0], key_regions.size());
 
+    // every replica, in any subspace, hides objects from before a
+    // truncation until its wiper deletes them
+    std::vector<region_id> space_regions;
+    std::vector<region_id> truncatable;
+    new_config.space_regions(m_daemon->m_us, &space_regions);
+
+    for (size_t i = 0; i < space_regions.size(); ++i)
+    {
+        const space* sp = new_config.get_space(space_regions[i]);
+
+        if (sp && new_config.subspace_of(space_regions[i]) == sp->subspaces[0].id)
+        {
+            truncatable.push_back(space_regions[i]);
+        }
+    }
+
+    m_truncated.adopt(&truncatable[0], truncatable.size());
+    std::vector<std::pair<region_id, uint64_t> > truncations;
+    m_daemon->m_data.truncated_regions(&truncations, NULL);
+
+    for (size_t i = 0; i < truncations.size(); ++i)
+    {
+        if (truncations[i].second > 0)
+        {
+            m_truncated.bump(truncations[i].first, truncations[i].second - 1);
+        }
+    }
+
+    m_retransmitter->resend_truncations();
+
     std::vector<region_id> transfers_in_regions;
     new_config.transfers_in_regions(m_daemon->m_us, &transfers_in_regions);
 
@@ -168,6 +233,14 @@ replication_manager :: reconfigure(const configuration&,
         {
             m_idgen.bump(key_regions[i], max_ver - 1);
         }
+
+        // the truncation used its version; nothing may be written below it
+        uint64_t truncated = truncated_before(key_regions[i]);
+
+        if (truncated > 1)
+        {
+            m_idgen.bump(key_regions[i], truncated);
+        }
     }
 
     // figure out when we're stable
@@ -175,7 +248,7 @@ replication_manager :: reconfigure(const configuration&,
 
     // clear timestamps for regions we no longer manage
     std::vector<region_id> mapped_regions;
-    m_daemon->m_config.mapped_regions(m_daemon->m_us, &mapped_regions);
+    m_daemon->m_config->mapped_regions(m_daemon->m_us, &mapped_regions);
     po6::threads::mutex::hold hold(&m_protect_stable_stuff);
     reset_to_unstable();
 
@@ -195,13 +268,45 @@ replication_manager :: reconfigure(const configuration&,
     }
 }
 
+void
+replication_manager :: reconfigure_version()
+{
+    m_retransmitter->initiate_pause();
+    m_retransmitter->wait_until_paused();
+
+    {
+        po6::threads::mutex::hold hold(&m_protect_stable_stuff);
+        reset_to_unstable();
+    }
+
+    std::vector<region_id> key_regions;
+    m_daemon->m_config->key_regions(m_daemon->m_us, &key_regions);
+
+    for (size_t i = 0; i < key_regions.size(); ++i)
+    {
+        uint64_t id = m_idgen.peek(key_regions[i]);
+
+        if (id > 0)
+        {
+            bool x = m_stable.bump(key_regions[i], id - 1);
+            assert(x);
+        }
+
+        check_stable(key_regions[i]);
+    }
+
+    check_stable();
+    m_retransmitter->unpause();
+    m_retransmitter->trigger();
+}
+
 void
 replication_manager :: debug_dump()
 {
     m_retransmitter->initiate_pause();
     m_retransmitter->wait_until_paused();
     std::vector<region_id> regions;
-    m_daemon->m_config.key_regions(m_daemon->m_us, &regions);
+    m_daemon->m_config->key_regions(m_daemon->m_us, &regions);
 
     // print counters
     LOG(INFO) << "region counters ===============================================================";
@@ -235,10 +340,10 @@ replication_manager :: client_atomic(const server_id& from,
                                      std::auto_ptr<key_change> kc,
                                      std::auto_ptr<e::buffer> backing)
 {
-    const region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
 
-    if (m_daemon->m_config.read_only())
+    if (m_daemon->m_config->read_only())
     {
         respond_to_client(to, from, nonce, NET_READONLY);
         return;
@@ -252,7 +357,7 @@ replication_manager :: client_atomic(const server_id& from,
         return;
     }
 
-    if (m_daemon->m_config.point_leader(ri, kc->key) != to)
+    if (m_daemon->m_config->point_leader(ri, kc->key) != to)
     {
         LOG(ERROR) << "dropping nonce=" << nonce << " from client=" << from
                    << " because it doesn't map to " << ri;
@@ -274,18 +379,30 @@ replication_manager :: chain_op(const virtual_server_id& from,
                                 bool has_value,
                                 const e::slice& key,
                                 const std::vector<e::slice>& value,
-                                std::auto_ptr<e::buffer> backing)
+                                const key_operation::delta_t& delta,
+                                std::auto_ptr<e::buffer> backing,
+                                uint64_t trace_id)
 {
-    const region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    bool valid = sc.attrs_sz == value.size() + 1 &&
-                 datatype_info::lookup(sc.attrs[0].type)->validate(key);
+    const region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    bool valid = datatype_info::lookup(sc.attrs[0].type)->validate(key);
 
-    if (has_value)
+    // a delta is checked against the schema here, and against the value it
+    // applies to once key_state finds it
+    if (!delta.empty())
+    {
+        valid = valid && has_value;
+
+        for (size_t i = 0; valid && i < delta.size(); ++i)
+        {
+            valid = validate_funcs(sc, delta[i]) == delta[i].size();
+        }
+    }
+    else
     {
         valid = valid && sc.attrs_sz == value.size() + 1;
 
-        for (size_t i = 0; valid && i + 1 < sc.attrs_sz; ++i)
+        for (size_t i = 0; valid && has_value && i + 1 < sc.attrs_sz; ++i)
         {
             valid = datatype_info::lookup(sc.attrs[i + 1].type)->validate(value[i]);
         }
@@ -299,7 +416,7 @@ replication_manager :: chain_op(const virtual_server_id& from,
 
     key_map_t::state_reference ksr;
     key_state* ks = get_or_create_key_state(ri, key, &ksr);
-    ks->enqueue_chain_op(this, to, sc, from, old_version, new_version, fresh, has_value, value, backing);
+    ks->enqueue_chain_op(this, to, sc, from, old_version, new_version, fresh, has_value, value, delta, backing, trace_id);
 }
 
 void
@@ -313,10 +430,11 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
                                       const region_id& prev_region,
                                       const region_id& this_old_region,
                                       const region_id& this_new_region,
-                                      const region_id& next_region)
+                                      const region_id& next_region,
+                                      uint64_t trace_id)
 {
-    const region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     bool valid = sc.attrs_sz == value.size() + 1 &&
                  datatype_info::lookup(sc.attrs[0].type)->validate(key);
 
@@ -334,7 +452,8 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
     key_map_t::state_reference ksr;
     key_state* ks = get_or_create_key_state(ri, key, &ksr);
     ks->enqueue_chain_subspace(this, to, sc, from, old_version, new_version, value, backing,
-                               prev_region, this_old_region, this_new_region, next_region);
+                               prev_region, this_old_region, this_new_region, next_region,
+                               trace_id);
 }
 
 void
@@ -343,8 +462,8 @@ replication_manager :: chain_ack(const virtual_server_id& from,
                                  uint64_t version,
                                  const e::slice& key)
 {
-    const region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     key_map_t::state_reference ksr;
     key_state* ks = get_key_state(ri, key, &ksr);
 
@@ -359,6 +478,120 @@ replication_manager :: chain_ack(const virtual_server_id& from,
     ks->enqueue_chain_ack(this, to, sc, from, version);
 }
 
+void
+replication_manager :: chain_nack(const virtual_server_id& from,
+                                  const virtual_server_id& to,
+                                  uint64_t version,
+                                  const e::slice& key)
+{
+    const region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    key_map_t::state_reference ksr;
+    key_state* ks = get_key_state(ri, key, &ksr);
+
+    if (!ks)
+    {
+        return;
+    }
+
+    // never wait for the state machine here; whoever is working it sends
+    // the full value
+    ks->enqueue_chain_nack(this, to, sc, from, version);
+}
+
+void
+replication_manager :: client_truncate(const server_id& from,
+                                       const virtual_server_id& to,
+                                       uint64_t nonce,
+                                       const std::vector<region_id>& regions)
+{
+    m_retransmitter->truncate(truncate_request(from, to, nonce, regions));
+}
+
+void
+replication_manager :: chain_truncate(const virtual_server_id& from,
+                                      const virtual_server_id& to,
+                                      const region_id& key_region,
+                                      uint64_t version)
+{
+    const region_id ri(m_daemon->m_config->get_region_id(to));
+    // the key region's chain, or the hand-off from its tail to the head of
+    // a region in another subspace of the space
+    const bool in_chain = m_daemon->m_config->next_in_region(from) == to;
+    const bool from_key_tail = ri != key_region &&
+                               m_daemon->m_config->tail_of_region(key_region) == from &&
+                               m_daemon->m_config->head_of_region(ri) == to;
+
+    if (ri == region_id() ||
+        m_daemon->m_config->get_space(ri) != m_daemon->m_config->get_space(key_region) ||
+        (ri == key_region ? !in_chain : !in_chain && !from_key_tail))
+    {
+        LOG(ERROR) << "dropping CHAIN_TRUNCATE which didn't come from the right host: "
+                   << "from=" << from << " to=" << to << " region=" << key_region
+                   << " version=" << version;
+        return;
+    }
+
+    if (!truncate(key_region, version))
+    {
+        return;
+    }
+
+    // pass it on even if we had it already; a replica that joined since may not
+    forward_truncate(to, key_region, version);
+}
+
+uint64_t
+replication_manager :: truncated_before(const region_id& ri)
+{
+    uint64_t version = 0;
+    return m_truncated.peek(ri, &version) ? version : 0;
+}
+
+uint64_t
+replication_manager :: truncated_before(const region_id& ri, const e::slice& key)
+{
+    uint64_t version = 0;
+
+    if (m_truncated.peek(ri, &version))
+    {
+        return version;
+    }
+
+    // objects in the other subspaces take their versions from the key region
+    region_id key_region = m_daemon->m_config->key_region(ri, key);
+    return m_truncated.peek(key_region, &version) ? version : 0;
+}
+
+bool
+replication_manager :: truncate_is_ordered(const region_id& key_region, uint64_t version)
+{
+    // every other replica hears of it from the head only once it is
+    virtual_server_id us = m_daemon->m_config->get_virtual(key_region, m_daemon->m_us);
+
+    if (us == virtual_server_id() ||
+        m_daemon->m_config->head_of_region(key_region) != us)
+    {
+        return true;
+    }
+
+    return m_idcol.lower_bound(key_region) >= version;
+}
+
+void
+replication_manager :: wipe_truncated(const region_id& ri,
+                                      const e::slice& key,
+                                      uint64_t truncated_before)
+{
+    key_map_t::state_reference ksr;
+    key_state* ks = get_or_create_key_state(ri, key, &ksr);
+
+    if (ks)
+    {
+        ks->wipe_truncated(this, truncated_before);
+    }
+}
+
 void
 replication_manager :: begin_checkpoint(uint64_t checkpoint_num)
 {
@@ -368,7 +601,7 @@ replication_manager :: begin_checkpoint(uint64_t checkpoint_num)
 
     {
         std::vector<region_id> mapped_regions;
-        m_daemon->m_config.mapped_regions(m_daemon->m_us, &mapped_regions);
+        m_daemon->m_config->mapped_regions(m_daemon->m_us, &mapped_regions);
         po6::threads::mutex::hold hold(&m_protect_stable_stuff);
         m_checkpoint = std::max(m_checkpoint, checkpoint_num);
         reset_to_unstable();
@@ -380,7 +613,7 @@ replication_manager :: begin_checkpoint(uint64_t checkpoint_num)
     }
 
     std::vector<region_id> key_regions;
-    m_daemon->m_config.key_regions(m_daemon->m_us, &key_regions);
+    m_daemon->m_config->key_regions(m_daemon->m_us, &key_regions);
 
     for (size_t i = 0; i < key_regions.size(); ++i)
     {
@@ -425,6 +658,15 @@ replication_manager :: end_checkpoint(uint64_t checkpoint_num)
     m_retransmitter->trigger();
 }
 
+bool
+replication_manager :: key_is_clean(const region_id& ri, const e::slice& key)
+{
+    key_region kr(ri, key);
+    key_map_t::state_reference ksr;
+    key_state* ks = m_key_states.get_state(kr, &ksr);
+    return !ks || ks->finished();
+}
+
 key_state*
 replication_manager :: get_key_state(const region_id& ri,
                                      const e::slice& key,
@@ -453,7 +695,7 @@ replication_manager :: post_get_key_state_init(region_id ri, key_state* ks)
         return ks;
     }
 
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
 
     switch (ks->initialize(&m_daemon->m_data, sc, ri))
     {
@@ -479,7 +721,7 @@ replication_manager :: respond_to_client(const virtual_server_id& us,
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint16_t);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
     uint16_t result = static_cast<uint16_t>(ret);
     msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << result;
     m_daemon->m_comm.send_client(us, client, RESP_ATOMIC, msg);
@@ -493,17 +735,17 @@ replication_manager :: send_message(const virtual_server_id& us,
     // If we've sent it somewhere, we shouldn't resend.  If the sender intends a
     // resend, they should clear "sent" first.
     assert(op->sent_to() == virtual_server_id());
-    region_id ri(m_daemon->m_config.get_region_id(us));
+    region_id ri(m_daemon->m_config->get_region_id(us));
 
     // If there's an ongoing transfer, don't actually send
-    if (m_daemon->m_config.is_server_blocked_by_live_transfer(m_daemon->m_us, ri))
+    if (m_daemon->m_config->is_server_blocked_by_live_transfer(m_daemon->m_us, ri))
     {
         return false;
     }
 
     // facts we use to decide what to do
     assert(ri == op->this_old_region() || ri == op->this_new_region());
-    bool last_in_chain = m_daemon->m_config.tail_of_region(ri) == us;
+    bool last_in_chain = m_daemon->m_config->tail_of_region(ri) == us;
     bool has_next_subspace = op->next_region() != region_id();
 
     // variables we fill in to determine the message type/destination
@@ -516,7 +758,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         {
             if (has_next_subspace)
             {
-                dest = m_daemon->m_config.head_of_region(op->next_region());
+                dest = m_daemon->m_config->head_of_region(op->next_region());
                 type = CHAIN_OP;
             }
             else
@@ -532,7 +774,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         }
         else
         {
-            dest = m_daemon->m_config.next_in_region(us);
+            dest = m_daemon->m_config->next_in_region(us);
             type = CHAIN_OP;
         }
     }
@@ -541,12 +783,12 @@ replication_manager :: send_message(const virtual_server_id& us,
         if (last_in_chain)
         {
             assert(op->has_value());
-            dest = m_daemon->m_config.head_of_region(op->this_new_region());
+            dest = m_daemon->m_config->head_of_region(op->this_new_region());
             type = CHAIN_SUBSPACE;
         }
         else
         {
-            dest = m_daemon->m_config.next_in_region(us);
+            dest = m_daemon->m_config->next_in_region(us);
             type = CHAIN_OP;
         }
     }
@@ -556,7 +798,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         {
             if (has_next_subspace)
             {
-                dest = m_daemon->m_config.head_of_region(op->next_region());
+                dest = m_daemon->m_config->head_of_region(op->next_region());
                 type = CHAIN_OP;
             }
             else
@@ -573,7 +815,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         else
         {
             assert(op->has_value());
-            dest = m_daemon->m_config.next_in_region(us);
+            dest = m_daemon->m_config->next_in_region(us);
             type = CHAIN_SUBSPACE;
         }
     }
@@ -583,21 +825,44 @@ replication_manager :: send_message(const virtual_server_id& us,
     }
 
     std::auto_ptr<e::buffer> msg;
+    // traced ops carry their trace id after everything else, where peers
+    // that do not know about tracing will ignore it
+    const uint64_t trace_id = op->trace_id();
+    const size_t trace_sz = trace_id ? sizeof(uint64_t) : 0;
 
     if (type == CHAIN_OP)
     {
+        const bool delta = m_delta_replication && op->has_delta();
         uint8_t flags = (op->is_fresh() ? 1 : 0)
-                      | (op->has_value() ? 2 : 0);
+                      | (op->has_value() ? 2 : 0)
+                      | (delta ? 4 : 0);
         size_t sz = HYPERDEX_HEADER_SIZE_VV
                   + sizeof(uint8_t)
                   + sizeof(uint64_t)
                   + sizeof(uint64_t)
                   + pack_size(key)
-                  + pack_size(op->value());
-        msg.reset(e::buffer::create(sz));
-        msg->pack_at(HYPERDEX_HEADER_SIZE_VV)
+                  + (delta ? pack_size(op->delta()) : pack_size(op->value()))
+                  + trace_sz;
+        msg = m_daemon->m_comm.create_buffer(sz);
+        e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV)
             << flags << op->prev_version() << op->this_version()
-            << key << op->value();
+            << key;
+
+        if (delta)
+        {
+            pa = pa << op->delta();
+        }
+        else
+        {
+            pa = pa << op->value();
+        }
+
+        if (trace_id)
+        {
+            pa = pa << trace_id;
+        }
+
+        m_daemon->m_traces.record(trace_id, trace_ring::CHAIN_OP_SEND, ri.get(), op->this_version());
     }
     else if (type == CHAIN_SUBSPACE)
     {
@@ -609,23 +874,31 @@ replication_manager :: send_message(const virtual_server_id& us,
                   + pack_size(op->prev_region())
                   + pack_size(op->this_old_region())
                   + pack_size(op->this_new_region())
-                  + pack_size(op->next_region());
-        msg.reset(e::buffer::create(sz));
-        msg->pack_at(HYPERDEX_HEADER_SIZE_VV)
+                  + pack_size(op->next_region())
+                  + trace_sz;
+        msg = m_daemon->m_comm.create_buffer(sz);
+        e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV)
             << op->prev_version() << op->this_version()
             << key << op->value()
             << op->prev_region()
             << op->this_old_region()
             << op->this_new_region()
             << op->next_region();
+
+        if (trace_id)
+        {
+            pa = pa << trace_id;
+        }
+
+        m_daemon->m_traces.record(trace_id, trace_ring::CHAIN_SUBSPACE_SEND, ri.get(), op->this_version());
     }
     else
     {
         abort();
     }
 
-    op->set_sent(m_daemon->m_config.version(), dest);
-    return m_daemon->m_comm.send_exact(us, dest, type, msg);
+    op->set_sent(m_daemon->m_config->version(), dest);
+    return m_daemon->m_comm.send_exact(us, dest, type, msg) != communication::SEND_FAILED;
 }
 
 bool
@@ -633,15 +906,38 @@ replication_manager :: send_ack(const virtual_server_id& us,
                                 const e::slice& key,
                                 e::intrusive_ptr<key_operation> op)
 {
-    if (!op->ackable() || !op->recv_from(m_daemon->m_config.version()))
+    if (!op->ackable() || !op->recv_from(m_daemon->m_config->version()))
     {
         return false;
     }
 
+    const uint64_t trace_id = op->trace_id();
+    size_t sz = HYPERDEX_HEADER_SIZE_VV + sizeof(uint64_t) + pack_size(key)
+              + (trace_id ? sizeof(uint64_t) : 0);
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
+    e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << op->this_version() << key;
+
+    if (trace_id)
+    {
+        pa = pa << trace_id;
+    }
+
+    m_daemon->m_traces.record(trace_id, trace_ring::CHAIN_ACK_SEND,
+                              m_daemon->m_config->get_region_id(us).get(),
+                              op->this_version());
+    return m_daemon->m_comm.send_exact(us, op->recv_from(), CHAIN_ACK, msg) != communication::SEND_FAILED;
+}
+
+bool
+replication_manager :: send_nack(const virtual_server_id& us,
+                                 const virtual_server_id& to,
+                                 uint64_t version,
+                                 const e::slice& key)
+{
     size_t sz = HYPERDEX_HEADER_SIZE_VV + sizeof(uint64_t) + pack_size(key);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << op->this_version() << key;
-    return m_daemon->m_comm.send_exact(us, op->recv_from(), CHAIN_ACK, msg);
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << version << key;
+    return m_daemon->m_comm.send_exact(us, to, CHAIN_NACK, msg) != communication::SEND_FAILED;
 }
 
 void
@@ -659,12 +955,12 @@ replication_manager :: retransmit(const std::vector<region_id>& point_leaders,
             ks->append_all_versions(versions);
         }
 
-        if (m_daemon->m_config.is_server_blocked_by_live_transfer(m_daemon->m_us, ri))
+        if (m_daemon->m_config->is_server_blocked_by_live_transfer(m_daemon->m_us, ri))
         {
             continue;
         }
 
-        virtual_server_id us = m_daemon->m_config.get_virtual(ri, m_daemon->m_us);
+        virtual_server_id us = m_daemon->m_config->get_virtual(ri, m_daemon->m_us);
 
         if (us == virtual_server_id() || ks->finished())
         {
@@ -672,7 +968,7 @@ replication_manager :: retransmit(const std::vector<region_id>& point_leaders,
             continue;
         }
 
-        const schema& sc(*m_daemon->m_config.get_schema(ri));
+        const schema& sc(*m_daemon->m_config->get_schema(ri));
         ks->resend_committable(this, us);
         ks->work_state_machine(this, us, sc);
     }
@@ -680,6 +976,218 @@ replication_manager :: retransmit(const std::vector<region_id>& point_leaders,
     m_daemon->m_comm.wake_one();
 }
 
+bool
+replication_manager :: send_truncate(const virtual_server_id& us,
+                                     const virtual_server_id& to,
+                                     const region_id& key_region,
+                                     uint64_t version)
+{
+    size_t sz = HYPERDEX_HEADER_SIZE_VV
+              + pack_size(key_region)
+              + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << key_region << version;
+    return m_daemon->m_comm.send_exact(us, to, CHAIN_TRUNCATE, msg) != communication::SEND_FAILED;
+}
+
+void
+replication_manager :: forward_truncate(const virtual_server_id& us,
+                                        const region_id& key_region,
+                                        uint64_t version)
+{
+    virtual_server_id next = m_daemon->m_config->next_in_region(us);
+
+    if (next != virtual_server_id())
+    {
+        send_truncate(us, next, key_region, version);
+        return;
+    }
+
+    if (m_daemon->m_config->get_region_id(us) != key_region)
+    {
+        return;
+    }
+
+    // the other subspaces store the key region's objects too, spread over
+    // all of their regions
+    const space* sp = m_daemon->m_config->get_space(key_region);
+
+    for (size_t ss = 1; sp && ss < sp->subspaces.size(); ++ss)
+    {
+        for (size_t r = 0; r < sp->subspaces[ss].regions.size(); ++r)
+        {
+            virtual_server_id head = m_daemon->m_config->head_of_region(sp->subspaces[ss].regions[r].id);
+
+            if (head != virtual_server_id())
+            {
+                send_truncate(us, head, key_region, version);
+            }
+        }
+    }
+}
+
+void
+replication_manager :: order_truncate(const truncate_request& tr)
+{
+    truncate_request ordered(tr);
+    ordered.versions.resize(tr.regions.size(), 0);
+
+    // With the workers parked, every write already ordered for a region has
+    // a version below the one generated here, and every write yet to come
+    // has a version above it.
+    m_daemon->pause();
+
+    for (size_t i = 0; i < tr.regions.size(); ++i)
+    {
+        const region_id& ri(tr.regions[i]);
+        virtual_server_id us = m_daemon->m_config->get_virtual(ri, m_daemon->m_us);
+
+        if (us == virtual_server_id() ||
+            m_daemon->m_config->head_of_region(ri) != us)
+        {
+            LOG(ERROR) << "cannot truncate " << ri << " because we no longer lead it";
+            ordered.result = NET_SERVERERROR;
+            continue;
+        }
+
+        uint64_t version = m_idgen.generate_id(ri);
+
+        if (!truncate(ri, version))
+        {
+            ordered.result = NET_SERVERERROR;
+            continue;
+        }
+
+        ordered.versions[i] = version;
+    }
+
+    // the rest of the chain and the other subspaces hear of it once the
+    // earlier writes are acked, so that none of them can arrive after it
+    {
+        po6::threads::mutex::hold hold(&m_protect_truncations);
+        m_ordered_truncations.push_back(ordered);
+        e::atomic::compare_and_swap_32_nobarrier(&m_truncations_waiting, 0, 1);
+    }
+
+    m_daemon->unpause();
+}
+
+void
+replication_manager :: check_truncations(const region_id& ri)
+{
+    if (!are_truncations_waiting())
+    {
+        return;
+    }
+
+    std::vector<virtual_server_id> forward_from;
+    std::vector<region_id> forward_regions;
+    std::vector<uint64_t> forward_versions;
+    std::list<truncate_request> done;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect_truncations);
+        std::list<truncate_request>::iterator it = m_ordered_truncations.begin();
+
+        while (it != m_ordered_truncations.end())
+        {
+            bool waiting = false;
+
+            for (size_t i = 0; i < it->regions.size(); ++i)
+            {
+                const region_id& tri(it->regions[i]);
+
+                if (it->versions[i] == 0 ||
+                    (ri != region_id() && ri != tri))
+                {
+                    waiting = waiting || it->versions[i] != 0;
+                    continue;
+                }
+
+                virtual_server_id us = m_daemon->m_config->get_virtual(tri, m_daemon->m_us);
+
+                if (us == virtual_server_id() ||
+                    m_daemon->m_config->head_of_region(tri) != us)
+                {
+                    LOG(ERROR) << "cannot finish truncating " << tri << " because we no longer lead it";
+                    it->result = NET_SERVERERROR;
+                    it->versions[i] = 0;
+                }
+                else if (m_idcol.lower_bound(tri) >= it->versions[i])
+                {
+                    forward_from.push_back(us);
+                    forward_regions.push_back(tri);
+                    forward_versions.push_back(it->versions[i]);
+                    it->versions[i] = 0;
+                }
+                else
+                {
+                    waiting = true;
+                }
+            }
+
+            if (waiting)
+            {
+                ++it;
+            }
+            else
+            {
+                done.splice(done.end(), m_ordered_truncations, it++);
+            }
+        }
+
+        if (m_ordered_truncations.empty())
+        {
+            e::atomic::compare_and_swap_32_nobarrier(&m_truncations_waiting, 1, 0);
+        }
+    }
+
+    for (size_t i = 0; i < forward_from.size(); ++i)
+    {
+        forward_truncate(forward_from[i], forward_regions[i], forward_versions[i]);
+    }
+
+    for (std::list<truncate_request>::iterator it = done.begin();
+            it != done.end(); ++it)
+    {
+        size_t sz = HYPERDEX_HEADER_SIZE_VC
+                  + sizeof(uint64_t)
+                  + sizeof(uint16_t);
+        std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
+        msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << it->nonce << static_cast<uint16_t>(it->result);
+        m_daemon->m_comm.send_client(it->to, it->from, TRUNCATE_SPACE, msg);
+    }
+}
+
+bool
+replication_manager :: truncate(const region_id& ri, uint64_t version)
+{
+    uint64_t before = 0;
+
+    if (!m_truncated.peek(ri, &before))
+    {
+        return false;
+    }
+
+    if (before >= version)
+    {
+        return true;
+    }
+
+    if (m_daemon->m_data.mark_truncated(ri, version) != datalayer::SUCCESS)
+    {
+        LOG(ERROR) << "could not record the truncation of " << ri;
+        return false;
+    }
+
+    m_truncated.bump(ri, version - 1);
+    // the floor is on disk; each replica removes its own copies once the
+    // writes ordered before it are through
+    m_daemon->m_data.request_truncate(ri, version);
+    LOG(INFO) << "truncated " << ri << " before version " << version;
+    return true;
+}
+
 void
 replication_manager :: collect(const region_id& ri, e::intrusive_ptr<key_operation> op)
 {
@@ -696,6 +1204,7 @@ replication_manager :: collect(const region_id& ri, uint64_t version)
 {
     m_idcol.collect(ri, version);
     check_stable(ri);
+    check_truncations(ri);
 }
 
 void
@@ -761,7 +1270,7 @@ void
 replication_manager :: reset_to_unstable()
 {
     m_unstable.clear();
-    m_daemon->m_config.point_leaders(m_daemon->m_us, &m_unstable);
+    m_daemon->m_config->point_leaders(m_daemon->m_us, &m_unstable);
     check_is_needed();
     m_retransmitter->trigger();
 }
@@ -786,7 +1295,7 @@ replication_manager :: check_stable()
 
     if (tell_coord_stable)
     {
-        m_daemon->m_coord->config_stable(m_daemon->m_config.version());
+        m_daemon->m_coord->config_stable(m_daemon->m_config->version());
         m_daemon->m_coord->checkpoint_report_stable(checkpoint);
     }
 }
@@ -834,7 +1343,7 @@ replication_manager :: check_stable(const region_id& ri)
 
     if (tell_coord_stable)
     {
-        m_daemon->m_coord->config_stable(m_daemon->m_config.version());
+        m_daemon->m_coord->config_stable(m_daemon->m_config->version());
         m_daemon->m_coord->checkpoint_report_stable(checkpoint);
     }
 }
@@ -843,6 +1352,11 @@ replication_manager :: retransmitter_thread :: retransmitter_thread(daemon* d)
     : background_thread(d)
     , m_rm(&d->m_repl)
     , m_trigger(0)
+    , m_truncates()
+    , m_resend_truncations(false)
+    , m_have_truncate(false)
+    , m_truncate()
+    , m_resend_now(false)
 {
 }
 
@@ -853,22 +1367,45 @@ replication_manager :: retransmitter_thread :: ~retransmitter_thread() throw ()
 bool
 replication_manager :: retransmitter_thread :: have_work()
 {
-    return m_trigger > 0;
+    return m_trigger > 0 || !m_truncates.empty();
 }
 
 void
 replication_manager :: retransmitter_thread :: copy_work()
 {
-    assert(m_trigger > 0);
-    --m_trigger;
+    m_have_truncate = !m_truncates.empty();
+
+    if (m_have_truncate)
+    {
+        m_truncate = m_truncates.front();
+        m_truncates.pop_front();
+    }
+    else
+    {
+        assert(m_trigger > 0);
+        --m_trigger;
+    }
+
+    m_resend_now = m_resend_truncations;
+    m_resend_truncations = false;
 }
 
 void
 replication_manager :: retransmitter_thread :: do_work()
 {
+    if (m_have_truncate)
+    {
+        // pausing the daemon pauses this thread too; be offline so that a
+        // reconfiguration waiting on it can get there first
+        this->offline();
+        m_rm->order_truncate(m_truncate);
+        this->online();
+        m_truncate = truncate_request();
+    }
+
     // get the list of point leaders
     std::vector<region_id> point_leaders;
-    m_rm->m_daemon->m_config.point_leaders(m_rm->m_daemon->m_us, &point_leaders);
+    m_rm->m_daemon->m_config->point_leaders(m_rm->m_daemon->m_us, &point_leaders);
     std::sort(point_leaders.begin(), point_leaders.end());
 
     // peek at the next-to-generate values of m_idgen
@@ -888,6 +1425,21 @@ replication_manager :: retransmitter_thread :: do_work()
     }
 
     m_rm->check_stable();
+    m_rm->check_truncations(region_id());
+
+    for (size_t i = 0; m_resend_now && i < point_leaders.size(); ++i)
+    {
+        const region_id& ri(point_leaders[i]);
+        uint64_t version = m_rm->truncated_before(ri);
+        virtual_server_id us = m_rm->m_daemon->m_config->get_virtual(ri, m_rm->m_daemon->m_us);
+
+        // one still waiting on earlier writes goes out when they are acked
+        if (version > 1 && m_rm->truncate_is_ordered(ri, version))
+        {
+            m_rm->forward_truncate(us, ri, version);
+        }
+    }
+
     m_rm->m_daemon->m_comm.wake_one();
 }
 
@@ -899,3 +1451,20 @@ replication_manager :: retransmitter_thread :: trigger()
     this->wakeup();
     this->unlock();
 }
+
+void
+replication_manager :: retransmitter_thread :: truncate(const truncate_request& tr)
+{
+    this->lock();
+    m_truncates.push_back(tr);
+    this->wakeup();
+    this->unlock();
+}
+
+void
+replication_manager :: retransmitter_thread :: resend_truncations()
+{
+    this->lock();
+    m_resend_truncations = true;
+    this->unlock();
+}
@@ -71,13 +71,18 @@ class replication_manager
 
     // Reconfigure this layer.
     public:
-        bool setup();
+        // with delta_replication, CHAIN_OPs may carry the funcalls that
+        // produce the new value instead of the value itself
+        bool setup(bool delta_replication);
         void teardown();
         void pause();
         void unpause();
         void reconfigure(const configuration& old_config,
                          const configuration& new_config,
                          const server_id& us);
+        // the configuration moved to a new version without changing any of
+        // our regions; track stability for the new version without pausing
+        void reconfigure_version();
         void debug_dump();
 
     // Network workers call these methods.
@@ -98,7 +103,9 @@ class replication_manager
                       bool has_value,
                       const e::slice& key,
                       const std::vector<e::slice>& value,
-                      std::auto_ptr<e::buffer> backing);
+                      const key_operation::delta_t& delta,
+                      std::auto_ptr<e::buffer> backing,
+                      uint64_t trace_id);
         void chain_subspace(const virtual_server_id& from,
                             const virtual_server_id& to,
                             uint64_t old_version,
@@ -109,16 +116,53 @@ class replication_manager
                             const region_id& prev_region,
                             const region_id& this_old_region,
                             const region_id& this_new_region,
-                            const region_id& next_region);
+                            const region_id& next_region,
+                            uint64_t trace_id);
         void chain_ack(const virtual_server_id& from,
                        const virtual_server_id& to,
                        uint64_t version,
                        const e::slice& key);
+        void chain_nack(const virtual_server_id& from,
+                        const virtual_server_id& to,
+                        uint64_t version,
+                        const e::slice& key);
+        // Truncate each of the regions, which we must lead, after the writes
+        // already ordered for them.  The replication thread orders it with
+        // the daemon paused.  Once those writes are acked, it is forwarded
+        // down the chain and on to every region of the other subspaces, and
+        // the client is answered.  Objects from before the truncation are
+        // hidden from then on, and every replica's wiper deletes its own
+        // copies in the background.
+        void client_truncate(const server_id& from,
+                             const virtual_server_id& to,
+                             uint64_t nonce,
+                             const std::vector<region_id>& regions);
+        void chain_truncate(const virtual_server_id& from,
+                            const virtual_server_id& to,
+                            const region_id& key_region,
+                            uint64_t version);
+        // objects of the key region with lower versions have been truncated
+        uint64_t truncated_before(const region_id& ri);
+        // the same for the key stored in ri, which may be in any subspace
+        uint64_t truncated_before(const region_id& ri, const e::slice& key);
+        // true once every write ordered before the truncation has been
+        // acked; only the key region's head can have it sooner
+        bool truncate_is_ordered(const region_id& key_region, uint64_t version);
+        // delete the key's stored value if it is older than truncated_before
+        // and no write to it is in flight; the wiper calls this at every
+        // replica
+        void wipe_truncated(const region_id& ri,
+                            const e::slice& key,
+                            uint64_t truncated_before);
+        // true if no write for the key is in flight at this replica, so that
+        // its stored value is the latest one any replica may have exposed
+        bool key_is_clean(const region_id& ri, const e::slice& key);
         void begin_checkpoint(uint64_t seq);
         void end_checkpoint(uint64_t seq);
 
     private:
         class retransmitter_thread;
+        struct truncate_request;
         typedef state_hash_table<key_region, key_state> key_map_t;
         friend class key_state;
 
@@ -145,8 +189,30 @@ class replication_manager
         bool send_ack(const virtual_server_id& us,
                       const e::slice& key,
                       e::intrusive_ptr<key_operation> op);
+        bool send_nack(const virtual_server_id& us,
+                       const virtual_server_id& to,
+                       uint64_t version,
+                       const e::slice& key);
         void retransmit(const std::vector<region_id>& point_leaders,
                         std::vector<std::pair<region_id, uint64_t> >* versions);
+        bool send_truncate(const virtual_server_id& us,
+                           const virtual_server_id& to,
+                           const region_id& key_region,
+                           uint64_t version);
+        // pass the truncation to the next replica of our region or, from
+        // the tail of the key region, to the head of every other region
+        void forward_truncate(const virtual_server_id& us,
+                              const region_id& key_region,
+                              uint64_t version);
+        // must be called by the replication thread while it is offline
+        void order_truncate(const truncate_request& tr);
+        // forward the ordered truncations whose earlier writes ri has now
+        // collected (all regions if ri is region_id()), and answer the
+        // clients whose truncations are through
+        void check_truncations(const region_id& ri);
+        // record the truncation; false if ri is not a key region of a space
+        // we hold
+        bool truncate(const region_id& ri, uint64_t version);
         void collect(const region_id& ri, e::intrusive_ptr<key_operation> op);
         void collect(const region_id& ri, uint64_t version);
         void close_gaps(const std::vector<region_id>& point_leaders,
@@ -159,6 +225,7 @@ class replication_manager
         void check_is_not_needed() { e::atomic::compare_and_swap_32_nobarrier(&m_need_check, 1, 0); }
         void check_stable();
         void check_stable(const region_id& ri);
+        bool are_truncations_waiting() { return e::atomic::compare_and_swap_32_nobarrier(&m_truncations_waiting, 0, 0) == 1; }
 
     private:
         daemon* m_daemon;
@@ -166,12 +233,19 @@ class replication_manager
         identifier_generator m_idgen;
         identifier_collector m_idcol;
         identifier_generator m_stable;
+        // for each key region of every space we hold a region of, the
+        // version below which objects were truncated (1 if never)
+        identifier_generator m_truncated;
         const std::auto_ptr<retransmitter_thread> m_retransmitter;
         po6::threads::mutex m_protect_stable_stuff;
         uint64_t m_checkpoint;
         uint32_t m_need_check;
         std::vector<region_timestamp> m_timestamps;
         std::vector<region_id> m_unstable;
+        po6::threads::mutex m_protect_truncations;
+        std::list<truncate_request> m_ordered_truncations;
+        uint32_t m_truncations_waiting;
+        bool m_delta_replication;
 
     private:
         replication_manager(const replication_manager&);
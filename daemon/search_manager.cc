@@ -123,6 +123,9 @@ class search_manager::state
         const std::auto_ptr<e::buffer> backing;
         std::vector<attribute_check> checks;
         e::intrusive_ptr<datalayer::iterator> iter;
+        // time spent on the search and bytes sent, across all its batches
+        uint64_t nanos;
+        uint64_t bytes;
 
     private:
         friend class e::intrusive_ptr<state>;
@@ -143,6 +146,8 @@ search_manager :: state :: state(const region_id& r,
     , backing(msg)
     , checks()
     , iter()
+    , nanos(0)
+    , bytes(0)
     , m_ref(0)
 {
     checks.swap(*c);
@@ -201,8 +206,8 @@ search_manager :: start(const server_id& from,
                         uint64_t search_id,
                         std::vector<attribute_check>* checks)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema* sc = m_daemon->m_config->get_schema(ri);
 
     if (sc->authorization)
     {
@@ -218,6 +223,7 @@ search_manager :: start(const server_id& from,
         return;
     }
 
+    uint64_t t_start = po6::monotonic_time();
     e::intrusive_ptr<state> st = new state(ri, msg, checks);
     std::stable_sort(st->checks.begin(), st->checks.end());
     datalayer::returncode rc = datalayer::SUCCESS;
@@ -239,6 +245,7 @@ search_manager :: start(const server_id& from,
             abort();
     }
 
+    st->nanos = po6::monotonic_time() - t_start;
     m_searches.insert(sid, st);
     next(from, to, nonce, search_id);
 }
@@ -249,20 +256,21 @@ search_manager :: next(const server_id& from,
                        uint64_t nonce,
                        uint64_t search_id)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     id sid(ri, from, search_id);
     e::intrusive_ptr<state> st;
 
     if (!m_searches.lookup(sid, &st))
     {
-        std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
+        std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
         msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
         m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DONE, msg);
         return;
     }
 
     po6::threads::mutex::hold hold(&st->lock);
+    uint64_t t_start = po6::monotonic_time();
 
     if (st->iter->valid())
     {
@@ -275,16 +283,21 @@ search_manager :: next(const server_id& from,
                   + sizeof(uint64_t)
                   + pack_size(key)
                   + pack_size(val);
-        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
         msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << key << val;
+        m_daemon->m_region_stats.count(ri, region_stats::SEARCH_ITEM, sz);
         m_daemon->m_comm.send_client(to, from, RESP_SEARCH_ITEM, msg);
         st->iter->next();
+        st->nanos += po6::monotonic_time() - t_start;
+        st->bytes += sz;
     }
     else
     {
-        std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
+        std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
         msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
         m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DONE, msg);
+        st->nanos += po6::monotonic_time() - t_start;
+        log_if_slow(slow_log::SEARCH, ri, st->checks, st->iter.get(), st->nanos, st->bytes);
         stop(from, to, search_id);
     }
 }
@@ -294,7 +307,7 @@ search_manager :: stop(const server_id& from,
                        const virtual_server_id& to,
                        uint64_t search_id)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
+    region_id ri(m_daemon->m_config->get_region_id(to));
     id sid(ri, from, search_id);
     m_searches.remove(sid);
 }
@@ -433,14 +446,15 @@ search_manager :: sorted_search(const server_id& from,
                                 uint16_t sort_by,
                                 bool maximize)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema* sc = m_daemon->m_config->get_schema(ri);
 
     if (sc->authorization)
     {
         return;
     }
 
+    uint64_t t_start = po6::monotonic_time();
     std::stable_sort(checks->begin(), checks->end());
     datalayer::returncode rc = datalayer::SUCCESS;
     datalayer::snapshot snap = m_daemon->m_data.make_snapshot();
@@ -489,7 +503,7 @@ search_manager :: sorted_search(const server_id& from,
         sz += pack_size(top_n[i].key) + pack_size(top_n[i].value);
     }
 
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
     e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
     pa = pa << nonce << static_cast<uint64_t>(top_n.size());
 
@@ -498,7 +512,10 @@ search_manager :: sorted_search(const server_id& from,
         pa = pa << top_n[i].key << top_n[i].value;
     }
 
+    m_daemon->m_region_stats.count(ri, region_stats::SEARCH_ITEM, sz);
     m_daemon->m_comm.send_client(to, from, RESP_SORTED_SEARCH, msg);
+    log_if_slow(slow_log::SORTED_SEARCH, ri, *checks, iter.get(),
+                po6::monotonic_time() - t_start, sz);
 }
 
 void
@@ -510,14 +527,15 @@ search_manager :: group_keyop(const server_id& from,
                               const e::slice& remain,
                               network_msgtype resp)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema* sc = m_daemon->m_config->get_schema(ri);
 
     if (sc->authorization)
     {
         return;
     }
 
+    uint64_t t_start = po6::monotonic_time();
     std::stable_sort(checks->begin(), checks->end());
     datalayer::returncode rc = datalayer::SUCCESS;
     datalayer::snapshot snap = m_daemon->m_data.make_snapshot();
@@ -552,10 +570,10 @@ search_manager :: group_keyop(const server_id& from,
                   + sizeof(uint64_t)
                   + pack_size(key)
                   + remain.size();
-        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
         msg->pack_at(HYPERDEX_HEADER_SIZE_SV)
             << uint64_t(0) << key << e::pack_memmove(remain.data(), remain.size());
-        virtual_server_id vsi = m_daemon->m_config.point_leader(ri, key);
+        virtual_server_id vsi = m_daemon->m_config->point_leader(ri, key);
 
         if (vsi != virtual_server_id())
         {
@@ -569,9 +587,11 @@ search_manager :: group_keyop(const server_id& from,
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint64_t);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
     msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << result;
     m_daemon->m_comm.send_client(to, from, resp, msg);
+    log_if_slow(slow_log::GROUP_ATOMIC, ri, *checks, iter.get(),
+                po6::monotonic_time() - t_start, sz);
 }
 
 void
@@ -580,14 +600,15 @@ search_manager :: count(const server_id& from,
                         uint64_t nonce,
                         std::vector<attribute_check>* checks)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema* sc = m_daemon->m_config->get_schema(ri);
 
     if (sc->authorization)
     {
         return;
     }
 
+    uint64_t t_start = po6::monotonic_time();
     std::stable_sort(checks->begin(), checks->end());
     datalayer::returncode rc = datalayer::SUCCESS;
     datalayer::snapshot snap = m_daemon->m_data.make_snapshot();
@@ -620,9 +641,11 @@ search_manager :: count(const server_id& from,
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint64_t);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
     msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << result;
     m_daemon->m_comm.send_client(to, from, RESP_COUNT, msg);
+    log_if_slow(slow_log::COUNT, ri, *checks, iter.get(),
+                po6::monotonic_time() - t_start, sz);
 }
 
 void
@@ -631,8 +654,8 @@ search_manager :: search_describe(const server_id& from,
                                   uint64_t nonce,
                                   std::vector<attribute_check>* checks)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema* sc = m_daemon->m_config->get_schema(ri);
 
     if (sc->authorization)
     {
@@ -669,6 +692,7 @@ search_manager :: search_describe(const server_id& from,
     }
 
     uint64_t num = 0;
+    iter->enable_timing();
     t_start = po6::monotonic_time();
 
     while (iter->valid())
@@ -679,13 +703,15 @@ search_manager :: search_describe(const server_id& from,
 
     t_end = po6::monotonic_time();
     ostr << " retrieved " << num << " objects in " << t_end - t_start << "ns\n";
+    ostr << " analyze\n";
+    iter->analyze(ostr, "  ");
     std::string str(ostr.str());
     const char* text = str.c_str();
     size_t text_sz = strlen(text);
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + text_sz;
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
     msg->pack_at(HYPERDEX_HEADER_SIZE_VC)
         << nonce << e::pack_memmove(text, text_sz);
     m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DESCRIBE, msg);
@@ -696,3 +722,45 @@ search_manager :: hash(const id& sid)
 {
     return sid.region.get() + sid.client.get() + sid.search_id;
 }
+
+void
+search_manager :: log_if_slow(slow_log::op_t op,
+                              const region_id& ri,
+                              const std::vector<attribute_check>& checks,
+                              datalayer::iterator* iter,
+                              uint64_t latency,
+                              uint64_t bytes)
+{
+    if (!m_daemon->m_slow_ops.slow(latency))
+    {
+        return;
+    }
+
+    const space* sp = m_daemon->m_config->get_space(ri);
+    const schema* sc = m_daemon->m_config->get_schema(ri);
+    slow_log::record r;
+    r.when = po6::wallclock_time();
+    r.latency = latency;
+    r.rows = iter->rows_examined();
+    r.bytes = bytes;
+    r.op = op;
+    r.space = sp ? sp->name : "";
+    std::ostringstream ostr;
+
+    // the values may be sensitive; the shape of the query is what matters
+    for (size_t i = 0; sc && i < checks.size(); ++i)
+    {
+        if (i > 0)
+        {
+            ostr << ", ";
+        }
+
+        ostr << sc->attrs[checks[i].attr].name << " " << checks[i].predicate << " ?";
+    }
+
+    r.checks = ostr.str();
+    ostr.str("");
+    ostr << *iter;
+    r.plan = ostr.str();
+    m_daemon->m_slow_ops.add(r);
+}
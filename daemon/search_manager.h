@@ -38,6 +38,7 @@
 #include "common/network_msgtype.h"
 #include "daemon/datalayer.h"
 #include "daemon/reconfigure_returncode.h"
+#include "daemon/slow_log.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 class daemon;
@@ -111,6 +112,13 @@ class search_manager
 
     private:
         static uint64_t hash(const id&);
+        // add the operation to the daemon's slow log if it took too long
+        void log_if_slow(slow_log::op_t op,
+                         const region_id& ri,
+                         const std::vector<attribute_check>& checks,
+                         datalayer::iterator* iter,
+                         uint64_t latency,
+                         uint64_t bytes);
 
     private:
         daemon* m_daemon;
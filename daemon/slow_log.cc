@@ -0,0 +1,249 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdio.h>
+
+// POSIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// STL
+#include <algorithm>
+#include <sstream>
+
+// po6
+#include <po6/path.h>
+#include <po6/time.h>
+
+// HyperDex
+#include "daemon/slow_log.h"
+
+using hyperdex::slow_log;
+
+const size_t slow_log::CAPACITY;
+const uint64_t slow_log::RATE;
+const uint64_t slow_log::ROTATE_BYTES;
+
+slow_log :: slow_log()
+    : m_threshold(0)
+    , m_path()
+    , m_mtx()
+    , m_records()
+    , m_tokens(RATE)
+    , m_refilled(po6::monotonic_time())
+    , m_suppressed(0)
+    , m_file()
+    , m_file_bytes(0)
+{
+}
+
+slow_log :: ~slow_log() throw ()
+{
+}
+
+bool
+slow_log :: setup(uint64_t threshold, const std::string& path)
+{
+    m_threshold = threshold;
+
+    if (path.empty())
+    {
+        return true;
+    }
+
+    e::compat::shared_ptr<po6::io::fd> fd(new po6::io::fd(::open(path.c_str(), O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR)));
+    struct stat st;
+
+    if (fd->get() < 0 || fstat(fd->get(), &st) < 0)
+    {
+        return false;
+    }
+
+    // the daemon changes its working directory after startup, so remember
+    // where the file really is for when it is rotated
+    if (!po6::path::realpath(path, &m_path))
+    {
+        return false;
+    }
+
+    m_file = fd;
+    m_file_bytes = st.st_size;
+    return true;
+}
+
+void
+slow_log :: add(const record& r)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (!admit(po6::monotonic_time()))
+    {
+        ++m_suppressed;
+        return;
+    }
+
+    m_records.push_front(r);
+
+    if (m_records.size() > CAPACITY)
+    {
+        m_records.pop_back();
+    }
+
+    if (m_file)
+    {
+        write(r);
+    }
+}
+
+void
+slow_log :: recent(size_t n, std::vector<record>* records)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    n = std::min(n, m_records.size());
+    records->assign(m_records.begin(), m_records.begin() + n);
+}
+
+uint64_t
+slow_log :: suppressed()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_suppressed;
+}
+
+const char*
+slow_log :: name(op_t op)
+{
+    switch (op)
+    {
+        case GET:
+            return "get";
+        case SEARCH:
+            return "search";
+        case SORTED_SEARCH:
+            return "sorted_search";
+        case COUNT:
+            return "count";
+        case GROUP_ATOMIC:
+            return "group_atomic";
+        default:
+            return "unknown";
+    }
+}
+
+std::string
+slow_log :: format(const record& r)
+{
+    char when[32];
+    snprintf(when, sizeof(when), "%lu.%06lu",
+             static_cast<unsigned long>(r.when / 1000000000ULL),
+             static_cast<unsigned long>((r.when % 1000000000ULL) / 1000ULL));
+    std::ostringstream ostr;
+    ostr << "time=" << when
+         << " op=" << name(r.op)
+         << " space=" << r.space
+         << " latency=" << r.latency / 1000ULL << "us"
+         << " rows=" << r.rows
+         << " bytes=" << r.bytes
+         << " plan=\"" << r.plan << "\""
+         << " checks=\"" << r.checks << "\"";
+    return ostr.str();
+}
+
+bool
+slow_log :: admit(uint64_t now)
+{
+    const uint64_t interval = 1000000000ULL / RATE;
+
+    if (now > m_refilled)
+    {
+        uint64_t earned = (now - m_refilled) / interval;
+
+        if (m_tokens + earned >= RATE)
+        {
+            m_tokens = RATE;
+            m_refilled = now;
+        }
+        else
+        {
+            m_tokens += earned;
+            m_refilled += earned * interval;
+        }
+    }
+
+    if (m_tokens == 0)
+    {
+        return false;
+    }
+
+    --m_tokens;
+    return true;
+}
+
+void
+slow_log :: write(const record& r)
+{
+    if (m_file_bytes >= ROTATE_BYTES)
+    {
+        rotate();
+    }
+
+    std::string line(format(r));
+    line.push_back('\n');
+
+    if (m_file->xwrite(line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+    {
+        // keep the in-memory log going even if the disk does not
+        m_file.reset();
+        return;
+    }
+
+    m_file_bytes += line.size();
+}
+
+void
+slow_log :: rotate()
+{
+    std::string old(m_path + ".1");
+
+    if (rename(m_path.c_str(), old.c_str()) < 0)
+    {
+        return;
+    }
+
+    e::compat::shared_ptr<po6::io::fd> fd(new po6::io::fd(::open(m_path.c_str(), O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR)));
+
+    if (fd->get() < 0)
+    {
+        return;
+    }
+
+    m_file = fd;
+    m_file_bytes = 0;
+}
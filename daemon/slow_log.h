@@ -0,0 +1,135 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_slow_log_h_
+#define hyperdex_daemon_slow_log_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <deque>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/io/fd.h>
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/compat.h>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A bounded log of operations that took longer than a threshold.  It keeps
+// the last CAPACITY records in memory and, if given a path, appends each one
+// to that file as a line of text, moving the file aside to path.1 once it
+// grows past ROTATE_BYTES.  A token bucket admits at most RATE records per
+// second; the rest are only counted, so a burst of slow operations samples
+// itself instead of flooding the log.
+class slow_log
+{
+    public:
+        const static size_t CAPACITY = 256;
+        const static uint64_t RATE = 16;
+        const static uint64_t ROTATE_BYTES = 64ULL * 1024ULL * 1024ULL;
+        enum op_t
+        {
+            GET,
+            SEARCH,
+            SORTED_SEARCH,
+            COUNT,
+            GROUP_ATOMIC
+        };
+        struct record
+        {
+            record()
+                : when(0), latency(0), rows(0), bytes(0), op(GET)
+                , space(), checks(), plan() {}
+            // wall-clock time the operation finished, in ns since the epoch
+            uint64_t when;
+            // ns spent serving the operation
+            uint64_t latency;
+            // objects examined
+            uint64_t rows;
+            // bytes returned to the client
+            uint64_t bytes;
+            op_t op;
+            std::string space;
+            // the predicates, with their values left out
+            std::string checks;
+            // the iterator chosen to answer the operation
+            std::string plan;
+        };
+
+    public:
+        slow_log();
+        ~slow_log() throw ();
+
+    public:
+        // log operations slower than threshold ns, where 0 disables the log;
+        // returns false if path is non-empty and cannot be opened
+        bool setup(uint64_t threshold, const std::string& path);
+        bool enabled() const { return m_threshold > 0; }
+        bool slow(uint64_t latency) const
+        { return enabled() && latency >= m_threshold; }
+        // log r, unless the rate limit says otherwise
+        void add(const record& r);
+        // the most recent records, newest first
+        void recent(size_t n, std::vector<record>* records);
+        // records turned away by the rate limit
+        uint64_t suppressed();
+        static const char* name(op_t op);
+        static std::string format(const record& r);
+
+    private:
+        bool admit(uint64_t now);
+        void write(const record& r);
+        void rotate();
+
+    private:
+        slow_log(const slow_log&);
+        slow_log& operator = (const slow_log&);
+
+    private:
+        uint64_t m_threshold;
+        std::string m_path;
+        po6::threads::mutex m_mtx;
+        std::deque<record> m_records;
+        uint64_t m_tokens;
+        uint64_t m_refilled;
+        uint64_t m_suppressed;
+        e::compat::shared_ptr<po6::io::fd> m_file;
+        uint64_t m_file_bytes;
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_slow_log_h_
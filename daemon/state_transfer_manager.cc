@@ -32,6 +32,8 @@
 
 // STL
 #include <algorithm>
+#include <set>
+#include <string>
 
 // Google Log
 #include <glog/logging.h>
@@ -49,6 +51,16 @@ using hyperdex::reconfigure_returncode;
 using hyperdex::state_transfer_manager;
 using hyperdex::transfer_id;
 
+namespace
+{
+
+// bulk transfers pack objects into batches of about this many bytes
+const size_t BULK_BYTES = 1024 * 1024;
+// and keep at most this many batches in flight
+const size_t BULK_WINDOW = 16;
+
+} // namespace
+
 class state_transfer_manager::background_thread : public ::hyperdex::background_thread
 {
     public:
@@ -62,7 +74,10 @@ class state_transfer_manager::background_thread : public ::hyperdex::background_
         virtual void do_work();
 
     public:
+        // retransmit and continue every transfer
         void kick();
+        // continue every transfer once the network budget allows
+        void pace();
 
     private:
         background_thread(const background_thread&);
@@ -71,6 +86,9 @@ class state_transfer_manager::background_thread : public ::hyperdex::background_
     private:
         state_transfer_manager* m_stm;
         bool m_need_kickstart;
+        bool m_need_pacing;
+        bool m_kickstart;
+        bool m_pacing;
 };
 
 state_transfer_manager :: state_transfer_manager(daemon* d)
@@ -237,7 +255,8 @@ void
 state_transfer_manager :: handshake_synack(const server_id& from,
                                            const virtual_server_id& to,
                                            const transfer_id& xid,
-                                           uint64_t timestamp)
+                                           uint64_t timestamp,
+                                           bool bulk)
 {
     transfer_out_state* tos = get_tos(xid);
 
@@ -260,10 +279,12 @@ state_transfer_manager :: handshake_synack(const server_id& from,
     iter.reset(m_daemon->m_data.replay_region_from_checkpoint(tos->xfer.rid, timestamp, &wipe));
     tos->handshake_syn = true;
     tos->wipe = wipe;
+    tos->bulk = bulk;
     tos->iter = iter;
     send_handshake_ack(tos->xfer, tos->wipe);
     transfer_more_state(tos);
-    LOG(INFO) << "received handshake_synack for " << xid << " @ " << timestamp;
+    LOG(INFO) << "received handshake_synack for " << xid << " @ " << timestamp
+              << (bulk ? " (sending in bulk)" : "");
 }
 
 void
@@ -356,11 +377,56 @@ state_transfer_manager :: xfer_op(const virtual_server_id& from,
                                   const e::slice& key,
                                   const std::vector<e::slice>& value)
 {
+    e::intrusive_ptr<pending> op(new pending());
+    op->seq_no = seq_no;
+    op->has_value = has_value;
+    op->version = version;
+    op->key = key;
+    op->value = value;
+    op->msg = msg;
+    queue_op(from, xid, op);
+}
+
+void
+state_transfer_manager :: xfer_bulk(const virtual_server_id& from,
+                                    const transfer_id& xid,
+                                    uint64_t seq_no,
+                                    std::auto_ptr<e::buffer> msg,
+                                    const std::vector<bool>& has_value,
+                                    const std::vector<uint64_t>& version,
+                                    const std::vector<e::slice>& key,
+                                    const std::vector<std::vector<e::slice> >& value)
+{
+    e::intrusive_ptr<pending> op(new pending());
+    op->seq_no = seq_no;
+    op->msg = msg;
+    op->batch.reserve(key.size());
+
+    for (size_t i = 0; i < key.size(); ++i)
+    {
+        e::intrusive_ptr<pending> obj(new pending());
+        obj->seq_no = seq_no;
+        obj->has_value = has_value[i];
+        obj->version = version[i];
+        obj->key = key[i];
+        obj->value = value[i];
+        op->batch.push_back(obj);
+    }
+
+    queue_op(from, xid, op);
+}
+
+void
+state_transfer_manager :: queue_op(const virtual_server_id& from,
+                                   const transfer_id& xid,
+                                   e::intrusive_ptr<pending> op)
+{
+    const char* type = op->batch.empty() ? "XFER_OP" : "XFER_BULK";
     transfer_in_state* tis = get_tis(xid);
 
     if (!tis)
     {
-        LOG(INFO) << "dropping XFER_OP for " << xid << " which we don't know about";
+        LOG(INFO) << "dropping " << type << " for " << xid << " which we don't know about";
         return;
     }
 
@@ -368,10 +434,12 @@ state_transfer_manager :: xfer_op(const virtual_server_id& from,
 
     if (tis->xfer.vsrc != from || tis->xfer.id != xid)
     {
-        LOG(INFO) << "dropping XFER_OP that came from the wrong host";
+        LOG(INFO) << "dropping " << type << " that came from the wrong host";
         return;
     }
 
+    uint64_t seq_no = op->seq_no;
+
     if (seq_no < tis->upper_bound_acked)
     {
         return send_ack(tis->xfer, seq_no);
@@ -394,13 +462,6 @@ state_transfer_manager :: xfer_op(const virtual_server_id& from,
         }
     }
 
-    e::intrusive_ptr<pending> op(new pending());
-    op->seq_no = seq_no;
-    op->has_value = has_value;
-    op->version = version;
-    op->key = key;
-    op->value = value;
-    op->msg = msg;
     tis->queued.insert(where_to_put_it, op);
     put_to_disk_and_send_acks(tis);
 }
@@ -499,34 +560,31 @@ state_transfer_manager :: transfer_more_state(transfer_out_state* tos)
     }
 
     assert(tos->iter.get());
+    const size_t window_sz = tos->bulk
+                           ? std::min(tos->window_sz, BULK_WINDOW)
+                           : tos->window_sz;
 
-    while (tos->window.size() < tos->window_sz && tos->iter->valid())
+    while (tos->window.size() < window_sz && tos->iter->valid())
     {
-        e::intrusive_ptr<pending> op(new pending());
-        op->seq_no = tos->next_seq_no;
-        ++tos->next_seq_no;
-        op->kref.assign(reinterpret_cast<const char*>(tos->iter->key().data()), tos->iter->key().size());
-        op->key = e::slice(op->kref);
-
-        if (tos->iter->has_value())
+        // once over budget, the background thread sends the rest
+        if (m_daemon->m_io.exhausted(io_scheduler::NETWORK))
         {
-            op->has_value = true;
-
-            if (tos->iter->unpack_value(&op->value, &op->version, &op->vref) != datalayer::SUCCESS)
-            {
-                LOG(ERROR) << "error doing state transfer";
-                break;
-            }
+            m_background_thread->pace();
+            return;
         }
-        else
+
+        e::intrusive_ptr<pending> op(new pending());
+
+        if (!(tos->bulk ? read_batch(tos, op.get()) : read_object(tos, op.get())))
         {
-            op->has_value = false;
-            op->version = 0;
+            LOG(ERROR) << "error doing state transfer";
+            break;
         }
 
+        op->seq_no = tos->next_seq_no;
+        ++tos->next_seq_no;
         tos->window.push_back(op);
         send_object(tos->xfer, op.get());
-        tos->iter->next();
     }
 
     if (!tos->handshake_ack)
@@ -534,7 +592,7 @@ state_transfer_manager :: transfer_more_state(transfer_out_state* tos)
         // pass!  we need the other end to give us some sign that it's ready,
         // otherwise we cannot consider moving forward, even if we're ready.
     }
-    else if (tos->window.empty() && m_daemon->m_config.is_transfer_live(tos->xfer.id))
+    else if (tos->window.empty() && m_daemon->m_config->is_transfer_live(tos->xfer.id))
     {
         m_daemon->m_coord->transfer_complete(tos->xfer.id);
     }
@@ -544,6 +602,62 @@ state_transfer_manager :: transfer_more_state(transfer_out_state* tos)
     }
 }
 
+bool
+state_transfer_manager :: read_object(transfer_out_state* tos, pending* op)
+{
+    op->kref.assign(reinterpret_cast<const char*>(tos->iter->key().data()), tos->iter->key().size());
+    op->key = e::slice(op->kref);
+
+    if (tos->iter->has_value())
+    {
+        op->has_value = true;
+
+        if (tos->iter->unpack_value(&op->value, &op->version, &op->vref) != datalayer::SUCCESS)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        op->has_value = false;
+        op->version = 0;
+    }
+
+    m_daemon->m_io.charge(io_scheduler::DISK_READ, op->key.size() + pack_size(op->value));
+    tos->iter->next();
+    return true;
+}
+
+bool
+state_transfer_manager :: read_batch(transfer_out_state* tos, pending* op)
+{
+    // the receiver writes a batch as one unit, so it may name each key once
+    std::set<std::string> keys;
+    size_t bytes = 0;
+
+    while (tos->iter->valid() && bytes < BULK_BYTES)
+    {
+        e::slice key = tos->iter->key();
+
+        if (!keys.insert(std::string(reinterpret_cast<const char*>(key.data()), key.size())).second)
+        {
+            break;
+        }
+
+        e::intrusive_ptr<pending> obj(new pending());
+
+        if (!read_object(tos, obj.get()))
+        {
+            break;
+        }
+
+        bytes += obj->key.size() + pack_size(obj->value);
+        op->batch.push_back(obj);
+    }
+
+    return !op->batch.empty();
+}
+
 void
 state_transfer_manager :: retransmit(transfer_out_state* tos)
 {
@@ -577,8 +691,46 @@ state_transfer_manager :: put_to_disk_and_send_acks(transfer_in_state* tis)
            tis->queued.front()->seq_no == tis->upper_bound_acked)
     {
         e::intrusive_ptr<pending> op = tis->queued.front();
+        // this runs on a network thread, so it charges the budget without
+        // waiting; the sender's budget paces the transfer itself
+        m_daemon->m_io.charge(io_scheduler::DISK_WRITE, op->msg.get() ? op->msg->size() : 0);
 
-        if (op->has_value)
+        if (!op->batch.empty())
+        {
+            std::vector<e::slice> keys;
+            std::vector<const std::vector<e::slice>*> values;
+            std::vector<uint64_t> versions;
+            keys.reserve(op->batch.size());
+            values.reserve(op->batch.size());
+            versions.reserve(op->batch.size());
+
+            for (size_t i = 0; i < op->batch.size(); ++i)
+            {
+                pending* obj = op->batch[i].get();
+                keys.push_back(obj->key);
+                values.push_back(obj->has_value ? &obj->value : NULL);
+                versions.push_back(obj->version);
+            }
+
+            datalayer::returncode rc = m_daemon->m_data.uncertain_write(tis->xfer.rid, keys, values, versions);
+
+            switch (rc)
+            {
+                case datalayer::SUCCESS:
+                    break;
+                case datalayer::NOT_FOUND:
+                case datalayer::BAD_ENCODING:
+                case datalayer::CORRUPTION:
+                case datalayer::IO_ERROR:
+                case datalayer::LEVELDB_ERROR:
+                    LOG(ERROR) << "state transfer caused error " << rc;
+                    break;
+                default:
+                    LOG(ERROR) << "state transfer caused unknown error";
+                    break;
+            }
+        }
+        else if (op->has_value)
         {
             datalayer::returncode rc = m_daemon->m_data.uncertain_put(tis->xfer.rid, op->key, op->value, op->version);
 
@@ -630,7 +782,7 @@ state_transfer_manager :: send_handshake_syn(const transfer& xfer)
 {
     size_t sz = HYPERDEX_HEADER_SIZE_VV
               + sizeof(uint64_t);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
     msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << xfer.id;
     m_daemon->m_comm.send_exact(xfer.vsrc, xfer.vdst, XFER_HS, msg);
 }
@@ -638,11 +790,14 @@ state_transfer_manager :: send_handshake_syn(const transfer& xfer)
 void
 state_transfer_manager :: send_handshake_synack(const transfer& xfer, uint64_t timestamp)
 {
+    // 0x1:  we accept XFER_BULK
+    uint8_t flags = 0x1;
     size_t sz = HYPERDEX_HEADER_SIZE_VV
               + sizeof(uint64_t)
-              + sizeof(uint64_t);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << xfer.id << timestamp;
+              + sizeof(uint64_t)
+              + sizeof(uint8_t);
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << xfer.id << timestamp << flags;
     m_daemon->m_comm.send_exact(xfer.vdst, xfer.vsrc, XFER_HSA, msg);
 }
 
@@ -653,7 +808,7 @@ state_transfer_manager :: send_handshake_ack(const transfer& xfer, bool wipe)
     size_t sz = HYPERDEX_HEADER_SIZE_VV
               + sizeof(uint64_t)
               + sizeof(uint8_t);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
     msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << xfer.id << flags;
     m_daemon->m_comm.send_exact(xfer.vsrc, xfer.vdst, XFER_HA, msg);
 }
@@ -663,7 +818,7 @@ state_transfer_manager :: send_handshake_wiped(const transfer& xfer)
 {
     size_t sz = HYPERDEX_HEADER_SIZE_VV
               + sizeof(uint64_t);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
     msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << xfer.id;
     m_daemon->m_comm.send_exact(xfer.vdst, xfer.vsrc, XFER_HW, msg);
 }
@@ -672,6 +827,11 @@ void
 state_transfer_manager :: send_object(const transfer& xfer,
                                       pending* op)
 {
+    if (!op->batch.empty())
+    {
+        return send_batch(xfer, op);
+    }
+
     uint8_t flags = (op->has_value ? 1 : 0);
     size_t sz = HYPERDEX_HEADER_SIZE_VV
               + sizeof(uint8_t)
@@ -680,12 +840,48 @@ state_transfer_manager :: send_object(const transfer& xfer,
               + sizeof(uint64_t)
               + sizeof(uint32_t) + op->key.size()
               + pack_size(op->value);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
     msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << xfer.id.get() << op->seq_no
                                           << op->version << op->key << op->value;
+    m_daemon->m_io.charge(io_scheduler::NETWORK, msg->size());
     m_daemon->m_comm.send_exact(xfer.vsrc, xfer.vdst, XFER_OP, msg);
 }
 
+void
+state_transfer_manager :: send_batch(const transfer& xfer,
+                                     pending* op)
+{
+    uint8_t flags = 0;
+    uint32_t count = op->batch.size();
+    size_t sz = HYPERDEX_HEADER_SIZE_VV
+              + sizeof(uint8_t)
+              + sizeof(uint64_t)
+              + sizeof(uint64_t)
+              + sizeof(uint32_t);
+
+    for (size_t i = 0; i < op->batch.size(); ++i)
+    {
+        sz += sizeof(uint8_t)
+            + sizeof(uint64_t)
+            + sizeof(uint32_t) + op->batch[i]->key.size()
+            + pack_size(op->batch[i]->value);
+    }
+
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
+    e::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV)
+                 << flags << xfer.id.get() << op->seq_no << count;
+
+    for (size_t i = 0; i < op->batch.size(); ++i)
+    {
+        pending* obj = op->batch[i].get();
+        uint8_t obj_flags = (obj->has_value ? 1 : 0);
+        pa = pa << obj_flags << obj->version << obj->key << obj->value;
+    }
+
+    m_daemon->m_io.charge(io_scheduler::NETWORK, msg->size());
+    m_daemon->m_comm.send_exact(xfer.vsrc, xfer.vdst, XFER_BULK, msg);
+}
+
 void
 state_transfer_manager :: send_ack(const transfer& xfer, uint64_t seq_no)
 {
@@ -694,7 +890,7 @@ state_transfer_manager :: send_ack(const transfer& xfer, uint64_t seq_no)
               + sizeof(uint8_t)
               + sizeof(uint64_t)
               + sizeof(uint64_t);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(m_daemon->m_comm.create_buffer(sz));
     msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << xfer.id.get() << seq_no;
     m_daemon->m_comm.send_exact(xfer.vdst, xfer.vsrc, XFER_ACK, msg);
 }
@@ -703,6 +899,9 @@ state_transfer_manager :: background_thread :: background_thread(state_transfer_
     : hyperdex::background_thread(stm->m_daemon)
     , m_stm(stm)
     , m_need_kickstart(false)
+    , m_need_pacing(false)
+    , m_kickstart(false)
+    , m_pacing(false)
 {
 }
 
@@ -719,24 +918,36 @@ state_transfer_manager :: background_thread :: thread_name()
 bool
 state_transfer_manager :: background_thread :: have_work()
 {
-    return m_need_kickstart;
+    return m_need_kickstart || m_need_pacing;
 }
 
 void
 state_transfer_manager :: background_thread :: copy_work()
 {
+    m_kickstart = m_need_kickstart;
+    m_pacing = m_need_pacing;
     m_need_kickstart = false;
+    m_need_pacing = false;
 }
 
 void
 state_transfer_manager :: background_thread :: do_work()
 {
+    if (m_pacing)
+    {
+        m_stm->m_daemon->m_io.wait(io_scheduler::NETWORK);
+    }
+
     for (size_t idx = 0; idx < m_stm->m_transfers_out.size(); ++idx)
     {
         po6::threads::mutex::hold hold2(&m_stm->m_transfers_out[idx]->mtx);
-        m_stm->retransmit(m_stm->m_transfers_out[idx].get());
+
+        if (m_kickstart)
+        {
+            m_stm->retransmit(m_stm->m_transfers_out[idx].get());
+        }
+
         m_stm->transfer_more_state(m_stm->m_transfers_out[idx].get());
-        ++idx;
     }
 
     m_stm->m_daemon->m_comm.wake_one();
@@ -750,3 +961,12 @@ state_transfer_manager :: background_thread :: kick()
     this->wakeup();
     this->unlock();
 }
+
+void
+state_transfer_manager :: background_thread :: pace()
+{
+    this->lock();
+    m_need_pacing = true;
+    this->wakeup();
+    this->unlock();
+}
@@ -71,7 +71,8 @@ class state_transfer_manager
         void handshake_synack(const server_id& from,
                               const virtual_server_id& to,
                               const transfer_id& xid,
-                              uint64_t timestamp);
+                              uint64_t timestamp,
+                              bool bulk);
         void handshake_ack(const virtual_server_id& from,
                            const transfer_id& xid,
                            bool wipe);
@@ -87,6 +88,14 @@ class state_transfer_manager
                      std::auto_ptr<e::buffer> msg,
                      const e::slice& key,
                      const std::vector<e::slice>& value);
+        void xfer_bulk(const virtual_server_id& from,
+                       const transfer_id& xid,
+                       uint64_t seq_no,
+                       std::auto_ptr<e::buffer> msg,
+                       const std::vector<bool>& has_value,
+                       const std::vector<uint64_t>& version,
+                       const std::vector<e::slice>& key,
+                       const std::vector<std::vector<e::slice> >& value);
         void xfer_ack(const server_id& from,
                       const virtual_server_id& to,
                       const transfer_id& xid,
@@ -102,8 +111,16 @@ class state_transfer_manager
         // get the appropriate state
         transfer_in_state* get_tis(const transfer_id& xid);
         transfer_out_state* get_tos(const transfer_id& xid);
+        // queue an incoming op for put_to_disk_and_send_acks
+        void queue_op(const virtual_server_id& from,
+                      const transfer_id& xid,
+                      e::intrusive_ptr<pending> op);
         // caller must hold mtx on tos
         void transfer_more_state(transfer_out_state* tos);
+        // read the object under tos->iter into op and advance the iterator
+        bool read_object(transfer_out_state* tos, pending* op);
+        // fill op->batch with objects of distinct keys from tos->iter
+        bool read_batch(transfer_out_state* tos, pending* op);
         void retransmit(transfer_out_state* tos);
         // caller must hold mtx on tis
         void put_to_disk_and_send_acks(transfer_in_state* tis);
@@ -114,6 +131,7 @@ class state_transfer_manager
         void send_handshake_ack(const transfer& xfer, bool wipe);
         void send_handshake_wiped(const transfer& xfer);
         void send_object(const transfer& xfer, pending* op);
+        void send_batch(const transfer& xfer, pending* op);
         void send_ack(const transfer& xfer, uint64_t seq_id);
 
     private:
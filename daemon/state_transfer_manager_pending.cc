@@ -42,6 +42,7 @@ state_transfer_manager :: state_transfer_manager :: pending :: pending()
     , msg()
     , kref()
     , vref()
+    , batch()
     , m_ref(0)
 {
 }
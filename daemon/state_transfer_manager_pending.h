@@ -48,6 +48,8 @@ class hyperdex::state_transfer_manager::pending
         std::auto_ptr<e::buffer> msg;
         std::string kref;
         datalayer::reference vref;
+        // in a bulk transfer, the objects sent under this sequence number
+        std::vector<e::intrusive_ptr<pending> > batch;
 
     private:
         friend class e::intrusive_ptr<pending>;
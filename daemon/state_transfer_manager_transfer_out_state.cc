@@ -47,6 +47,7 @@ state_transfer_manager :: transfer_out_state :: transfer_out_state(const transfe
     , handshake_syn(false)
     , handshake_ack(false)
     , wipe(false)
+    , bulk(false)
     , m_ref(0)
 {
 }
@@ -65,4 +66,5 @@ state_transfer_manager :: transfer_out_state :: debug_dump()
     LOG(INFO) << "    handshake_syn=" << handshake_syn;
     LOG(INFO) << "    handshake_ack=" << handshake_ack;
     LOG(INFO) << "    wipe=" << wipe;
+    LOG(INFO) << "    bulk=" << bulk;
 }
@@ -62,6 +62,7 @@ class state_transfer_manager::transfer_out_state
         bool handshake_syn; // do we know the other end got a syn?
         bool handshake_ack; // do we know the other end got a ack?
         bool wipe;
+        bool bulk; // does the other end accept XFER_BULK?
 
     private:
         friend class e::intrusive_ptr<transfer_out_state>;
@@ -0,0 +1,95 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/buffer_pool.h"
+
+using hyperdex::buffer_pool;
+
+TEST(BufferPool, CreateRoundsUp)
+{
+    buffer_pool bp;
+    std::auto_ptr<e::buffer> buf = bp.create(100);
+    ASSERT_GE(buf->capacity(), 100U);
+    ASSERT_EQ(buf->size(), 0U);
+    ASSERT_EQ(bp.created(), 1U);
+    ASSERT_EQ(bp.reused(), 0U);
+}
+
+TEST(BufferPool, RecycleThroughDepot)
+{
+    buffer_pool bp;
+    std::auto_ptr<e::buffer> buf = bp.create(100);
+    buf->pack_at(0) << uint64_t(0xdeadbeef);
+    e::buffer* ptr = buf.get();
+    bp.recycle(buf);
+    ASSERT_EQ(bp.recycled(), 1U);
+    buf = bp.create(64);
+    ASSERT_TRUE(buf.get() == ptr);
+    ASSERT_EQ(buf->size(), 0U);
+    ASSERT_EQ(bp.reused(), 1U);
+}
+
+TEST(BufferPool, RecycleThroughThreadCache)
+{
+    buffer_pool bp;
+    buffer_pool::thread_cache tc(&bp);
+    std::auto_ptr<e::buffer> buf = bp.create(1000);
+    e::buffer* ptr = buf.get();
+    bp.recycle(buf);
+    // too big for what's cached
+    buf = bp.create(4000);
+    ASSERT_TRUE(buf.get() != ptr);
+    ASSERT_EQ(bp.created(), 2U);
+    buf = bp.create(1500);
+    ASSERT_TRUE(buf.get() == ptr);
+    ASSERT_EQ(bp.reused(), 1U);
+}
+
+TEST(BufferPool, OddSizes)
+{
+    buffer_pool bp;
+    // too small to satisfy any class
+    bp.recycle(std::auto_ptr<e::buffer>(e::buffer::create(8)));
+    ASSERT_EQ(bp.discarded(), 1U);
+    // too large to keep around
+    bp.recycle(std::auto_ptr<e::buffer>(e::buffer::create(16 * 1024 * 1024)));
+    ASSERT_EQ(bp.discarded(), 2U);
+    // large requests bypass the pool
+    std::auto_ptr<e::buffer> buf = bp.create(1024 * 1024);
+    ASSERT_GE(buf->capacity(), 1024U * 1024U);
+    // a 100 byte buffer is recycled into the 32 byte class
+    bp.recycle(std::auto_ptr<e::buffer>(e::buffer::create(100)));
+    ASSERT_EQ(bp.recycled(), 1U);
+    buf = bp.create(100);
+    ASSERT_EQ(bp.reused(), 0U);
+    buf = bp.create(32);
+    ASSERT_EQ(bp.reused(), 1U);
+}
@@ -0,0 +1,281 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+#include <string.h>
+
+// STL
+#include <memory>
+#include <string>
+#include <vector>
+
+// e
+#include <e/arena.h>
+#include <e/compat.h>
+
+// HyperDex
+#include "test/th.h"
+#include "common/datatype_info.h"
+#include "common/datatype_int64.h"
+#include "daemon/change_combiner.h"
+
+using hyperdex::attribute;
+using hyperdex::change_combiner;
+using hyperdex::datatype_info;
+using hyperdex::datatype_int64;
+using hyperdex::funcall;
+using hyperdex::schema;
+
+namespace
+{
+
+const attribute ATTRS[] = {attribute("k", HYPERDATATYPE_STRING),
+                           attribute("n", HYPERDATATYPE_INT64),
+                           attribute("l", HYPERDATATYPE_LIST_STRING)};
+
+struct change_builder
+{
+    change_builder() : scratch(), funcs() {}
+    change_builder& num_add(int64_t x);
+    change_builder& list_rpush(const char* s);
+    std::vector<e::compat::shared_ptr<std::vector<char> > > scratch;
+    std::vector<funcall> funcs;
+};
+
+change_builder&
+change_builder :: num_add(int64_t x)
+{
+    e::compat::shared_ptr<std::vector<char> > s(new std::vector<char>());
+    scratch.push_back(s);
+    funcall f;
+    f.attr = 1;
+    f.name = hyperdex::FUNC_NUM_ADD;
+    datatype_int64::pack(x, s.get(), &f.arg1);
+    f.arg1_datatype = HYPERDATATYPE_INT64;
+    funcs.push_back(f);
+    return *this;
+}
+
+change_builder&
+change_builder :: list_rpush(const char* s)
+{
+    funcall f;
+    f.attr = 2;
+    f.name = hyperdex::FUNC_LIST_RPUSH;
+    f.arg1 = e::slice(s, strlen(s));
+    f.arg1_datatype = HYPERDATATYPE_STRING;
+    funcs.push_back(f);
+    return *this;
+}
+
+schema
+make_schema()
+{
+    schema sc;
+    sc.attrs_sz = sizeof(ATTRS) / sizeof(ATTRS[0]);
+    sc.attrs = ATTRS;
+    return sc;
+}
+
+std::vector<std::string>
+stringify(const std::vector<e::slice>& value)
+{
+    std::vector<std::string> s;
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        s.push_back(std::string(reinterpret_cast<const char*>(value[i].data()), value[i].size()));
+    }
+
+    return s;
+}
+
+// apply each change to the value the previous one left, as the chain would
+// if every change got its own version
+void
+one_by_one(const schema& sc,
+           const std::vector<change_builder>& changes,
+           std::vector<bool>* results,
+           std::vector<std::string>* value)
+{
+    std::vector<e::compat::shared_ptr<e::arena> > arenas;
+    std::vector<e::slice> current(sc.attrs_sz - 1);
+    e::slice key("key", 3);
+
+    for (size_t i = 0; i < changes.size(); ++i)
+    {
+        e::compat::shared_ptr<e::arena> memory(new e::arena());
+        arenas.push_back(memory);
+        std::vector<e::slice> next(sc.attrs_sz - 1);
+
+        if (hyperdex::apply_funcs(sc, changes[i].funcs, key, current, memory.get(), &next) < changes[i].funcs.size())
+        {
+            results->push_back(false);
+        }
+        else
+        {
+            results->push_back(true);
+            current.swap(next);
+        }
+    }
+
+    *value = stringify(current);
+}
+
+// apply the first change, then fold the rest into it, as key_state does
+void
+folded(const schema& sc,
+       const std::vector<change_builder>& changes,
+       std::vector<bool>* results,
+       std::vector<std::string>* value)
+{
+    std::auto_ptr<e::arena> memory(new e::arena());
+    std::vector<e::slice> zero(sc.attrs_sz - 1);
+    std::vector<e::slice> first(sc.attrs_sz - 1);
+    e::slice key("key", 3);
+    ASSERT_EQ(hyperdex::apply_funcs(sc, changes[0].funcs, key, zero, memory.get(), &first),
+              changes[0].funcs.size());
+    results->push_back(true);
+    change_combiner combined(sc, key, memory, first);
+
+    for (size_t i = 1; i < changes.size(); ++i)
+    {
+        results->push_back(combined.fold(changes[i].funcs));
+    }
+
+    *value = stringify(combined.value());
+    std::auto_ptr<e::arena> last(combined.memory());
+    ASSERT_TRUE(last.get() != NULL);
+}
+
+void
+check_equivalent(const std::vector<change_builder>& changes)
+{
+    schema sc(make_schema());
+    std::vector<bool> expected_results;
+    std::vector<std::string> expected_value;
+    one_by_one(sc, changes, &expected_results, &expected_value);
+    std::vector<bool> results;
+    std::vector<std::string> value;
+    folded(sc, changes, &results, &value);
+    ASSERT_TRUE(results == expected_results);
+    ASSERT_TRUE(value == expected_value);
+}
+
+int64_t
+number(const std::vector<change_builder>& changes)
+{
+    schema sc(make_schema());
+    std::vector<bool> results;
+    std::vector<std::string> value;
+    folded(sc, changes, &results, &value);
+    return datatype_int64::unpack(e::slice(value[0].data(), value[0].size()));
+}
+
+uint64_t
+length(const std::vector<change_builder>& changes)
+{
+    schema sc(make_schema());
+    std::vector<bool> results;
+    std::vector<std::string> value;
+    folded(sc, changes, &results, &value);
+    datatype_info* di = datatype_info::lookup(HYPERDATATYPE_LIST_STRING);
+    return di->length(e::slice(value[1].data(), value[1].size()));
+}
+
+} // namespace
+
+TEST(ChangeCombiner, NumAdd)
+{
+    std::vector<change_builder> changes;
+
+    for (int64_t i = 1; i <= 64; ++i)
+    {
+        changes.push_back(change_builder().num_add(i));
+    }
+
+    check_equivalent(changes);
+    ASSERT_EQ(number(changes), 64 * 65 / 2);
+}
+
+TEST(ChangeCombiner, ListRPush)
+{
+    const char* elems[] = {"a", "bb", "ccc", "dddd", "eeeee"};
+    std::vector<change_builder> changes;
+
+    for (size_t i = 0; i < 64; ++i)
+    {
+        changes.push_back(change_builder().list_rpush(elems[i % 5]));
+    }
+
+    check_equivalent(changes);
+    ASSERT_EQ(length(changes), 64U);
+}
+
+TEST(ChangeCombiner, Mixed)
+{
+    std::vector<change_builder> changes;
+
+    for (size_t i = 0; i < 32; ++i)
+    {
+        changes.push_back(change_builder().num_add(i).list_rpush("x"));
+        changes.push_back(change_builder().list_rpush("y"));
+        changes.push_back(change_builder().num_add(-1));
+    }
+
+    check_equivalent(changes);
+}
+
+TEST(ChangeCombiner, CmpFailMidBatch)
+{
+    std::vector<change_builder> changes;
+    changes.push_back(change_builder().num_add(5).list_rpush("a"));
+    changes.push_back(change_builder().num_add(7));
+    // overflows, so neither func applies
+    changes.push_back(change_builder().num_add(INT64_MAX).list_rpush("lost"));
+    changes.push_back(change_builder().list_rpush("b"));
+    changes.push_back(change_builder().num_add(INT64_MAX));
+    changes.push_back(change_builder().num_add(-12).list_rpush("c"));
+    check_equivalent(changes);
+
+    schema sc(make_schema());
+    std::vector<bool> results;
+    std::vector<std::string> value;
+    folded(sc, changes, &results, &value);
+    ASSERT_EQ(results.size(), 6U);
+    ASSERT_TRUE(results[0]);
+    ASSERT_TRUE(results[1]);
+    ASSERT_FALSE(results[2]);
+    ASSERT_TRUE(results[3]);
+    ASSERT_FALSE(results[4]);
+    ASSERT_TRUE(results[5]);
+    ASSERT_EQ(number(changes), 0);
+    ASSERT_EQ(length(changes), 3U);
+}
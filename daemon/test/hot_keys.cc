@@ -0,0 +1,120 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdio.h>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/hot_keys.h"
+
+using hyperdex::hot_keys;
+
+TEST(HotKeys, CountsExactlyUnderCapacity)
+{
+    hot_keys hk(1);
+
+    for (size_t i = 0; i < 10; ++i)
+    {
+        hk.observe(e::slice("a", 1));
+    }
+
+    for (size_t i = 0; i < 5; ++i)
+    {
+        hk.observe(e::slice("b", 1));
+    }
+
+    hk.observe(e::slice("c", 1));
+    std::vector<hot_keys::entry> top;
+    hk.top(2, &top);
+    ASSERT_EQ(top.size(), 2U);
+    ASSERT_EQ(top[0].key, "a");
+    ASSERT_EQ(top[0].count, 10U);
+    ASSERT_EQ(top[0].error, 0U);
+    ASSERT_EQ(top[1].key, "b");
+    ASSERT_EQ(top[1].count, 5U);
+}
+
+TEST(HotKeys, FindsHeavyHitterAmongManyKeys)
+{
+    hot_keys hk(1);
+
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        char buf[16];
+        size_t sz = sprintf(buf, "k%lu", static_cast<unsigned long>(i));
+        hk.observe(e::slice(buf, sz));
+
+        if (i % 4 == 0)
+        {
+            hk.observe(e::slice("hot", 3));
+        }
+    }
+
+    std::vector<hot_keys::entry> top;
+    hk.top(1, &top);
+    ASSERT_EQ(top.size(), 1U);
+    ASSERT_EQ(top[0].key, "hot");
+    // Space-Saving never undercounts, and overcounts by at most error
+    ASSERT_GE(top[0].count, 2500U);
+    ASSERT_LE(top[0].count - top[0].error, 2500U);
+}
+
+TEST(HotKeys, SamplesAndScales)
+{
+    hot_keys hk(4);
+
+    for (size_t i = 0; i < 400; ++i)
+    {
+        hk.observe(e::slice("a", 1));
+    }
+
+    std::vector<hot_keys::entry> top;
+    hk.top(10, &top);
+    ASSERT_EQ(top.size(), 1U);
+    ASSERT_EQ(top[0].count, 400U);
+}
+
+TEST(HotKeys, ReportsLastCompletedPeriod)
+{
+    hot_keys hk(1);
+    hk.observe(e::slice("a", 1));
+    hk.rotate();
+    hk.observe(e::slice("b", 1));
+    hk.observe(e::slice("b", 1));
+    std::vector<hot_keys::entry> top;
+    hk.top(10, &top);
+    ASSERT_EQ(top.size(), 1U);
+    ASSERT_EQ(top[0].key, "a");
+    hk.rotate();
+    hk.top(10, &top);
+    ASSERT_EQ(top.size(), 1U);
+    ASSERT_EQ(top[0].key, "b");
+    ASSERT_EQ(top[0].count, 2U);
+}
@@ -67,3 +67,18 @@ TEST(IdentifierGenerator, Test)
     id = ig.generate_id(ri);
     ASSERT_EQ(id, 9U);
 }
+
+TEST(IdentifierGenerator, PeekUnmanaged)
+{
+    identifier_generator ig;
+    region_id ri(1);
+    ig.adopt(&ri, 1);
+    uint64_t id = 0;
+    ASSERT_TRUE(ig.peek(ri, &id));
+    ASSERT_EQ(id, 1U);
+    ig.bump(ri, 4);
+    ASSERT_TRUE(ig.peek(ri, &id));
+    ASSERT_EQ(id, 5U);
+    ASSERT_EQ(ig.peek(ri), 5U);
+    ASSERT_FALSE(ig.peek(region_id(2), &id));
+}
@@ -0,0 +1,350 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdlib.h>
+
+// STL
+#include <set>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
+
+// e
+#include <e/compat.h>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/index_build_plan.h"
+
+using hyperdex::index_build_plan;
+using po6::threads::make_obj_func;
+
+namespace
+{
+
+// A stand-in for one region:  every key starts with "p" and the remainder is
+// spread unevenly over the first byte, so that the parts differ in size.
+class keyspace
+{
+    public:
+        keyspace() : keys(), bounds(), sizes()
+        {
+            srand(0xdeadbeef);
+
+            while (keys.size() < 20000)
+            {
+                unsigned b = rand() % 256;
+                b = (b * b) / 256;
+                std::string key("p");
+                key += char(b);
+                key += char(rand() % 256);
+                key += char(rand() % 256);
+                keys.insert(key);
+            }
+
+            // the empty key sorts first and must not fall outside every part
+            keys.insert("p");
+            bounds.push_back("p");
+
+            for (unsigned b = 1; b < 256; ++b)
+            {
+                bounds.push_back(std::string("p") + char(b));
+            }
+
+            bounds.push_back("q");
+
+            for (size_t b = 0; b + 1 < bounds.size(); ++b)
+            {
+                std::set<std::string>::const_iterator lo = keys.lower_bound(bounds[b]);
+                std::set<std::string>::const_iterator hi = keys.lower_bound(bounds[b + 1]);
+                sizes.push_back(std::distance(lo, hi));
+            }
+        }
+
+    public:
+        std::set<std::string> keys;
+        std::vector<std::string> bounds;
+        std::vector<uint64_t> sizes;
+};
+
+// Plays the part of the indexer's workers:  claims parts of the plan under a
+// lock, "indexes" the keys of each part and checkpoints as it goes, stopping
+// early once "budget" keys have been indexed.
+class builder
+{
+    public:
+        builder(const keyspace* ks, index_build_plan* plan, uint64_t budget)
+            : m_ks(ks)
+            , m_plan(plan)
+            , m_mtx()
+            , m_budget(budget)
+            , m_indexed()
+        {
+        }
+
+    public:
+        void run_serial() { worker(); }
+        void run_parallel(size_t workers);
+        const std::set<std::string>& indexed() const { return m_indexed; }
+
+    private:
+        void worker();
+        bool build_part(size_t idx, const std::string& next, const std::string& limit);
+        // true if the budget is spent
+        bool index(const std::string& key);
+
+    private:
+        const keyspace* m_ks;
+        index_build_plan* m_plan;
+        po6::threads::mutex m_mtx;
+        uint64_t m_budget;
+        std::set<std::string> m_indexed;
+
+    private:
+        builder(const builder&);
+        builder& operator = (const builder&);
+};
+
+void
+builder :: run_parallel(size_t workers)
+{
+    std::vector<e::compat::shared_ptr<po6::threads::thread> > threads;
+
+    for (size_t i = 0; i < workers; ++i)
+    {
+        e::compat::shared_ptr<po6::threads::thread> t;
+        t.reset(new po6::threads::thread(make_obj_func(&builder::worker, this)));
+        threads.push_back(t);
+        t->start();
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i]->join();
+    }
+}
+
+void
+builder :: worker()
+{
+    while (true)
+    {
+        size_t idx;
+        std::string next;
+        std::string limit;
+
+        {
+            po6::threads::mutex::hold hold(&m_mtx);
+
+            if (m_budget == 0 || !m_plan->claim(&idx, &next, &limit))
+            {
+                return;
+            }
+        }
+
+        if (!build_part(idx, next, limit))
+        {
+            return;
+        }
+    }
+}
+
+bool
+builder :: build_part(size_t idx, const std::string& next, const std::string& limit)
+{
+    std::set<std::string>::const_iterator it = m_ks->keys.lower_bound(next);
+    std::set<std::string>::const_iterator end = m_ks->keys.lower_bound(limit);
+    uint64_t objects = 0;
+
+    while (it != end)
+    {
+        bool stop = index(*it);
+        ++it;
+        ++objects;
+
+        if ((objects % 64 == 0 || stop) && it != end)
+        {
+            po6::threads::mutex::hold hold(&m_mtx);
+            m_plan->advance(idx, *it, false);
+
+            if (stop)
+            {
+                return false;
+            }
+        }
+    }
+
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_plan->advance(idx, std::string(), true);
+    return true;
+}
+
+bool
+builder :: index(const std::string& key)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_indexed.insert(key);
+
+    if (m_budget == 0)
+    {
+        return true;
+    }
+
+    --m_budget;
+    return m_budget == 0;
+}
+
+bool
+all_done(const index_build_plan& plan)
+{
+    for (size_t i = 0; i < plan.parts().size(); ++i)
+    {
+        if (!plan.parts()[i].done)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+TEST(IndexBuildPlan, SplitCoversRegion)
+{
+    keyspace ks;
+    index_build_plan plan;
+    plan.split(ks.bounds, ks.sizes, 32);
+    ASSERT_LE(plan.parts().size(), 32U);
+    ASSERT_GT(plan.parts().size(), 1U);
+    ASSERT_EQ(plan.total_bytes(), ks.keys.size());
+    ASSERT_EQ(plan.parts().front().start, ks.bounds.front());
+    ASSERT_EQ(plan.parts().back().limit, ks.bounds.back());
+
+    for (size_t i = 0; i < plan.parts().size(); ++i)
+    {
+        ASSERT_EQ(plan.parts()[i].start, plan.parts()[i].next);
+        ASSERT_LT(plan.parts()[i].start, plan.parts()[i].limit);
+        ASSERT_FALSE(plan.parts()[i].done);
+
+        if (i > 0)
+        {
+            ASSERT_EQ(plan.parts()[i - 1].limit, plan.parts()[i].start);
+        }
+    }
+}
+
+TEST(IndexBuildPlan, EncodeDecode)
+{
+    keyspace ks;
+    index_build_plan plan;
+    plan.split(ks.bounds, ks.sizes, 8);
+    plan.set_timestamp("timestamp");
+    plan.advance(1, "p\x80", false);
+    plan.advance(2, std::string(), true);
+    std::string record;
+    plan.encode(&record);
+
+    index_build_plan copy;
+    ASSERT_TRUE(copy.decode(record));
+    ASSERT_EQ(copy.timestamp(), plan.timestamp());
+    ASSERT_EQ(copy.total_bytes(), plan.total_bytes());
+    ASSERT_EQ(copy.parts().size(), plan.parts().size());
+
+    for (size_t i = 0; i < plan.parts().size(); ++i)
+    {
+        ASSERT_EQ(copy.parts()[i].start, plan.parts()[i].start);
+        ASSERT_EQ(copy.parts()[i].limit, plan.parts()[i].limit);
+        ASSERT_EQ(copy.parts()[i].next, plan.parts()[i].next);
+        ASSERT_EQ(copy.parts()[i].done, plan.parts()[i].done);
+    }
+
+    ASSERT_FALSE(copy.decode(record.substr(0, record.size() - 1)));
+    ASSERT_FALSE(copy.decode(std::string("\xff\xff\xff\xff\xff\xff\xff\xff", 8)));
+    ASSERT_FALSE(copy.decode(std::string()));
+    // a failed decode leaves the plan as it was
+    ASSERT_EQ(copy.parts().size(), plan.parts().size());
+}
+
+TEST(IndexBuildPlan, ParallelMatchesSerial)
+{
+    keyspace ks;
+    index_build_plan serial_plan;
+    serial_plan.split(ks.bounds, ks.sizes, 1);
+    builder serial(&ks, &serial_plan, UINT64_MAX);
+    serial.run_serial();
+    ASSERT_TRUE(all_done(serial_plan));
+    ASSERT_TRUE(serial.indexed() == ks.keys);
+
+    index_build_plan parallel_plan;
+    parallel_plan.split(ks.bounds, ks.sizes, 32);
+    builder parallel(&ks, &parallel_plan, UINT64_MAX);
+    parallel.run_parallel(8);
+    ASSERT_TRUE(all_done(parallel_plan));
+    ASSERT_TRUE(parallel.indexed() == serial.indexed());
+}
+
+TEST(IndexBuildPlan, ResumedMatchesSerial)
+{
+    keyspace ks;
+    index_build_plan serial_plan;
+    serial_plan.split(ks.bounds, ks.sizes, 1);
+    builder serial(&ks, &serial_plan, UINT64_MAX);
+    serial.run_serial();
+
+    // interrupt the build several times, each time carrying only the
+    // encoded progress over to a fresh plan, as a restart would
+    index_build_plan plan;
+    plan.split(ks.bounds, ks.sizes, 32);
+    plan.set_timestamp("timestamp");
+    std::set<std::string> indexed;
+    size_t restarts = 0;
+
+    while (!all_done(plan))
+    {
+        ASSERT_LT(restarts, 100U);
+        builder b(&ks, &plan, 1500);
+        b.run_parallel(4);
+        indexed.insert(b.indexed().begin(), b.indexed().end());
+        std::string record;
+        plan.encode(&record);
+        plan.clear();
+        ASSERT_TRUE(plan.decode(record));
+        ASSERT_EQ(plan.timestamp(), std::string("timestamp"));
+        plan.restart();
+        ++restarts;
+    }
+
+    ASSERT_GT(restarts, 1U);
+    ASSERT_TRUE(indexed == serial.indexed());
+}
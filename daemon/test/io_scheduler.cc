@@ -0,0 +1,112 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#define __STDC_LIMIT_MACROS
+
+// POSIX
+#include <time.h>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/io_scheduler.h"
+
+using hyperdex::io_scheduler;
+
+namespace
+{
+
+void
+sleep_past_interval()
+{
+    timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = 150ULL * 1000ULL * 1000ULL;
+    nanosleep(&ts, NULL);
+}
+
+} // namespace
+
+TEST(IOScheduler, UnpacedNeverExhausts)
+{
+    io_scheduler io;
+    io.setup(0, 1024 * 1024);
+    io.charge(io_scheduler::DISK_WRITE, 1ULL << 40);
+    ASSERT_FALSE(io.exhausted(io_scheduler::DISK_WRITE));
+    ASSERT_EQ(io.consumed(io_scheduler::DISK_WRITE), 1ULL << 40);
+    ASSERT_EQ(io.consumed(io_scheduler::DISK_READ), 0U);
+}
+
+TEST(IOScheduler, OverdrawExhausts)
+{
+    io_scheduler io;
+    io.setup(1000, 1024 * 1024);
+    io.charge(io_scheduler::NETWORK, 16 * 1024 * 1024);
+    ASSERT_TRUE(io.exhausted(io_scheduler::NETWORK));
+    ASSERT_FALSE(io.exhausted(io_scheduler::DISK_READ));
+}
+
+TEST(IOScheduler, SlowClientsHalveBudget)
+{
+    io_scheduler io;
+    io.setup(1000, 64 * 1024 * 1024);
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        io.observe(10ULL * 1000ULL * 1000ULL);
+    }
+
+    sleep_past_interval();
+    io.charge(io_scheduler::DISK_READ, 1);
+    ASSERT_EQ(io.budget(io_scheduler::DISK_READ), 32U * 1024U * 1024U);
+    ASSERT_GE(io.client_p99(), 1000U);
+}
+
+TEST(IOScheduler, FastClientsRestoreBudget)
+{
+    io_scheduler io;
+    io.setup(1000, 64 * 1024 * 1024);
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        io.observe(10ULL * 1000ULL * 1000ULL);
+    }
+
+    sleep_past_interval();
+    io.charge(io_scheduler::DISK_READ, 1);
+    uint64_t backed_off = io.budget(io_scheduler::DISK_READ);
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        io.observe(100ULL * 1000ULL);
+    }
+
+    sleep_past_interval();
+    io.charge(io_scheduler::DISK_READ, 1);
+    ASSERT_GT(io.budget(io_scheduler::DISK_READ), backed_off);
+    ASSERT_LE(io.client_p99(), 1000U);
+}
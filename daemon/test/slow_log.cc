@@ -0,0 +1,121 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdio.h>
+#include <stdlib.h>
+
+// POSIX
+#include <unistd.h>
+
+// STL
+#include <fstream>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/slow_log.h"
+
+using hyperdex::slow_log;
+
+TEST(SlowLog, Threshold)
+{
+    slow_log off;
+    ASSERT_TRUE(off.setup(0, ""));
+    ASSERT_FALSE(off.slow(UINT64_MAX));
+    slow_log on;
+    ASSERT_TRUE(on.setup(100, ""));
+    ASSERT_FALSE(on.slow(99));
+    ASSERT_TRUE(on.slow(100));
+}
+
+TEST(SlowLog, NewestFirst)
+{
+    slow_log sl;
+    ASSERT_TRUE(sl.setup(1, ""));
+
+    for (uint64_t i = 0; i < 3; ++i)
+    {
+        slow_log::record r;
+        r.rows = i;
+        sl.add(r);
+    }
+
+    std::vector<slow_log::record> recs;
+    sl.recent(2, &recs);
+    ASSERT_EQ(recs.size(), 2U);
+    ASSERT_EQ(recs[0].rows, 2U);
+    ASSERT_EQ(recs[1].rows, 1U);
+}
+
+TEST(SlowLog, RateLimits)
+{
+    slow_log sl;
+    ASSERT_TRUE(sl.setup(1, ""));
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        sl.add(slow_log::record());
+    }
+
+    std::vector<slow_log::record> recs;
+    sl.recent(slow_log::CAPACITY, &recs);
+    ASSERT_EQ(recs.size(), slow_log::RATE);
+    ASSERT_EQ(sl.suppressed(), 100 - slow_log::RATE);
+}
+
+TEST(SlowLog, AppendsToFile)
+{
+    char path[] = "/tmp/hyperdex-slow-log-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    {
+        slow_log sl;
+        ASSERT_TRUE(sl.setup(1, path));
+        slow_log::record r;
+        r.when = 1500000000ULL * 1000000000ULL + 2000;
+        r.latency = 5000000;
+        r.rows = 42;
+        r.op = slow_log::SEARCH;
+        r.space = "kv";
+        r.checks = "v LESS_EQUAL ?";
+        r.plan = "search_iterator(range_iterator())";
+        sl.add(r);
+    }
+
+    std::ifstream in(path);
+    std::string line;
+    ASSERT_TRUE(std::getline(in, line));
+    ASSERT_EQ(line, "time=1500000000.000002 op=search space=kv latency=5000us "
+                    "rows=42 bytes=0 plan=\"search_iterator(range_iterator())\" "
+                    "checks=\"v LESS_EQUAL ?\"");
+    ASSERT_FALSE(std::getline(in, line));
+    unlink(path);
+}
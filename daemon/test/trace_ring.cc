@@ -0,0 +1,82 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/trace_ring.h"
+
+using hyperdex::trace_ring;
+
+TEST(TraceRing, DrainsInOrder)
+{
+    trace_ring tr;
+    tr.record(7, trace_ring::CLIENT_ATOMIC, 1, 0);
+    tr.record(7, trace_ring::CHAIN_OP_SEND, 1, 42);
+    tr.record(8, trace_ring::CHAIN_ACK_RECV, 2, 43);
+    std::vector<trace_ring::entry> entries;
+    tr.drain(&entries);
+    ASSERT_EQ(entries.size(), 3U);
+    ASSERT_EQ(entries[0].trace_id, 7U);
+    ASSERT_EQ(entries[0].event, trace_ring::CLIENT_ATOMIC);
+    ASSERT_EQ(entries[1].version, 42U);
+    ASSERT_EQ(entries[2].trace_id, 8U);
+    ASSERT_EQ(entries[2].region, 2U);
+    ASSERT_LE(entries[0].when, entries[2].when);
+    tr.drain(&entries);
+    ASSERT_EQ(entries.size(), 0U);
+    ASSERT_EQ(tr.lost(), 0U);
+}
+
+TEST(TraceRing, IgnoresUntracedWrites)
+{
+    trace_ring tr;
+    tr.record(0, trace_ring::CLIENT_ATOMIC, 1, 0);
+    std::vector<trace_ring::entry> entries;
+    tr.drain(&entries);
+    ASSERT_EQ(entries.size(), 0U);
+}
+
+TEST(TraceRing, CountsOverwrittenEvents)
+{
+    trace_ring tr;
+
+    for (uint64_t i = 0; i < trace_ring::SLOTS + 10; ++i)
+    {
+        tr.record(i + 1, trace_ring::WRITE_DONE, 1, i);
+    }
+
+    std::vector<trace_ring::entry> entries;
+    tr.drain(&entries);
+    ASSERT_EQ(entries.size(), trace_ring::SLOTS);
+    ASSERT_EQ(tr.lost(), 10U);
+    ASSERT_EQ(entries[0].version, 10U);
+    tr.record(1, trace_ring::WRITE_DONE, 1, 0);
+    tr.drain(&entries);
+    ASSERT_EQ(entries.size(), 1U);
+}
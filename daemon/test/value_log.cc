@@ -0,0 +1,241 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdlib.h>
+#include <string.h>
+
+// STL
+#include <string>
+
+// LevelDB
+#include <hyperleveldb/db.h>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/datalayer_value_log.h"
+
+using hyperdex::datalayer;
+using hyperdex::leveldb_db_ptr;
+using hyperdex::leveldb_snapshot_ptr;
+
+namespace
+{
+
+class scratch_dir
+{
+    public:
+        scratch_dir() : path()
+        {
+            char tmpl[] = "/tmp/hyperdex-value-log-XXXXXX";
+            path = mkdtemp(tmpl) ? tmpl : "";
+        }
+        ~scratch_dir() throw ()
+        {
+            if (!path.empty())
+            {
+                std::string cmd("rm -rf " + path);
+
+                if (system(cmd.c_str()) != 0)
+                {
+                    // left for the OS to reclaim
+                }
+            }
+        }
+
+    public:
+        std::string path;
+};
+
+leveldb_db_ptr
+open_db(const std::string& dir)
+{
+    leveldb::Options opts;
+    opts.create_if_missing = true;
+    leveldb::DB* db = NULL;
+    leveldb::Status st = leveldb::DB::Open(opts, dir + "/db", &db);
+    return leveldb_db_ptr(st.ok() ? db : NULL);
+}
+
+e::slice
+as_slice(const std::string& s)
+{
+    return e::slice(s.data(), s.size());
+}
+
+std::string
+read_value(datalayer::value_log* vl, const char* pointer)
+{
+    uint64_t segment;
+    uint64_t offset;
+    uint32_t length;
+
+    if (!hyperdex::decode_value_pointer(e::slice(pointer, VALUE_POINTER_SIZE),
+                                        &segment, &offset, &length))
+    {
+        return "<bad pointer>";
+    }
+
+    std::string out(length, '\0');
+
+    if (vl->read(e::slice(pointer, VALUE_POINTER_SIZE), &out[0]) != datalayer::SUCCESS)
+    {
+        return "<not found>";
+    }
+
+    return out;
+}
+
+} // namespace
+
+TEST(ValueLog, PointerEncoding)
+{
+    char buf[VALUE_POINTER_SIZE];
+    hyperdex::encode_value_pointer(0x0102030405060708ULL, 0xfffffffff0ULL, 0xdeadbeef, buf);
+    uint64_t segment;
+    uint64_t offset;
+    uint32_t length;
+    ASSERT_TRUE(hyperdex::decode_value_pointer(e::slice(buf, VALUE_POINTER_SIZE),
+                                               &segment, &offset, &length));
+    ASSERT_EQ(segment, 0x0102030405060708ULL);
+    ASSERT_EQ(offset, 0xfffffffff0ULL);
+    ASSERT_EQ(length, 0xdeadbeefU);
+    ASSERT_FALSE(hyperdex::decode_value_pointer(e::slice(buf, VALUE_POINTER_SIZE - 1),
+                                                &segment, &offset, &length));
+}
+
+TEST(ValueLog, AppendRead)
+{
+    scratch_dir dir;
+    leveldb_db_ptr db = open_db(dir.path);
+    ASSERT_TRUE(db.get() != NULL);
+    datalayer::value_log vl;
+    ASSERT_TRUE(vl.open(dir.path, db, 1));
+    ASSERT_TRUE(vl.in_use());
+    ASSERT_TRUE(vl.should_separate(1));
+    std::string v1(1000, 'a');
+    std::string v2("hello world");
+    char p1[VALUE_POINTER_SIZE];
+    char p2[VALUE_POINTER_SIZE];
+    ASSERT_EQ(vl.append(leveldb::Slice("key1"), 1, as_slice(v1), p1), datalayer::SUCCESS);
+    ASSERT_EQ(vl.append(leveldb::Slice("key2"), 3, as_slice(v2), p2), datalayer::SUCCESS);
+    ASSERT_EQ(vl.sync(), datalayer::SUCCESS);
+    ASSERT_EQ(read_value(&vl, p1), v1);
+    ASSERT_EQ(read_value(&vl, p2), v2);
+    ASSERT_EQ(vl.segments(), 1U);
+    ASSERT_EQ(vl.bytes(), 2 * (10U + 4U) + v1.size() + v2.size());
+
+    // a pointer past the end of the segment is corruption, not a short read
+    char bad[VALUE_POINTER_SIZE];
+    hyperdex::encode_value_pointer(1, vl.bytes() - 4, 8, bad);
+    char out[8];
+    ASSERT_EQ(vl.read(e::slice(bad, VALUE_POINTER_SIZE), out), datalayer::CORRUPTION);
+    vl.close();
+}
+
+TEST(ValueLog, ReopenAndScan)
+{
+    scratch_dir dir;
+    leveldb_db_ptr db = open_db(dir.path);
+    ASSERT_TRUE(db.get() != NULL);
+    std::string v("some value that is big enough");
+    char p[VALUE_POINTER_SIZE];
+
+    {
+        datalayer::value_log vl;
+        ASSERT_TRUE(vl.open(dir.path, db, 1));
+        ASSERT_EQ(vl.append(leveldb::Slice("key"), 2, as_slice(v), p), datalayer::SUCCESS);
+        ASSERT_EQ(vl.sync(), datalayer::SUCCESS);
+        vl.close();
+    }
+
+    datalayer::value_log vl;
+    ASSERT_TRUE(vl.open(dir.path, db, 1));
+    ASSERT_EQ(read_value(&vl, p), v);
+    // reopening seals the old segment and starts a new head
+    ASSERT_EQ(vl.segments(), 2U);
+    datalayer::value_log::segment_reader sr(&vl, 1);
+    ASSERT_TRUE(sr.valid());
+    ASSERT_EQ(sr.key().ToString(), "key");
+    ASSERT_EQ(sr.attr(), 2U);
+    ASSERT_EQ(sr.length(), v.size());
+    sr.next();
+    ASSERT_FALSE(sr.valid());
+    ASSERT_FALSE(sr.error());
+    vl.close();
+}
+
+TEST(ValueLog, RelocateAndRetire)
+{
+    scratch_dir dir;
+    leveldb_db_ptr db = open_db(dir.path);
+    ASSERT_TRUE(db.get() != NULL);
+    std::string v("a value that the collector will move");
+    char old_pointer[VALUE_POINTER_SIZE];
+
+    {
+        datalayer::value_log vl;
+        ASSERT_TRUE(vl.open(dir.path, db, 1));
+        ASSERT_EQ(vl.append(leveldb::Slice("key"), 1, as_slice(v), old_pointer), datalayer::SUCCESS);
+        ASSERT_EQ(vl.sync(), datalayer::SUCCESS);
+        vl.close();
+    }
+
+    datalayer::value_log vl;
+    ASSERT_TRUE(vl.open(dir.path, db, 1));
+    uint64_t segment = 0;
+    ASSERT_TRUE(vl.next_candidate(&segment));
+    ASSERT_EQ(segment, 1U);
+
+    // move the record to the head the way the collector does
+    char new_pointer[VALUE_POINTER_SIZE];
+    datalayer::value_log::segment_reader sr(&vl, segment);
+    ASSERT_TRUE(sr.valid());
+    std::string value(read_value(&vl, old_pointer));
+    ASSERT_EQ(value, v);
+    ASSERT_EQ(vl.append(sr.key(), sr.attr(), as_slice(value), new_pointer), datalayer::SUCCESS);
+    ASSERT_EQ(vl.sync(), datalayer::SUCCESS);
+    vl.set_liveness(segment, 0, sr.record_size());
+    ASSERT_FALSE(vl.next_candidate(&segment));
+
+    // a snapshot that predates retirement keeps the segment on disk
+    uint64_t epoch = vl.epoch();
+    leveldb_snapshot_ptr snap(db, db->GetSnapshot());
+    vl.track(epoch, snap);
+    vl.retire(1);
+    vl.allow_collect_before("now");
+    ASSERT_EQ(vl.unlink_retired(), 0U);
+    ASSERT_EQ(read_value(&vl, old_pointer), v);
+    snap = leveldb_snapshot_ptr();
+    ASSERT_EQ(vl.unlink_retired(), 1U);
+    ASSERT_EQ(read_value(&vl, old_pointer), "<not found>");
+    ASSERT_EQ(read_value(&vl, new_pointer), v);
+    ASSERT_EQ(vl.segments(), 1U);
+    vl.close();
+}
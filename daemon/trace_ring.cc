@@ -0,0 +1,138 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// po6
+#include <po6/time.h>
+
+// HyperDex
+#include "daemon/trace_ring.h"
+
+using hyperdex::trace_ring;
+
+const uint64_t trace_ring::SLOTS;
+
+trace_ring :: trace_ring()
+    : m_head(0)
+    , m_tail(0)
+    , m_lost(0)
+    , m_slots(SLOTS)
+{
+}
+
+trace_ring :: ~trace_ring() throw ()
+{
+}
+
+void
+trace_ring :: drain(std::vector<entry>* entries)
+{
+    entries->clear();
+    uint64_t head = __sync_fetch_and_add(&m_head, 0);
+
+    if (head - m_tail > SLOTS)
+    {
+        m_lost += head - m_tail - SLOTS;
+        m_tail = head - SLOTS;
+    }
+
+    while (m_tail < head)
+    {
+        slot* s = &m_slots[m_tail & (SLOTS - 1)];
+        uint64_t seqno = s->seqno;
+        __sync_synchronize();
+
+        if (seqno < m_tail + 1)
+        {
+            // the writer of this slot has not finished; pick up from here
+            // next time
+            break;
+        }
+
+        entry e = s->e;
+        __sync_synchronize();
+
+        if (seqno == m_tail + 1 && s->seqno == seqno)
+        {
+            entries->push_back(e);
+        }
+        else
+        {
+            ++m_lost;
+        }
+
+        ++m_tail;
+    }
+}
+
+const char*
+trace_ring :: name(event_t event)
+{
+    switch (event)
+    {
+        case CLIENT_ATOMIC:
+            return "client_atomic";
+        case ORDERED:
+            return "ordered";
+        case CHAIN_OP_SEND:
+            return "chain_op_send";
+        case CHAIN_OP_RECV:
+            return "chain_op_recv";
+        case CHAIN_SUBSPACE_SEND:
+            return "chain_subspace_send";
+        case CHAIN_SUBSPACE_RECV:
+            return "chain_subspace_recv";
+        case WRITE_START:
+            return "write_start";
+        case WRITE_DONE:
+            return "write_done";
+        case CHAIN_ACK_SEND:
+            return "chain_ack_send";
+        case CHAIN_ACK_RECV:
+            return "chain_ack_recv";
+        case CLIENT_RESPONSE:
+            return "client_response";
+        default:
+            return "unknown";
+    }
+}
+
+void
+trace_ring :: append(uint64_t trace_id, event_t event, uint64_t region, uint64_t version)
+{
+    uint64_t pos = __sync_fetch_and_add(&m_head, 1);
+    slot* s = &m_slots[pos & (SLOTS - 1)];
+    // a reader that sees zero knows the slot is being rewritten
+    s->seqno = 0;
+    __sync_synchronize();
+    s->e.trace_id = trace_id;
+    s->e.when = po6::wallclock_time();
+    s->e.region = region;
+    s->e.version = version;
+    s->e.event = event;
+    __sync_synchronize();
+    s->seqno = pos + 1;
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2014, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_trace_ring_h_
+#define hyperdex_daemon_trace_ring_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// Per-hop timestamps of the writes a client chose to trace.  Any thread may
+// record an event without blocking: it claims a slot with an atomic increment
+// and publishes it by writing the slot's sequence number last.  A single
+// reader drains the ring; events it has not drained before the writers lap it
+// are overwritten and counted as lost.
+class trace_ring
+{
+    public:
+        enum event_t
+        {
+            CLIENT_ATOMIC,
+            ORDERED,
+            CHAIN_OP_SEND,
+            CHAIN_OP_RECV,
+            CHAIN_SUBSPACE_SEND,
+            CHAIN_SUBSPACE_RECV,
+            WRITE_START,
+            WRITE_DONE,
+            CHAIN_ACK_SEND,
+            CHAIN_ACK_RECV,
+            CLIENT_RESPONSE
+        };
+        struct entry
+        {
+            entry() : trace_id(0), when(0), region(0), version(0), event(CLIENT_ATOMIC) {}
+            uint64_t trace_id;
+            uint64_t when;
+            uint64_t region;
+            uint64_t version;
+            event_t event;
+        };
+        // must be pow2
+        const static uint64_t SLOTS = 4096;
+
+    public:
+        trace_ring();
+        ~trace_ring() throw ();
+
+    public:
+        // a zero trace_id means the write is not traced, and is a no-op
+        void record(uint64_t trace_id, event_t event, uint64_t region, uint64_t version)
+        { if (trace_id != 0) { append(trace_id, event, region, version); } }
+        // move the events recorded since the last drain into entries, oldest
+        // first; only one thread may drain
+        void drain(std::vector<entry>* entries);
+        // events overwritten before they were drained
+        uint64_t lost() const { return m_lost; }
+        static const char* name(event_t event);
+
+    private:
+        struct slot
+        {
+            slot() : seqno(0), e() {}
+            uint64_t seqno;
+            entry e;
+        };
+        trace_ring(const trace_ring&);
+        trace_ring& operator = (const trace_ring&);
+
+    private:
+        void append(uint64_t trace_id, event_t event, uint64_t region, uint64_t version);
+
+    private:
+        uint64_t m_head;
+        uint64_t m_tail;
+        uint64_t m_lost;
+        std::vector<slot> m_slots;
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_trace_ring_h_
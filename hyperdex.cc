@@ -44,6 +44,7 @@ main(int argc, const char* argv[])
     cmds.push_back(e::subcommand("add-space",             "Create a new HyperDex space"));
     cmds.push_back(e::subcommand("rm-space",              "Remove an existing HyperDex space"));
     cmds.push_back(e::subcommand("mv-space",              "Rename a HyperDex space"));
+    cmds.push_back(e::subcommand("truncate-space",        "Remove every object from a HyperDex space"));
     cmds.push_back(e::subcommand("add-index",             "Create a new index on an existing space"));
     cmds.push_back(e::subcommand("rm-index",              "Remove an existing index"));
     cmds.push_back(e::subcommand("list-spaces",           "List the names of all spaces"));
@@ -55,6 +56,8 @@ main(int argc, const char* argv[])
     cmds.push_back(e::subcommand("server-forget",         "Manually remove all trace that a daemon exists"));
     cmds.push_back(e::subcommand("show-config",           "Output a human-readable version of the cluster configuration"));
     cmds.push_back(e::subcommand("perf-counters",         "Collect performance counters from a cluster"));
+    cmds.push_back(e::subcommand("hot-keys",              "Show the most frequently read and written keys of a space"));
+    cmds.push_back(e::subcommand("slow-ops",              "Show the slowest operations the daemons have logged"));
     cmds.push_back(e::subcommand("set-read-only",         "Put the cluster into read-only mode, blocking writes"));
     cmds.push_back(e::subcommand("set-read-write",        "Put the cluster into read-write mode, permitting writes"));
     cmds.push_back(e::subcommand("set-fault-tolerance",   "Set the fault-tolerance for the specified space"));
@@ -121,6 +121,11 @@ hyperdex_admin_mv_space(struct hyperdex_admin* admin,
                         const char* target,
                         enum hyperdex_admin_returncode* status);
 
+int64_t
+hyperdex_admin_truncate_space(struct hyperdex_admin* admin,
+                              const char* space,
+                              enum hyperdex_admin_returncode* status);
+
 int64_t
 hyperdex_admin_list_spaces(struct hyperdex_admin* admin,
                            enum hyperdex_admin_returncode* status,
@@ -189,6 +194,19 @@ hyperdex_admin_enable_perf_counters(struct hyperdex_admin* admin,
 void
 hyperdex_admin_disable_perf_counters(struct hyperdex_admin* admin);
 
+int64_t
+hyperdex_admin_hot_keys(struct hyperdex_admin* admin,
+                        const char* space,
+                        uint64_t limit,
+                        enum hyperdex_admin_returncode* status,
+                        const char** hot_keys);
+
+int64_t
+hyperdex_admin_slow_ops(struct hyperdex_admin* admin,
+                        uint64_t limit,
+                        enum hyperdex_admin_returncode* status,
+                        const char** slow_ops);
+
 int64_t
 hyperdex_admin_loop(struct hyperdex_admin* admin, int timeout,
                     enum hyperdex_admin_returncode* status);
@@ -76,6 +76,9 @@ class Admin
         int64_t mv_space(const char* source, const char* target,
                          enum hyperdex_admin_returncode* status)
             { return hyperdex_admin_mv_space(m_adm, source, target, status); }
+        int64_t truncate_space(const char* name,
+                               enum hyperdex_admin_returncode* status)
+            { return hyperdex_admin_truncate_space(m_adm, name, status); }
         int64_t list_spaces(enum hyperdex_admin_returncode* status,
                             const char** spaces)
             { return hyperdex_admin_list_spaces(m_adm, status, spaces); }
@@ -102,6 +105,14 @@ class Admin
             { return hyperdex_admin_enable_perf_counters(m_adm, status, pc); }
         void disable_perf_counters()
             { return hyperdex_admin_disable_perf_counters(m_adm); }
+        int64_t hot_keys(const char* space, uint64_t limit,
+                         enum hyperdex_admin_returncode* status,
+                         const char** hot_keys)
+            { return hyperdex_admin_hot_keys(m_adm, space, limit, status, hot_keys); }
+        int64_t slow_ops(uint64_t limit,
+                         enum hyperdex_admin_returncode* status,
+                         const char** slow_ops)
+            { return hyperdex_admin_slow_ops(m_adm, limit, status, slow_ops); }
 
     public:
         int64_t loop(int timeout, enum hyperdex_admin_returncode* status)
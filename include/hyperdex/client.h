@@ -1171,6 +1171,14 @@ hyperdex_client_poll_fd(struct hyperdex_client* client);
 int
 hyperdex_client_block(struct hyperdex_client* client, int timeout);
 
+/* resend a GET to a second replica when the first is slower than usual */
+void
+hyperdex_client_set_hedged_reads(struct hyperdex_client* client, int enabled);
+
+/* tag one in every "one_in" atomic operations for tracing; zero disables */
+void
+hyperdex_client_set_trace_sampling(struct hyperdex_client* client, uint64_t one_in);
+
 enum hyperdatatype
 hyperdex_client_attribute_type(struct hyperdex_client* client,
                                const char* space, const char* name,
@@ -763,6 +763,10 @@ class Client
             { return hyperdex_client_poll_fd(m_cl); }
         int block(int timeout)
             { return hyperdex_client_block(m_cl, timeout); }
+        void set_hedged_reads(bool enabled)
+            { hyperdex_client_set_hedged_reads(m_cl, enabled ? 1 : 0); }
+        void set_trace_sampling(uint64_t one_in)
+            { hyperdex_client_set_trace_sampling(m_cl, one_in); }
         std::string error_message()
             { return hyperdex_client_error_message(m_cl); }
         std::string error_location()
@@ -29,11 +29,15 @@
 #include <cstdlib>
 
 // POSIX
+#include <dirent.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 // STL
+#include <algorithm>
+#include <map>
+#include <sstream>
 #include <string>
 
 // po6
@@ -210,49 +214,382 @@ record_latest(const std::string& base, const std::string& now)
     return true;
 }
 
+static pid_t
+fork_exec(const std::vector<std::string>& args)
+{
+    pid_t child = fork();
+
+    if (child == 0)
+    {
+        std::vector<const char*> arg_ptrs;
+        arg_ptrs.reserve(args.size() + 1);
+
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            arg_ptrs.push_back(args[i].c_str());
+        }
+
+        arg_ptrs.push_back(NULL);
+        execvp(arg_ptrs[0], const_cast<char* const*>(&arg_ptrs[0]));
+        std::cerr << "could not exec: " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    else if (child < 0)
+    {
+        std::cerr << "could not fork: " << strerror(errno) << std::endl;
+    }
+
+    return child;
+}
+
+static bool
+wait_child(pid_t child)
+{
+    int status = 0;
+
+    if (waitpid(child, &status, 0) < 0)
+    {
+        std::cerr << "could not wait for child: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        std::cerr << "child process failed" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 static bool
 fork_exec_wait(const std::vector<std::string>& args)
 {
-    pid_t child = fork();
+    pid_t child = fork_exec(args);
+    return child > 0 && wait_child(child);
+}
 
-    if (child > 0)
+// run every command, at most "parallel" at a time
+static bool
+fork_exec_wait_all(const std::vector<std::vector<std::string> >& cmds,
+                   size_t parallel)
+{
+    std::vector<pid_t> running;
+    bool success = true;
+
+    for (size_t i = 0; i < cmds.size() || !running.empty(); )
     {
+        if (i < cmds.size() && running.size() < parallel)
+        {
+            pid_t child = fork_exec(cmds[i]);
+            ++i;
+
+            if (child > 0)
+            {
+                running.push_back(child);
+            }
+            else
+            {
+                success = false;
+            }
+
+            continue;
+        }
+
         int status = 0;
+        pid_t child = wait(&status);
 
-        if (waitpid(child, &status, 0) < 0)
+        if (child < 0)
         {
             std::cerr << "could not wait for child: " << strerror(errno) << std::endl;
             return false;
         }
 
+        std::vector<pid_t>::iterator it = std::find(running.begin(), running.end(), child);
+
+        if (it == running.end())
+        {
+            continue;
+        }
+
+        running.erase(it);
+
         if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
         {
             std::cerr << "child process failed" << std::endl;
-            return false;
+            success = false;
         }
+    }
 
-        return true;
+    return success;
+}
+
+// previous backups, most recent first; each backup is a directory holding a
+// coordinator.bin
+static void
+list_backups(const std::string& base, const std::string& exclude,
+             std::vector<std::string>* backups)
+{
+    DIR* dir = opendir(base.c_str());
+
+    if (!dir)
+    {
+        return;
     }
-    else if (child == 0)
+
+    struct dirent* ent;
+
+    while ((ent = readdir(dir)))
     {
-        std::vector<const char*> arg_ptrs;
-        arg_ptrs.reserve(args.size() + 1);
+        std::string name(ent->d_name);
+        struct stat stbuf;
 
-        for (size_t i = 0; i < args.size(); ++i)
+        if (name == "." || name == ".." || name == exclude ||
+            stat(po6::path::join(base, name, "coordinator.bin").c_str(), &stbuf) < 0)
         {
-            arg_ptrs.push_back(args[i].c_str());
+            continue;
         }
 
-        arg_ptrs.push_back(NULL);
-        execvp(arg_ptrs[0], const_cast<char* const*>(&arg_ptrs[0]));
-        std::cerr << "could not exec: " << strerror(errno) << std::endl;
-        exit(EXIT_FAILURE);
+        backups->push_back(name);
     }
-    else
+
+    closedir(dir);
+    std::sort(backups->begin(), backups->end());
+    std::reverse(backups->begin(), backups->end());
+}
+
+struct manifest_entry
+{
+    manifest_entry() : path(), size(0), shared(false) {}
+    std::string path;
+    uint64_t size;
+    bool shared;
+};
+
+static bool
+manifest_entry_compare(const manifest_entry& lhs, const manifest_entry& rhs)
+{
+    return lhs.path < rhs.path;
+}
+
+static bool
+scan_files(const std::string& base, const std::string& rel,
+           std::vector<manifest_entry>* entries)
+{
+    std::string path(po6::path::join(base, rel));
+    DIR* dir = opendir(path.c_str());
+
+    if (!dir)
+    {
+        std::cerr << "could not read " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    bool success = true;
+    struct dirent* ent;
+
+    while (success && (ent = readdir(dir)))
+    {
+        std::string name(ent->d_name);
+
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+
+        std::string child(rel.empty() ? name : po6::path::join(rel, name));
+        struct stat stbuf;
+
+        if (lstat(po6::path::join(base, child).c_str(), &stbuf) < 0)
+        {
+            std::cerr << "could not stat " << child << ": " << strerror(errno) << std::endl;
+            success = false;
+        }
+        else if (S_ISDIR(stbuf.st_mode))
+        {
+            success = scan_files(base, child, entries);
+        }
+        else if (S_ISREG(stbuf.st_mode))
+        {
+            // a file with other links is held by an earlier backup too
+            manifest_entry me;
+            me.path = child;
+            me.size = stbuf.st_size;
+            me.shared = stbuf.st_nlink > 1;
+            entries->push_back(me);
+        }
+    }
+
+    closedir(dir);
+    return success;
+}
+
+// MANIFEST lists every file the backup needs, one "path size shared|new" per
+// line, so that a restore can check that the backup is whole
+static bool
+write_manifest(const std::string& backupdir)
+{
+    std::vector<manifest_entry> entries;
+
+    if (!scan_files(backupdir, "", &entries))
     {
-        std::cerr << "could not fork: " << strerror(errno) << std::endl;
         return false;
     }
+
+    std::sort(entries.begin(), entries.end(), manifest_entry_compare);
+    std::ostringstream ostr;
+    uint64_t total = 0;
+    uint64_t added = 0;
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        ostr << entries[i].path << " " << entries[i].size << " "
+             << (entries[i].shared ? "shared" : "new") << "\n";
+        total += entries[i].size;
+        added += entries[i].shared ? 0 : entries[i].size;
+    }
+
+    std::string manifest(ostr.str());
+    std::string path(po6::path::join(backupdir, "MANIFEST"));
+    po6::io::fd fd(open(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR));
+
+    if (fd.get() < 0 ||
+        fd.xwrite(manifest.data(), manifest.size()) < static_cast<ssize_t>(manifest.size()))
+    {
+        std::cerr << "could not write the backup MANIFEST: "
+                  << strerror(errno) << std::endl;
+        return false;
+    }
+
+    std::cout << "backup holds " << entries.size() << " files totaling "
+              << total << " bytes, of which " << added
+              << " bytes are new since earlier backups" << std::endl;
+    return true;
+}
+
+static bool
+check_manifest(const std::string& backupdir)
+{
+    std::string path(po6::path::join(backupdir, "MANIFEST"));
+    po6::io::fd fd(open(path.c_str(), O_RDONLY));
+
+    if (fd.get() < 0)
+    {
+        std::cerr << "could not open the backup MANIFEST: "
+                  << strerror(errno) << std::endl;
+        return false;
+    }
+
+    std::string manifest;
+    char buf[4096];
+    ssize_t amt;
+
+    while ((amt = fd.xread(buf, sizeof(buf))) > 0)
+    {
+        manifest.append(buf, amt);
+    }
+
+    std::istringstream istr(manifest);
+    std::string file;
+    uint64_t size;
+    std::string kind;
+    bool success = true;
+
+    while (istr >> file >> size >> kind)
+    {
+        struct stat stbuf;
+
+        if (stat(po6::path::join(backupdir, file).c_str(), &stbuf) < 0 ||
+            static_cast<uint64_t>(stbuf.st_size) != size)
+        {
+            std::cerr << "backup is missing or has a damaged copy of " << file << std::endl;
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+// rsync treats "host:path" as remote, but not "/path/with:colon"
+static std::string
+with_user(const char* user, const std::string& loc)
+{
+    size_t colon = loc.find(':');
+
+    if (user && colon != std::string::npos && colon < loc.find('/'))
+    {
+        return std::string(user) + "@" + loc;
+    }
+
+    return loc;
+}
+
+static std::vector<std::string>
+rsync_args(const char* user, const std::string& src, const std::string& dst,
+           const std::vector<std::string>& link_dests)
+{
+    std::vector<std::string> args;
+    args.push_back("rsync");
+    args.push_back("-a");
+    args.push_back("--delete");
+
+    for (size_t i = 0; i < link_dests.size(); ++i)
+    {
+        args.push_back("--link-dest=" + link_dests[i]);
+    }
+
+    args.push_back("--");
+    args.push_back(with_user(user, src));
+    args.push_back(with_user(user, dst));
+    return args;
+}
+
+// copy each daemon's directory of the backup to a "sid=[host:]dir" target
+static int
+restore(const std::string& backupdir, const char* user, size_t parallel,
+        const char** targets, size_t targets_sz)
+{
+    if (!check_manifest(backupdir))
+    {
+        std::cerr << "refusing to restore from an incomplete backup" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::vector<std::string> > cmds;
+
+    for (size_t i = 0; i < targets_sz; ++i)
+    {
+        std::string target(targets[i]);
+        size_t eq = target.find('=');
+
+        if (eq == std::string::npos || eq == 0)
+        {
+            std::cerr << "restore targets take the form sid=[host:]dir, not "
+                      << target << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::string daemon_dir(po6::path::join(backupdir, target.substr(0, eq)));
+        struct stat stbuf;
+
+        if (stat(daemon_dir.c_str(), &stbuf) < 0)
+        {
+            std::cerr << "backup holds no server " << target.substr(0, eq) << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        cmds.push_back(rsync_args(user, daemon_dir + "/", target.substr(eq + 1),
+                                  std::vector<std::string>()));
+    }
+
+    if (!fork_exec_wait_all(cmds, parallel))
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "restore the coordinator from "
+              << po6::path::join(backupdir, "coordinator.bin") << std::endl;
+    return EXIT_SUCCESS;
 }
 
 int
@@ -261,6 +598,9 @@ main(int argc, const char* argv[])
     bool _cleanup = true;
     const char* _data = ".";
     const char* _user = NULL;
+    const char* _restore = NULL;
+    long _parallel = 4;
+    long _link_dests = 8;
     connect_opts conn;
     e::argparser ap;
     ap.autohelp();
@@ -271,6 +611,15 @@ main(int argc, const char* argv[])
     ap.arg().name('u', "user")
             .description("username to use for ssh connections (default: this user)")
             .metavar("user").as_string(&_user);
+    ap.arg().name('j', "parallel")
+            .description("copy this many servers' state at once (default: 4)")
+            .metavar("N").as_long(&_parallel);
+    ap.arg().long_name("link-backups")
+            .description("hard link unchanged files from this many earlier backups (default: 8)")
+            .metavar("N").as_long(&_link_dests);
+    ap.arg().name('r', "restore")
+            .description("restore the named backup to the sid=[host:]dir targets given as arguments")
+            .metavar("backup").as_string(&_restore);
 
     if (!ap.parse(argc, argv))
     {
@@ -284,6 +633,19 @@ main(int argc, const char* argv[])
         return EXIT_FAILURE;
     }
 
+    if (_parallel <= 0)
+    {
+        std::cerr << "--parallel must be positive" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // rsync accepts at most 20 --link-dest options
+    if (_link_dests < 0 || _link_dests > 20)
+    {
+        std::cerr << "--link-backups must be between 0 and 20" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     using po6::path::join;
 
     try
@@ -303,6 +665,12 @@ main(int argc, const char* argv[])
             return EXIT_FAILURE;
         }
 
+        if (_restore)
+        {
+            return restore(join(base, _restore), _user, _parallel,
+                           ap.args(), ap.args_sz());
+        }
+
         std::string now;
         std::vector<daemon_backup> daemons;
 
@@ -324,6 +692,19 @@ main(int argc, const char* argv[])
             return EXIT_FAILURE;
         }
 
+        // SSTs never change once written, so any file a daemon still has
+        // from an earlier backup is hard linked rather than copied.  LATEST
+        // goes first so that it wins ties.
+        std::vector<std::string> earlier;
+        list_backups(base, now, &earlier);
+
+        if (has_previous)
+        {
+            std::string latest(po6::path::basename(previous));
+            earlier.erase(std::remove(earlier.begin(), earlier.end(), latest), earlier.end());
+            earlier.insert(earlier.begin(), latest);
+        }
+
         std::string backupdir(join(base, now));
 
         if (mkdir(backupdir.c_str(), S_IRWXU) < 0)
@@ -341,67 +722,39 @@ main(int argc, const char* argv[])
             return EXIT_FAILURE;
         }
 
+        std::vector<std::vector<std::string> > cmds;
+
         for (size_t i = 0; i < daemons.size(); ++i)
         {
             char buf[21];
             sprintf(buf, "%lu", daemons[i].sid);
             std::string daemon_dir(join(base, now, buf));
-            bool prev = false;
-            std::string link_dest;
+            std::vector<std::string> link_dests;
 
-            if (has_previous)
+            for (size_t j = 0; j < earlier.size() &&
+                    link_dests.size() < static_cast<size_t>(_link_dests); ++j)
             {
                 struct stat stbuf;
-                std::string daemon_prev(join(previous, buf));
-                int status = stat(daemon_prev.c_str(), &stbuf);
+                std::string daemon_prev(join(base, earlier[j], buf));
 
-                if (status < 0 && errno == ENOENT)
-                {
-                    prev = false;
-                }
-                else if (status < 0)
-                {
-                    prev = false;
-                    std::cerr << "could not stat prev backup for " << daemons[i].sid << ": "
-                              << strerror(errno) << std::endl;
-                    success = false;
-                }
-                else
+                if (stat(daemon_prev.c_str(), &stbuf) == 0)
                 {
-                    prev = true;
-                    link_dest  = "--link-dest=";
-                    link_dest += daemon_prev.c_str();
+                    link_dests.push_back(daemon_prev);
                 }
             }
 
-            std::vector<std::string> args;
-            args.push_back("rsync");
-            args.push_back("-a");
-            args.push_back("--delete");
-
-            if (prev)
-            {
-                args.push_back(link_dest);
-            }
-
-            args.push_back("--");
             std::string rsync_url = daemons[i].addr + ":" + daemons[i].path + "/";
+            cmds.push_back(rsync_args(_user, rsync_url, daemon_dir, link_dests));
+        }
 
-            if (_user)
-            {
-                args.push_back(std::string(_user) + "@" + rsync_url);
-            }
-            else
-            {
-                args.push_back(rsync_url);
-            }
-
-            args.push_back(daemon_dir.c_str());
+        if (!fork_exec_wait_all(cmds, _parallel))
+        {
+            success = false;
+        }
 
-            if (!fork_exec_wait(args))
-            {
-                success = false;
-            }
+        if (success && !write_manifest(backupdir))
+        {
+            success = false;
         }
 
         if (success && _cleanup)
@@ -27,6 +27,17 @@
 
 // C
 #include <cstdlib>
+#include <ctime>
+
+// STL
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
 // e
 #include <e/guard.h>
@@ -35,13 +46,329 @@
 #include <hyperdex/admin.hpp>
 #include "tools/common.h"
 
+namespace
+{
+
+// the load on one region or space, summed over the servers reporting it
+struct load
+{
+    load()
+        : name(), ops(0), gets(0), atomics(0), searches(0), chain_ops(0)
+        , bytes_read(0), bytes_written(0), pending(0), keys(0) {}
+    std::string name;
+    double ops;
+    double gets;
+    double atomics;
+    double searches;
+    double chain_ops;
+    double bytes_read;
+    double bytes_written;
+    uint64_t pending;
+    uint64_t keys;
+};
+
+bool
+busier(const load& lhs, const load& rhs)
+{
+    return lhs.ops > rhs.ops;
+}
+
+// Turns the cumulative region.* and space.* counters into rates.  Daemons
+// only report the regions whose counters changed, so a counter's rate is
+// measured up to the latest time its server reported anything.
+class summary
+{
+    public:
+        summary() : m_now(), m_start(), m_current() {}
+
+    public:
+        // ignores counters other than region.* and space.*
+        void observe(const hyperdex_admin_perf_counter& pc);
+        void print(std::ostream& out, size_t top);
+
+    private:
+        typedef std::pair<uint64_t, std::string> key_t;
+        typedef std::pair<uint64_t, uint64_t> sample_t;
+        std::map<uint64_t, uint64_t> m_now;
+        std::map<key_t, sample_t> m_start;
+        std::map<key_t, sample_t> m_current;
+};
+
+void
+summary :: observe(const hyperdex_admin_perf_counter& pc)
+{
+    std::string prop(pc.property);
+
+    if (prop.compare(0, 7, "region.") != 0 &&
+        prop.compare(0, 6, "space.") != 0)
+    {
+        return;
+    }
+
+    key_t k(pc.id, prop);
+    sample_t s(pc.time, pc.measurement);
+    m_now[pc.id] = std::max(m_now[pc.id], pc.time);
+    m_current[k] = s;
+
+    if (m_start.find(k) == m_start.end())
+    {
+        m_start[k] = s;
+    }
+}
+
+void
+summary :: print(std::ostream& out, size_t top)
+{
+    std::map<std::string, load> loads;
+
+    for (std::map<key_t, sample_t>::iterator it = m_current.begin();
+            it != m_current.end(); ++it)
+    {
+        const std::string& prop(it->first.second);
+        size_t dot = prop.rfind('.');
+        load* l = &loads[prop.substr(0, dot)];
+        l->name = prop.substr(0, dot);
+        std::string counter(prop.substr(dot + 1));
+        sample_t* start = &m_start[it->first];
+        uint64_t now = m_now[it->first.first];
+
+        if (counter == "pending")
+        {
+            l->pending += it->second.second;
+            continue;
+        }
+        else if (counter == "keys")
+        {
+            l->keys = std::max(l->keys, it->second.second);
+            continue;
+        }
+
+        double rate = 0;
+
+        if (now > start->first && it->second.second >= start->second)
+        {
+            rate = (it->second.second - start->second) * 1e9 / (now - start->first);
+        }
+
+        *start = sample_t(now, it->second.second);
+
+        if (counter == "gets")
+        {
+            l->gets += rate;
+        }
+        else if (counter == "atomics")
+        {
+            l->atomics += rate;
+        }
+        else if (counter == "searches")
+        {
+            l->searches += rate;
+        }
+        else if (counter == "chain_ops")
+        {
+            l->chain_ops += rate;
+        }
+        else if (counter == "bytes_read")
+        {
+            l->bytes_read += rate;
+        }
+        else if (counter == "bytes_written")
+        {
+            l->bytes_written += rate;
+        }
+    }
+
+    std::vector<load> regions;
+    std::vector<load> spaces;
+
+    for (std::map<std::string, load>::iterator it = loads.begin();
+            it != loads.end(); ++it)
+    {
+        load& l(it->second);
+        l.ops = l.gets + l.atomics + l.searches + l.chain_ops;
+
+        if (l.name.compare(0, 6, "space.") == 0)
+        {
+            spaces.push_back(l);
+        }
+        else
+        {
+            regions.push_back(l);
+        }
+    }
+
+    std::sort(regions.begin(), regions.end(), busier);
+    std::sort(spaces.begin(), spaces.end(), busier);
+    regions.resize(std::min(regions.size(), top));
+    out << std::left << std::setw(24) << "name" << std::right
+        << std::setw(10) << "ops/s"
+        << std::setw(10) << "gets/s"
+        << std::setw(10) << "atomic/s"
+        << std::setw(10) << "search/s"
+        << std::setw(10) << "chain/s"
+        << std::setw(12) << "read B/s"
+        << std::setw(12) << "write B/s"
+        << std::setw(9) << "pending"
+        << std::setw(12) << "keys" << "\n";
+    out << std::fixed << std::setprecision(0);
+
+    for (size_t i = 0; i < spaces.size() + regions.size(); ++i)
+    {
+        const load& l(i < spaces.size() ? spaces[i] : regions[i - spaces.size()]);
+        out << std::left << std::setw(24) << l.name << std::right
+            << std::setw(10) << l.ops
+            << std::setw(10) << l.gets
+            << std::setw(10) << l.atomics
+            << std::setw(10) << l.searches
+            << std::setw(10) << l.chain_ops
+            << std::setw(12) << l.bytes_read
+            << std::setw(12) << l.bytes_written
+            << std::setw(9) << l.pending
+            << std::setw(12) << l.keys << "\n";
+    }
+
+    out << std::endl;
+}
+
+// Collects the trace.<id>.<event>.<region> counters, whose measurement is
+// the wall-clock time of one hop of a traced write, and writes each trace as
+// a timeline in the Chrome trace event format.  Each hop becomes a slice on
+// the row of the server it happened on, lasting until the next hop of the
+// same trace, so network and queueing delays show up as long slices.
+class timeline
+{
+    public:
+        timeline() : m_traces() {}
+
+    public:
+        // ignores counters other than trace.*
+        void observe(const hyperdex_admin_perf_counter& pc);
+        size_t traces() const { return m_traces.size(); }
+        void write(std::ostream& out);
+
+    private:
+        struct hop
+        {
+            hop() : when(0), server(0), region(), name() {}
+            uint64_t when;
+            uint64_t server;
+            std::string region;
+            std::string name;
+            bool operator < (const hop& rhs) const { return when < rhs.when; }
+        };
+        std::map<std::string, std::vector<hop> > m_traces;
+};
+
+void
+timeline :: observe(const hyperdex_admin_perf_counter& pc)
+{
+    std::string prop(pc.property);
+
+    if (prop.compare(0, 6, "trace.") != 0)
+    {
+        return;
+    }
+
+    size_t name = prop.find('.', 6);
+    size_t region = name == std::string::npos ? name : prop.find('.', name + 1);
+
+    if (region == std::string::npos)
+    {
+        return;
+    }
+
+    hop h;
+    h.when = pc.measurement;
+    h.server = pc.id;
+    h.region = prop.substr(region + 1);
+    h.name = prop.substr(name + 1, region - name - 1);
+    m_traces[prop.substr(6, name - 6)].push_back(h);
+}
+
+void
+timeline :: write(std::ostream& out)
+{
+    uint64_t base = std::numeric_limits<uint64_t>::max();
+
+    for (std::map<std::string, std::vector<hop> >::iterator it = m_traces.begin();
+            it != m_traces.end(); ++it)
+    {
+        std::sort(it->second.begin(), it->second.end());
+        base = std::min(base, it->second.front().when);
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    out << std::fixed << std::setprecision(3);
+    const char* sep = "\n";
+    size_t pid = 0;
+
+    for (std::map<std::string, std::vector<hop> >::iterator it = m_traces.begin();
+            it != m_traces.end(); ++it)
+    {
+        const std::vector<hop>& hops(it->second);
+        std::map<uint64_t, size_t> tids;
+        ++pid;
+        out << sep << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+            << ",\"args\":{\"name\":\"trace " << it->first << "\"}}";
+        sep = ",\n";
+
+        for (size_t i = 0; i < hops.size(); ++i)
+        {
+            if (tids.find(hops[i].server) == tids.end())
+            {
+                size_t tid = tids.size() + 1;
+                tids[hops[i].server] = tid;
+                out << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+                    << ",\"tid\":" << tid
+                    << ",\"args\":{\"name\":\"server " << hops[i].server << "\"}}";
+            }
+
+            out << sep << "{\"name\":\"" << hops[i].name
+                << "\",\"cat\":\"hyperdex\",\"pid\":" << pid
+                << ",\"tid\":" << tids[hops[i].server]
+                << ",\"ts\":" << (hops[i].when - base) / 1000.;
+
+            if (i + 1 < hops.size())
+            {
+                out << ",\"ph\":\"X\",\"dur\":" << (hops[i + 1].when - hops[i].when) / 1000.;
+            }
+            else
+            {
+                out << ",\"ph\":\"i\",\"s\":\"t\"";
+            }
+
+            out << ",\"args\":{\"region\":" << hops[i].region << "}}";
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+} // namespace
+
 int
 main(int argc, const char* argv[])
 {
+    bool _summary = false;
+    long _top = 10;
+    long _interval = 10;
+    const char* _trace = NULL;
     hyperdex::connect_opts conn;
     e::argparser ap;
     ap.autohelp();
     ap.add("Connect to a cluster:", conn.parser());
+    ap.arg().name('s', "summary")
+            .description("instead of every counter, periodically print the load on each space and the busiest regions")
+            .set_true(&_summary);
+    ap.arg().name('n', "top")
+            .description("with --summary, print this many regions (default: 10)")
+            .metavar("N").as_long(&_top);
+    ap.arg().name('i', "interval")
+            .description("with --summary, seconds between summaries; with --trace, seconds to collect traces (default: 10)")
+            .metavar("S").as_long(&_interval);
+    ap.arg().name('t', "trace")
+            .description("collect the timelines of traced writes and write them to FILE in the Chrome trace format")
+            .metavar("FILE").as_string(&_trace);
 
     if (!ap.parse(argc, argv))
     {
@@ -62,6 +389,12 @@ main(int argc, const char* argv[])
         return EXIT_FAILURE;
     }
 
+    if (_top < 0 || _interval <= 0)
+    {
+        std::cerr << "--top must be non-negative and --interval positive" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     try
     {
         hyperdex::Admin h(conn.host(), conn.port());
@@ -69,6 +402,9 @@ main(int argc, const char* argv[])
         hyperdex_admin_perf_counter pc;
         int64_t pid = h.enable_perf_counters(&prc, &pc);
         assert(pid>=0);
+        summary sum;
+        timeline tl;
+        time_t next_summary = time(NULL) + _interval;
 
         while(true)
         {
@@ -82,7 +418,43 @@ main(int argc, const char* argv[])
 
             assert(lid==pid);
             assert(prc == HYPERDEX_ADMIN_SUCCESS);
-            std::cout << pc.id << " " << pc.time << " " << pc.property << " = " << pc.measurement << std::endl;
+
+            if (_trace)
+            {
+                tl.observe(pc);
+
+                if (time(NULL) < next_summary)
+                {
+                    continue;
+                }
+
+                std::ofstream fout(_trace);
+                tl.write(fout);
+                fout.flush();
+
+                if (!fout)
+                {
+                    std::cerr << "could not write " << _trace << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                std::cout << "wrote " << tl.traces() << " traces to " << _trace << std::endl;
+                return EXIT_SUCCESS;
+            }
+
+            if (!_summary)
+            {
+                std::cout << pc.id << " " << pc.time << " " << pc.property << " = " << pc.measurement << std::endl;
+                continue;
+            }
+
+            sum.observe(pc);
+
+            if (time(NULL) >= next_summary)
+            {
+                sum.print(std::cout, _top);
+                next_summary = time(NULL) + _interval;
+            }
         }
 
         return EXIT_SUCCESS;